@@ -0,0 +1,27 @@
+# - Find liburing
+# Find the io_uring library and includes
+#
+# URING_INCLUDE_DIR - where to find liburing.h, etc.
+# URING_LIBRARIES - List of libraries when using liburing.
+# URING_FOUND - True if liburing found.
+
+find_path(URING_INCLUDE_DIR liburing.h)
+find_library(URING_LIBRARIES uring)
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(uring DEFAULT_MSG URING_LIBRARIES URING_INCLUDE_DIR)
+
+if(URING_FOUND)
+  if(NOT TARGET uring::uring)
+    add_library(uring::uring UNKNOWN IMPORTED)
+  endif()
+  set_target_properties(uring::uring PROPERTIES
+    INTERFACE_INCLUDE_DIRECTORIES "${URING_INCLUDE_DIR}"
+    IMPORTED_LINK_INTERFACE_LANGUAGES "C"
+    IMPORTED_LOCATION "${URING_LIBRARIES}")
+endif()
+
+mark_as_advanced(
+  URING_INCLUDE_DIR
+  URING_LIBRARIES
+)
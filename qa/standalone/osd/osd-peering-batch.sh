@@ -0,0 +1,105 @@
+#!/usr/bin/env bash
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU Library Public License as published by
+# the Free Software Foundation; either version 2, or (at your option)
+# any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Library Public License for more details.
+#
+
+source $CEPH_ROOT/qa/standalone/ceph-helpers.sh
+
+function run() {
+    local dir=$1
+    shift
+
+    export CEPH_MON="127.0.0.1:7150" # git grep '\<7150\>' : there must be only one
+    export CEPH_ARGS
+    CEPH_ARGS+="--fsid=$(uuidgen) --auth-supported=none "
+    CEPH_ARGS+="--mon-host=$CEPH_MON "
+    CEPH_ARGS+="--osd_pool_default_size=2 "
+
+    local funcs=${@:-$(set | sed -n -e 's/^\(TEST_[0-9a-z_]*\) .*/\1/p')}
+    for func in $funcs ; do
+        setup $dir || return 1
+        $func $dir || return 1
+        teardown $dir || return 1
+    done
+}
+
+function get_osd_counter() {
+    local osd=$1
+    local counter=$2
+
+    ceph daemon osd.$osd perf dump | jq ".osd.$counter"
+}
+
+# bring up two osds with the given peering batch settings, create a pool
+# and make every pg peer again by marking osd.1 down
+function peer_pgs() {
+    local dir=$1
+    shift
+
+    run_mon $dir a || return 1
+    run_mgr $dir x || return 1
+    for id in 0 1 ; do
+        run_osd $dir $id "$@" || return 1
+    done
+    create_pool foo 64 64 || return 1
+    wait_for_clean || return 1
+
+    ceph osd down 1 || return 1
+    wait_for_clean || return 1
+}
+
+function TEST_peering_batch_off() {
+    local dir=$1
+
+    peer_pgs $dir || return 1
+    for id in 0 1 ; do
+        test $(get_osd_counter $id peering_batch_sent) = 0 || return 1
+    done
+}
+
+function TEST_peering_batch_coalesce() {
+    local dir=$1
+    local max_pgs=16
+
+    # pgs only peer in the right order if notifies, queries and infos
+    # sent in batches still reach the peers in the order they were queued
+    peer_pgs $dir --osd_peering_batch_max_pgs=$max_pgs \
+        --osd_peering_batch_max_delay=1 || return 1
+    for id in 0 1 ; do
+        local sent=$(get_osd_counter $id peering_batch_sent)
+        local pgs=$(get_osd_counter $id peering_batch_pgs)
+        test $sent -gt 0 || return 1
+        # several pgs share a batch, and no batch grows past max_pgs
+        test $pgs -gt $sent || return 1
+        test $pgs -le $(($sent * $max_pgs)) || return 1
+    done
+}
+
+function TEST_peering_batch_max_delay() {
+    local dir=$1
+
+    # max_pgs is never reached, so batches go out when the shard runs out
+    # of work or after max_delay, whichever comes first
+    peer_pgs $dir --osd_peering_batch_max_pgs=1000 \
+        --osd_peering_batch_max_delay=0.1 || return 1
+    for id in 0 1 ; do
+        test $(get_osd_counter $id peering_batch_sent) -gt 0 || return 1
+        local waited=$(get_osd_counter $id peering_batch_lat.avgtime)
+        echo "osd.$id peering batches waited ${waited}s on average"
+        test $(echo "$waited <= 0.1" | bc) = 1 || return 1
+    done
+}
+
+main osd-peering-batch "$@"
+
+# Local Variables:
+# compile-command: "make -j4 && ../qa/run-standalone.sh osd-peering-batch.sh"
+# End:
@@ -106,6 +106,93 @@ function TEST_scrub_test() {
     teardown $dir || return 1
 }
 
+# Deep scrub reads several strides, across objects, per work item.  Make
+# sure an object whose digest is built up over several work items still
+# gets compared correctly.
+function TEST_deep_scrub_work_item() {
+    local dir=$1
+    local poolname=test
+    local OSDS=3
+    local objects=5
+
+    TESTDATA="testdata.$$"
+
+    setup $dir || return 1
+    run_mon $dir a --osd_pool_default_size=3 || return 1
+    run_mgr $dir x || return 1
+    local ceph_osd_args="--osd_deep_scrub_stride=4096 "
+    ceph_osd_args+="--osd_deep_scrub_work_item_bytes=16384"
+    for osd in $(seq 0 $(expr $OSDS - 1))
+    do
+      run_osd $dir $osd $ceph_osd_args || return 1
+    done
+
+    # Create a pool with a single pg
+    create_pool $poolname 1 1
+    wait_for_clean || return 1
+    poolid=$(ceph osd dump | grep "^pool.*[']${poolname}[']" | awk '{ print $2 }')
+
+    dd if=/dev/urandom of=$TESTDATA bs=1024 count=100
+    for i in `seq 1 $objects`
+    do
+        rados -p $poolname put obj${i} $TESTDATA
+    done
+
+    local pgid="${poolid}.0"
+    pg_deep_scrub "$pgid" || return 1
+    ceph pg dump pgs | grep ^${pgid} | grep -vq -- +inconsistent || return 1
+
+    # change only the last byte of one replica
+    cp $TESTDATA $TESTDATA.bad
+    printf 'x' | dd of=$TESTDATA.bad bs=1 seek=102399 conv=notrunc
+    cmp -s $TESTDATA $TESTDATA.bad && return 1
+    local otherosd=$(get_not_primary $poolname obj3)
+    objectstore_tool $dir $otherosd obj3 set-bytes $TESTDATA.bad
+    rm -f $TESTDATA $TESTDATA.bad
+
+    pg_deep_scrub "$pgid" || return 1
+    ceph pg dump pgs | grep ^${pgid} | grep -q -- +inconsistent || return 1
+    test "$(rados list-inconsistent-obj $pgid | jq -r '.inconsistents[].object.name')" = "obj3" || return 1
+
+    teardown $dir || return 1
+}
+
+# osd_deep_scrub_max_bytes_per_sec must slow deep scrub down to its rate.
+function TEST_deep_scrub_max_bytes_per_sec() {
+    local dir=$1
+    local poolname=test
+    local objects=4
+
+    TESTDATA="testdata.$$"
+
+    setup $dir || return 1
+    run_mon $dir a --osd_pool_default_size=1 || return 1
+    run_mgr $dir x || return 1
+    run_osd $dir 0 || return 1
+
+    create_pool $poolname 1 1
+    wait_for_clean || return 1
+    poolid=$(ceph osd dump | grep "^pool.*[']${poolname}[']" | awk '{ print $2 }')
+
+    dd if=/dev/urandom of=$TESTDATA bs=1024 count=1024
+    for i in `seq 1 $objects`
+    do
+        rados -p $poolname put obj${i} $TESTDATA
+    done
+    rm -f $TESTDATA
+
+    # 4 MB at 1 MB/s
+    ceph tell osd.0 injectargs -- --osd_deep_scrub_max_bytes_per_sec=1048576 || return 1
+    local pgid="${poolid}.0"
+    local start=$(date +%s)
+    pg_deep_scrub "$pgid" || return 1
+    local elapsed=$(expr $(date +%s) - $start)
+    test $elapsed -ge 3 || return 1
+    ceph pg dump pgs | grep ^${pgid} | grep -vq -- +inconsistent || return 1
+
+    teardown $dir || return 1
+}
+
 main osd-scrub-test "$@"
 
 # Local Variables:
@@ -1021,6 +1021,16 @@ using namespace ceph;
     size_t length, uint32_t crc)
   {
     length = std::min<size_t>(length, get_remaining());
+    if (length > 0 && p->length() - p_off >= length) {
+      uint32_t bcrc;
+      if (p->get_raw()->get_block_crc(p->offset() + p_off, length, &bcrc)) {
+	if (buffer_track_crc)
+	  buffer_cached_crc_adjusted++;
+	advance(length);
+	// see list::crc32c() for the initial value adjustment
+	return bcrc ^ ceph_crc32c(-1 ^ crc, NULL, length);
+      }
+    }
     while (length > 0) {
       const char *p;
       size_t l = get_ptr_and_advance(length, &p);
@@ -1541,8 +1551,13 @@ using namespace ceph;
 	return;
       }
     }
-    // add new item to list
-    push_back(ptr_node::create(bp, off, len));
+    // add new item to list. the first segment of our append_buffer lives
+    // in the node storage of its raw, saving an allocation.
+    if (&bp == &append_buffer) {
+      push_back(ptr_node::create_exclusive(bp, off, len));
+    } else {
+      push_back(ptr_node::create(bp, off, len));
+    }
   }
 
   void buffer::list::append(const list& bl)
@@ -2042,6 +2057,35 @@ __u32 buffer::list::crc32c(__u32 crc) const
   return crc;
 }
 
+__u32 buffer::list::crc32c_blocks(__u32 crc, unsigned block_size) const
+{
+  ceph_assert(block_size);
+  for (const auto& node : _buffers) {
+    if (!node.length()) {
+      continue;
+    }
+    auto p = (const unsigned char*)node.c_str();
+    unsigned left = node.length();
+    std::vector<uint32_t> crcs;
+    crcs.reserve(left / block_size);
+    while (left >= block_size) {
+      uint32_t bcrc = ceph_crc32c(-1, p, block_size);
+      crcs.push_back(bcrc);
+      crc = bcrc ^ ceph_crc32c(-1 ^ crc, NULL, block_size);
+      p += block_size;
+      left -= block_size;
+    }
+    if (left) {
+      crc = ceph_crc32c(crc, p, left);
+    }
+    if (!crcs.empty()) {
+      node.get_raw()->set_block_crcs(node.offset(), block_size,
+				     std::move(crcs));
+    }
+  }
+  return crc;
+}
+
 void buffer::list::invalidate_crc()
 {
   for (const auto& node : _buffers) {
@@ -2180,6 +2224,23 @@ bool buffer::ptr_node::dispose_if_hypercombined(
   return is_hypercombined;
 }
 
+void* buffer::ptr_node::unused_raw_storage(const buffer::ptr& p)
+{
+  // a node placed in the raw holds a reference to it. so if p holds the
+  // only one, the storage is unused unless p is that very node. p is
+  // either an rvalue or exclusively accessed by our caller, so nobody can
+  // take another reference meanwhile. make_shareable() swaps the raw out
+  // from under its ptr, so a node must never live in an unshareable raw.
+  buffer::raw* const r = p.get_raw();
+  if (r && r->nref.load(std::memory_order_acquire) == 1 &&
+      &p != static_cast<const ptr*>(
+	reinterpret_cast<const ptr_node*>(&r->bptr_storage)) &&
+      r->is_shareable()) {
+    return &r->bptr_storage;
+  }
+  return nullptr;
+}
+
 std::unique_ptr<buffer::ptr_node, buffer::ptr_node::disposer>
 buffer::ptr_node::create_hypercombined(buffer::raw* const r)
 {
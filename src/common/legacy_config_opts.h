@@ -120,6 +120,7 @@ OPTION(ms_tcp_prefetch_max_size, OPT_U32) // max prefetch size, we limit this to
 OPTION(ms_initial_backoff, OPT_DOUBLE)
 OPTION(ms_max_backoff, OPT_DOUBLE)
 OPTION(ms_crc_data, OPT_BOOL)
+OPTION(ms_crc_data_block_size, OPT_U64)
 OPTION(ms_crc_header, OPT_BOOL)
 OPTION(ms_die_on_bad_msg, OPT_BOOL)
 OPTION(ms_die_on_unhandled_msg, OPT_BOOL)
@@ -147,6 +148,8 @@ OPTION(ms_dump_on_send, OPT_BOOL)           // hexdump msg to log on send
 OPTION(ms_dump_corrupt_message_level, OPT_INT)  // debug level to hexdump undecodeable messages at
 OPTION(ms_async_op_threads, OPT_U64)            // number of worker processing threads for async messenger created on init
 OPTION(ms_async_max_op_threads, OPT_U64)        // max number of worker processing threads for async messenger
+OPTION(ms_async_send_batch_msgs, OPT_U64)       // max queued messages written to the socket at once
+OPTION(ms_async_send_batch_bytes, OPT_U64)      // write a batch of queued messages once it reaches this size
 OPTION(ms_async_set_affinity, OPT_BOOL)
 // example: ms_async_affinity_cores = 0,1
 // The number of coreset is expected to equal to ms_async_op_threads, otherwise
@@ -154,6 +157,8 @@ OPTION(ms_async_set_affinity, OPT_BOOL)
 // If ms_async_affinity_cores is empty, all threads will be bind to current running
 // core
 OPTION(ms_async_affinity_cores, OPT_STR)
+OPTION(ms_async_affinity_iface, OPT_STR)
+OPTION(ms_async_worker_placement, OPT_STR)
 OPTION(ms_async_rdma_device_name, OPT_STR)
 OPTION(ms_async_rdma_enable_hugepage, OPT_BOOL)
 OPTION(ms_async_rdma_buffer_size, OPT_INT)
@@ -175,6 +180,11 @@ OPTION(ms_async_rdma_dscp, OPT_INT)            // in RoCE, this means DSCP
 OPTION(ms_async_rdma_cm, OPT_BOOL)
 OPTION(ms_async_rdma_type, OPT_STR)
 
+// io_uring stack
+OPTION(ms_async_uring_queue_depth, OPT_U32)
+OPTION(ms_async_uring_recv_buffer_size, OPT_U64)
+OPTION(ms_async_uring_recv_buffers, OPT_U32)
+
 // when there are enough accept failures, indicating there are unrecoverable failures,
 // just do ceph_abort() . Here we make it configurable.
 OPTION(ms_max_accept_failures, OPT_INT)
@@ -205,6 +215,8 @@ OPTION(mon_osd_cache_size, OPT_INT)  // the size of osdmaps cache, not to rely o
 
 OPTION(mon_cpu_threads, OPT_INT)
 OPTION(mon_osd_mapping_pgs_per_chunk, OPT_INT)
+OPTION(mon_osd_mapping_incremental_max_pgs, OPT_U64)
+OPTION(mon_osd_mapping_incremental_verify, OPT_BOOL)
 OPTION(mon_osd_max_creating_pgs, OPT_INT)
 OPTION(mon_tick_interval, OPT_INT)
 OPTION(mon_session_timeout, OPT_INT)    // must send keepalive or subscribe
@@ -734,6 +746,8 @@ OPTION(osd_scrub_interval_randomize_ratio, OPT_FLOAT) // randomize the scheduled
 OPTION(osd_scrub_backoff_ratio, OPT_DOUBLE)   // the probability to back off the scheduled scrub
 OPTION(osd_scrub_chunk_min, OPT_INT)
 OPTION(osd_scrub_chunk_max, OPT_INT)
+OPTION(osd_peering_batch_max_pgs, OPT_U64)
+OPTION(osd_peering_batch_max_delay, OPT_FLOAT)
 OPTION(osd_scrub_sleep, OPT_FLOAT)   // sleep between [deep]scrub ops
 OPTION(osd_scrub_auto_repair, OPT_BOOL)   // whether auto-repair inconsistencies upon deep-scrubbing
 OPTION(osd_scrub_auto_repair_num_errors, OPT_U32)   // only auto-repair when number of errors is below this threshold
@@ -741,6 +755,9 @@ OPTION(osd_deep_scrub_interval, OPT_FLOAT) // once a week
 OPTION(osd_deep_scrub_randomize_ratio, OPT_FLOAT) // scrubs will randomly become deep scrubs at this rate (0.15 -> 15% of scrubs are deep)
 OPTION(osd_deep_scrub_stride, OPT_INT)
 OPTION(osd_deep_scrub_keys, OPT_INT)
+OPTION(osd_deep_scrub_work_item_bytes, OPT_U64)
+OPTION(osd_deep_scrub_max_bytes_per_sec, OPT_U64)
+OPTION(osd_deep_scrub_use_store_csum, OPT_BOOL)
 OPTION(osd_deep_scrub_update_digest_min_age, OPT_INT)   // objects must be this old (seconds) before we update the whole-object digest on scrub
 OPTION(osd_skip_data_digest, OPT_BOOL)
 OPTION(osd_deep_scrub_large_omap_object_key_threshold, OPT_U64)
@@ -900,6 +900,13 @@ std::vector<Option> get_global_options() {
     .set_default(true)
     .set_description(""),
 
+    Option("ms_crc_data_block_size", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(0)
+    .set_description("Remember received data crcs per block of this size")
+    .set_long_description("When nonzero, the data crc of each received message is computed in blocks of this size and the per-block crcs are kept with the buffers.  A store checksumming the same data with crc32c in the same block size (e.g. bluestore with bluestore_csum_type=crc32c and a matching csum chunk) then reuses them instead of reading the data again.  Only blocks that line up with the store's checksum chunks are reused.")
+    .add_see_also("ms_crc_data")
+    .add_see_also("bluestore_csum_type"),
+
     Option("ms_crc_header", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
     .set_default(true)
     .set_description(""),
@@ -1040,13 +1047,41 @@ std::vector<Option> get_global_options() {
     .set_default(5)
     .set_description(""),
 
+    Option("ms_async_send_batch_msgs", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(32)
+    .set_description("Maximum number of queued messages a connection writes to its socket at once")
+    .set_long_description("Only messages that are already queued are batched; a lone message is sent right away.")
+    .add_see_also("ms_async_send_batch_bytes"),
+
+    Option("ms_async_send_batch_bytes", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(64_K)
+    .set_description("Size at which a batch of queued messages is written to the socket (0 to write each message separately)")
+    .add_see_also("ms_async_send_batch_msgs"),
+
     Option("ms_async_set_affinity", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
-    .set_default(true)
-    .set_description(""),
+    .set_default(false)
+    .set_description("Pin messenger worker threads to CPUs")
+    .set_long_description("The CPUs are taken from ms_async_affinity_cores, or else from the NUMA node of ms_async_affinity_iface.  Neither option pins any thread unless this is set.")
+    .add_see_also("ms_async_affinity_cores")
+    .add_see_also("ms_async_affinity_iface"),
 
     Option("ms_async_affinity_cores", Option::TYPE_STR, Option::LEVEL_ADVANCED)
     .set_default("")
-    .set_description(""),
+    .set_description("Comma-separated list of CPUs to pin messenger workers to")
+    .set_long_description("Only used when ms_async_set_affinity is true.  Workers beyond the number of listed CPUs wrap around the list.")
+    .add_see_also("ms_async_set_affinity"),
+
+    Option("ms_async_affinity_iface", Option::TYPE_STR, Option::LEVEL_ADVANCED)
+    .set_default("")
+    .set_description("Pin messenger workers to the CPUs of this network interface's NUMA node")
+    .set_long_description("Only used by the posix stack, when ms_async_set_affinity is true and ms_async_affinity_cores is empty.")
+    .add_see_also("ms_async_affinity_cores"),
+
+    Option("ms_async_worker_placement", Option::TYPE_STR, Option::LEVEL_ADVANCED)
+    .set_default("connections")
+    .set_enum_allowed({"connections", "load"})
+    .set_description("How a new connection picks its messenger worker")
+    .set_long_description("'connections' picks the worker with the fewest connections.  'load' also weighs the traffic each worker has recently handled, so that a few busy connections do not all end up on one worker."),
 
     Option("ms_async_rdma_device_name", Option::TYPE_STR, Option::LEVEL_ADVANCED)
     .set_default("")
@@ -1113,6 +1148,21 @@ std::vector<Option> get_global_options() {
     .set_default("ib")
     .set_description(""),
 
+    Option("ms_async_uring_queue_depth", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(1024)
+    .set_description("Submission queue entries of each io_uring worker's ring (ms_type=async+uring)"),
+
+    Option("ms_async_uring_recv_buffer_size", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(64_K)
+    .set_description("Size of each buffer provided to the kernel for io_uring socket receives")
+    .add_see_also("ms_async_uring_recv_buffers"),
+
+    Option("ms_async_uring_recv_buffers", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(128)
+    .set_min(1)
+    .set_description("Number of receive buffers each io_uring worker shares among its connections")
+    .add_see_also("ms_async_uring_recv_buffer_size"),
+
     Option("ms_dpdk_port_id", Option::TYPE_INT, Option::LEVEL_ADVANCED)
     .set_default(0)
     .set_description(""),
@@ -1264,6 +1314,16 @@ std::vector<Option> get_global_options() {
     .set_default(4096)
     .set_description(""),
 
+    Option("mon_osd_mapping_incremental_max_pgs", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(4096)
+    .set_description("Maximum number of PGs to remap incrementally for a new OSDMap")
+    .set_long_description("When an OSDMap incremental (e.g., a pg_temp change or a few OSDs marked down) affects no more than this many PGs, the monitor only recalculates the mappings of those PGs instead of starting a full mapping job. 0 disables incremental updates.")
+    .add_see_also("mon_osd_mapping_incremental_verify"),
+
+    Option("mon_osd_mapping_incremental_verify", Option::TYPE_BOOL, Option::LEVEL_DEV)
+    .set_default(false)
+    .set_description("Cross-check incremental PG mapping updates against a full recalculation"),
+
     Option("mon_osd_max_creating_pgs", Option::TYPE_INT, Option::LEVEL_ADVANCED)
     .set_default(1024)
     .set_description("Maximum number of PGs the mon will create at once"),
@@ -3153,6 +3213,24 @@ std::vector<Option> get_global_options() {
     .set_default(1024)
     .set_description("Number of keys to read from an object at a time during deep scrub"),
 
+    Option("osd_deep_scrub_work_item_bytes", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(4_M)
+    .set_description("Number of object bytes deep scrub reads before requeueing itself")
+    .set_long_description("Deep scrub reads object data osd_deep_scrub_stride bytes at a time.  Up to this many bytes are read back to back, across object boundaries, before the scrub yields and requeues itself in the op queue.  0 yields after every stride.")
+    .add_see_also("osd_deep_scrub_stride"),
+
+    Option("osd_deep_scrub_max_bytes_per_sec", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(0)
+    .set_description("Maximum rate at which deep scrubs on an OSD read object data (0 for unlimited)")
+    .set_long_description("When the budget is exhausted, a deep scrub is not requeued until enough budget has accumulated, leaving the op queue to other work in the meantime.")
+    .add_see_also("osd_deep_scrub_work_item_bytes"),
+
+    Option("osd_deep_scrub_use_store_csum", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(false)
+    .set_description("Rely on the object store's checksums instead of computing data digests during deep scrub")
+    .set_long_description("If the object store verifies checksums on every read (e.g., BlueStore), deep scrub still reads all object data, which catches media errors, but skips computing a data digest over it.  Scrub maps from replicated pools then carry no data digest, so replicas whose data differs without a checksum error are not detected, the data digest recorded in the object info is neither checked nor updated (osd_deep_scrub_update_digest_min_age has no effect), and repair cannot use data digests to pick an authoritative copy.  Omap digests are always computed.  Erasure coded pools ignore this option.")
+    .add_see_also("osd_deep_scrub_update_digest_min_age"),
+
     Option("osd_deep_scrub_update_digest_min_age", Option::TYPE_INT, Option::LEVEL_ADVANCED)
     .set_default(2_hr)
     .set_description("Update overall object digest only if object was last modified longer ago than this"),
@@ -3606,6 +3684,18 @@ std::vector<Option> get_global_options() {
     .set_default(255)
     .set_description(""),
 
+    Option("osd_peering_batch_max_pgs", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(0)
+    .set_description("Maximum number of PGs whose peering messages are coalesced into one message per peer (0 to send them right away)")
+    .set_long_description("Batching is disabled by default.  A value such as 64 reduces the number of peering messages when many PGs peer at once, at the cost of up to osd_peering_batch_max_delay of added latency.")
+    .add_see_also("osd_peering_batch_max_delay"),
+
+    Option("osd_peering_batch_max_delay", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(.005)
+    .set_description("Maximum time peering messages wait to be coalesced with other PGs' messages")
+    .set_long_description("Batched peering messages are also sent as soon as the shard that generated them has no more queued work.")
+    .add_see_also("osd_peering_batch_max_pgs"),
+
     Option("osd_snap_trim_priority", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
     .set_default(5)
     .set_description(""),
@@ -6572,11 +6662,70 @@ static std::vector<Option> get_rbd_options() {
     .set_default(false)
     .set_description("whether to block writes to the cache before the aio_write call completes"),
 
+    Option("rbd_cache_shards", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(1)
+    .set_min(1)
+    .set_description("number of independently locked caches an image's objects are spread across")
+    .set_long_description("The cache size and dirty limits are divided evenly "
+                          "between the shards, and each shard runs its own "
+                          "flusher thread."),
+
+    Option("rbd_persistent_cache_enabled", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(false)
+    .set_description("whether to cache writes in a persistent log on a local device")
+    .set_long_description("Writes are acked once they are stable in the log, "
+                          "and are written back to the image in order. The "
+                          "log is opened along with the exclusive lock. "
+                          "rbd_cache is disabled for writable images using "
+                          "it, so that a write is only retired from the log "
+                          "once it is stable in the cluster."),
+
+    Option("rbd_persistent_cache_path", Option::TYPE_STR, Option::LEVEL_ADVANCED)
+    .set_default("/var/lib/ceph/rbd-persistent-cache")
+    .set_description("directory holding the persistent cache logs")
+    .set_long_description("The directory must survive a reboot: a log on "
+                          "tmpfs loses the writes it holds."),
+
+    Option("rbd_persistent_cache_size", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(1_G)
+    .set_description("size in bytes of the persistent cache log of an image"),
+
+    Option("rbd_persistent_cache_max_writeback", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(32)
+    .set_min(1)
+    .set_description("maximum number of persistent cache log entries written back concurrently"),
+
+    Option("rbd_shared_cache_enabled", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(false)
+    .set_description("whether to cache the parent snapshot objects of clones in a directory shared by all clients of the host")
+    .set_long_description("Objects are fetched whole on the first read and "
+                          "are never evicted. The cache is only readable by "
+                          "the user creating it, so all clients sharing it "
+                          "must run as that user. The directory must only be "
+                          "writable by trusted clients."),
+
+    Option("rbd_shared_cache_path", Option::TYPE_STR, Option::LEVEL_ADVANCED)
+    .set_default("/var/cache/ceph/rbd-shared-cache")
+    .set_description("directory holding the shared parent image cache"),
+
     Option("rbd_concurrent_management_ops", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
     .set_default(10)
     .set_min(1)
     .set_description("how many operations can be in flight for a management operation like deleting or resizing an image"),
 
+    Option("rbd_deep_copy_concurrent_objects", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(0)
+    .set_description("how many objects can be copied in parallel by a deep copy or migration")
+    .set_long_description("If zero, rbd_concurrent_management_ops is used."),
+
+    Option("rbd_deep_copy_skip_zeroes", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(false)
+    .set_description("do not write zeroed data when deep copying or migrating an image")
+    .set_long_description("Allocated extents which only hold zeros are "
+                          "treated like holes, so the copy is sparse even "
+                          "if the source image was thick provisioned. An "
+                          "object which only holds zeros is not created."),
+
     Option("rbd_balance_snap_reads", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
     .set_default(false)
     .set_description("distribute snap read requests to random OSD"),
@@ -6617,6 +6766,37 @@ static std::vector<Option> get_rbd_options() {
     .set_default(50_M)
     .set_description("how many bytes are read in total before readahead is disabled"),
 
+    Option("rbd_readahead_objects", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(0)
+    .set_description("number of whole objects to prefetch ahead of sequential reads when the cache is disabled")
+    .set_long_description("Set to 0 to disable object readahead. It does not apply to images striped over several objects."),
+
+    Option("rbd_readahead_streams", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(4)
+    .set_min(1)
+    .set_description("number of sequential read streams tracked per image by object readahead"),
+
+    Option("rbd_readahead_buffer_max_bytes", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(64_M)
+    .set_description("maximum size of the objects buffered by object readahead"),
+
+    Option("rbd_write_coalesce", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(false)
+    .set_description("merge sequential writes to an object while earlier writes are in flight")
+    .set_long_description("Only applies when the cache is disabled. Writes "
+                          "which do not continue the previous write to the "
+                          "object are sent right away. Journaled writes are "
+                          "never merged."),
+
+    Option("rbd_write_coalesce_max_bytes", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(1_M)
+    .set_description("maximum size of a coalesced object write"),
+
+    Option("rbd_write_coalesce_max_delay", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(0.001)
+    .set_min(0)
+    .set_description("maximum time a write waits to be coalesced, seconds"),
+
     Option("rbd_clone_copy_on_read", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
     .set_default(false)
     .set_description("copy-up parent image blocks to clone upon read request"),
@@ -6758,6 +6938,14 @@ static std::vector<Option> get_rbd_options() {
     .set_default(0)
     .set_description("maximum number of object sets a journal client can be behind before it is automatically unregistered"),
 
+    Option("rbd_journal_replay_max_concurrent_writes", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(1)
+    .set_min(1)
+    .set_description("maximum number of non-overlapping writes applied concurrently when replaying the journal")
+    .set_long_description("Only applies when the writeback cache is disabled. "
+                          "Overlapping writes, discards and flushes are still "
+                          "applied in journal order."),
+
     Option("rbd_qos_iops_limit", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
     .set_default(0)
     .set_description("the desired limit of IO operations per second"),
@@ -19,6 +19,8 @@
 #include "include/util.h"
 #include "common/debug.h"
 #include "common/errno.h"
+#include "include/str_list.h"
+#include "common/strtol.h"
 #include "common/version.h"
 
 #ifdef HAVE_SYS_VFS_H
@@ -34,6 +36,7 @@
 #endif
 #endif
 
+#include <algorithm>
 #include <string>
 
 #include <stdio.h>
@@ -321,6 +324,32 @@ string cleanbin(string &str)
   return result;
 }
 
+int parse_cpu_list(const string& s, vector<int> *cpus)
+{
+  vector<int> result;
+  vector<string> ranges;
+  get_str_vec(s, ", \t\n", ranges);
+  for (auto& range : ranges) {
+    string err;
+    auto dash = range.find('-');
+    int first = strict_strtol(range.substr(0, dash).c_str(), 10, &err);
+    if (!err.empty() || first < 0)
+      return -EINVAL;
+    int last = first;
+    if (dash != string::npos) {
+      last = strict_strtol(range.substr(dash + 1).c_str(), 10, &err);
+      if (!err.empty() || last < first)
+        return -EINVAL;
+    }
+    for (int cpu = first; cpu <= last; ++cpu)
+      result.push_back(cpu);
+  }
+  std::sort(result.begin(), result.end());
+  result.erase(std::unique(result.begin(), result.end()), result.end());
+  cpus->swap(result);
+  return 0;
+}
+
 std::string bytes2str(uint64_t count) {
   static char s[][2] = {"\0", "k", "M", "G", "T", "P", "E", "\0"};
   int i = 0;
@@ -14,6 +14,8 @@
 
 #pragma once
 
+#include <functional>
+#include <vector>
 #include <seastar/core/future.hh>
 
 #include "Fwd.h"
@@ -55,6 +57,17 @@ class Messenger {
   /// after this future becomes available
   virtual seastar::future<> shutdown() = 0;
 
+  /// picks the shard (reactor core) that should dispatch a message
+  using shard_router_t = std::function<unsigned (const Message&)>;
+
+  /// dispatch each received message on the shard picked by @c router, with
+  /// @c dispatchers[shard], which must live on that shard. messages for
+  /// other shards are handed over in batches; the connection passed along
+  /// with them forwards send() back to the connection's own shard. the
+  /// messenger's own dispatcher still handles everything else.
+  virtual void set_shard_router(shard_router_t router,
+                                std::vector<Dispatcher*> dispatchers) = 0;
+
   uint32_t get_global_seq(uint32_t old=0) {
     if (old > global_seq) {
       global_seq = old;
@@ -15,6 +15,7 @@
 #include "SocketMessenger.h"
 
 #include <tuple>
+#include <seastar/core/sharded.hh>
 
 #include "auth/Auth.h"
 #include "Errors.h"
@@ -22,6 +23,72 @@
 
 using namespace ceph::net;
 
+namespace {
+
+/// stands in for a connection of another shard when a message is dispatched
+/// away from it. the addresses, peer type and state are read on the
+/// connection's shard when the message is routed; send(), keepalive() and
+/// close() run on the connection's shard.
+class RoutedConnection final : public Connection {
+ public:
+  // the connections of a routed batch, released on their own shard once
+  // every message of the batch is done with them
+  using batch_refs_t = seastar::lw_shared_ptr<
+    seastar::foreign_ptr<std::unique_ptr<std::vector<ConnectionRef>>>>;
+
+ private:
+  Connection* conn;
+  Messenger* msgr;
+  batch_refs_t refs;
+  const unsigned owner;
+  const bool connected;
+
+  template<typename Func>
+  seastar::future<> on_owner(Func&& func) {
+    return seastar::smp::submit_to(owner, std::forward<Func>(func))
+      .finally([self = ConnectionRef(this)] {});
+  }
+
+ public:
+  RoutedConnection(const SocketMessenger::routed_msg_t& m,
+                   batch_refs_t refs, unsigned owner)
+    : Connection(m.my_addr),
+      conn(m.conn), msgr(m.msgr), refs(std::move(refs)), owner(owner),
+      connected(m.connected) {
+    peer_addr = m.peer_addr;
+    peer_type = m.peer_type;
+  }
+
+  /// the messenger lives on the connection's shard, and may only be used
+  /// from there
+  Messenger* get_messenger() const override {
+    return msgr;
+  }
+  int get_peer_type() const override {
+    return peer_type;
+  }
+  bool is_connected() override {
+    return connected;
+  }
+  seastar::future<> send(MessageRef msg) override {
+    return on_owner([conn = conn, msg = std::move(msg)] () mutable {
+        return conn->send(std::move(msg));
+      });
+  }
+  seastar::future<> keepalive() override {
+    return on_owner([conn = conn] {
+        return conn->keepalive();
+      });
+  }
+  seastar::future<> close() override {
+    return on_owner([conn = conn] {
+        return conn->close();
+      });
+  }
+};
+
+} // anonymous namespace
+
 SocketMessenger::SocketMessenger(const entity_name_t& myname)
   : Messenger{myname}
 {}
@@ -45,6 +112,13 @@ seastar::future<> SocketMessenger::dispatch(SocketConnectionRef conn)
   return seastar::keep_doing([=] {
       return conn->read_message()
         .then([=] (MessageRef msg) {
+          if (shard_router) {
+            if (auto shard = shard_router(*msg);
+                shard != seastar::engine().cpu_id()) {
+              route(conn, std::move(msg), shard);
+              return seastar::now();
+            }
+          }
           // start dispatch, ignoring exceptions from the application layer
           seastar::with_gate(pending_dispatch, [=, msg = std::move(msg)] {
               return dispatcher->ms_dispatch(conn, std::move(msg))
@@ -69,6 +143,60 @@ seastar::future<> SocketMessenger::dispatch(SocketConnectionRef conn)
     });
 }
 
+void SocketMessenger::route(SocketConnectionRef conn, MessageRef msg,
+                            unsigned shard)
+{
+  auto& batch = routed[shard];
+  const bool first = batch.msgs.empty();
+  if (batch.conns.empty() || batch.conns.back() != conn) {
+    batch.conns.push_back(conn);
+  }
+  batch.msgs.push_back(routed_msg_t{conn.get(), conn->get_messenger(),
+                                    conn->get_my_addr(), conn->get_peer_addr(),
+                                    conn->get_peer_type(), conn->is_connected(),
+                                    std::move(msg)});
+  if (batch.msgs.size() >= max_routed_batch) {
+    // ignore exceptions, e.g. from a shut down gate
+    seastar::with_gate(pending_dispatch, [this, shard] {
+        return flush_routed(shard);
+      }).handle_exception([] (std::exception_ptr eptr) {});
+  } else if (first) {
+    // let the other connections with messages ready add to the batch
+    seastar::with_gate(pending_dispatch, [this, shard] {
+        return seastar::later().then([this, shard] {
+            return flush_routed(shard);
+          });
+      }).handle_exception([] (std::exception_ptr eptr) {});
+  }
+}
+
+seastar::future<> SocketMessenger::flush_routed(unsigned shard)
+{
+  if (routed[shard].msgs.empty()) {
+    return seastar::now();
+  }
+  auto batch = std::exchange(routed[shard], routed_batch_t{});
+  auto conns = seastar::make_foreign(
+    std::make_unique<std::vector<ConnectionRef>>(std::move(batch.conns)));
+  return seastar::smp::submit_to(shard,
+    [dispatcher = shard_dispatchers[shard],
+     owner = seastar::engine().cpu_id(),
+     conns = std::move(conns),
+     msgs = std::move(batch.msgs)] () mutable {
+      auto refs = seastar::make_lw_shared(std::move(conns));
+      return seastar::do_with(std::move(msgs),
+        [dispatcher, owner, refs] (auto& msgs) {
+          return seastar::parallel_for_each(msgs,
+            [dispatcher, owner, refs] (auto& m) {
+              ConnectionRef conn = new RoutedConnection(m, refs, owner);
+              // ignore exceptions from the application layer
+              return dispatcher->ms_dispatch(conn, std::move(m.msg))
+                .handle_exception([] (std::exception_ptr eptr) {});
+            });
+        });
+    });
+}
+
 seastar::future<> SocketMessenger::accept(seastar::connected_socket socket,
                                           seastar::socket_address paddr)
 {
@@ -168,6 +296,15 @@ seastar::future<> SocketMessenger::shutdown()
     });
 }
 
+void SocketMessenger::set_shard_router(shard_router_t router,
+                                       std::vector<Dispatcher*> dispatchers)
+{
+  ceph_assert(dispatchers.size() == seastar::smp::count);
+  shard_router = std::move(router);
+  shard_dispatchers = std::move(dispatchers);
+  routed.resize(seastar::smp::count);
+}
+
 void SocketMessenger::set_default_policy(const SocketPolicy& p)
 {
   policy_set.set_default(p);
@@ -30,6 +30,20 @@ namespace ceph::net {
 using SocketPolicy = ceph::net::Policy<ceph::thread::Throttle>;
 
 class SocketMessenger final : public Messenger {
+ public:
+  /// a routed message and the state of its connection, read on the
+  /// connection's shard
+  struct routed_msg_t {
+    Connection* conn;
+    Messenger* msgr;
+    entity_addr_t my_addr;
+    entity_addr_t peer_addr;
+    peer_type_t peer_type;
+    bool connected;
+    MessageRef msg;
+  };
+
+ private:
   std::optional<seastar::server_socket> listener;
   Dispatcher *dispatcher = nullptr;
   std::map<entity_addr_t, SocketConnectionRef> connections;
@@ -38,7 +52,20 @@ class SocketMessenger final : public Messenger {
   ceph::net::PolicySet<Throttle> policy_set;
   seastar::gate pending_dispatch;
 
+  // messages for other shards, see set_shard_router()
+  shard_router_t shard_router;
+  std::vector<Dispatcher*> shard_dispatchers;
+  struct routed_batch_t {
+    /// keeps the connections alive until the batch is done, released here
+    std::vector<ConnectionRef> conns;
+    std::vector<routed_msg_t> msgs;
+  };
+  std::vector<routed_batch_t> routed;  ///< by target shard
+  static constexpr size_t max_routed_batch = 128;
+
   seastar::future<> dispatch(SocketConnectionRef conn);
+  void route(SocketConnectionRef conn, MessageRef msg, unsigned shard);
+  seastar::future<> flush_routed(unsigned shard);
 
   seastar::future<> accept(seastar::connected_socket socket,
                            seastar::socket_address paddr);
@@ -55,6 +82,9 @@ class SocketMessenger final : public Messenger {
 
   seastar::future<> shutdown() override;
 
+  void set_shard_router(shard_router_t router,
+                        std::vector<Dispatcher*> dispatchers) override;
+
   seastar::future<msgr_tag_t, bufferlist>
   verify_authorizer(peer_type_t peer_type,
 		    auth_proto_t protocol,
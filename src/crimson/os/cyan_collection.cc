@@ -0,0 +1,43 @@
+#include "cyan_collection.h"
+
+#include "cyan_object.h"
+
+namespace ceph::os {
+
+Collection::Collection(const coll_t& c)
+  : cid{c}
+{}
+
+Collection::~Collection() = default;
+
+ObjectRef Collection::create_object() const
+{
+  return new ceph::os::Object{};
+}
+
+ObjectRef Collection::get_object(ghobject_t oid)
+{
+  auto o = object_hash.find(oid);
+  if (o == object_hash.end())
+    return ObjectRef();
+  return o->second;
+}
+
+ObjectRef Collection::get_or_create_object(ghobject_t oid)
+{
+  auto result = object_hash.emplace(oid, ObjectRef{});
+  if (result.second)
+    object_map[oid] = result.first->second = create_object();
+  return result.first->second;
+}
+
+uint64_t Collection::used_bytes() const
+{
+  uint64_t result = 0;
+  for (auto& obj : object_map) {
+    result += obj.second->get_size();
+  }
+  return result;
+}
+
+}
@@ -0,0 +1,41 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <boost/intrusive_ptr.hpp>
+#include <boost/smart_ptr/intrusive_ref_counter.hpp>
+
+#include "osd/osd_types.h"
+#include "cyan_object.h"
+
+namespace ceph::os {
+
+/**
+ * a collection of objects in a CyanStore
+ *
+ * like the store owning it, a collection lives on a single shard, so it
+ * does not need to be protected by any lock.
+ */
+struct Collection final : public boost::intrusive_ref_counter<
+  Collection,
+  boost::thread_unsafe_counter>
+{
+  const coll_t cid;
+  int bits = 0;
+  std::unordered_map<ghobject_t, ObjectRef> object_hash;  ///< for lookup
+  std::map<ghobject_t, ObjectRef> object_map;        ///< for iteration
+  bool exists = true;
+
+  explicit Collection(const coll_t& c);
+  ~Collection();
+
+  ObjectRef create_object() const;
+  ObjectRef get_object(ghobject_t oid);
+  ObjectRef get_or_create_object(ghobject_t oid);
+  uint64_t used_bytes() const;
+};
+using CollectionRef = boost::intrusive_ptr<Collection>;
+
+}
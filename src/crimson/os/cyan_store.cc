@@ -0,0 +1,837 @@
+#include "cyan_store.h"
+
+#include <sstream>
+#include <system_error>
+#include <seastar/core/reactor.hh>
+
+#include "common/Formatter.h"
+#include "crimson/common/log.h"
+
+namespace {
+  seastar::logger& logger() {
+    return ceph::get_logger(ceph_subsys_filestore);
+  }
+
+  template<typename T>
+  seastar::future<T> make_errno_future(int r) {
+    return seastar::make_exception_future<T>(
+      std::system_error(-r, std::generic_category()));
+  }
+}
+
+namespace ceph::os {
+
+CyanStore::~CyanStore() = default;
+
+seastar::future<> CyanStore::stop()
+{
+  coll_map.clear();
+  new_coll_map.clear();
+  used_bytes = 0;
+  return seastar::now();
+}
+
+unsigned CyanStore::shard_of(const coll_t& cid)
+{
+  if (spg_t pgid; cid.is_pg(&pgid)) {
+    return pgid.pgid.ps() % seastar::smp::count;
+  } else {
+    return 0;
+  }
+}
+
+CollectionRef CyanStore::create_new_collection(const coll_t& cid)
+{
+  auto c = new Collection{cid};
+  new_coll_map[cid] = c;
+  return c;
+}
+
+CollectionRef CyanStore::open_collection(const coll_t& cid)
+{
+  return _get_collection(cid);
+}
+
+std::vector<coll_t> CyanStore::list_collections() const
+{
+  std::vector<coll_t> collections;
+  for (auto& coll : coll_map) {
+    collections.push_back(coll.first);
+  }
+  return collections;
+}
+
+seastar::future<bufferlist> CyanStore::read(CollectionRef c,
+                                            const ghobject_t& oid,
+                                            uint64_t offset,
+                                            size_t len,
+                                            uint32_t op_flags)
+{
+  logger().debug("{} {} {} {}~{}",
+                __func__, c->cid, oid, offset, len);
+  if (!c->exists) {
+    return make_errno_future<bufferlist>(-ENOENT);
+  }
+  ObjectRef o = c->get_object(oid);
+  if (!o) {
+    return make_errno_future<bufferlist>(-ENOENT);
+  }
+  if (offset >= o->get_size())
+    return seastar::make_ready_future<bufferlist>();
+  size_t l = len;
+  if (l == 0 && offset == 0)  // note: len == 0 means read the entire object
+    l = o->get_size();
+  else if (offset + l > o->get_size())
+    l = o->get_size() - offset;
+  bufferlist bl;
+  o->read(offset, l, bl);
+  return seastar::make_ready_future<bufferlist>(std::move(bl));
+}
+
+seastar::future<uint64_t> CyanStore::stat(CollectionRef c,
+                                          const ghobject_t& oid)
+{
+  ObjectRef o = c->get_object(oid);
+  if (!o) {
+    return make_errno_future<uint64_t>(-ENOENT);
+  }
+  return seastar::make_ready_future<uint64_t>(o->get_size());
+}
+
+seastar::future<ceph::bufferptr> CyanStore::get_attr(CollectionRef c,
+                                                     const ghobject_t& oid,
+                                                     std::string_view name)
+{
+  logger().debug("{} {} {}", __func__, c->cid, oid);
+  ObjectRef o = c->get_object(oid);
+  if (!o) {
+    return make_errno_future<ceph::bufferptr>(-ENOENT);
+  }
+  if (auto found = o->xattr.find(name); found != o->xattr.end()) {
+    return seastar::make_ready_future<ceph::bufferptr>(found->second);
+  } else {
+    return make_errno_future<ceph::bufferptr>(-ENODATA);
+  }
+}
+
+seastar::future<CyanStore::attrs_t> CyanStore::get_attrs(CollectionRef c,
+                                                         const ghobject_t& oid)
+{
+  logger().debug("{} {} {}", __func__, c->cid, oid);
+  ObjectRef o = c->get_object(oid);
+  if (!o) {
+    return make_errno_future<attrs_t>(-ENOENT);
+  }
+  return seastar::make_ready_future<attrs_t>(o->xattr);
+}
+
+seastar::future<CyanStore::omap_values_t>
+CyanStore::omap_get_values(CollectionRef c,
+                           const ghobject_t& oid,
+                           const std::set<std::string>& keys)
+{
+  logger().debug("{} {} {}", __func__, c->cid, oid);
+  ObjectRef o = c->get_object(oid);
+  if (!o) {
+    return make_errno_future<omap_values_t>(-ENOENT);
+  }
+  omap_values_t values;
+  for (auto& key : keys) {
+    if (auto found = o->omap.find(key); found != o->omap.end()) {
+      values.insert(*found);
+    }
+  }
+  return seastar::make_ready_future<omap_values_t>(std::move(values));
+}
+
+seastar::future<CyanStore::omap_values_t>
+CyanStore::omap_get_values(CollectionRef c,
+                           const ghobject_t& oid,
+                           const std::string& start,
+                           uint64_t limit)
+{
+  logger().debug("{} {} {}", __func__, c->cid, oid);
+  ObjectRef o = c->get_object(oid);
+  if (!o) {
+    return make_errno_future<omap_values_t>(-ENOENT);
+  }
+  omap_values_t values;
+  for (auto i = o->omap.upper_bound(start);
+       i != o->omap.end() && values.size() < limit;
+       ++i) {
+    values.insert(*i);
+  }
+  return seastar::make_ready_future<omap_values_t>(std::move(values));
+}
+
+seastar::future<bufferlist> CyanStore::omap_get_header(CollectionRef c,
+                                                       const ghobject_t& oid)
+{
+  ObjectRef o = c->get_object(oid);
+  if (!o) {
+    return make_errno_future<bufferlist>(-ENOENT);
+  }
+  return seastar::make_ready_future<bufferlist>(o->omap_header);
+}
+
+seastar::future<std::vector<ghobject_t>, ghobject_t>
+CyanStore::list_objects(CollectionRef c,
+                        const ghobject_t& start,
+                        const ghobject_t& end,
+                        uint64_t limit)
+{
+  logger().debug("{} {} {} {} {}",
+                 __func__, c->cid, start, end, limit);
+  std::vector<ghobject_t> objects;
+  objects.reserve(limit);
+  ghobject_t next = ghobject_t::get_max();
+  for (auto i = c->object_map.lower_bound(start);
+       i != c->object_map.end();
+       ++i) {
+    if (objects.size() >= limit || i->first >= end) {
+      next = i->first;
+      break;
+    }
+    objects.push_back(i->first);
+  }
+  return seastar::make_ready_future<std::vector<ghobject_t>, ghobject_t>(
+    std::move(objects), next);
+}
+
+seastar::future<> CyanStore::do_transaction(CollectionRef ch,
+                                            Transaction&& t)
+{
+  _do_transaction(t);
+  for (auto i : {t.get_on_applied_sync(),
+                 t.get_on_applied(),
+                 t.get_on_commit()}) {
+    if (i) {
+      i->complete(0);
+    }
+  }
+  return seastar::now();
+}
+
+void CyanStore::_do_transaction(Transaction& t)
+{
+  auto i = t.begin();
+  int pos = 0;
+
+  while (i.have_op()) {
+    Transaction::Op* op = i.decode_op();
+    int r = 0;
+    switch (auto op_code = op->op; op_code) {
+    case Transaction::OP_NOP:
+      break;
+    case Transaction::OP_TOUCH:
+    {
+      coll_t cid = i.get_cid(op->cid);
+      ghobject_t oid = i.get_oid(op->oid);
+      r = _touch(cid, oid);
+    }
+    break;
+    case Transaction::OP_WRITE:
+    {
+      coll_t cid = i.get_cid(op->cid);
+      ghobject_t oid = i.get_oid(op->oid);
+      uint64_t off = op->off;
+      uint64_t len = op->len;
+      uint32_t fadvise_flags = i.get_fadvise_flags();
+      bufferlist bl;
+      i.decode_bl(bl);
+      r = _write(cid, oid, off, len, bl, fadvise_flags);
+    }
+    break;
+    case Transaction::OP_ZERO:
+    {
+      coll_t cid = i.get_cid(op->cid);
+      ghobject_t oid = i.get_oid(op->oid);
+      r = _zero(cid, oid, op->off, op->len);
+    }
+    break;
+    case Transaction::OP_TRIMCACHE:
+      // deprecated, no-op
+      break;
+    case Transaction::OP_TRUNCATE:
+    {
+      coll_t cid = i.get_cid(op->cid);
+      ghobject_t oid = i.get_oid(op->oid);
+      r = _truncate(cid, oid, op->off);
+    }
+    break;
+    case Transaction::OP_REMOVE:
+    case Transaction::OP_COLL_REMOVE:
+    {
+      coll_t cid = i.get_cid(op->cid);
+      ghobject_t oid = i.get_oid(op->oid);
+      r = _remove(cid, oid);
+    }
+    break;
+    case Transaction::OP_SETATTR:
+    {
+      coll_t cid = i.get_cid(op->cid);
+      ghobject_t oid = i.get_oid(op->oid);
+      std::string name = i.decode_string();
+      bufferlist bl;
+      i.decode_bl(bl);
+      std::map<std::string, bufferptr> to_set;
+      to_set[name] = bufferptr(bl.c_str(), bl.length());
+      r = _setattrs(cid, oid, to_set);
+    }
+    break;
+    case Transaction::OP_SETATTRS:
+    {
+      coll_t cid = i.get_cid(op->cid);
+      ghobject_t oid = i.get_oid(op->oid);
+      std::map<std::string, bufferptr> aset;
+      i.decode_attrset(aset);
+      r = _setattrs(cid, oid, aset);
+    }
+    break;
+    case Transaction::OP_RMATTR:
+    {
+      coll_t cid = i.get_cid(op->cid);
+      ghobject_t oid = i.get_oid(op->oid);
+      std::string name = i.decode_string();
+      r = _rmattr(cid, oid, name);
+    }
+    break;
+    case Transaction::OP_RMATTRS:
+    {
+      coll_t cid = i.get_cid(op->cid);
+      ghobject_t oid = i.get_oid(op->oid);
+      r = _rmattrs(cid, oid);
+    }
+    break;
+    case Transaction::OP_CLONE:
+    {
+      coll_t cid = i.get_cid(op->cid);
+      ghobject_t oid = i.get_oid(op->oid);
+      ghobject_t noid = i.get_oid(op->dest_oid);
+      r = _clone(cid, oid, noid);
+    }
+    break;
+    case Transaction::OP_CLONERANGE:
+    {
+      coll_t cid = i.get_cid(op->cid);
+      ghobject_t oid = i.get_oid(op->oid);
+      ghobject_t noid = i.get_oid(op->dest_oid);
+      r = _clone_range(cid, oid, noid, op->off, op->len, op->off);
+    }
+    break;
+    case Transaction::OP_CLONERANGE2:
+    {
+      coll_t cid = i.get_cid(op->cid);
+      ghobject_t oid = i.get_oid(op->oid);
+      ghobject_t noid = i.get_oid(op->dest_oid);
+      r = _clone_range(cid, oid, noid, op->off, op->len, op->dest_off);
+    }
+    break;
+    case Transaction::OP_MKCOLL:
+    {
+      coll_t cid = i.get_cid(op->cid);
+      r = _create_collection(cid, op->split_bits);
+    }
+    break;
+    case Transaction::OP_COLL_HINT:
+    {
+      // ignore the hint
+      bufferlist hint;
+      i.decode_bl(hint);
+    }
+    break;
+    case Transaction::OP_RMCOLL:
+    {
+      coll_t cid = i.get_cid(op->cid);
+      r = _destroy_collection(cid);
+    }
+    break;
+    case Transaction::OP_COLL_MOVE_RENAME:
+    {
+      coll_t oldcid = i.get_cid(op->cid);
+      ghobject_t oldoid = i.get_oid(op->oid);
+      coll_t newcid = i.get_cid(op->dest_cid);
+      ghobject_t newoid = i.get_oid(op->dest_oid);
+      r = _collection_move_rename(oldcid, oldoid, newcid, newoid);
+      if (r == -ENOENT)
+        r = 0;
+    }
+    break;
+    case Transaction::OP_TRY_RENAME:
+    {
+      coll_t cid = i.get_cid(op->cid);
+      ghobject_t oldoid = i.get_oid(op->oid);
+      ghobject_t newoid = i.get_oid(op->dest_oid);
+      r = _collection_move_rename(cid, oldoid, cid, newoid);
+      if (r == -ENOENT)
+        r = 0;
+    }
+    break;
+    case Transaction::OP_OMAP_CLEAR:
+    {
+      coll_t cid = i.get_cid(op->cid);
+      ghobject_t oid = i.get_oid(op->oid);
+      r = _omap_clear(cid, oid);
+    }
+    break;
+    case Transaction::OP_OMAP_SETKEYS:
+    {
+      coll_t cid = i.get_cid(op->cid);
+      ghobject_t oid = i.get_oid(op->oid);
+      bufferlist aset_bl;
+      i.decode_attrset_bl(&aset_bl);
+      r = _omap_setkeys(cid, oid, aset_bl);
+    }
+    break;
+    case Transaction::OP_OMAP_RMKEYS:
+    {
+      coll_t cid = i.get_cid(op->cid);
+      ghobject_t oid = i.get_oid(op->oid);
+      bufferlist keys_bl;
+      i.decode_keyset_bl(&keys_bl);
+      r = _omap_rmkeys(cid, oid, keys_bl);
+    }
+    break;
+    case Transaction::OP_OMAP_RMKEYRANGE:
+    {
+      coll_t cid = i.get_cid(op->cid);
+      ghobject_t oid = i.get_oid(op->oid);
+      std::string first = i.decode_string();
+      std::string last = i.decode_string();
+      r = _omap_rmkeyrange(cid, oid, first, last);
+    }
+    break;
+    case Transaction::OP_OMAP_SETHEADER:
+    {
+      coll_t cid = i.get_cid(op->cid);
+      ghobject_t oid = i.get_oid(op->oid);
+      bufferlist bl;
+      i.decode_bl(bl);
+      r = _omap_setheader(cid, oid, bl);
+    }
+    break;
+    case Transaction::OP_SPLIT_COLLECTION2:
+    {
+      coll_t cid = i.get_cid(op->cid);
+      coll_t dest = i.get_cid(op->dest_cid);
+      r = _split_collection(cid, op->split_bits, op->split_rem, dest);
+    }
+    break;
+    case Transaction::OP_MERGE_COLLECTION:
+    {
+      coll_t cid = i.get_cid(op->cid);
+      coll_t dest = i.get_cid(op->dest_cid);
+      r = _merge_collection(cid, op->split_bits, dest);
+    }
+    break;
+    case Transaction::OP_SETALLOCHINT:
+      break;
+    default:
+      logger().error("bad op {}", static_cast<unsigned>(op_code));
+      ceph_abort_msg("not implemented");
+    }
+    if (r < 0) {
+      bool ok = false;
+      if (r == -ENOENT && !(op->op == Transaction::OP_CLONERANGE ||
+                            op->op == Transaction::OP_CLONE ||
+                            op->op == Transaction::OP_CLONERANGE2)) {
+        // -ENOENT is usually okay
+        ok = true;
+      }
+      if (r == -ENODATA) {
+        ok = true;
+      }
+      if (!ok) {
+        logger().error("error {} not handled on operation {} "
+                       "(op {}, counting from 0)",
+                       r, static_cast<unsigned>(op->op), pos);
+        JSONFormatter f(true);
+        f.open_object_section("transaction");
+        t.dump(&f);
+        f.close_section();
+        std::stringstream str;
+        f.flush(str);
+        logger().error("transaction dump:\n{}", str.str());
+        ceph_abort_msg("unexpected error");
+      }
+    }
+    ++pos;
+  }
+}
+
+CollectionRef CyanStore::_get_collection(const coll_t& cid)
+{
+  auto cp = coll_map.find(cid);
+  if (cp == coll_map.end())
+    return {};
+  return cp->second;
+}
+
+int CyanStore::_touch(const coll_t& cid, const ghobject_t& oid)
+{
+  logger().debug("{} cid={} oid={}", __func__, cid, oid);
+  auto c = _get_collection(cid);
+  if (!c)
+    return -ENOENT;
+
+  c->get_or_create_object(oid);
+  return 0;
+}
+
+int CyanStore::_write(const coll_t& cid, const ghobject_t& oid,
+                      uint64_t offset, size_t len, const bufferlist& bl,
+                      uint32_t fadvise_flags)
+{
+  logger().debug("{} {} {} {} ~ {}",
+                 __func__, cid, oid, offset, len);
+  ceph_assert(len == bl.length());
+
+  auto c = _get_collection(cid);
+  if (!c)
+    return -ENOENT;
+
+  ObjectRef o = c->get_or_create_object(oid);
+  if (len > 0) {
+    const ssize_t old_size = o->get_size();
+    o->write(offset, bl);
+    used_bytes += (o->get_size() - old_size);
+  }
+
+  return 0;
+}
+
+int CyanStore::_zero(const coll_t& cid, const ghobject_t& oid,
+                     uint64_t offset, size_t len)
+{
+  logger().debug("{} {} {} {} ~ {}",
+                 __func__, cid, oid, offset, len);
+  bufferlist bl;
+  bl.append_zero(len);
+  return _write(cid, oid, offset, len, bl, 0);
+}
+
+int CyanStore::_truncate(const coll_t& cid, const ghobject_t& oid,
+                         uint64_t size)
+{
+  logger().debug("{} cid={} oid={} size={}",
+                 __func__, cid, oid, size);
+  auto c = _get_collection(cid);
+  if (!c)
+    return -ENOENT;
+
+  ObjectRef o = c->get_object(oid);
+  if (!o)
+    return -ENOENT;
+  const ssize_t old_size = o->get_size();
+  int r = o->truncate(size);
+  used_bytes += (o->get_size() - old_size);
+  return r;
+}
+
+int CyanStore::_remove(const coll_t& cid, const ghobject_t& oid)
+{
+  logger().debug("{} cid={} oid={}", __func__, cid, oid);
+  auto c = _get_collection(cid);
+  if (!c)
+    return -ENOENT;
+
+  auto i = c->object_hash.find(oid);
+  if (i == c->object_hash.end())
+    return -ENOENT;
+  used_bytes -= i->second->get_size();
+  c->object_hash.erase(i);
+  c->object_map.erase(oid);
+  return 0;
+}
+
+int CyanStore::_setattrs(const coll_t& cid, const ghobject_t& oid,
+                         std::map<std::string,bufferptr>& aset)
+{
+  logger().debug("{} cid={} oid={}", __func__, cid, oid);
+  auto c = _get_collection(cid);
+  if (!c)
+    return -ENOENT;
+
+  ObjectRef o = c->get_object(oid);
+  if (!o)
+    return -ENOENT;
+  for (auto& [name, value] : aset)
+    o->xattr[name] = value;
+  return 0;
+}
+
+int CyanStore::_rmattr(const coll_t& cid, const ghobject_t& oid,
+                       const std::string& name)
+{
+  logger().debug("{} cid={} oid={} name={}", __func__, cid, oid, name);
+  auto c = _get_collection(cid);
+  if (!c)
+    return -ENOENT;
+
+  ObjectRef o = c->get_object(oid);
+  if (!o)
+    return -ENOENT;
+  auto i = o->xattr.find(name);
+  if (i == o->xattr.end())
+    return -ENODATA;
+  o->xattr.erase(i);
+  return 0;
+}
+
+int CyanStore::_rmattrs(const coll_t& cid, const ghobject_t& oid)
+{
+  logger().debug("{} cid={} oid={}", __func__, cid, oid);
+  auto c = _get_collection(cid);
+  if (!c)
+    return -ENOENT;
+
+  ObjectRef o = c->get_object(oid);
+  if (!o)
+    return -ENOENT;
+  o->xattr.clear();
+  return 0;
+}
+
+int CyanStore::_clone(const coll_t& cid, const ghobject_t& oldoid,
+                      const ghobject_t& newoid)
+{
+  logger().debug("{} cid={} {} -> {}", __func__, cid, oldoid, newoid);
+  auto c = _get_collection(cid);
+  if (!c)
+    return -ENOENT;
+
+  ObjectRef oo = c->get_object(oldoid);
+  if (!oo)
+    return -ENOENT;
+  ObjectRef no = c->get_or_create_object(newoid);
+  used_bytes += oo->get_size() - no->get_size();
+  no->clone(oo.get(), 0, oo->get_size(), 0);
+
+  no->omap_header = oo->omap_header;
+  no->omap = oo->omap;
+  no->xattr = oo->xattr;
+  return 0;
+}
+
+int CyanStore::_clone_range(const coll_t& cid, const ghobject_t& oldoid,
+                            const ghobject_t& newoid,
+                            uint64_t srcoff, uint64_t len, uint64_t dstoff)
+{
+  logger().debug("{} cid={} {} {}~{} -> {} {}~{}",
+                 __func__, cid, oldoid, srcoff, len, newoid, dstoff, len);
+  auto c = _get_collection(cid);
+  if (!c)
+    return -ENOENT;
+
+  ObjectRef oo = c->get_object(oldoid);
+  if (!oo)
+    return -ENOENT;
+  ObjectRef no = c->get_or_create_object(newoid);
+  if (srcoff >= oo->get_size())
+    return 0;
+  if (srcoff + len >= oo->get_size())
+    len = oo->get_size() - srcoff;
+
+  const ssize_t old_size = no->get_size();
+  no->clone(oo.get(), srcoff, len, dstoff);
+  used_bytes += (no->get_size() - old_size);
+  return len;
+}
+
+int CyanStore::_omap_clear(const coll_t& cid, const ghobject_t& oid)
+{
+  logger().debug("{} cid={} oid={}", __func__, cid, oid);
+  auto c = _get_collection(cid);
+  if (!c)
+    return -ENOENT;
+
+  ObjectRef o = c->get_object(oid);
+  if (!o)
+    return -ENOENT;
+  o->omap.clear();
+  o->omap_header.clear();
+  return 0;
+}
+
+int CyanStore::_omap_setkeys(const coll_t& cid, const ghobject_t& oid,
+                             bufferlist& aset_bl)
+{
+  logger().debug("{} cid={} oid={}", __func__, cid, oid);
+  auto c = _get_collection(cid);
+  if (!c)
+    return -ENOENT;
+
+  ObjectRef o = c->get_object(oid);
+  if (!o)
+    return -ENOENT;
+  auto p = aset_bl.cbegin();
+  __u32 num;
+  decode(num, p);
+  while (num--) {
+    std::string key;
+    decode(key, p);
+    decode(o->omap[key], p);
+  }
+  return 0;
+}
+
+int CyanStore::_omap_rmkeys(const coll_t& cid, const ghobject_t& oid,
+                            bufferlist& keys_bl)
+{
+  logger().debug("{} cid={} oid={}", __func__, cid, oid);
+  auto c = _get_collection(cid);
+  if (!c)
+    return -ENOENT;
+
+  ObjectRef o = c->get_object(oid);
+  if (!o)
+    return -ENOENT;
+  auto p = keys_bl.cbegin();
+  __u32 num;
+  decode(num, p);
+  while (num--) {
+    std::string key;
+    decode(key, p);
+    o->omap.erase(key);
+  }
+  return 0;
+}
+
+int CyanStore::_omap_rmkeyrange(const coll_t& cid, const ghobject_t& oid,
+                                const std::string& first,
+                                const std::string& last)
+{
+  logger().debug("{} cid={} oid={} first={} last={}",
+                 __func__, cid, oid, first, last);
+  auto c = _get_collection(cid);
+  if (!c)
+    return -ENOENT;
+
+  ObjectRef o = c->get_object(oid);
+  if (!o)
+    return -ENOENT;
+  auto p = o->omap.lower_bound(first);
+  auto e = o->omap.lower_bound(last);
+  o->omap.erase(p, e);
+  return 0;
+}
+
+int CyanStore::_omap_setheader(const coll_t& cid, const ghobject_t& oid,
+                               const bufferlist& bl)
+{
+  logger().debug("{} cid={} oid={}", __func__, cid, oid);
+  auto c = _get_collection(cid);
+  if (!c)
+    return -ENOENT;
+
+  ObjectRef o = c->get_object(oid);
+  if (!o)
+    return -ENOENT;
+  o->omap_header = bl;
+  return 0;
+}
+
+int CyanStore::_create_collection(const coll_t& cid, int bits)
+{
+  logger().debug("{} cid={} bits={}", __func__, cid, bits);
+  auto result = coll_map.try_emplace(cid);
+  if (!result.second)
+    return -EEXIST;
+  auto p = new_coll_map.find(cid);
+  ceph_assert(p != new_coll_map.end());
+  result.first->second = p->second;
+  result.first->second->bits = bits;
+  new_coll_map.erase(p);
+  return 0;
+}
+
+int CyanStore::_destroy_collection(const coll_t& cid)
+{
+  logger().debug("{} cid={}", __func__, cid);
+  auto cp = coll_map.find(cid);
+  if (cp == coll_map.end())
+    return -ENOENT;
+  if (!cp->second->object_map.empty())
+    return -ENOTEMPTY;
+  cp->second->exists = false;
+  coll_map.erase(cp);
+  return 0;
+}
+
+int CyanStore::_collection_move_rename(const coll_t& oldcid,
+                                       const ghobject_t& oldoid,
+                                       const coll_t& cid,
+                                       const ghobject_t& oid)
+{
+  logger().debug("{} {} {} -> {} {}",
+                 __func__, oldcid, oldoid, cid, oid);
+  auto c = _get_collection(cid);
+  if (!c)
+    return -ENOENT;
+  auto oc = _get_collection(oldcid);
+  if (!oc)
+    return -ENOENT;
+  if (c->object_hash.count(oid))
+    return -EEXIST;
+  auto found = oc->object_hash.find(oldoid);
+  if (found == oc->object_hash.end())
+    return -ENOENT;
+  ObjectRef o = found->second;
+  c->object_map[oid] = o;
+  c->object_hash[oid] = o;
+  oc->object_hash.erase(found);
+  oc->object_map.erase(oldoid);
+  return 0;
+}
+
+int CyanStore::_split_collection(const coll_t& cid, uint32_t bits,
+                                 uint32_t match, const coll_t& dest)
+{
+  logger().debug("{} cid={} bits={} match={} dest={}",
+                 __func__, cid, bits, match, dest);
+  auto sc = _get_collection(cid);
+  if (!sc)
+    return -ENOENT;
+  auto dc = _get_collection(dest);
+  if (!dc)
+    return -ENOENT;
+
+  auto p = sc->object_map.begin();
+  while (p != sc->object_map.end()) {
+    if (p->first.match(bits, match)) {
+      dc->object_map.insert(*p);
+      dc->object_hash.insert(*p);
+      sc->object_hash.erase(p->first);
+      p = sc->object_map.erase(p);
+    } else {
+      ++p;
+    }
+  }
+  sc->bits = bits;
+  ceph_assert(dc->bits == (int)bits);
+  return 0;
+}
+
+int CyanStore::_merge_collection(const coll_t& cid, uint32_t bits,
+                                 const coll_t& dest)
+{
+  logger().debug("{} cid={} bits={} dest={}",
+                 __func__, cid, bits, dest);
+  auto sc = _get_collection(cid);
+  if (!sc)
+    return -ENOENT;
+  auto dc = _get_collection(dest);
+  if (!dc)
+    return -ENOENT;
+
+  for (auto& p : sc->object_map) {
+    dc->object_map.insert(p);
+    dc->object_hash.insert(p);
+  }
+  dc->bits = bits;
+  sc->exists = false;
+  coll_map.erase(cid);
+  return 0;
+}
+
+}
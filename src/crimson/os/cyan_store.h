@@ -0,0 +1,136 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+#pragma once
+
+#include <map>
+#include <set>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <seastar/core/future.hh>
+
+#include "os/ObjectStore.h"
+#include "osd/osd_types.h"
+#include "cyan_collection.h"
+
+namespace ceph::os {
+
+/**
+ * a seastar-native in-memory ObjectStore
+ *
+ * it serves reads and applies transactions in the calling reactor, so the
+ * crimson data path can be exercised and benchmarked end-to-end without
+ * handing requests over to threads. one instance is supposed to be started
+ * on each shard with seastar::sharded<CyanStore>. an instance only knows
+ * about the collections created on it, and a collection is expected to be
+ * accessed on the shard returned by shard_of().
+ *
+ * read errors are reported as std::system_error with the errno as its code.
+ */
+class CyanStore {
+  std::unordered_map<coll_t, CollectionRef> coll_map;
+  std::map<coll_t, CollectionRef> new_coll_map;
+  uint64_t used_bytes = 0;
+
+public:
+  using Transaction = ::ObjectStore::Transaction;
+  using attrs_t = std::map<std::string, ceph::bufferptr, std::less<>>;
+  using omap_values_t = std::map<std::string, bufferlist, std::less<>>;
+
+  CyanStore() = default;
+  ~CyanStore();
+
+  /// required by seastar::sharded<>
+  seastar::future<> stop();
+
+  /// the shard serving the given collection
+  static unsigned shard_of(const coll_t& cid);
+
+  seastar::future<bufferlist> read(CollectionRef c,
+				   const ghobject_t& oid,
+				   uint64_t offset,
+				   size_t len,
+				   uint32_t op_flags = 0);
+  /// the size of the object
+  seastar::future<uint64_t> stat(CollectionRef c,
+				 const ghobject_t& oid);
+  seastar::future<ceph::bufferptr> get_attr(CollectionRef c,
+					    const ghobject_t& oid,
+					    std::string_view name);
+  seastar::future<attrs_t> get_attrs(CollectionRef c,
+				     const ghobject_t& oid);
+  seastar::future<omap_values_t> omap_get_values(
+    CollectionRef c,
+    const ghobject_t& oid,
+    const std::set<std::string>& keys);
+  /// up to @c limit omap entries following @c start
+  seastar::future<omap_values_t> omap_get_values(
+    CollectionRef c,
+    const ghobject_t& oid,
+    const std::string& start,
+    uint64_t limit);
+  seastar::future<bufferlist> omap_get_header(CollectionRef c,
+					      const ghobject_t& oid);
+  /// up to @c limit objects in [start, end), and the one to continue with
+  seastar::future<std::vector<ghobject_t>, ghobject_t> list_objects(
+    CollectionRef c,
+    const ghobject_t& start,
+    const ghobject_t& end,
+    uint64_t limit);
+
+  /// the collection comes into existence once the transaction creating it
+  /// is applied
+  CollectionRef create_new_collection(const coll_t& cid);
+  CollectionRef open_collection(const coll_t& cid);
+  std::vector<coll_t> list_collections() const;
+
+  /// apply the transaction, and complete its contexts in this reactor
+  seastar::future<> do_transaction(CollectionRef ch,
+				   Transaction&& txn);
+
+  uint64_t get_used_bytes() const {
+    return used_bytes;
+  }
+
+private:
+  void _do_transaction(Transaction& t);
+  int _touch(const coll_t& cid, const ghobject_t& oid);
+  int _write(const coll_t& cid, const ghobject_t& oid,
+	     uint64_t offset, size_t len, const bufferlist& bl,
+	     uint32_t fadvise_flags);
+  int _zero(const coll_t& cid, const ghobject_t& oid,
+	    uint64_t offset, size_t len);
+  int _truncate(const coll_t& cid, const ghobject_t& oid, uint64_t size);
+  int _remove(const coll_t& cid, const ghobject_t& oid);
+  int _setattrs(const coll_t& cid, const ghobject_t& oid,
+		std::map<std::string,bufferptr>& aset);
+  int _rmattr(const coll_t& cid, const ghobject_t& oid,
+	      const std::string& name);
+  int _rmattrs(const coll_t& cid, const ghobject_t& oid);
+  int _clone(const coll_t& cid, const ghobject_t& oldoid,
+	     const ghobject_t& newoid);
+  int _clone_range(const coll_t& cid, const ghobject_t& oldoid,
+		   const ghobject_t& newoid,
+		   uint64_t srcoff, uint64_t len, uint64_t dstoff);
+  int _omap_clear(const coll_t& cid, const ghobject_t& oid);
+  int _omap_setkeys(const coll_t& cid, const ghobject_t& oid,
+		    bufferlist& aset_bl);
+  int _omap_rmkeys(const coll_t& cid, const ghobject_t& oid,
+		   bufferlist& keys_bl);
+  int _omap_rmkeyrange(const coll_t& cid, const ghobject_t& oid,
+		       const std::string& first, const std::string& last);
+  int _omap_setheader(const coll_t& cid, const ghobject_t& oid,
+		      const bufferlist& bl);
+  int _create_collection(const coll_t& cid, int bits);
+  int _destroy_collection(const coll_t& cid);
+  int _collection_move_rename(const coll_t& oldcid, const ghobject_t& oldoid,
+			      const coll_t& cid, const ghobject_t& oid);
+  int _split_collection(const coll_t& cid, uint32_t bits, uint32_t rem,
+			const coll_t& dest);
+  int _merge_collection(const coll_t& cid, uint32_t bits,
+			const coll_t& dest);
+  CollectionRef _get_collection(const coll_t& cid);
+};
+
+}
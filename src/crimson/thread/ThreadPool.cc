@@ -53,16 +53,32 @@ void ThreadPool::loop()
     }
     if (work_item) {
       work_item->process();
+      completed[work_item->shard]->push(work_item);
     } else if (is_stopping()) {
       break;
     }
   }
 }
 
+bool CompletionPoller::poll()
+{
+  WorkItem* work_item = nullptr;
+  size_t n = 0;
+  while (completed.pop(work_item)) {
+    work_item->complete();
+    n++;
+  }
+  in_flight -= n;
+  return n > 0;
+}
+
 seastar::future<> ThreadPool::start()
 {
-  auto slots_per_shard = queue_size / seastar::smp::count;
-  return submit_queue.start(slots_per_shard);
+  for (unsigned shard = 0; shard < seastar::smp::count; shard++) {
+    completed.emplace_back(
+      std::make_unique<completion_queue_t>(slots_per_shard()));
+  }
+  return submit_queue.start(slots_per_shard(), &completed);
 }
 
 seastar::future<> ThreadPool::stop()
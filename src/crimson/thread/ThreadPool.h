@@ -4,29 +4,38 @@
 
 #include <atomic>
 #include <condition_variable>
+#include <optional>
 #include <tuple>
 #include <type_traits>
+#include <vector>
 #include <boost/lockfree/queue.hpp>
 #include <boost/optional.hpp>
 #include <seastar/core/future.hh>
+#include <seastar/core/future-util.hh>
 #include <seastar/core/gate.hh>
+#include <seastar/core/reactor.hh>
 #include <seastar/core/semaphore.hh>
 #include <seastar/core/sharded.hh>
 
-#include "Condition.h"
+#include "include/ceph_assert.h"
 
 namespace ceph::thread {
 
 struct WorkItem {
+  /// the shard which submitted this item, and which completes it
+  unsigned shard = 0;
   virtual ~WorkItem() {}
+  /// run in a thread of the pool
   virtual void process() = 0;
+  /// run in the reactor of the submitting shard, once processed
+  virtual void complete() = 0;
 };
 
 template<typename Func, typename T = std::invoke_result_t<Func>>
 struct Task final : WorkItem {
   Func func;
   seastar::future_state<T> state;
-  ceph::thread::Condition on_done;
+  seastar::promise<T> on_done;
 public:
   explicit Task(Func&& f)
     : func(std::move(f))
@@ -37,23 +46,60 @@ public:
     } catch (...) {
       state.set_exception(std::current_exception());
     }
-    on_done.notify();
+  }
+  void complete() override {
+    try {
+      on_done.set_value(state.get0(std::move(state).get()));
+    } catch (...) {
+      on_done.set_exception(std::current_exception());
+    }
   }
   seastar::future<T> get_future() {
-    return on_done.wait().then([this] {
-      return seastar::make_ready_future<T>(state.get0(std::move(state).get()));
-    });
+    return on_done.get_future();
   }
 };
 
+/// the items processed for a shard, waiting for it to complete them
+using completion_queue_t = boost::lockfree::queue<WorkItem*>;
+
+/// completes the processed items of a shard from its reactor's poll loop,
+/// so the pool's threads never need to wake the reactor up themselves
+class CompletionPoller final : public seastar::pollfn {
+  completion_queue_t& completed;
+  size_t& in_flight;
+public:
+  CompletionPoller(completion_queue_t& completed, size_t& in_flight)
+    : completed{completed}, in_flight{in_flight}
+  {}
+  bool poll() override;
+  bool pure_poll() override {
+    return !completed.empty();
+  }
+  // the reactor is only allowed to sleep if nothing is being processed for
+  // it, as nobody would wake it up on completion
+  bool try_enter_interrupt_mode() override {
+    return in_flight == 0;
+  }
+  void exit_interrupt_mode() override {}
+};
+
 struct SubmitQueue {
   seastar::semaphore free_slots;
   seastar::gate pending_tasks;
-  explicit SubmitQueue(size_t num_free_slots)
-    : free_slots(num_free_slots)
+  /// the number of submitted items not completed yet
+  size_t in_flight = 0;
+  std::optional<seastar::reactor::poller> poller;
+  /// @param completed the completion queues of all shards
+  SubmitQueue(size_t num_free_slots,
+              std::vector<std::unique_ptr<completion_queue_t>>* completed)
+    : free_slots(num_free_slots),
+      poller{std::make_unique<CompletionPoller>(
+        *(*completed)[seastar::engine().cpu_id()], in_flight)}
   {}
   seastar::future<> stop() {
-    return pending_tasks.close();
+    return pending_tasks.close().then([this] {
+      poller.reset();
+    });
   }
 };
 
@@ -66,15 +112,25 @@ class ThreadPool {
   seastar::sharded<SubmitQueue> submit_queue;
   const size_t queue_size;
   boost::lockfree::queue<WorkItem*> pending;
+  /// indexed by shard
+  std::vector<std::unique_ptr<completion_queue_t>> completed;
 
   void loop();
   bool is_stopping() const {
     return stopping.load(std::memory_order_relaxed);
   }
   static void pin(unsigned cpu_id);
+  SubmitQueue& local_queue() {
+    return submit_queue.local();
+  }
   seastar::semaphore& local_free_slots() {
     return submit_queue.local().free_slots;
   }
+  void queue(WorkItem* item) {
+    item->shard = seastar::engine().cpu_id();
+    ++local_queue().in_flight;
+    pending.push(item);
+  }
   ThreadPool(const ThreadPool&) = delete;
   ThreadPool& operator=(const ThreadPool&) = delete;
 public:
@@ -84,14 +140,18 @@ public:
    *                 multiple of the number of cores.
    * @param n_threads the number of threads in this thread pool.
    * @param cpu the CPU core to which this thread pool is assigned
-   * @note each @c Task has its own ceph::thread::Condition, which possesses
-   * possesses an fd, so we should keep the size of queue under a reasonable
-   * limit.
+   * @note processed tasks are completed by a poller in the reactor of the
+   * submitting shard, which keeps that reactor polling as long as it has
+   * tasks in this pool.
    */
   ThreadPool(size_t n_threads, size_t queue_sz, unsigned cpu);
   ~ThreadPool();
   seastar::future<> start();
   seastar::future<> stop();
+  /// the number of tasks a shard can have in this pool at the same time
+  size_t slots_per_shard() const {
+    return queue_size / seastar::smp::count;
+  }
   template<typename Func, typename...Args>
   auto submit(Func&& func, Args&&... args) {
     auto packaged = [func=std::move(func),
@@ -104,7 +164,7 @@ public:
           .then([packaged=std::move(packaged), this] {
             auto task = new Task{std::move(packaged)};
             auto fut = task->get_future();
-            pending.push(task);
+            queue(task);
             cond.notify_one();
             return fut.finally([task, this] {
               local_free_slots().signal();
@@ -113,6 +173,36 @@ public:
           });
         });
   }
+  /// submit a batch of tasks, waking up the pool only once for all of them
+  ///
+  /// @param funcs at most slots_per_shard() callables
+  /// @return the results of all the tasks, in the order of @c funcs
+  template<typename Func, typename T = std::invoke_result_t<Func>>
+  seastar::future<std::vector<T>> submit_batch(std::vector<Func>&& funcs) {
+    ceph_assert(funcs.size() <= slots_per_shard());
+    return seastar::with_gate(submit_queue.local().pending_tasks,
+      [funcs=std::move(funcs), this] () mutable {
+        const auto n = funcs.size();
+        return local_free_slots().wait(n)
+          .then([funcs=std::move(funcs), n, this] () mutable {
+            std::vector<std::unique_ptr<Task<Func>>> tasks;
+            std::vector<seastar::future<T>> futs;
+            tasks.reserve(n);
+            futs.reserve(n);
+            for (auto& func : funcs) {
+              auto& task = tasks.emplace_back(
+                std::make_unique<Task<Func>>(std::move(func)));
+              futs.push_back(task->get_future());
+              queue(task.get());
+            }
+            cond.notify_all();
+            return seastar::when_all_succeed(futs.begin(), futs.end())
+              .finally([tasks=std::move(tasks), n, this] {
+                local_free_slots().signal(n);
+              });
+          });
+      });
+  }
 };
 
 } // namespace ceph::thread
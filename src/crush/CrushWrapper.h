@@ -1538,6 +1538,30 @@ public:
       out[i] = rawout[i];
   }
 
+  /// map each input in xs with the given rule; same results as do_rule()
+  template<typename WeightVector>
+  void do_rule_batch(int rule, const vector<int>& xs,
+		     vector<vector<int>> *out, int maxout,
+		     const WeightVector& weight,
+		     uint64_t choose_args_index) const {
+    vector<int> rawout(xs.size() * maxout);
+    vector<int> rawlen(xs.size());
+    vector<char> work(crush_work_size(crush, maxout));
+    crush_init_workspace(crush, work.data());
+    crush_choose_arg_map arg_map = choose_args_get_with_fallback(
+      choose_args_index);
+    int r = crush_do_rule_batch(crush, rule, xs.data(), xs.size(),
+				rawout.data(), maxout, rawlen.data(),
+				&weight[0], weight.size(), work.data(),
+				arg_map.args);
+    out->resize(xs.size());
+    for (unsigned i = 0; i < xs.size(); ++i) {
+      int numrep = r > 0 ? std::max(rawlen[i], 0) : 0;
+      auto first = rawout.begin() + i * maxout;
+      (*out)[i].assign(first, first + numrep);
+    }
+  }
+
   int _choose_type_stack(
     CephContext *cct,
     const vector<pair<int,int>>& stack,
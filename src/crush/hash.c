@@ -58,6 +58,34 @@ static __u32 crush_hash32_rjenkins1_3(__u32 a, __u32 b, __u32 c)
 	return hash;
 }
 
+/*
+ * Same as crush_hash32_rjenkins1_3(), but for @n different values of
+ * @b.  The loop body is free of branches and of dependencies between
+ * iterations, which lets the compiler evaluate several lanes at once
+ * with SIMD instructions.
+ */
+static void crush_hash32_rjenkins1_3_multi(__u32 a0, const __u32 *bv,
+					   __u32 c0, __u32 *out,
+					   unsigned int n)
+{
+	unsigned int i;
+
+	for (i = 0; i < n; i++) {
+		__u32 a = a0;
+		__u32 b = bv[i];
+		__u32 c = c0;
+		__u32 hash = crush_hash_seed ^ a ^ b ^ c;
+		__u32 x = 231232;
+		__u32 y = 1232;
+		crush_hashmix(a, b, hash);
+		crush_hashmix(c, x, hash);
+		crush_hashmix(y, a, hash);
+		crush_hashmix(b, x, hash);
+		crush_hashmix(y, c, hash);
+		out[i] = hash;
+	}
+}
+
 static __u32 crush_hash32_rjenkins1_4(__u32 a, __u32 b, __u32 c, __u32 d)
 {
 	__u32 hash = crush_hash_seed ^ a ^ b ^ c ^ d;
@@ -120,6 +148,21 @@ __u32 crush_hash32_3(int type, __u32 a, __u32 b, __u32 c)
 	}
 }
 
+void crush_hash32_3_multi(int type, __u32 a, const __u32 *b, __u32 c,
+			  __u32 *out, unsigned int n)
+{
+	unsigned int i;
+
+	switch (type) {
+	case CRUSH_HASH_RJENKINS1:
+		crush_hash32_rjenkins1_3_multi(a, b, c, out, n);
+		break;
+	default:
+		for (i = 0; i < n; i++)
+			out[i] = 0;
+	}
+}
+
 __u32 crush_hash32_4(int type, __u32 a, __u32 b, __u32 c, __u32 d)
 {
 	switch (type) {
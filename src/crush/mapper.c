@@ -330,11 +330,11 @@ static inline __s32 *get_choose_arg_ids(const struct crush_bucket_straw2 *bucket
  *
  * for reference, see the exponential distribution example at:  
  * https://en.wikipedia.org/wiki/Inverse_transform_sampling#Examples
+ *
+ * @u is crush_hash32_3(type, x, id, r) for the item being drawn.
  */
-static inline __s64 generate_exponential_distribution(int type, int x, int y, int z, 
-                                                      int weight)
+static inline __s64 generate_exponential_distribution(__u32 u, int weight)
 {
-	unsigned int u = crush_hash32_3(type, x, y, z);
 	u &= 0xffff;
 
 	/*
@@ -358,25 +358,43 @@ static inline __s64 generate_exponential_distribution(int type, int x, int y, in
 	return div64_s64(ln, weight);
 }
 
+/*
+ * number of items whose hashes are computed together by
+ * crush_hash32_3_multi() before drawing their straws.
+ */
+#define CRUSH_STRAW2_BATCH 32
+
 static int bucket_straw2_choose(const struct crush_bucket_straw2 *bucket,
 				int x, int r, const struct crush_choose_arg *arg,
                                 int position)
 {
-	unsigned int i, high = 0;
+	unsigned int i, j, n, high = 0;
 	__s64 draw, high_draw = 0;
         __u32 *weights = get_choose_arg_weights(bucket, arg, position);
         __s32 *ids = get_choose_arg_ids(bucket, arg);
-	for (i = 0; i < bucket->h.size; i++) {
-                dprintk("weight 0x%x item %d\n", weights[i], ids[i]);
-		if (weights[i]) {
-			draw = generate_exponential_distribution(bucket->h.hash, x, ids[i], r, weights[i]);
-		} else {
-			draw = S64_MIN;
-		}
+	__u32 hashes[CRUSH_STRAW2_BATCH];
+
+	for (i = 0; i < bucket->h.size; i += n) {
+		n = bucket->h.size - i;
+		if (n > CRUSH_STRAW2_BATCH)
+			n = CRUSH_STRAW2_BATCH;
+		crush_hash32_3_multi(bucket->h.hash, x,
+				     (const __u32 *)(ids + i), r,
+				     hashes, n);
+		for (j = 0; j < n; j++) {
+			dprintk("weight 0x%x item %d\n", weights[i + j],
+				ids[i + j]);
+			if (weights[i + j]) {
+				draw = generate_exponential_distribution(
+					hashes[j], weights[i + j]);
+			} else {
+				draw = S64_MIN;
+			}
 
-		if (i == 0 || draw > high_draw) {
-			high = i;
-			high_draw = draw;
+			if (i + j == 0 || draw > high_draw) {
+				high = i + j;
+				high_draw = draw;
+			}
 		}
 	}
 
@@ -1103,3 +1121,43 @@ int crush_do_rule(const struct crush_map *map,
 
 	return result_len;
 }
+
+/**
+ * crush_do_rule_batch - calculate mappings for several inputs
+ * @map: the crush_map
+ * @ruleno: the rule id
+ * @x: array of @nx hash inputs
+ * @nx: number of inputs
+ * @result: pointer to @nx * @result_max result slots
+ * @result_max: maximum result size for each input
+ * @result_len: array of @nx result sizes
+ * @weight: weight vector (for map leaves)
+ * @weight_max: size of weight vector
+ * @cwin: Pointer to at least map->working_size bytes of memory or NULL.
+ *
+ * The workspace is initialized by the caller once and reused for all
+ * inputs.  The mapping of @x[i] is stored in
+ * @result[i * @result_max, i * @result_max + @result_len[i][.
+ */
+int crush_do_rule_batch(const struct crush_map *map,
+			int ruleno, const int *x, int nx,
+			int *result, int result_max, int *result_len,
+			const __u32 *weight, int weight_max,
+			void *cwin, const struct crush_choose_arg *choose_args)
+{
+	int i;
+
+	if ((__u32)ruleno >= map->max_rules) {
+		dprintk(" bad ruleno %d\n", ruleno);
+		return 0;
+	}
+
+	for (i = 0; i < nx; i++) {
+		result_len[i] = crush_do_rule(map, ruleno, x[i],
+					      result + i * result_max,
+					      result_max,
+					      weight, weight_max,
+					      cwin, choose_args);
+	}
+	return nx;
+}
@@ -78,6 +78,35 @@ extern int crush_do_rule(const struct crush_map *map,
 			 const __u32 *weights, int weight_max,
 			 void *cwin, const struct crush_choose_arg *choose_args);
 
+/** @ingroup API
+ *
+ * Map each of the __nx__ inputs in __x__ the same way crush_do_rule()
+ * does, reusing the same __cwin__ for all of them. The result for
+ * __x[i]__ is stored at __result + i * result_max__ and its size in
+ * __result_len[i]__.
+ *
+ * @param map the crush_map
+ * @param ruleno a positive integer < __CRUSH_MAX_RULES__
+ * @param x the values to map
+ * @param nx the number of values in __x__
+ * @param result an array of items of size __nx__ * __result_max__
+ * @param result_max the maximum number of items for each input
+ * @param result_len an array of size __nx__
+ * @param weights an array of weights of size __weight_max__
+ * @param weight_max the size of the __weights__ array
+ * @param cwin must be an char array initialized by crush_init_workspace
+ * @param choose_args weights and ids for each known bucket
+ *
+ * @return 0 on error or __nx__ on success
+ */
+extern int crush_do_rule_batch(const struct crush_map *map,
+			       int ruleno,
+			       const int *x, int nx,
+			       int *result, int result_max, int *result_len,
+			       const __u32 *weights, int weight_max,
+			       void *cwin,
+			       const struct crush_choose_arg *choose_args);
+
 /* Returns the exact amount of workspace that will need to be used
    for a given combination of crush_map and result_max. The caller can
    then allocate this much on its own, either on the stack, in a
@@ -408,6 +408,14 @@ namespace buffer CEPH_BUFFER_API {
     static std::unique_ptr<ptr_node, disposer> create(const unsigned l) {
       return create_hypercombined(buffer::create(l));
     }
+    static std::unique_ptr<ptr_node, disposer> create(ptr&& p) {
+      return create_embedded(std::move(p));
+    }
+    /// like create(p, o, l), for a @c p nobody else can access meanwhile
+    static std::unique_ptr<ptr_node, disposer> create_exclusive(
+      const ptr& p, unsigned o, unsigned l) {
+      return create_embedded(p, o, l);
+    }
     template <class... Args>
     static std::unique_ptr<ptr_node, disposer> create(Args&&... args) {
       return std::unique_ptr<ptr_node, disposer>(
@@ -429,6 +437,29 @@ namespace buffer CEPH_BUFFER_API {
 
     static bool dispose_if_hypercombined(ptr_node* delete_this);
     static std::unique_ptr<ptr_node, disposer> create_hypercombined(raw* r);
+    // place the node in the storage reserved for it in the raw, unless
+    // some other node is already there
+    template <class... Args>
+    static std::unique_ptr<ptr_node, disposer> create_embedded(
+      const ptr& p, Args&&... args) {
+      if (void* storage = unused_raw_storage(p); storage) {
+	return std::unique_ptr<ptr_node, disposer>(
+	  new (storage) ptr_node(p, std::forward<Args>(args)...));
+      } else {
+	return std::unique_ptr<ptr_node, disposer>(
+	  new ptr_node(p, std::forward<Args>(args)...));
+      }
+    }
+    static std::unique_ptr<ptr_node, disposer> create_embedded(ptr&& p) {
+      if (void* storage = unused_raw_storage(p); storage) {
+	return std::unique_ptr<ptr_node, disposer>(
+	  new (storage) ptr_node(std::move(p)));
+      } else {
+	return std::unique_ptr<ptr_node, disposer>(
+	  new ptr_node(std::move(p)));
+      }
+    }
+    static void* unused_raw_storage(const ptr& p);
   };
   /*
    * list - the useful bit!
@@ -1228,6 +1259,10 @@ namespace buffer CEPH_BUFFER_API {
       }
     }
     uint32_t crc32c(uint32_t crc) const;
+    /// same as crc32c(), but also remember the crc of each whole block_size
+    /// block of every buffer so a later iterator crc32c() over exactly such
+    /// a block (e.g. a store checksum chunk) is answered from the cache
+    uint32_t crc32c_blocks(uint32_t crc, unsigned block_size) const;
     void invalidate_crc();
     sha1_digest_t sha1(); 
 
@@ -17,7 +17,9 @@
 
 #include <atomic>
 #include <map>
+#include <memory>
 #include <utility>
+#include <vector>
 #include <type_traits>
 #include "include/buffer.h"
 #include "include/mempool.h"
@@ -38,6 +40,15 @@ namespace ceph::buffer {
     std::pair<size_t, size_t> last_crc_offset {std::numeric_limits<size_t>::max(), std::numeric_limits<size_t>::max()};
     std::pair<uint32_t, uint32_t> last_crc_val;
 
+    // crc32c(-1) of consecutive block_size blocks starting at raw offset
+    // 'off', recorded by bufferlist::crc32c_blocks()
+    struct block_crcs_t {
+      size_t off;
+      unsigned block_size;
+      std::vector<uint32_t> crcs;
+    };
+    std::unique_ptr<block_crcs_t> block_crcs;
+
     mutable ceph::spinlock crc_spinlock;
 
     explicit raw(unsigned l, int mempool=mempool::mempool_buffer_anon)
@@ -112,10 +123,32 @@ public:
       last_crc_offset = fromto;
       last_crc_val = crc;
     }
+    bool get_block_crc(size_t off, size_t len, uint32_t *crc) const {
+      std::lock_guard lg(crc_spinlock);
+      if (!block_crcs || len != block_crcs->block_size ||
+	  off < block_crcs->off || (off - block_crcs->off) % len) {
+	return false;
+      }
+      size_t i = (off - block_crcs->off) / len;
+      if (i >= block_crcs->crcs.size()) {
+	return false;
+      }
+      *crc = block_crcs->crcs[i];
+      return true;
+    }
+    void set_block_crcs(size_t off, unsigned block_size,
+			std::vector<uint32_t>&& crcs) {
+      auto b = std::make_unique<block_crcs_t>(
+	block_crcs_t{off, block_size, std::move(crcs)});
+      std::lock_guard lg(crc_spinlock);
+      block_crcs.swap(b);
+    }
     void invalidate_crc() {
+      std::unique_ptr<block_crcs_t> b;
       std::lock_guard lg(crc_spinlock);
       last_crc_offset.first = std::numeric_limits<size_t>::max();
       last_crc_offset.second = std::numeric_limits<size_t>::max();
+      block_crcs.swap(b);
     }
   };
 } // namespace ceph::buffer
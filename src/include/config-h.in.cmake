@@ -133,6 +133,9 @@
 /* AsyncMessenger RDMA conditional compilation */
 #cmakedefine HAVE_RDMA
 
+/* AsyncMessenger io_uring conditional compilation */
+#cmakedefine HAVE_LIBURING
+
 /* ibverbs experimental conditional compilation */
 #cmakedefine HAVE_IBV_EXP
 
@@ -372,6 +372,38 @@ struct denc_traits<T, std::enable_if_t<!std::is_void_v<_denc::ExtType_t<T>>>>
   }
 };
 
+// types whose encoding is their in-memory representation. a run of them in
+// a contiguous container is encoded and decoded with a single memcpy and a
+// single bounds check, instead of element by element.
+namespace _denc {
+template<typename T, typename=void>
+struct is_memcpy_safe : std::false_type {};
+
+template<typename T>
+struct is_memcpy_safe<
+  T,
+  std::enable_if_t<
+    is_any_of<underlying_type_t<T>,
+	      ceph_le64, ceph_le32, ceph_le16, uint8_t
+#ifndef _CHAR_IS_SIGNED
+		, int8_t
+#endif
+	      >>> : std::true_type {};
+
+#if defined(CEPH_LITTLE_ENDIAN)
+// not bool, as not every byte on the wire is a valid bool
+template<typename T>
+struct is_memcpy_safe<
+  T,
+  std::enable_if_t<!std::is_void_v<ExtType_t<T>> &&
+		   !std::is_same_v<T, bool> &&
+		   sizeof(T) == sizeof(ExtType_t<T>)>> : std::true_type {};
+#endif
+
+template<typename T>
+inline constexpr bool is_memcpy_safe_v = is_memcpy_safe<T>::value;
+} // namespace _denc
+
 // varint
 //
 // high bit of each byte indicates another byte follows.
@@ -894,6 +926,9 @@ namespace _denc {
     static constexpr bool featured = traits::featured;
     static constexpr bool bounded = false;
     static constexpr bool need_contiguous = traits::need_contiguous;
+    // the elements can be copied in and out as a whole
+    static constexpr bool memcpy_safe =
+      Details::contiguous && _denc::is_memcpy_safe_v<T>;
 
     template<typename U=T>
     static void bound_encode(const container& s, size_t& p, uint64_t f = 0) {
@@ -947,6 +982,13 @@ namespace _denc {
     // nohead
     static void encode_nohead(const container& s, buffer::list::contiguous_appender& p,
 			      uint64_t f = 0) {
+      if constexpr (memcpy_safe) {
+	if (!s.empty()) {
+	  p.append(reinterpret_cast<const char*>(s.data()),
+		   sizeof(T) * s.size());
+	}
+	return;
+      }
       for (const T& e : s) {
         if constexpr (traits::featured) {
           denc(e, p, f);
@@ -958,6 +1000,15 @@ namespace _denc {
     static void decode_nohead(size_t num, container& s,
 			      buffer::ptr::const_iterator& p, uint64_t f=0) {
       s.clear();
+      if constexpr (memcpy_safe) {
+	if (num) {
+	  // advancing first throws if we are short of data
+	  const char* src = p.get_pos_add(sizeof(T) * num);
+	  s.resize(num);
+	  memcpy(s.data(), src, sizeof(T) * num);
+	}
+	return;
+      }
       Details::reserve(s, num);
       while (num--) {
 	T t;
@@ -970,6 +1021,16 @@ namespace _denc {
     decode_nohead(size_t num, container& s,
 		  buffer::list::const_iterator& p) {
       s.clear();
+      if constexpr (memcpy_safe) {
+	if (num) {
+	  if (p.get_remaining() < sizeof(T) * num) {
+	    throw buffer::end_of_buffer();
+	  }
+	  s.resize(num);
+	  p.copy(sizeof(T) * num, reinterpret_cast<char*>(s.data()));
+	}
+	return;
+      }
       Details::reserve(s, num);
       while (num--) {
 	T t;
@@ -1001,6 +1062,7 @@ namespace _denc {
   template<typename Container>
   struct container_details_base {
     using T = typename Container::value_type;
+    static constexpr bool contiguous = false;
     static void reserve(Container& c, size_t s) {
       if constexpr (container_has_reserve_v<Container>) {
         c.reserve(s);
@@ -1015,6 +1077,11 @@ namespace _denc {
       c.emplace_back(std::forward<Args>(args)...);
     }
   };
+
+  template<typename Container>
+  struct vector_details : public pushback_details<Container> {
+    static constexpr bool contiguous = true;
+  };
 }
 
 template<typename T, typename ...Ts>
@@ -1030,7 +1097,7 @@ struct denc_traits<
   std::vector<T, Ts...>,
   typename std::enable_if_t<denc_traits<T>::supported>>
   : public _denc::container_base<std::vector,
-				 _denc::pushback_details<std::vector<T, Ts...>>,
+				 _denc::vector_details<std::vector<T, Ts...>>,
 				 T, Ts...> {};
 
 namespace _denc {
@@ -1133,24 +1200,36 @@ public:
 
   static void encode(const container& s, buffer::list::contiguous_appender& p,
 	 uint64_t f = 0) {
-    for (const auto& e : s) {
-      if constexpr (traits::featured) {
-        denc(e, p, f);
-      } else {
-        denc(e, p);
+    if constexpr (_denc::is_memcpy_safe_v<T>) {
+      p.append(reinterpret_cast<const char*>(s.data()), sizeof(T) * N);
+    } else {
+      for (const auto& e : s) {
+        if constexpr (traits::featured) {
+          denc(e, p, f);
+        } else {
+          denc(e, p);
+        }
       }
     }
   }
   static void decode(container& s, buffer::ptr::const_iterator& p, uint64_t f = 0) {
-    for (auto& e : s)
-      denc(e, p, f);
+    if constexpr (_denc::is_memcpy_safe_v<T>) {
+      memcpy(s.data(), p.get_pos_add(sizeof(T) * N), sizeof(T) * N);
+    } else {
+      for (auto& e : s)
+        denc(e, p, f);
+    }
   }
   template<typename U=T>
   static std::enable_if_t<!!sizeof(U) &&
 			  !need_contiguous>
   decode(container& s, buffer::list::const_iterator& p) {
-    for (auto& e : s) {
-      denc(e, p);
+    if constexpr (_denc::is_memcpy_safe_v<T>) {
+      p.copy(sizeof(T) * N, reinterpret_cast<char*>(s.data()));
+    } else {
+      for (auto& e : s) {
+        denc(e, p);
+      }
     }
   }
 };
@@ -1125,6 +1125,31 @@ namespace librados
         ObjectReadOperation *op, int flags,
         bufferlist *pbl, const blkin_trace_info *trace_info);
 
+    /**
+     * Schedule operations on many objects with a single completion
+     *
+     * The operations are mapped and sent together, grouped by OSD, which
+     * is cheaper than one aio_operate() per object.  The completion
+     * fires once all of them have finished, with 0 or the first error
+     * encountered.
+     *
+     * @param oids the objects to operate on
+     * @param ops the operation for each object, in the same order
+     * @param c what to do when all of the operations are complete
+     * @param flags flags to apply to every operation (OPERATION_*)
+     * @param prvals where to store the result of each operation, or
+     *               NULL; it must remain valid until @p c completes
+     * @returns 0 on success, negative error code on failure
+     */
+    int aio_operate_batch(const std::vector<std::string>& oids,
+			  const std::vector<ObjectWriteOperation*>& ops,
+			  AioCompletion *c, int flags,
+			  std::vector<int> *prvals);
+    int aio_operate_batch(const std::vector<std::string>& oids,
+			  const std::vector<ObjectReadOperation*>& ops,
+			  AioCompletion *c, int flags,
+			  std::vector<int> *prvals);
+
     // watch/notify
     int watch2(const std::string& o, uint64_t *handle,
 	       librados::WatchCtx2 *ctx);
@@ -90,6 +90,11 @@ void dump_services(Formatter* f, const map<string, list<string> >& services, con
 string cleanbin(bufferlist &bl, bool &b64);
 string cleanbin(string &str);
 
+/// parse a cpu list as found in sysfs, e.g. "0-7,16-23"
+/// @param cpus the cpus in the list, sorted and without duplicates
+/// @return 0 on success, -EINVAL if the list is malformed
+int parse_cpu_list(const string& s, vector<int> *cpus);
+
 namespace ceph::util {
 
 // Returns true if s matches any parameters:
@@ -803,6 +803,100 @@ int librados::IoCtxImpl::aio_operate(const object_t& oid,
   return 0;
 }
 
+namespace {
+
+/// completes a batch of ops once all of them have finished
+struct C_aio_Batch {
+  /// per-op completion, owned by the batch rather than by the Objecter
+  struct Item : public Context {
+    C_aio_Batch *batch = nullptr;
+    size_t index = 0;
+
+    void finish(int r) override {
+      batch->finish_item(index, r);
+    }
+    void complete(int r) override {
+      finish(r);
+    }
+  };
+
+  Context *on_finish;
+  std::unique_ptr<Item[]> items;
+  std::vector<int> *prvals;
+  std::atomic<size_t> pending;
+  std::atomic<int> result = { 0 };
+
+  C_aio_Batch(Context *on_finish, size_t count, std::vector<int> *prvals)
+    : on_finish(on_finish), items(new Item[count]), prvals(prvals),
+      pending(count) {
+    for (size_t i = 0; i < count; ++i) {
+      items[i].batch = this;
+      items[i].index = i;
+    }
+  }
+
+  void finish_item(size_t index, int r) {
+    if (prvals) {
+      (*prvals)[index] = r;
+    }
+    if (r < 0) {
+      int expected = 0;
+      result.compare_exchange_strong(expected, r);
+    }
+    if (--pending == 0) {
+      on_finish->complete(result);
+      delete this;
+    }
+  }
+};
+
+} // anonymous namespace
+
+int librados::IoCtxImpl::aio_operate_batch(
+  const std::vector<object_t>& oids,
+  const std::vector<::ObjectOperation*>& ops,
+  AioCompletionImpl *c, bool is_read, int flags, std::vector<int> *prvals)
+{
+  FUNCTRACE(client->cct);
+  if (oids.size() != ops.size())
+    return -EINVAL;
+  /* can't write to a snapshot */
+  if (!is_read && snap_seq != CEPH_NOSNAP)
+    return -EROFS;
+
+  Context *oncomplete = new C_aio_Complete(c);
+  c->io = this;
+  if (is_read) {
+    c->is_read = true;
+  } else {
+    queue_aio_write(c);
+  }
+
+  if (prvals) {
+    prvals->assign(ops.size(), 0);
+  }
+  if (ops.empty()) {
+    oncomplete->complete(0);
+    return 0;
+  }
+
+  auto batch = new C_aio_Batch(oncomplete, ops.size(), prvals);
+  auto ut = ceph::real_clock::now();
+  std::vector<Objecter::Op*> objecter_ops;
+  objecter_ops.reserve(ops.size());
+  for (size_t i = 0; i < ops.size(); ++i) {
+    if (is_read) {
+      objecter_ops.push_back(objecter->prepare_read_op(
+	oids[i], oloc, *ops[i], snap_seq, nullptr, flags, &batch->items[i]));
+    } else {
+      objecter_ops.push_back(objecter->prepare_mutate_op(
+	oids[i], oloc, *ops[i], snapc, ut, flags, &batch->items[i]));
+    }
+  }
+  objecter->op_submit_batch(objecter_ops);
+  return 0;
+}
+
 int librados::IoCtxImpl::aio_read(const object_t oid, AioCompletionImpl *c,
 				  bufferlist *pbl, size_t len, uint64_t off,
 				  uint64_t snapid, const blkin_trace_info *info)
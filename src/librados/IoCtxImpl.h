@@ -158,6 +158,10 @@ struct librados::IoCtxImpl {
 		  int flags, const blkin_trace_info *trace_info = nullptr);
   int aio_operate_read(const object_t& oid, ::ObjectOperation *o,
 		       AioCompletionImpl *c, int flags, bufferlist *pbl, const blkin_trace_info *trace_info = nullptr);
+  int aio_operate_batch(const std::vector<object_t>& oids,
+			const std::vector<::ObjectOperation*>& ops,
+			AioCompletionImpl *c, bool is_read, int flags,
+			std::vector<int> *prvals);
 
   struct C_aio_stat_Ack : public Context {
     librados::AioCompletionImpl *c;
@@ -1524,6 +1524,36 @@ int librados::IoCtx::aio_operate(const std::string& oid, AioCompletion *c,
                translate_flags(flags), pbl, trace_info);
 }
 
+int librados::IoCtx::aio_operate_batch(
+  const std::vector<std::string>& oids,
+  const std::vector<librados::ObjectWriteOperation*>& ops,
+  AioCompletion *c, int flags, std::vector<int> *prvals)
+{
+  std::vector<object_t> objs(oids.begin(), oids.end());
+  std::vector<::ObjectOperation*> o;
+  o.reserve(ops.size());
+  for (auto op : ops) {
+    o.push_back(&op->impl->o);
+  }
+  return io_ctx_impl->aio_operate_batch(objs, o, c->pc, false,
+					translate_flags(flags), prvals);
+}
+
+int librados::IoCtx::aio_operate_batch(
+  const std::vector<std::string>& oids,
+  const std::vector<librados::ObjectReadOperation*>& ops,
+  AioCompletion *c, int flags, std::vector<int> *prvals)
+{
+  std::vector<object_t> objs(oids.begin(), oids.end());
+  std::vector<::ObjectOperation*> o;
+  o.reserve(ops.size());
+  for (auto op : ops) {
+    o.push_back(&op->impl->o);
+  }
+  return io_ctx_impl->aio_operate_batch(objs, o, c->pc, true,
+					translate_flags(flags), prvals);
+}
+
 void librados::IoCtx::snap_set_read(snap_t seq)
 {
   io_ctx_impl->set_snap_read(seq);
@@ -25,6 +25,7 @@
 #include "librbd/Types.h"
 #include "librbd/Utils.h"
 #include "librbd/LibrbdWriteback.h"
+#include "librbd/cache/WriteLogImageCache.h"
 #include "librbd/exclusive_lock/AutomaticPolicy.h"
 #include "librbd/exclusive_lock/StandardPolicy.h"
 #include "librbd/io/AioCompletion.h"
@@ -286,6 +287,8 @@ public:
     plb.add_u64_counter(l_librbd_resize, "resize", "Resizes");
     plb.add_u64_counter(l_librbd_readahead, "readahead", "Read ahead");
     plb.add_u64_counter(l_librbd_readahead_bytes, "readahead_bytes", "Data size in read ahead", NULL, 0, unit_t(UNIT_BYTES));
+    plb.add_u64_counter(l_librbd_coalesced_wr, "coalesced_wr", "Object writes held for coalescing");
+    plb.add_u64_counter(l_librbd_coalesced_wr_ops, "coalesced_wr_ops", "Coalesced object writes sent");
     plb.add_u64_counter(l_librbd_invalidate_cache, "invalidate_cache", "Cache invalidates");
 
     plb.add_time(l_librbd_opened_time, "opened_time", "Opened time",
@@ -805,6 +808,15 @@ public:
 
 #undef ASSIGN_OPTION
 
+    if (cache && !read_only &&
+        config.get_val<bool>("rbd_persistent_cache_enabled")) {
+      // the persistent cache retires a log entry once its writeback
+      // completes, which must not be acked by the in-memory cache
+      ldout(cct, 5) << __func__ << ": persistent cache enabled, "
+                    << "disabling rbd_cache" << dendl;
+      cache = false;
+    }
+
     if (sparse_read_threshold_bytes == 0) {
       sparse_read_threshold_bytes = get_object_size();
     }
@@ -850,6 +862,10 @@ public:
     return new Journal<ImageCtx>(*this);
   }
 
+  cache::ImageCache *ImageCtx::create_image_cache() {
+    return new cache::WriteLogImageCache<ImageCtx>(*this);
+  }
+
   void ImageCtx::set_image_name(const std::string &image_name) {
     // update the name so rename can be invoked repeatedly
     RWLock::RLocker owner_locker(owner_lock);
@@ -303,6 +303,7 @@ namespace librbd {
     ExclusiveLock<ImageCtx> *create_exclusive_lock();
     ObjectMap<ImageCtx> *create_object_map(uint64_t snap_id);
     Journal<ImageCtx> *create_journal();
+    cache::ImageCache *create_image_cache();
 
     void clear_pending_completions();
 
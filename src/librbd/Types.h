@@ -46,6 +46,8 @@ enum {
 
   l_librbd_readahead,
   l_librbd_readahead_bytes,
+  l_librbd_coalesced_wr,
+  l_librbd_coalesced_wr_ops,
 
   l_librbd_invalidate_cache,
 
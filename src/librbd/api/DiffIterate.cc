@@ -17,6 +17,7 @@
 #include "osdc/Striper.h"
 #include "librados/snap_set_diff.h"
 #include <boost/tuple/tuple.hpp>
+#include <limits>
 #include <list>
 #include <map>
 #include <vector>
@@ -44,6 +45,7 @@ struct DiffContext {
   uint64_t end_snap_id;
   interval_set<uint64_t> parent_diff;
   OrderedThrottle throttle;
+  size_t batch_size;
 
   template <typename I>
   DiffContext(I &image_ctx, DiffIterate<>::Callback callback,
@@ -53,6 +55,108 @@ struct DiffContext {
       whole_object(_whole_object), from_snap_id(_from_snap_id),
       end_snap_id(_end_snap_id),
       throttle(image_ctx.config.template get_val<uint64_t>("rbd_concurrent_management_ops"), true) {
+    // requests waiting for their batch to be sent hold throttle slots, so
+    // keep a batch below the throttle limit and allow two in flight
+    batch_size = std::max<uint64_t>(
+      1, image_ctx.config.template get_val<uint64_t>(
+           "rbd_concurrent_management_ops") / 2);
+  }
+};
+
+/**
+ * Requests for the objects of an image extent which are sent together:
+ * list_snaps ops are issued to RADOS with a single aio_operate_batch()
+ * call and the requests which need no op (the object map already tells
+ * their state) complete along with them, so that all of them still
+ * complete in image order.
+ */
+class ListSnapsBatch {
+public:
+  ListSnapsBatch(librados::IoCtx &head_ctx, size_t max_size)
+    : m_head_ctx(head_ctx), m_max_size(max_size) {
+  }
+  ~ListSnapsBatch() {
+    ceph_assert(m_batch == nullptr);
+  }
+
+  void add_list_snaps(const std::string &oid, librados::snap_set_t *snap_set,
+                      int *snap_ret, Context *on_finish) {
+    auto batch = get_batch();
+    batch->oids.push_back(oid);
+    batch->ops.emplace_back();
+    batch->ops.back().list_snaps(snap_set, snap_ret);
+    batch->requests.push_back({on_finish, 0, batch->oids.size() - 1});
+    send_if_full();
+  }
+
+  void add_complete(Context *on_finish, int r) {
+    auto batch = get_batch();
+    batch->requests.push_back({on_finish, r, NO_OP});
+    send_if_full();
+  }
+
+  void send() {
+    C_Batch *batch = m_batch;
+    if (batch == nullptr) {
+      return;
+    }
+    m_batch = nullptr;
+
+    if (batch->oids.empty()) {
+      batch->complete(0);
+      return;
+    }
+
+    std::vector<librados::ObjectReadOperation*> ops;
+    for (auto &op : batch->ops) {
+      ops.push_back(&op);
+    }
+    librados::AioCompletion *rados_completion =
+      util::create_rados_callback(batch);
+    int r = m_head_ctx.aio_operate_batch(batch->oids, ops, rados_completion,
+                                         0, &batch->rvals);
+    ceph_assert(r == 0);
+    rados_completion->release();
+  }
+
+private:
+  static const size_t NO_OP = std::numeric_limits<size_t>::max();
+
+  struct Request {
+    Context *on_finish;
+    int r;
+    size_t op_index;
+  };
+
+  struct C_Batch : public Context {
+    std::vector<Request> requests;
+    std::vector<std::string> oids;
+    std::list<librados::ObjectReadOperation> ops;
+    std::vector<int> rvals;
+
+    void finish(int r) override {
+      for (auto &request : requests) {
+        request.on_finish->complete(
+          request.op_index == NO_OP ? request.r : rvals[request.op_index]);
+      }
+    }
+  };
+
+  librados::IoCtx &m_head_ctx;
+  size_t m_max_size;
+  C_Batch *m_batch = nullptr;
+
+  C_Batch *get_batch() {
+    if (m_batch == nullptr) {
+      m_batch = new C_Batch();
+    }
+    return m_batch;
+  }
+
+  void send_if_full() {
+    if (m_batch->requests.size() >= m_max_size) {
+      send();
+    }
   }
 };
 
@@ -67,17 +171,22 @@ public:
       m_object_extents(object_extents), m_snap_ret(0) {
   }
 
-  void send() {
+  void send(ListSnapsBatch *batch) {
     C_OrderedThrottle *ctx = m_diff_context.throttle.start_op(this);
-    librados::AioCompletion *rados_completion =
-      util::create_rados_callback(ctx);
+    batch->add_list_snaps(m_oid, &m_snap_set, &m_snap_ret, ctx);
+  }
 
-    librados::ObjectReadOperation op;
-    op.list_snaps(&m_snap_set, &m_snap_ret);
+  // the object map shows the object was removed since the start snapshot
+  void send_hole(ListSnapsBatch *batch) {
+    m_hole = true;
+    C_OrderedThrottle *ctx = m_diff_context.throttle.start_op(this);
+    batch->add_complete(ctx, 0);
+  }
 
-    int r = m_head_ctx.aio_operate(m_oid, rados_completion, &op, NULL);
-    ceph_assert(r == 0);
-    rados_completion->release();
+  // the object map shows the object does not exist in the end snapshot
+  void send_nonexistent(ListSnapsBatch *batch) {
+    C_OrderedThrottle *ctx = m_diff_context.throttle.start_op(this);
+    batch->add_complete(ctx, -ENOENT);
   }
 
 protected:
@@ -91,7 +200,10 @@ protected:
     }
 
     Diffs diffs;
-    if (r == 0) {
+    if (r == 0 && m_hole) {
+      ldout(cct, 20) << "object " << m_oid << ": removed" << dendl;
+      compute_hole(&diffs);
+    } else if (r == 0) {
       ldout(cct, 20) << "object " << m_oid << ": list_snaps complete" << dendl;
       compute_diffs(&diffs);
     } else if (r == -ENOENT) {
@@ -126,6 +238,7 @@ private:
 
   librados::snap_set_t m_snap_set;
   int m_snap_ret;
+  bool m_hole = false;
 
   void compute_diffs(Diffs *diffs) {
     CephContext *cct = m_cct;
@@ -191,6 +304,13 @@ private:
     }
   }
 
+  void compute_hole(Diffs *diffs) {
+    for (auto &q : m_object_extents) {
+      diffs->push_back(boost::make_tuple(m_offset + q.offset, q.length,
+                                         false));
+    }
+  }
+
   void compute_parent_overlap(Diffs *diffs) {
     if (m_diff_context.from_snap_id == 0 &&
         !m_diff_context.parent_diff.empty()) {
@@ -309,7 +429,7 @@ int DiffIterate<I>::execute() {
   BitVector<2> object_diff_state;
   {
     RWLock::RLocker snap_locker(m_image_ctx.snap_lock);
-    if (m_whole_object && (m_image_ctx.features & RBD_FEATURE_FAST_DIFF) != 0) {
+    if ((m_image_ctx.features & RBD_FEATURE_FAST_DIFF) != 0) {
       r = diff_object_map(from_snap_id, end_snap_id, &object_diff_state);
       if (r < 0) {
         ldout(cct, 5) << "fast diff disabled" << dendl;
@@ -350,6 +470,7 @@ int DiffIterate<I>::execute() {
     }
   }
 
+  ListSnapsBatch batch(head_ctx, diff_context.batch_size);
   uint64_t period = m_image_ctx.get_stripe_period();
   uint64_t off = m_offset;
   uint64_t left = m_length;
@@ -370,11 +491,15 @@ int DiffIterate<I>::execute() {
          p != object_extents.end(); ++p) {
       ldout(cct, 20) << "object " << p->first << dendl;
 
+      uint8_t diff_state = OBJECT_DIFF_STATE_UPDATED;
       if (fast_diff_enabled) {
         const uint64_t object_no = p->second.front().objectno;
-        if (object_diff_state[object_no] != OBJECT_DIFF_STATE_NONE) {
-          bool updated = (object_diff_state[object_no] ==
-                            OBJECT_DIFF_STATE_UPDATED);
+        diff_state = object_diff_state[object_no];
+      }
+
+      if (fast_diff_enabled && m_whole_object) {
+        if (diff_state != OBJECT_DIFF_STATE_NONE) {
+          bool updated = (diff_state == OBJECT_DIFF_STATE_UPDATED);
           for (std::vector<ObjectExtent>::iterator q = p->second.begin();
                q != p->second.end(); ++q) {
             r = m_callback(off + q->offset, q->length, updated, m_callback_arg);
@@ -383,17 +508,36 @@ int DiffIterate<I>::execute() {
             }
           }
         }
+        continue;
+      }
+
+      // from the beginning of time, an object which does not exist in the
+      // end snapshot can only report the parent overlap
+      if (diff_state == OBJECT_DIFF_STATE_HOLE && from_snap_id == 0) {
+        diff_state = OBJECT_DIFF_STATE_NONE;
+      }
+      if (diff_state == OBJECT_DIFF_STATE_NONE &&
+          (from_snap_id != 0 || diff_context.parent_diff.empty())) {
+        ldout(cct, 20) << "object " << p->first << ": unchanged" << dendl;
+        continue;
+      }
+
+      C_DiffObject *diff_object = new C_DiffObject(m_image_ctx, head_ctx,
+                                                   diff_context,
+                                                   p->first.name, off,
+                                                   p->second);
+      if (diff_state == OBJECT_DIFF_STATE_UPDATED) {
+        diff_object->send(&batch);
+      } else if (diff_state == OBJECT_DIFF_STATE_HOLE) {
+        diff_object->send_hole(&batch);
       } else {
-        C_DiffObject *diff_object = new C_DiffObject(m_image_ctx, head_ctx,
-                                                     diff_context,
-                                                     p->first.name, off,
-                                                     p->second);
-        diff_object->send();
-
-        if (diff_context.throttle.pending_error()) {
-          r = diff_context.throttle.wait_for_ret();
-          return r;
-        }
+        diff_object->send_nonexistent(&batch);
+      }
+
+      if (diff_context.throttle.pending_error()) {
+        batch.send();
+        r = diff_context.throttle.wait_for_ret();
+        return r;
       }
     }
 
@@ -401,6 +545,7 @@ int DiffIterate<I>::execute() {
     off += read_len;
   }
 
+  batch.send();
   r = diff_context.throttle.wait_for_ret();
   if (r < 0) {
     return r;
@@ -4,6 +4,7 @@
 #include "librbd/cache/ObjectCacherObjectDispatch.h"
 #include "common/errno.h"
 #include "common/WorkQueue.h"
+#include "include/stringify.h"
 #include "librbd/ImageCtx.h"
 #include "librbd/Journal.h"
 #include "librbd/Utils.h"
@@ -32,32 +33,32 @@ typedef std::vector<ObjectExtent> ObjectExtents;
 template <typename I>
 struct ObjectCacherObjectDispatch<I>::C_InvalidateCache : public Context {
   ObjectCacherObjectDispatch* dispatcher;
+  Shard* shard;
   bool purge_on_error;
   Context *on_finish;
 
-  C_InvalidateCache(ObjectCacherObjectDispatch* dispatcher,
+  C_InvalidateCache(ObjectCacherObjectDispatch* dispatcher, Shard* shard,
                     bool purge_on_error, Context *on_finish)
-    : dispatcher(dispatcher), purge_on_error(purge_on_error),
+    : dispatcher(dispatcher), shard(shard), purge_on_error(purge_on_error),
       on_finish(on_finish) {
   }
 
   void finish(int r) override {
-    ceph_assert(dispatcher->m_cache_lock.is_locked());
+    ceph_assert(shard->cache_lock.is_locked());
     auto cct = dispatcher->m_image_ctx->cct;
 
     if (r == -EBLACKLISTED) {
       lderr(cct) << "blacklisted during flush (purging)" << dendl;
-      dispatcher->m_object_cacher->purge_set(dispatcher->m_object_set);
+      shard->object_cacher->purge_set(shard->object_set);
     } else if (r < 0 && purge_on_error) {
       lderr(cct) << "failed to invalidate cache (purging): "
                  << cpp_strerror(r) << dendl;
-      dispatcher->m_object_cacher->purge_set(dispatcher->m_object_set);
+      shard->object_cacher->purge_set(shard->object_set);
     } else if (r != 0) {
       lderr(cct) << "failed to invalidate cache: " << cpp_strerror(r) << dendl;
     }
 
-    auto unclean = dispatcher->m_object_cacher->release_set(
-      dispatcher->m_object_set);
+    auto unclean = shard->object_cacher->release_set(shard->object_set);
     if (unclean == 0) {
       r = 0;
     } else {
@@ -72,20 +73,29 @@ struct ObjectCacherObjectDispatch<I>::C_InvalidateCache : public Context {
   }
 };
 
+template <typename I>
+ObjectCacherObjectDispatch<I>::Shard::~Shard() {
+  delete object_cacher;
+  delete object_set;
+
+  delete writeback_handler;
+}
+
 template <typename I>
 ObjectCacherObjectDispatch<I>::ObjectCacherObjectDispatch(
     I* image_ctx)
-  : m_image_ctx(image_ctx),
-    m_cache_lock(util::unique_lock_name(
-      "librbd::cache::ObjectCacherObjectDispatch::cache_lock", this)) {
+  : m_image_ctx(image_ctx) {
+  auto shards = m_image_ctx->config.template get_val<uint64_t>(
+    "rbd_cache_shards");
+  for (uint64_t i = 0; i < shards; ++i) {
+    m_shards.emplace_back(new Shard(util::unique_lock_name(
+      "librbd::cache::ObjectCacherObjectDispatch::cache_lock",
+      this) + "::" + stringify(i)));
+  }
 }
 
 template <typename I>
 ObjectCacherObjectDispatch<I>::~ObjectCacherObjectDispatch() {
-  delete m_object_cacher;
-  delete m_object_set;
-
-  delete m_writeback_handler;
 }
 
 template <typename I>
@@ -93,10 +103,7 @@ void ObjectCacherObjectDispatch<I>::init() {
   auto cct = m_image_ctx->cct;
   ldout(cct, 5) << dendl;
 
-  m_cache_lock.Lock();
   ldout(cct, 5) << "enabling caching..." << dendl;
-  m_writeback_handler = new LibrbdWriteback(m_image_ctx, m_cache_lock);
-
   uint64_t init_max_dirty = m_image_ctx->cache_max_dirty;
   if (m_image_ctx->cache_writethrough_until_flush) {
     init_max_dirty = 0;
@@ -118,14 +125,8 @@ void ObjectCacherObjectDispatch<I>::init() {
                 << " num_objects=" << 10
                 << " max_dirty=" << init_max_dirty
                 << " target_dirty=" << target_dirty
-                << " max_dirty_age=" << max_dirty_age << dendl;
-
-  m_object_cacher = new ObjectCacher(cct, m_image_ctx->perfcounter->get_name(),
-                                     *m_writeback_handler, m_cache_lock,
-                                     nullptr, nullptr, cache_size,
-                                     10,  /* reset this in init */
-                                     init_max_dirty, target_dirty,
-                                     max_dirty_age, block_writes_upfront);
+                << " max_dirty_age=" << max_dirty_age
+                << " shards=" << m_shards.size() << dendl;
 
   // size object cache appropriately
   if (max_dirty_object == 0) {
@@ -135,12 +136,32 @@ void ObjectCacherObjectDispatch<I>::init() {
   }
   ldout(cct, 5) << " cache bytes " << cache_size
                 << " -> about " << max_dirty_object << " objects" << dendl;
-  m_object_cacher->set_max_objects(max_dirty_object);
 
-  m_object_set = new ObjectCacher::ObjectSet(nullptr,
-                                             m_image_ctx->data_ctx.get_id(), 0);
-  m_object_cacher->start();
-  m_cache_lock.Unlock();
+  // the limits are split evenly between the shards
+  uint64_t shards = m_shards.size();
+  for (uint64_t i = 0; i < shards; ++i) {
+    auto &shard = *m_shards[i];
+    Mutex::Locker cache_locker(shard.cache_lock);
+
+    std::string name = m_image_ctx->perfcounter->get_name();
+    if (i > 0) {
+      name += "-" + stringify(i);
+    }
+
+    shard.writeback_handler = new LibrbdWriteback(m_image_ctx,
+                                                  shard.cache_lock);
+    shard.object_cacher = new ObjectCacher(
+      cct, name, *shard.writeback_handler, shard.cache_lock, nullptr, nullptr,
+      cache_size / shards, 10,  /* reset this in init */
+      init_max_dirty / shards, target_dirty / shards, max_dirty_age,
+      block_writes_upfront);
+    shard.object_cacher->set_max_objects(
+      std::max<uint64_t>(1, max_dirty_object / shards));
+
+    shard.object_set = new ObjectCacher::ObjectSet(
+      nullptr, m_image_ctx->data_ctx.get_id(), 0);
+    shard.object_cacher->start();
+  }
 
   // add ourself to the IO object dispatcher chain
   m_image_ctx->io_object_dispatcher->register_object_dispatch(this);
@@ -155,21 +176,27 @@ void ObjectCacherObjectDispatch<I>::shut_down(Context* on_finish) {
 
   // shut down the cache
   on_finish = new FunctionContext([this, on_finish](int r) {
-      m_object_cacher->stop();
+      for (auto &shard : m_shards) {
+        shard->object_cacher->stop();
+      }
       on_finish->complete(r);
     });
 
   // ensure we aren't holding the cache lock post-flush
   on_finish = util::create_async_context_callback(*m_image_ctx, on_finish);
 
-  // invalidate any remaining cache entries
-  on_finish = new C_InvalidateCache(this, true, on_finish);
+  auto gather_ctx = new C_Gather(cct, on_finish);
+  for (auto &shard : m_shards) {
+    // invalidate any remaining cache entries
+    auto ctx = new C_InvalidateCache(this, shard.get(), true,
+                                     gather_ctx->new_sub());
 
-  // flush all pending writeback state
-  m_cache_lock.Lock();
-  m_object_cacher->release_set(m_object_set);
-  m_object_cacher->flush_set(m_object_set, on_finish);
-  m_cache_lock.Unlock();
+    // flush all pending writeback state
+    Mutex::Locker cache_locker(shard->cache_lock);
+    shard->object_cacher->release_set(shard->object_set);
+    shard->object_cacher->flush_set(shard->object_set, ctx);
+  }
+  gather_ctx->activate();
 }
 
 template <typename I>
@@ -189,8 +216,9 @@ bool ObjectCacherObjectDispatch<I>::read(
   on_dispatched = util::create_async_context_callback(*m_image_ctx,
                                                       on_dispatched);
 
+  auto &shard = get_shard(object_no);
   m_image_ctx->snap_lock.get_read();
-  auto rd = m_object_cacher->prepare_read(snap_id, read_data, op_flags);
+  auto rd = shard.object_cacher->prepare_read(snap_id, read_data, op_flags);
   m_image_ctx->snap_lock.put_read();
 
   ObjectExtent extent(oid, object_no, object_off, object_len, 0);
@@ -201,9 +229,10 @@ bool ObjectCacherObjectDispatch<I>::read(
   ZTracer::Trace trace(parent_trace);
   *dispatch_result = io::DISPATCH_RESULT_COMPLETE;
 
-  m_cache_lock.Lock();
-  int r = m_object_cacher->readx(rd, m_object_set, on_dispatched, &trace);
-  m_cache_lock.Unlock();
+  shard.cache_lock.Lock();
+  int r = shard.object_cacher->readx(rd, shard.object_set, on_dispatched,
+                                     &trace);
+  shard.cache_lock.Unlock();
   if (r != 0) {
     on_dispatched->complete(r);
   }
@@ -226,12 +255,13 @@ bool ObjectCacherObjectDispatch<I>::discard(
 
   // discard the cache state after changes are committed to disk (and to
   // prevent races w/ readahead)
+  auto &shard = get_shard(object_no);
   auto ctx = *on_finish;
   *on_finish = new FunctionContext(
-    [this, object_extents, ctx](int r) {
-      m_cache_lock.Lock();
-      m_object_cacher->discard_set(m_object_set, object_extents);
-      m_cache_lock.Unlock();
+    [&shard, object_extents, ctx](int r) {
+      shard.cache_lock.Lock();
+      shard.object_cacher->discard_set(shard.object_set, object_extents);
+      shard.cache_lock.Unlock();
 
       ctx->complete(r);
     });
@@ -244,10 +274,10 @@ bool ObjectCacherObjectDispatch<I>::discard(
 
   // ensure any in-flight writeback is complete before advancing
   // the discard request
-  m_cache_lock.Lock();
-  m_object_cacher->discard_writeback(m_object_set, object_extents,
-                                     on_dispatched);
-  m_cache_lock.Unlock();
+  shard.cache_lock.Lock();
+  shard.object_cacher->discard_writeback(shard.object_set, object_extents,
+                                         on_dispatched);
+  shard.cache_lock.Unlock();
   return true;
 }
 
@@ -266,8 +296,9 @@ bool ObjectCacherObjectDispatch<I>::write(
   on_dispatched = util::create_async_context_callback(*m_image_ctx,
                                                       on_dispatched);
 
+  auto &shard = get_shard(object_no);
   m_image_ctx->snap_lock.get_read();
-  ObjectCacher::OSDWrite *wr = m_object_cacher->prepare_write(
+  ObjectCacher::OSDWrite *wr = shard.object_cacher->prepare_write(
     snapc, data, ceph::real_time::min(), op_flags, *journal_tid);
   m_image_ctx->snap_lock.put_read();
 
@@ -279,9 +310,9 @@ bool ObjectCacherObjectDispatch<I>::write(
   ZTracer::Trace trace(parent_trace);
   *dispatch_result = io::DISPATCH_RESULT_COMPLETE;
 
-  m_cache_lock.Lock();
-  m_object_cacher->writex(wr, m_object_set, on_dispatched, &trace);
-  m_cache_lock.Unlock();
+  shard.cache_lock.Lock();
+  shard.object_cacher->writex(wr, shard.object_set, on_dispatched, &trace);
+  shard.cache_lock.Unlock();
   return true;
 }
 
@@ -337,9 +368,10 @@ bool ObjectCacherObjectDispatch<I>::compare_and_write(
   object_extents.emplace_back(oid, object_no, object_off, cmp_data.length(),
                               0);
 
-  Mutex::Locker cache_locker(m_cache_lock);
-  m_object_cacher->flush_set(m_object_set, object_extents, &trace,
-                             on_dispatched);
+  auto &shard = get_shard(object_no);
+  Mutex::Locker cache_locker(shard.cache_lock);
+  shard.object_cacher->flush_set(shard.object_set, object_extents, &trace,
+                                 on_dispatched);
   return true;
 }
 
@@ -355,18 +387,26 @@ bool ObjectCacherObjectDispatch<I>::flush(
   on_dispatched = util::create_async_context_callback(*m_image_ctx,
                                                       on_dispatched);
 
-  m_cache_lock.Lock();
-  if (flush_source == io::FLUSH_SOURCE_USER && !m_user_flushed &&
+  bool enable_writeback = false;
+  if (flush_source == io::FLUSH_SOURCE_USER &&
       m_image_ctx->cache_writethrough_until_flush &&
-      m_image_ctx->cache_max_dirty > 0) {
-    m_user_flushed = true;
-    m_object_cacher->set_max_dirty(m_image_ctx->cache_max_dirty);
+      m_image_ctx->cache_max_dirty > 0 && !m_user_flushed.exchange(true)) {
+    enable_writeback = true;
     ldout(cct, 5) << "saw first user flush, enabling writeback" << dendl;
   }
 
   *dispatch_result = io::DISPATCH_RESULT_CONTINUE;
-  m_object_cacher->flush_set(m_object_set, on_dispatched);
-  m_cache_lock.Unlock();
+
+  auto gather_ctx = new C_Gather(cct, on_dispatched);
+  for (auto &shard : m_shards) {
+    Mutex::Locker cache_locker(shard->cache_lock);
+    if (enable_writeback) {
+      shard->object_cacher->set_max_dirty(
+        m_image_ctx->cache_max_dirty / m_shards.size());
+    }
+    shard->object_cacher->flush_set(shard->object_set, gather_ctx->new_sub());
+  }
+  gather_ctx->activate();
   return true;
 }
 
@@ -378,13 +418,17 @@ bool ObjectCacherObjectDispatch<I>::invalidate_cache(Context* on_finish) {
   // ensure we aren't holding the cache lock post-flush
   on_finish = util::create_async_context_callback(*m_image_ctx, on_finish);
 
-  // invalidate any remaining cache entries
-  on_finish = new C_InvalidateCache(this, false, on_finish);
+  auto gather_ctx = new C_Gather(cct, on_finish);
+  for (auto &shard : m_shards) {
+    // invalidate any remaining cache entries
+    auto ctx = new C_InvalidateCache(this, shard.get(), false,
+                                     gather_ctx->new_sub());
 
-  m_cache_lock.Lock();
-  m_object_cacher->release_set(m_object_set);
-  m_object_cacher->flush_set(m_object_set, on_finish);
-  m_cache_lock.Unlock();
+    Mutex::Locker cache_locker(shard->cache_lock);
+    shard->object_cacher->release_set(shard->object_set);
+    shard->object_cacher->flush_set(shard->object_set, ctx);
+  }
+  gather_ctx->activate();
   return true;
 }
 
@@ -394,9 +438,10 @@ bool ObjectCacherObjectDispatch<I>::reset_existence_cache(
   auto cct = m_image_ctx->cct;
   ldout(cct, 5) << dendl;
 
-  m_cache_lock.Lock();
-  m_object_cacher->clear_nonexistence(m_object_set);
-  m_cache_lock.Unlock();
+  for (auto &shard : m_shards) {
+    Mutex::Locker cache_locker(shard->cache_lock);
+    shard->object_cacher->clear_nonexistence(shard->object_set);
+  }
 
   return false;
 }
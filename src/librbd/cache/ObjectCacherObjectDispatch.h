@@ -7,6 +7,9 @@
 #include "librbd/io/ObjectDispatchInterface.h"
 #include "common/Mutex.h"
 #include "osdc/ObjectCacher.h"
+#include <atomic>
+#include <memory>
+#include <vector>
 
 struct WritebackHandler;
 
@@ -92,15 +95,32 @@ public:
 private:
   struct C_InvalidateCache;
 
+  /**
+   * Objects are spread across independent object cachers by object
+   * number, so that IO to different objects does not serialize on a
+   * single cache lock.
+   */
+  struct Shard {
+    Mutex cache_lock;
+    ObjectCacher *object_cacher = nullptr;
+    ObjectCacher::ObjectSet *object_set = nullptr;
+
+    WritebackHandler *writeback_handler = nullptr;
+
+    explicit Shard(const std::string &lock_name) : cache_lock(lock_name) {
+    }
+    ~Shard();
+  };
+
   ImageCtxT* m_image_ctx;
 
-  Mutex m_cache_lock;
-  ObjectCacher *m_object_cacher = nullptr;
-  ObjectCacher::ObjectSet *m_object_set = nullptr;
+  std::vector<std::unique_ptr<Shard>> m_shards;
 
-  WritebackHandler *m_writeback_handler = nullptr;
+  std::atomic<bool> m_user_flushed = { false };
 
-  bool m_user_flushed = false;
+  Shard &get_shard(uint64_t object_no) {
+    return *m_shards[object_no % m_shards.size()];
+  }
 
 };
 
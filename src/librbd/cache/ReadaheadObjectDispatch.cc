@@ -0,0 +1,411 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "librbd/cache/ReadaheadObjectDispatch.h"
+#include "common/dout.h"
+#include "common/perf_counters.h"
+#include "common/WorkQueue.h"
+#include "librbd/ImageCtx.h"
+#include "librbd/Types.h"
+#include "librbd/Utils.h"
+#include "librbd/io/ObjectDispatchSpec.h"
+#include "librbd/io/ObjectDispatcher.h"
+
+#define dout_subsys ceph_subsys_rbd
+#undef dout_prefix
+#define dout_prefix *_dout << "librbd::cache::ReadaheadObjectDispatch: " \
+                           << this << " " << __func__ << ": "
+
+namespace librbd {
+namespace cache {
+
+template <typename I>
+ReadaheadObjectDispatch<I>::ReadaheadObjectDispatch(I* image_ctx)
+  : m_image_ctx(image_ctx), m_object_size(image_ctx->layout.object_size),
+    m_readahead_objects(image_ctx->config.template get_val<uint64_t>(
+      "rbd_readahead_objects")),
+    m_trigger_requests(image_ctx->config.template get_val<uint64_t>(
+      "rbd_readahead_trigger_requests")),
+    m_max_streams(image_ctx->config.template get_val<uint64_t>(
+      "rbd_readahead_streams")),
+    m_max_buffer_bytes(image_ctx->config.template get_val<Option::size_t>(
+      "rbd_readahead_buffer_max_bytes")),
+    m_disable_after_bytes(image_ctx->config.template get_val<Option::size_t>(
+      "rbd_readahead_disable_after_bytes")),
+    m_lock(util::unique_lock_name(
+      "librbd::cache::ReadaheadObjectDispatch::m_lock", this)) {
+}
+
+template <typename I>
+ReadaheadObjectDispatch<I>::~ReadaheadObjectDispatch() {
+  ceph_assert(m_in_flight_writes.empty());
+}
+
+template <typename I>
+void ReadaheadObjectDispatch<I>::init() {
+  auto cct = m_image_ctx->cct;
+  ldout(cct, 5) << "readahead_objects=" << m_readahead_objects << ", "
+                << "streams=" << m_max_streams << dendl;
+
+  // add ourself to the IO object dispatcher chain
+  m_image_ctx->io_object_dispatcher->register_object_dispatch(this);
+}
+
+template <typename I>
+void ReadaheadObjectDispatch<I>::shut_down(Context* on_finish) {
+  auto cct = m_image_ctx->cct;
+  ldout(cct, 5) << dendl;
+
+  m_async_op_tracker.wait_for_ops(on_finish);
+}
+
+template <typename I>
+bool ReadaheadObjectDispatch<I>::read(
+    const std::string &oid, uint64_t object_no, uint64_t object_off,
+    uint64_t object_len, librados::snap_t snap_id, int op_flags,
+    const ZTracer::Trace &parent_trace, ceph::bufferlist* read_data,
+    io::ExtentMap* extent_map, int* object_dispatch_flags,
+    io::DispatchResult* dispatch_result, Context** on_finish,
+    Context* on_dispatched) {
+  auto cct = m_image_ctx->cct;
+  ldout(cct, 20) << "object_no=" << object_no << " " << object_off << "~"
+                 << object_len << ", snap_id=" << snap_id << dendl;
+
+  ObjectKey key(snap_id, object_no);
+  EntryRef entry;
+  ReadRequest* req = nullptr;
+  uint64_t prefetch_start = 0;
+  uint64_t prefetch_end = 0;
+  {
+    Mutex::Locker locker(m_lock);
+    m_total_bytes_read += object_len;
+    update_stream(object_no, object_off, object_len, snap_id,
+                  &prefetch_start, &prefetch_end);
+
+    auto it = m_entries.find(key);
+    if (it != m_entries.end()) {
+      entry = it->second.first;
+      m_entry_lru.splice(m_entry_lru.begin(), m_entry_lru, it->second.second);
+
+      on_dispatched = util::create_async_context_callback(*m_image_ctx,
+                                                          on_dispatched);
+      req = new ReadRequest{object_off, object_len, read_data,
+                            dispatch_result, on_dispatched};
+      *dispatch_result = io::DISPATCH_RESULT_COMPLETE;
+      if (!entry->ready) {
+        ldout(cct, 20) << "waiting for prefetch of " << oid << dendl;
+        entry->waiters.push_back(req);
+        req = nullptr;
+      } else if (object_off + object_len >= m_object_size) {
+        // the stream is done with the object
+        erase_entry(key);
+      }
+    }
+  }
+
+  if (prefetch_start < prefetch_end) {
+    uint64_t object_count;
+    {
+      RWLock::RLocker snap_locker(m_image_ctx->snap_lock);
+      object_count = m_image_ctx->get_object_count(snap_id);
+    }
+    for (uint64_t i = prefetch_start;
+         i < std::min(prefetch_end, object_count); ++i) {
+      send_prefetch(i, snap_id);
+    }
+  }
+
+  if (req != nullptr) {
+    ldout(cct, 20) << "hit " << oid << dendl;
+    complete_read(*entry, req);
+  }
+  return (entry != nullptr);
+}
+
+template <typename I>
+bool ReadaheadObjectDispatch<I>::discard(
+    const std::string &oid, uint64_t object_no, uint64_t object_off,
+    uint64_t object_len, const ::SnapContext &snapc, int discard_flags,
+    const ZTracer::Trace &parent_trace, int* object_dispatch_flags,
+    uint64_t* journal_tid, io::DispatchResult* dispatch_result,
+    Context** on_finish, Context* on_dispatched) {
+  start_write(object_no, on_finish);
+  return false;
+}
+
+template <typename I>
+bool ReadaheadObjectDispatch<I>::write(
+    const std::string &oid, uint64_t object_no, uint64_t object_off,
+    ceph::bufferlist&& data, const ::SnapContext &snapc, int op_flags,
+    const ZTracer::Trace &parent_trace, int* object_dispatch_flags,
+    uint64_t* journal_tid, io::DispatchResult* dispatch_result,
+    Context** on_finish, Context* on_dispatched) {
+  start_write(object_no, on_finish);
+  return false;
+}
+
+template <typename I>
+bool ReadaheadObjectDispatch<I>::write_same(
+    const std::string &oid, uint64_t object_no, uint64_t object_off,
+    uint64_t object_len, io::Extents&& buffer_extents,
+    ceph::bufferlist&& data, const ::SnapContext &snapc, int op_flags,
+    const ZTracer::Trace &parent_trace, int* object_dispatch_flags,
+    uint64_t* journal_tid, io::DispatchResult* dispatch_result,
+    Context** on_finish, Context* on_dispatched) {
+  start_write(object_no, on_finish);
+  return false;
+}
+
+template <typename I>
+bool ReadaheadObjectDispatch<I>::compare_and_write(
+    const std::string &oid, uint64_t object_no, uint64_t object_off,
+    ceph::bufferlist&& cmp_data, ceph::bufferlist&& write_data,
+    const ::SnapContext &snapc, int op_flags,
+    const ZTracer::Trace &parent_trace, uint64_t* mismatch_offset,
+    int* object_dispatch_flags, uint64_t* journal_tid,
+    io::DispatchResult* dispatch_result, Context** on_finish,
+    Context* on_dispatched) {
+  start_write(object_no, on_finish);
+  return false;
+}
+
+template <typename I>
+bool ReadaheadObjectDispatch<I>::invalidate_cache(Context* on_finish) {
+  auto cct = m_image_ctx->cct;
+  ldout(cct, 5) << dendl;
+
+  Mutex::Locker locker(m_lock);
+  while (!m_entry_lru.empty()) {
+    erase_entry(m_entry_lru.back()->key);
+  }
+  m_streams.clear();
+  return false;
+}
+
+template <typename I>
+void ReadaheadObjectDispatch<I>::update_stream(
+    uint64_t object_no, uint64_t object_off, uint64_t object_len,
+    librados::snap_t snap_id, uint64_t* prefetch_start,
+    uint64_t* prefetch_end) {
+  ceph_assert(m_lock.is_locked());
+
+  uint64_t offset = object_no * m_object_size + object_off;
+  auto it = m_streams.begin();
+  for (; it != m_streams.end(); ++it) {
+    if (it->snap_id == snap_id && it->next_offset == offset) {
+      break;
+    }
+  }
+
+  if (it == m_streams.end()) {
+    if (m_streams.size() >= m_max_streams) {
+      m_streams.pop_back();
+    }
+    m_streams.push_front({snap_id, offset + object_len, 1, object_no + 1});
+    it = m_streams.begin();
+  } else {
+    it->next_offset = offset + object_len;
+    ++it->sequential_requests;
+    m_streams.splice(m_streams.begin(), m_streams, it);
+  }
+
+  if (it->sequential_requests < m_trigger_requests ||
+      (m_disable_after_bytes != 0 &&
+       m_total_bytes_read > m_disable_after_bytes)) {
+    return;
+  }
+
+  // keep the following objects of the stream prefetched
+  uint64_t end = object_no + 1 + m_readahead_objects;
+  uint64_t start = std::max(object_no + 1, it->readahead_end);
+  if (start < end) {
+    ldout(m_image_ctx->cct, 20) << "stream at " << offset << ": "
+                                << "prefetching objects " << start << "~"
+                                << end - start << dendl;
+    it->readahead_end = end;
+    *prefetch_start = start;
+    *prefetch_end = end;
+  }
+}
+
+template <typename I>
+void ReadaheadObjectDispatch<I>::send_prefetch(uint64_t object_no,
+                                               librados::snap_t snap_id) {
+  auto cct = m_image_ctx->cct;
+
+  ObjectKey key(snap_id, object_no);
+  auto entry = std::make_shared<Entry>();
+  entry->key = key;
+  {
+    Mutex::Locker locker(m_lock);
+    if (m_entries.count(key) != 0) {
+      return;
+    }
+    if (snap_id == CEPH_NOSNAP && m_in_flight_writes.count(object_no) != 0) {
+      ldout(cct, 20) << "skipping object " << object_no << " being written"
+                     << dendl;
+      return;
+    }
+    if (!reserve_buffer()) {
+      ldout(cct, 20) << "buffer full, skipping object " << object_no << dendl;
+      return;
+    }
+
+    m_entry_lru.push_front(entry);
+    m_entries[key] = {entry, m_entry_lru.begin()};
+    m_buffer_bytes += m_object_size;
+  }
+
+  ldout(cct, 20) << "object_no=" << object_no << ", snap_id=" << snap_id
+                 << dendl;
+  m_image_ctx->perfcounter->inc(l_librbd_readahead);
+  m_image_ctx->perfcounter->inc(l_librbd_readahead_bytes, m_object_size);
+
+  m_async_op_tracker.start_op();
+  auto ctx = new FunctionContext([this, entry](int r) {
+      handle_prefetch(entry, r);
+    });
+  auto req = io::ObjectDispatchSpec::create_read(
+    m_image_ctx, io::OBJECT_DISPATCH_LAYER_READAHEAD,
+    m_image_ctx->get_object_name(object_no), object_no, 0, m_object_size,
+    snap_id, 0, {}, &entry->bl, &entry->extent_map, ctx);
+  req->send();
+}
+
+template <typename I>
+void ReadaheadObjectDispatch<I>::handle_prefetch(EntryRef entry, int r) {
+  auto cct = m_image_ctx->cct;
+  ldout(cct, 20) << "object_no=" << entry->key.second << ", r=" << r << dendl;
+
+  if (r >= 0 && !entry->extent_map.empty()) {
+    // expand a sparse read so that any extent can be served from it
+    bufferlist bl;
+    uint64_t data_off = 0;
+    for (auto &extent : entry->extent_map) {
+      if (extent.first > bl.length()) {
+        bl.append_zero(extent.first - bl.length());
+      }
+      bufferlist sub_bl;
+      sub_bl.substr_of(entry->bl, data_off, extent.second);
+      bl.claim_append(sub_bl);
+      data_off += extent.second;
+    }
+    entry->bl.swap(bl);
+    entry->extent_map.clear();
+  }
+
+  ReadRequests waiters;
+  {
+    Mutex::Locker locker(m_lock);
+    entry->r = (r < 0 ? r : 0);
+    entry->ready = true;
+    waiters.swap(entry->waiters);
+
+    // reads of objects which could not be prefetched go to the cluster
+    if (r < 0 && r != -ENOENT && !entry->invalidated) {
+      erase_entry(entry->key);
+    }
+  }
+
+  for (auto req : waiters) {
+    if (r < 0 && r != -ENOENT) {
+      *req->dispatch_result = io::DISPATCH_RESULT_CONTINUE;
+      req->on_dispatched->complete(0);
+      delete req;
+      continue;
+    }
+    complete_read(*entry, req);
+  }
+
+  m_async_op_tracker.finish_op();
+}
+
+template <typename I>
+void ReadaheadObjectDispatch<I>::complete_read(const Entry &entry,
+                                               ReadRequest* req) {
+  // a missing object reads as zeros, as it does from the cluster
+  int r = entry.r;
+  req->read_data->clear();
+  if (r == 0 && req->object_off < entry.bl.length()) {
+    req->read_data->substr_of(
+      entry.bl, req->object_off,
+      std::min<uint64_t>(req->object_len,
+                         entry.bl.length() - req->object_off));
+  }
+
+  *req->dispatch_result = io::DISPATCH_RESULT_COMPLETE;
+  req->on_dispatched->complete(r);
+  delete req;
+}
+
+template <typename I>
+bool ReadaheadObjectDispatch<I>::reserve_buffer() {
+  ceph_assert(m_lock.is_locked());
+
+  // objects being prefetched cannot be evicted
+  auto it = m_entry_lru.end();
+  while (m_buffer_bytes + m_object_size > m_max_buffer_bytes &&
+         it != m_entry_lru.begin()) {
+    --it;
+    if ((*it)->ready) {
+      auto key = (*it)->key;
+      it = m_entry_lru.erase(it);
+      m_entries.erase(key);
+      m_buffer_bytes -= m_object_size;
+    }
+  }
+  return (m_buffer_bytes + m_object_size <= m_max_buffer_bytes);
+}
+
+template <typename I>
+void ReadaheadObjectDispatch<I>::erase_entry(const ObjectKey &key) {
+  ceph_assert(m_lock.is_locked());
+
+  auto it = m_entries.find(key);
+  if (it == m_entries.end()) {
+    return;
+  }
+
+  // reads already waiting for a prefetch are still served by it
+  it->second.first->invalidated = true;
+  m_entry_lru.erase(it->second.second);
+  m_entries.erase(it);
+  m_buffer_bytes -= m_object_size;
+}
+
+template <typename I>
+void ReadaheadObjectDispatch<I>::start_write(uint64_t object_no,
+                                             Context** on_finish) {
+  auto cct = m_image_ctx->cct;
+  ldout(cct, 20) << "object_no=" << object_no << dendl;
+
+  {
+    Mutex::Locker locker(m_lock);
+    ++m_in_flight_writes[object_no];
+    erase_entry(ObjectKey(CEPH_NOSNAP, object_no));
+  }
+
+  // objects are not prefetched until the write completes
+  m_async_op_tracker.start_op();
+  Context* ctx = *on_finish;
+  *on_finish = new FunctionContext([this, object_no, ctx](int r) {
+      finish_write(object_no);
+      ctx->complete(r);
+      m_async_op_tracker.finish_op();
+    });
+}
+
+template <typename I>
+void ReadaheadObjectDispatch<I>::finish_write(uint64_t object_no) {
+  Mutex::Locker locker(m_lock);
+  auto it = m_in_flight_writes.find(object_no);
+  ceph_assert(it != m_in_flight_writes.end());
+  if (--it->second == 0) {
+    m_in_flight_writes.erase(it);
+  }
+}
+
+} // namespace cache
+} // namespace librbd
+
+template class librbd::cache::ReadaheadObjectDispatch<librbd::ImageCtx>;
@@ -0,0 +1,175 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#ifndef CEPH_LIBRBD_CACHE_READAHEAD_OBJECT_DISPATCH_H
+#define CEPH_LIBRBD_CACHE_READAHEAD_OBJECT_DISPATCH_H
+
+#include "librbd/io/ObjectDispatchInterface.h"
+#include "common/AsyncOpTracker.h"
+#include "common/Mutex.h"
+#include <list>
+#include <map>
+#include <memory>
+#include <utility>
+
+namespace librbd {
+
+class ImageCtx;
+
+namespace cache {
+
+/**
+ * Readahead for images without the object cacher.  Sequential streams of
+ * object reads are detected, several per image, and once a stream has
+ * issued enough sequential requests the whole objects which follow it are
+ * prefetched into a bounded buffer.  Reads of buffered objects are served
+ * from memory and writes drop the objects they touch from the buffer.
+ *
+ * Streams are tracked in object space, so this only applies to images
+ * which are not striped over several objects.
+ */
+template <typename ImageCtxT = ImageCtx>
+class ReadaheadObjectDispatch : public io::ObjectDispatchInterface {
+public:
+  static ReadaheadObjectDispatch* create(ImageCtxT* image_ctx) {
+    return new ReadaheadObjectDispatch(image_ctx);
+  }
+
+  ReadaheadObjectDispatch(ImageCtxT* image_ctx);
+  ~ReadaheadObjectDispatch() override;
+
+  io::ObjectDispatchLayer get_object_dispatch_layer() const override {
+    return io::OBJECT_DISPATCH_LAYER_READAHEAD;
+  }
+
+  void init();
+  void shut_down(Context* on_finish) override;
+
+  bool read(
+      const std::string &oid, uint64_t object_no, uint64_t object_off,
+      uint64_t object_len, librados::snap_t snap_id, int op_flags,
+      const ZTracer::Trace &parent_trace, ceph::bufferlist* read_data,
+      io::ExtentMap* extent_map, int* object_dispatch_flags,
+      io::DispatchResult* dispatch_result, Context** on_finish,
+      Context* on_dispatched) override;
+
+  bool discard(
+      const std::string &oid, uint64_t object_no, uint64_t object_off,
+      uint64_t object_len, const ::SnapContext &snapc, int discard_flags,
+      const ZTracer::Trace &parent_trace, int* object_dispatch_flags,
+      uint64_t* journal_tid, io::DispatchResult* dispatch_result,
+      Context** on_finish, Context* on_dispatched) override;
+
+  bool write(
+      const std::string &oid, uint64_t object_no, uint64_t object_off,
+      ceph::bufferlist&& data, const ::SnapContext &snapc, int op_flags,
+      const ZTracer::Trace &parent_trace, int* object_dispatch_flags,
+      uint64_t* journal_tid, io::DispatchResult* dispatch_result,
+      Context** on_finish, Context* on_dispatched) override;
+
+  bool write_same(
+      const std::string &oid, uint64_t object_no, uint64_t object_off,
+      uint64_t object_len, io::Extents&& buffer_extents,
+      ceph::bufferlist&& data, const ::SnapContext &snapc, int op_flags,
+      const ZTracer::Trace &parent_trace, int* object_dispatch_flags,
+      uint64_t* journal_tid, io::DispatchResult* dispatch_result,
+      Context** on_finish, Context* on_dispatched) override;
+
+  bool compare_and_write(
+      const std::string &oid, uint64_t object_no, uint64_t object_off,
+      ceph::bufferlist&& cmp_data, ceph::bufferlist&& write_data,
+      const ::SnapContext &snapc, int op_flags,
+      const ZTracer::Trace &parent_trace, uint64_t* mismatch_offset,
+      int* object_dispatch_flags, uint64_t* journal_tid,
+      io::DispatchResult* dispatch_result, Context** on_finish,
+      Context* on_dispatched) override;
+
+  bool flush(
+      io::FlushSource flush_source, const ZTracer::Trace &parent_trace,
+      io::DispatchResult* dispatch_result, Context** on_finish,
+      Context* on_dispatched) override {
+    return false;
+  }
+
+  bool invalidate_cache(Context* on_finish) override;
+  bool reset_existence_cache(Context* on_finish) override {
+    return false;
+  }
+
+  void extent_overwritten(
+      uint64_t object_no, uint64_t object_off, uint64_t object_len,
+      uint64_t journal_tid, uint64_t new_journal_tid) override {
+  }
+
+private:
+  typedef std::pair<librados::snap_t, uint64_t> ObjectKey;
+
+  struct ReadRequest {
+    uint64_t object_off;
+    uint64_t object_len;
+    ceph::bufferlist* read_data;
+    io::DispatchResult* dispatch_result;
+    Context* on_dispatched;
+  };
+  typedef std::list<ReadRequest*> ReadRequests;
+
+  /// a whole object, buffered or being prefetched
+  struct Entry {
+    ObjectKey key;
+    bool ready = false;
+    bool invalidated = false;
+    int r = 0;
+    ceph::bufferlist bl;
+    io::ExtentMap extent_map;
+    ReadRequests waiters;
+  };
+  typedef std::shared_ptr<Entry> EntryRef;
+  typedef std::list<EntryRef> EntryLRU;
+
+  /// a sequential stream of reads, in object space
+  struct Stream {
+    librados::snap_t snap_id;
+    uint64_t next_offset;
+    uint64_t sequential_requests;
+    uint64_t readahead_end;     ///< first object not prefetched yet
+  };
+
+  ImageCtxT* m_image_ctx;
+  uint64_t m_object_size;
+  uint64_t m_readahead_objects;
+  uint64_t m_trigger_requests;
+  uint64_t m_max_streams;
+  uint64_t m_max_buffer_bytes;
+  uint64_t m_disable_after_bytes;
+
+  AsyncOpTracker m_async_op_tracker;
+
+  Mutex m_lock;
+  std::list<Stream> m_streams;            ///< most recently used first
+  std::map<ObjectKey, std::pair<EntryRef, typename EntryLRU::iterator>>
+    m_entries;
+  EntryLRU m_entry_lru;                   ///< most recently used first
+  uint64_t m_buffer_bytes = 0;
+  uint64_t m_total_bytes_read = 0;
+  std::map<uint64_t, uint64_t> m_in_flight_writes;  ///< by object number
+
+  void update_stream(uint64_t object_no, uint64_t object_off,
+                     uint64_t object_len, librados::snap_t snap_id,
+                     uint64_t* prefetch_start, uint64_t* prefetch_end);
+  void send_prefetch(uint64_t object_no, librados::snap_t snap_id);
+  void handle_prefetch(EntryRef entry, int r);
+
+  void complete_read(const Entry &entry, ReadRequest* req);
+
+  bool reserve_buffer();
+  void erase_entry(const ObjectKey &key);
+  void start_write(uint64_t object_no, Context** on_finish);
+  void finish_write(uint64_t object_no);
+};
+
+} // namespace cache
+} // namespace librbd
+
+extern template class librbd::cache::ReadaheadObjectDispatch<librbd::ImageCtx>;
+
+#endif // CEPH_LIBRBD_CACHE_READAHEAD_OBJECT_DISPATCH_H
@@ -0,0 +1,407 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "librbd/cache/SharedReadOnlyObjectDispatch.h"
+#include "common/dout.h"
+#include "common/errno.h"
+#include "common/safe_io.h"
+#include "common/Timer.h"
+#include "common/WorkQueue.h"
+#include "include/stringify.h"
+#include "librbd/ImageCtx.h"
+#include "librbd/Utils.h"
+#include "librbd/io/ObjectDispatcher.h"
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define dout_subsys ceph_subsys_rbd
+#undef dout_prefix
+#define dout_prefix *_dout << "librbd::cache::SharedReadOnlyObjectDispatch: " \
+                           << this << " " << __func__ << ": "
+
+namespace librbd {
+namespace cache {
+
+namespace {
+
+// how long to wait before checking again for an object being fetched
+// by another instance
+const double FETCH_RETRY_INTERVAL = 0.01;
+
+// the cache holds image data: only the user running the clients may read it
+const mode_t CACHE_DIR_MODE = 0700;
+const mode_t CACHE_FILE_MODE = 0600;
+
+// published in place of an object which does not exist
+const char *DNE_SUFFIX = ".dne";
+
+class ThreadPoolSingleton : public ThreadPool {
+public:
+  ContextWQ *work_queue;
+
+  explicit ThreadPoolSingleton(CephContext *cct)
+    : ThreadPool(cct, "librbd::cache::shared_read_only_thread_pool",
+                 "tp_rbd_sro", 1),
+      work_queue(new ContextWQ("librbd::cache::shared_read_only_work_queue",
+                               cct->_conf.get_val<uint64_t>(
+                                 "rbd_op_thread_timeout"),
+                               this)) {
+    start();
+  }
+  ~ThreadPoolSingleton() override {
+    work_queue->drain();
+    delete work_queue;
+
+    stop();
+  }
+};
+
+int create_directories(const std::string &path) {
+  for (size_t pos = 1; pos != std::string::npos;) {
+    pos = path.find('/', pos + 1);
+    std::string dir = path.substr(0, pos);
+    if (::mkdir(dir.c_str(), CACHE_DIR_MODE) < 0 && errno != EEXIST) {
+      return -errno;
+    }
+  }
+  return 0;
+}
+
+} // anonymous namespace
+
+template <typename I>
+SharedReadOnlyObjectDispatch<I>::SharedReadOnlyObjectDispatch(I* image_ctx)
+  : m_image_ctx(image_ctx),
+    m_lock(util::unique_lock_name(
+      "librbd::cache::SharedReadOnlyObjectDispatch::m_lock", this)) {
+  CephContext *cct = m_image_ctx->cct;
+
+  // the pool and image ids are only unique within a cluster
+  std::string fsid;
+  librados::Rados rados(m_image_ctx->data_ctx);
+  rados.cluster_fsid(&fsid);
+  m_cache_dir = m_image_ctx->config.template get_val<std::string>(
+      "rbd_shared_cache_path") + "/" + fsid + "/" +
+    stringify(m_image_ctx->data_ctx.get_id()) + "/" + m_image_ctx->id;
+
+  auto thread_pool = &cct->lookup_or_create_singleton_object<
+    ThreadPoolSingleton>("librbd::cache::shared_read_only_thread_pool",
+                         false, cct);
+  m_work_queue = thread_pool->work_queue;
+  ImageCtx::get_timer_instance(cct, &m_timer, &m_timer_lock);
+}
+
+template <typename I>
+SharedReadOnlyObjectDispatch<I>::~SharedReadOnlyObjectDispatch() {
+  ceph_assert(m_fetches.empty());
+}
+
+template <typename I>
+void SharedReadOnlyObjectDispatch<I>::init() {
+  auto cct = m_image_ctx->cct;
+  ldout(cct, 5) << "cache_dir=" << m_cache_dir << dendl;
+
+  int r = create_directories(m_cache_dir);
+  if (r < 0) {
+    lderr(cct) << "failed to create " << m_cache_dir << ": "
+               << cpp_strerror(r) << dendl;
+    delete this;
+    return;
+  }
+
+  // add ourself to the IO object dispatcher chain
+  m_image_ctx->io_object_dispatcher->register_object_dispatch(this);
+}
+
+template <typename I>
+void SharedReadOnlyObjectDispatch<I>::shut_down(Context* on_finish) {
+  auto cct = m_image_ctx->cct;
+  ldout(cct, 5) << dendl;
+
+  m_async_op_tracker.wait_for_ops(on_finish);
+}
+
+template <typename I>
+bool SharedReadOnlyObjectDispatch<I>::read(
+    const std::string &oid, uint64_t object_no, uint64_t object_off,
+    uint64_t object_len, librados::snap_t snap_id, int op_flags,
+    const ZTracer::Trace &parent_trace, ceph::bufferlist* read_data,
+    io::ExtentMap* extent_map, int* object_dispatch_flags,
+    io::DispatchResult* dispatch_result, Context** on_finish,
+    Context* on_dispatched) {
+  // only snapshots are immutable
+  if (snap_id == CEPH_NOSNAP) {
+    return false;
+  }
+
+  auto cct = m_image_ctx->cct;
+  ldout(cct, 20) << "object_no=" << object_no << " " << object_off << "~"
+                 << object_len << ", snap_id=" << snap_id << dendl;
+
+  auto req = new ReadRequest{oid, snap_id, object_off, object_len, read_data,
+                             dispatch_result, on_dispatched};
+  *dispatch_result = io::DISPATCH_RESULT_COMPLETE;
+
+  m_async_op_tracker.start_op();
+  m_work_queue->queue(new FunctionContext([this, req](int r) {
+      process_read(req);
+    }), 0);
+  return true;
+}
+
+template <typename I>
+std::string SharedReadOnlyObjectDispatch<I>::get_object_path(
+    const std::string &oid, librados::snap_t snap_id) const {
+  return m_cache_dir + "/" + stringify(snap_id) + "/" + oid;
+}
+
+template <typename I>
+void SharedReadOnlyObjectDispatch<I>::process_read(ReadRequest* req) {
+  auto cct = m_image_ctx->cct;
+  auto path = get_object_path(req->oid, req->snap_id);
+
+  int r = read_object_file(path, req);
+  if (r == 0) {
+    ldout(cct, 20) << "hit " << path << dendl;
+    complete_read(req, 0, true);
+    return;
+  } else if (r == -ENOENT && ::access((path + DNE_SUFFIX).c_str(), F_OK) == 0) {
+    ldout(cct, 20) << "hit dne " << path << dendl;
+    complete_read(req, -ENOENT, true);
+    return;
+  } else if (r != -ENOENT) {
+    lderr(cct) << "failed to read " << path << ": " << cpp_strerror(r)
+               << dendl;
+    complete_read(req, 0, false);
+    return;
+  }
+
+  {
+    Mutex::Locker locker(m_lock);
+    auto &reqs = m_fetches[path];
+    reqs.push_back(req);
+    if (reqs.size() > 1) {
+      // the object is already being fetched
+      return;
+    }
+  }
+
+  ldout(cct, 20) << "miss " << path << dendl;
+  send_fetch(new Fetch{req->oid, req->snap_id, path});
+}
+
+template <typename I>
+int SharedReadOnlyObjectDispatch<I>::read_object_file(const std::string &path,
+                                                     ReadRequest* req) {
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return -errno;
+  }
+
+  // the object may be shorter than the read
+  bufferptr bp(buffer::create(req->object_len));
+  int r = safe_pread(fd, bp.c_str(), req->object_len, req->object_off);
+  VOID_TEMP_FAILURE_RETRY(::close(fd));
+  if (r < 0) {
+    return r;
+  }
+
+  bp.set_length(r);
+  req->read_data->clear();
+  req->read_data->push_back(std::move(bp));
+  return 0;
+}
+
+template <typename I>
+void SharedReadOnlyObjectDispatch<I>::send_fetch(Fetch* fetch) {
+  auto cct = m_image_ctx->cct;
+
+  int r;
+  if (fetch->lock_fd < 0) {
+    auto snap_dir = fetch->path.substr(0, fetch->path.rfind('/'));
+    if (::mkdir(snap_dir.c_str(), CACHE_DIR_MODE) < 0 && errno != EEXIST) {
+      r = -errno;
+      lderr(cct) << "failed to create " << snap_dir << ": " << cpp_strerror(r)
+                 << dendl;
+      finish_fetch(fetch, r);
+      return;
+    }
+
+    auto lock_path = fetch->path + ".lock";
+    fetch->lock_fd = ::open(lock_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC,
+                            CACHE_FILE_MODE);
+    if (fetch->lock_fd < 0) {
+      r = -errno;
+      lderr(cct) << "failed to open " << lock_path << ": " << cpp_strerror(r)
+                 << dendl;
+      finish_fetch(fetch, r);
+      return;
+    }
+  }
+
+  // another instance of the host may be fetching the same object: check
+  // again later rather than block the work queue on the lock
+  if (::flock(fetch->lock_fd, LOCK_EX | LOCK_NB) < 0) {
+    r = -errno;
+    if (r != -EWOULDBLOCK) {
+      lderr(cct) << "failed to lock " << fetch->path << ": "
+                 << cpp_strerror(r) << dendl;
+      finish_fetch(fetch, r);
+      return;
+    }
+
+    ldout(cct, 20) << "waiting for " << fetch->path << dendl;
+    Mutex::Locker timer_locker(*m_timer_lock);
+    m_timer->add_event_after(
+      FETCH_RETRY_INTERVAL, new FunctionContext([this, fetch](int r) {
+        m_work_queue->queue(new FunctionContext([this, fetch](int r) {
+            send_fetch(fetch);
+          }), 0);
+      }));
+    return;
+  }
+
+  int fd = ::open(fetch->path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd >= 0) {
+    // published while we waited for the lock
+    r = fetch->bl.read_fd(fd, m_image_ctx->layout.object_size);
+    VOID_TEMP_FAILURE_RETRY(::close(fd));
+    finish_fetch(fetch, r < 0 ? r : 0);
+    return;
+  } else if (::access((fetch->path + DNE_SUFFIX).c_str(), F_OK) == 0) {
+    finish_fetch(fetch, -ENOENT);
+    return;
+  }
+
+  ldout(cct, 20) << "fetching " << fetch->oid << dendl;
+  librados::ObjectReadOperation op;
+  op.read(0, m_image_ctx->layout.object_size, &fetch->bl, nullptr);
+
+  auto ctx = new FunctionContext([this, fetch](int r) {
+      handle_fetch(fetch, r);
+    });
+  librados::AioCompletion *comp = util::create_rados_callback(ctx);
+  int flags = m_image_ctx->get_read_flags(fetch->snap_id);
+  r = m_image_ctx->data_ctx.aio_operate(fetch->oid, comp, &op, flags,
+                                        nullptr);
+  ceph_assert(r == 0);
+  comp->release();
+}
+
+template <typename I>
+void SharedReadOnlyObjectDispatch<I>::handle_fetch(Fetch* fetch, int r) {
+  auto cct = m_image_ctx->cct;
+  ldout(cct, 20) << "oid=" << fetch->oid << ", r=" << r << dendl;
+
+  // keep disk writes off the librados callback thread
+  m_work_queue->queue(new FunctionContext([this, fetch](int r) {
+      std::string path;
+      if (r == 0) {
+        path = fetch->path;
+      } else if (r == -ENOENT && !has_parent(fetch->snap_id)) {
+        path = fetch->path + DNE_SUFFIX;
+      }
+      if (!path.empty()) {
+        int write_r = write_object_file(
+          path, r == 0 ? fetch->bl : bufferlist{});
+        if (write_r < 0) {
+          lderr(m_image_ctx->cct) << "failed to write " << path << ": "
+                                  << cpp_strerror(write_r) << dendl;
+        }
+      }
+      finish_fetch(fetch, r);
+    }), r);
+}
+
+template <typename I>
+bool SharedReadOnlyObjectDispatch<I>::has_parent(
+    librados::snap_t snap_id) const {
+  // an object missing from a clone is read from its parent instead
+  RWLock::RLocker snap_locker(m_image_ctx->snap_lock);
+  RWLock::RLocker parent_locker(m_image_ctx->parent_lock);
+  uint64_t overlap = 0;
+  int r = m_image_ctx->get_parent_overlap(snap_id, &overlap);
+  return r < 0 || overlap > 0;
+}
+
+template <typename I>
+int SharedReadOnlyObjectDispatch<I>::write_object_file(
+    const std::string &path, const bufferlist &bl) {
+  auto tmp_path = path + ".tmp";
+  int fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                  CACHE_FILE_MODE);
+  if (fd < 0) {
+    return -errno;
+  }
+
+  // readers must never see a partial object, even after a crash
+  int r = bl.write_fd(fd);
+  if (r == 0 && ::fdatasync(fd) < 0) {
+    r = -errno;
+  }
+  VOID_TEMP_FAILURE_RETRY(::close(fd));
+  if (r == 0 && ::rename(tmp_path.c_str(), path.c_str()) < 0) {
+    r = -errno;
+  }
+  if (r < 0) {
+    ::unlink(tmp_path.c_str());
+  }
+  return r;
+}
+
+template <typename I>
+void SharedReadOnlyObjectDispatch<I>::finish_fetch(Fetch* fetch, int r) {
+  if (fetch->lock_fd >= 0) {
+    VOID_TEMP_FAILURE_RETRY(::close(fetch->lock_fd));
+  }
+
+  ReadRequests reqs;
+  {
+    Mutex::Locker locker(m_lock);
+    auto it = m_fetches.find(fetch->path);
+    ceph_assert(it != m_fetches.end());
+    reqs.swap(it->second);
+    m_fetches.erase(it);
+  }
+
+  // objects missing from a clone, and failed fetches, are read from the
+  // cluster, which also handles the fallback to the parent of the image
+  bool dne = (r == -ENOENT && !has_parent(fetch->snap_id));
+  for (auto req : reqs) {
+    if (dne) {
+      complete_read(req, -ENOENT, true);
+      continue;
+    } else if (r < 0) {
+      complete_read(req, 0, false);
+      continue;
+    }
+
+    req->read_data->clear();
+    if (req->object_off < fetch->bl.length()) {
+      req->read_data->substr_of(
+        fetch->bl, req->object_off,
+        std::min<uint64_t>(req->object_len,
+                           fetch->bl.length() - req->object_off));
+    }
+    complete_read(req, 0, true);
+  }
+  delete fetch;
+}
+
+template <typename I>
+void SharedReadOnlyObjectDispatch<I>::complete_read(ReadRequest* req, int r,
+                                                    bool handled) {
+  *req->dispatch_result = handled ? io::DISPATCH_RESULT_COMPLETE :
+                                    io::DISPATCH_RESULT_CONTINUE;
+  req->on_dispatched->complete(r);
+  delete req;
+
+  m_async_op_tracker.finish_op();
+}
+
+} // namespace cache
+} // namespace librbd
+
+template class librbd::cache::SharedReadOnlyObjectDispatch<librbd::ImageCtx>;
@@ -0,0 +1,173 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#ifndef CEPH_LIBRBD_CACHE_SHARED_READ_ONLY_OBJECT_DISPATCH_H
+#define CEPH_LIBRBD_CACHE_SHARED_READ_ONLY_OBJECT_DISPATCH_H
+
+#include "librbd/io/ObjectDispatchInterface.h"
+#include "common/AsyncOpTracker.h"
+#include "common/Mutex.h"
+#include <list>
+#include <map>
+#include <string>
+
+class ContextWQ;
+class SafeTimer;
+
+namespace librbd {
+
+class ImageCtx;
+
+namespace cache {
+
+/**
+ * Read-only cache of the objects of image snapshots, kept as one file per
+ * object in a local directory shared by all librbd instances of the host.
+ * It is enabled for the parent images of clones, so that clones of the
+ * same parent on a host fetch each parent object from the cluster once.
+ *
+ * Snapshot objects never change, so files are never invalidated.  A
+ * missing object is fetched whole under an flock() on a per-object lock
+ * file, so that concurrent instances wait for the first fetch instead of
+ * issuing their own, and is published by renaming a complete file in
+ * place.  An object which does not exist is recorded with an empty
+ * marker file, unless the image is itself a clone whose parent provides
+ * the data.  Reads of such objects, or of objects which fail to be cached,
+ * continue down to the cluster.
+ */
+template <typename ImageCtxT = ImageCtx>
+class SharedReadOnlyObjectDispatch : public io::ObjectDispatchInterface {
+public:
+  static SharedReadOnlyObjectDispatch* create(ImageCtxT* image_ctx) {
+    return new SharedReadOnlyObjectDispatch(image_ctx);
+  }
+
+  SharedReadOnlyObjectDispatch(ImageCtxT* image_ctx);
+  ~SharedReadOnlyObjectDispatch() override;
+
+  io::ObjectDispatchLayer get_object_dispatch_layer() const override {
+    return io::OBJECT_DISPATCH_LAYER_SHARED_PERSISTENT_CACHE;
+  }
+
+  void init();
+  void shut_down(Context* on_finish) override;
+
+  bool read(
+      const std::string &oid, uint64_t object_no, uint64_t object_off,
+      uint64_t object_len, librados::snap_t snap_id, int op_flags,
+      const ZTracer::Trace &parent_trace, ceph::bufferlist* read_data,
+      io::ExtentMap* extent_map, int* object_dispatch_flags,
+      io::DispatchResult* dispatch_result, Context** on_finish,
+      Context* on_dispatched) override;
+
+  bool discard(
+      const std::string &oid, uint64_t object_no, uint64_t object_off,
+      uint64_t object_len, const ::SnapContext &snapc, int discard_flags,
+      const ZTracer::Trace &parent_trace, int* object_dispatch_flags,
+      uint64_t* journal_tid, io::DispatchResult* dispatch_result,
+      Context** on_finish, Context* on_dispatched) override {
+    return false;
+  }
+
+  bool write(
+      const std::string &oid, uint64_t object_no, uint64_t object_off,
+      ceph::bufferlist&& data, const ::SnapContext &snapc, int op_flags,
+      const ZTracer::Trace &parent_trace, int* object_dispatch_flags,
+      uint64_t* journal_tid, io::DispatchResult* dispatch_result,
+      Context** on_finish, Context* on_dispatched) override {
+    return false;
+  }
+
+  bool write_same(
+      const std::string &oid, uint64_t object_no, uint64_t object_off,
+      uint64_t object_len, io::Extents&& buffer_extents,
+      ceph::bufferlist&& data, const ::SnapContext &snapc, int op_flags,
+      const ZTracer::Trace &parent_trace, int* object_dispatch_flags,
+      uint64_t* journal_tid, io::DispatchResult* dispatch_result,
+      Context** on_finish, Context* on_dispatched) override {
+    return false;
+  }
+
+  bool compare_and_write(
+      const std::string &oid, uint64_t object_no, uint64_t object_off,
+      ceph::bufferlist&& cmp_data, ceph::bufferlist&& write_data,
+      const ::SnapContext &snapc, int op_flags,
+      const ZTracer::Trace &parent_trace, uint64_t* mismatch_offset,
+      int* object_dispatch_flags, uint64_t* journal_tid,
+      io::DispatchResult* dispatch_result, Context** on_finish,
+      Context* on_dispatched) override {
+    return false;
+  }
+
+  bool flush(
+      io::FlushSource flush_source, const ZTracer::Trace &parent_trace,
+      io::DispatchResult* dispatch_result, Context** on_finish,
+      Context* on_dispatched) override {
+    return false;
+  }
+
+  bool invalidate_cache(Context* on_finish) override {
+    return false;
+  }
+  bool reset_existence_cache(Context* on_finish) override {
+    return false;
+  }
+
+  void extent_overwritten(
+      uint64_t object_no, uint64_t object_off, uint64_t object_len,
+      uint64_t journal_tid, uint64_t new_journal_tid) override {
+  }
+
+  std::string get_object_path(const std::string &oid,
+                              librados::snap_t snap_id) const;
+
+private:
+  struct ReadRequest {
+    std::string oid;
+    librados::snap_t snap_id;
+    uint64_t object_off;
+    uint64_t object_len;
+    ceph::bufferlist* read_data;
+    io::DispatchResult* dispatch_result;
+    Context* on_dispatched;
+  };
+  typedef std::list<ReadRequest*> ReadRequests;
+
+  /// a fetch of a whole object into its cache file
+  struct Fetch {
+    std::string oid;
+    librados::snap_t snap_id;
+    std::string path;
+    int lock_fd = -1;
+    ceph::bufferlist bl;
+  };
+
+  ImageCtxT* m_image_ctx;
+  std::string m_cache_dir;
+
+  ContextWQ* m_work_queue = nullptr;
+  SafeTimer* m_timer = nullptr;
+  Mutex* m_timer_lock = nullptr;
+  AsyncOpTracker m_async_op_tracker;
+
+  Mutex m_lock;
+  std::map<std::string, ReadRequests> m_fetches;  ///< waiting, by path
+
+  void process_read(ReadRequest* req);
+  int read_object_file(const std::string &path, ReadRequest* req);
+
+  void send_fetch(Fetch* fetch);
+  void handle_fetch(Fetch* fetch, int r);
+  bool has_parent(librados::snap_t snap_id) const;
+  int write_object_file(const std::string &path, const ceph::bufferlist &bl);
+  void finish_fetch(Fetch* fetch, int r);
+
+  void complete_read(ReadRequest* req, int r, bool handled);
+};
+
+} // namespace cache
+} // namespace librbd
+
+extern template class librbd::cache::SharedReadOnlyObjectDispatch<librbd::ImageCtx>;
+
+#endif // CEPH_LIBRBD_CACHE_SHARED_READ_ONLY_OBJECT_DISPATCH_H
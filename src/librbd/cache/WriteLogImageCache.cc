@@ -0,0 +1,1342 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "WriteLogImageCache.h"
+#include "include/buffer.h"
+#include "include/Context.h"
+#include "include/intarith.h"
+#include "include/stringify.h"
+#include "common/dout.h"
+#include "common/errno.h"
+#include "common/safe_io.h"
+#include "common/Timer.h"
+#include "librbd/ImageCtx.h"
+#include "librbd/Utils.h"
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#define dout_subsys ceph_subsys_rbd
+#undef dout_prefix
+#define dout_prefix *_dout << "librbd::cache::WriteLogImageCache: " << this \
+                           << " " <<  __func__ << ": "
+
+namespace librbd {
+namespace cache {
+
+using namespace write_log;
+
+namespace {
+
+// entries are split so that a single one never takes a large share of
+// the log, and writesame is only expanded into the log below this size
+const uint64_t MAX_ENTRY_DATA = 1 << 20;
+const uint64_t MAX_WRITESAME_EXPANSION = 8 * MAX_ENTRY_DATA;
+
+// bounds of the delay before a failed writeback is retried
+const double WRITEBACK_RETRY_MIN_DELAY = 1;
+const double WRITEBACK_RETRY_MAX_DELAY = 30;
+
+void encode_entry_header(uint64_t generation, const LogEntry &entry,
+                         const bufferlist &data, bufferlist *bl) {
+  EntryHeader header;
+  memset(static_cast<void*>(&header), 0, sizeof(header));
+  header.magic = ENTRY_MAGIC;
+  header.generation = generation;
+  header.seq = entry.seq;
+  header.image_offset = entry.image_offset;
+  header.length = entry.length;
+  header.data_len = data.length();
+  header.type = entry.type;
+  header.flags = entry.flags;
+
+  uint32_t crc = ceph_crc32c(-1, reinterpret_cast<unsigned char*>(&header),
+                             sizeof(header));
+  header.crc = data.crc32c(crc);
+  bl->append(reinterpret_cast<const char*>(&header), sizeof(header));
+}
+
+bool verify_entry_crc(EntryHeader header, const bufferlist &data) {
+  uint32_t expected = header.crc;
+  header.crc = 0;
+  uint32_t crc = ceph_crc32c(-1, reinterpret_cast<unsigned char*>(&header),
+                             sizeof(header));
+  return data.crc32c(crc) == expected;
+}
+
+struct C_ReadRequest : public Context {
+  std::vector<ReadExtent> pieces;
+  std::vector<bufferlist> hits;
+  bufferlist miss_bl;
+  bufferlist *bl;
+  Context *on_finish;
+
+  C_ReadRequest(bufferlist *bl, Context *on_finish)
+    : bl(bl), on_finish(on_finish) {
+  }
+
+  void finish(int r) override {
+    if (r < 0) {
+      on_finish->complete(r);
+      return;
+    }
+
+    bl->clear();
+    auto hit = hits.begin();
+    uint64_t miss_offset = 0;
+    for (auto &piece : pieces) {
+      switch (piece.kind) {
+      case ReadExtent::HIT:
+        bl->claim_append(*hit++);
+        break;
+      case ReadExtent::ZERO:
+        bl->append_zero(piece.length);
+        break;
+      case ReadExtent::MISS:
+        if (miss_offset < miss_bl.length()) {
+          uint64_t length = std::min<uint64_t>(piece.length,
+                                               miss_bl.length() - miss_offset);
+          bufferlist sub_bl;
+          sub_bl.substr_of(miss_bl, miss_offset, length);
+          bl->claim_append(sub_bl);
+          if (length < piece.length) {
+            bl->append_zero(piece.length - length);
+          }
+        } else {
+          bl->append_zero(piece.length);
+        }
+        miss_offset += piece.length;
+        break;
+      }
+    }
+    on_finish->complete(0);
+  }
+};
+
+} // anonymous namespace
+
+uint64_t LogEntry::get_log_bytes() const {
+  return round_up_to(sizeof(EntryHeader) + data_len, BLOCK_SIZE);
+}
+
+template <typename I>
+WriteLogImageCache<I>::WriteLogImageCache(I &image_ctx)
+  : m_image_ctx(image_ctx), m_image_writeback(image_ctx),
+    m_max_entry_data(MAX_ENTRY_DATA),
+    m_max_writeback(image_ctx.config.template get_val<uint64_t>(
+      "rbd_persistent_cache_max_writeback")),
+    m_thread_pool(image_ctx.cct, "librbd::cache::WriteLogImageCache",
+                  "tp_rbd_wlog", 1),
+    m_work_queue("librbd::cache::WriteLogImageCache::work_queue",
+                 image_ctx.config.template get_val<uint64_t>(
+                   "rbd_op_thread_timeout"),
+                 &m_thread_pool),
+    m_lock(util::unique_lock_name("librbd::cache::WriteLogImageCache::m_lock",
+                                  this)) {
+  m_thread_pool.start();
+  ImageCtx::get_timer_instance(image_ctx.cct, &m_timer, &m_timer_lock);
+}
+
+template <typename I>
+WriteLogImageCache<I>::~WriteLogImageCache() {
+  {
+    Mutex::Locker locker(m_lock);
+    m_shut_down = true;
+    cancel_writeback_retry();
+  }
+  m_work_queue.drain();
+  m_thread_pool.stop();
+
+  if (m_fd >= 0) {
+    VOID_TEMP_FAILURE_RETRY(::close(m_fd));
+  }
+  ceph_assert(m_retire_waiters.empty());
+  ceph_assert(m_writeback_in_flight == 0);
+}
+
+template <typename I>
+std::string WriteLogImageCache<I>::get_log_path() const {
+  // the pool and image ids are only unique within a cluster
+  std::string fsid;
+  librados::Rados rados(m_image_ctx.md_ctx);
+  rados.cluster_fsid(&fsid);
+
+  return m_image_ctx.config.template get_val<std::string>(
+      "rbd_persistent_cache_path") + "/rbd-write-log." + fsid + "." +
+    stringify(m_image_ctx.md_ctx.get_id()) + "." + m_image_ctx.id;
+}
+
+template <typename I>
+void WriteLogImageCache<I>::aio_read(Extents &&image_extents, bufferlist *bl,
+                                     int fadvise_flags, Context *on_finish) {
+  CephContext *cct = m_image_ctx.cct;
+  ldout(cct, 20) << "image_extents=" << image_extents << ", "
+                 << "on_finish=" << on_finish << dendl;
+
+  // read on the thread appending to the log, so that the space holding
+  // the data of a hit cannot be reused under the read
+  m_work_queue.queue(new FunctionContext(
+    [this, image_extents=std::move(image_extents), bl, fadvise_flags,
+     on_finish](int r) {
+      process_read(image_extents, bl, fadvise_flags, on_finish);
+    }));
+}
+
+template <typename I>
+void WriteLogImageCache<I>::aio_write(Extents &&image_extents,
+                                      bufferlist&& bl,
+                                      int fadvise_flags,
+                                      Context *on_finish) {
+  CephContext *cct = m_image_ctx.cct;
+  ldout(cct, 20) << "image_extents=" << image_extents << ", "
+                 << "on_finish=" << on_finish << dendl;
+
+  C_Gather *gather_ctx = new C_Gather(cct, on_finish);
+  {
+    Mutex::Locker locker(m_lock);
+    uint64_t bl_offset = 0;
+    for (auto &extent : image_extents) {
+      for (uint64_t offset = 0; offset < extent.second;) {
+        uint64_t length = std::min(extent.second - offset, m_max_entry_data);
+
+        LogEntry entry;
+        entry.type = ENTRY_TYPE_WRITE;
+        entry.image_offset = extent.first + offset;
+        entry.length = length;
+        entry.data_len = length;
+        entry.bl.substr_of(bl, bl_offset, length);
+        entry.on_persist = gather_ctx->new_sub();
+        queue_entry(std::move(entry));
+
+        offset += length;
+        bl_offset += length;
+      }
+    }
+  }
+  gather_ctx->activate();
+}
+
+template <typename I>
+void WriteLogImageCache<I>::aio_discard(uint64_t offset, uint64_t length,
+                                        bool skip_partial_discard,
+                                        Context *on_finish) {
+  CephContext *cct = m_image_ctx.cct;
+  ldout(cct, 20) << "offset=" << offset << ", "
+                 << "length=" << length << ", "
+                 << "on_finish=" << on_finish << dendl;
+
+  LogEntry entry;
+  entry.type = ENTRY_TYPE_DISCARD;
+  entry.flags = skip_partial_discard ? ENTRY_FLAG_SKIP_PARTIAL_DISCARD : 0;
+  entry.image_offset = offset;
+  entry.length = length;
+  entry.on_persist = on_finish;
+
+  Mutex::Locker locker(m_lock);
+  queue_entry(std::move(entry));
+}
+
+template <typename I>
+void WriteLogImageCache<I>::aio_flush(Context *on_finish) {
+  CephContext *cct = m_image_ctx.cct;
+  ldout(cct, 20) << "on_finish=" << on_finish << dendl;
+
+  // acked once every earlier entry is persisted: they are appended in
+  // order and never written back past the flush entry
+  LogEntry entry;
+  entry.type = ENTRY_TYPE_FLUSH;
+  entry.on_persist = on_finish;
+
+  Mutex::Locker locker(m_lock);
+  queue_entry(std::move(entry));
+}
+
+template <typename I>
+void WriteLogImageCache<I>::aio_writesame(uint64_t offset, uint64_t length,
+                                          bufferlist&& bl, int fadvise_flags,
+                                          Context *on_finish) {
+  CephContext *cct = m_image_ctx.cct;
+  ldout(cct, 20) << "offset=" << offset << ", "
+                 << "length=" << length << ", "
+                 << "data_len=" << bl.length() << ", "
+                 << "on_finish=" << on_finish << dendl;
+
+  if (length <= MAX_WRITESAME_EXPANSION && bl.length() > 0) {
+    // the pattern buffers are shared, not copied
+    bufferlist data_bl;
+    while (data_bl.length() < length) {
+      data_bl.append(bl);
+    }
+    if (data_bl.length() > length) {
+      bufferlist sub_bl;
+      sub_bl.substr_of(data_bl, 0, length);
+      data_bl.swap(sub_bl);
+    }
+    aio_write({{offset, length}}, std::move(data_bl), fadvise_flags,
+              on_finish);
+    return;
+  }
+
+  // too large to go through the log: write back what precedes it first
+  flush(new FunctionContext(
+    [this, offset, length, bl=std::move(bl), fadvise_flags,
+     on_finish](int r) mutable {
+      if (r < 0) {
+        on_finish->complete(r);
+        return;
+      }
+      RWLock::RLocker owner_locker(m_image_ctx.owner_lock);
+      m_image_writeback.aio_writesame(offset, length, std::move(bl),
+                                      fadvise_flags, on_finish);
+    }));
+}
+
+template <typename I>
+void WriteLogImageCache<I>::aio_compare_and_write(Extents &&image_extents,
+                                                  bufferlist&& cmp_bl,
+                                                  bufferlist&& bl,
+                                                  uint64_t *mismatch_offset,
+                                                  int fadvise_flags,
+                                                  Context *on_finish) {
+  CephContext *cct = m_image_ctx.cct;
+  ldout(cct, 20) << "image_extents=" << image_extents << ", "
+                 << "on_finish=" << on_finish << dendl;
+
+  // the comparison has to happen against the data in the cluster
+  flush(new FunctionContext(
+    [this, image_extents=std::move(image_extents), cmp_bl=std::move(cmp_bl),
+     bl=std::move(bl), mismatch_offset, fadvise_flags,
+     on_finish](int r) mutable {
+      if (r < 0) {
+        on_finish->complete(r);
+        return;
+      }
+      RWLock::RLocker owner_locker(m_image_ctx.owner_lock);
+      m_image_writeback.aio_compare_and_write(
+        std::move(image_extents), std::move(cmp_bl), std::move(bl),
+        mismatch_offset, fadvise_flags, on_finish);
+    }));
+}
+
+template <typename I>
+void WriteLogImageCache<I>::init(Context *on_finish) {
+  CephContext *cct = m_image_ctx.cct;
+  ldout(cct, 5) << dendl;
+
+  // the caller may delete us from its callback
+  on_finish = util::create_async_context_callback(m_image_ctx, on_finish);
+  m_work_queue.queue(new FunctionContext([this, on_finish](int r) {
+      r = open_log();
+      if (r < 0) {
+        on_finish->complete(r);
+        return;
+      }
+
+      // whatever a crash left in the log reaches the image before any
+      // new write is accepted
+      wait_for_retire(new FunctionContext([this, on_finish](int r) {
+          if (r < 0) {
+            lderr(m_image_ctx.cct) << "failed to write back the log: "
+                                   << cpp_strerror(r) << dendl;
+            on_finish->complete(r);
+            return;
+          }
+          start_new_generation(on_finish);
+        }));
+    }));
+}
+
+template <typename I>
+void WriteLogImageCache<I>::shut_down(Context *on_finish) {
+  CephContext *cct = m_image_ctx.cct;
+  ldout(cct, 5) << dendl;
+
+  on_finish = util::create_async_context_callback(m_image_ctx, on_finish);
+  flush(new FunctionContext([this, on_finish](int r) {
+      m_work_queue.queue(new FunctionContext([this, on_finish](int r) {
+          if (r == 0) {
+            r = persist_super();
+          }
+
+          // writes still waiting for room in the log will not get it
+          LogEntries entries;
+          {
+            Mutex::Locker locker(m_lock);
+            m_shut_down = true;
+            cancel_writeback_retry();
+            if (m_error == 0) {
+              m_error = -ESHUTDOWN;
+            }
+            entries.swap(m_pending);
+            complete_retire_waiters();
+          }
+          for (auto &entry : entries) {
+            entry.on_persist->complete(-ESHUTDOWN);
+          }
+
+          if (m_fd >= 0) {
+            VOID_TEMP_FAILURE_RETRY(::close(m_fd));
+            m_fd = -1;
+          }
+          on_finish->complete(r);
+        }), r);
+    }));
+}
+
+template <typename I>
+void WriteLogImageCache<I>::invalidate(Context *on_finish) {
+  CephContext *cct = m_image_ctx.cct;
+  ldout(cct, 20) << dendl;
+
+  // nothing is cached but dirty data, which cannot be dropped
+  flush(on_finish);
+}
+
+template <typename I>
+void WriteLogImageCache<I>::flush(Context *on_finish) {
+  CephContext *cct = m_image_ctx.cct;
+  ldout(cct, 20) << "on_finish=" << on_finish << dendl;
+
+  wait_for_retire(new FunctionContext([this, on_finish](int r) {
+      if (r < 0) {
+        on_finish->complete(r);
+        return;
+      }
+      RWLock::RLocker owner_locker(m_image_ctx.owner_lock);
+      m_image_writeback.aio_flush(on_finish);
+    }));
+}
+
+template <typename I>
+int WriteLogImageCache<I>::open_log() {
+  CephContext *cct = m_image_ctx.cct;
+  std::string path = get_log_path();
+  uint64_t log_size = p2align<uint64_t>(
+    m_image_ctx.config.template get_val<Option::size_t>(
+      "rbd_persistent_cache_size"), BLOCK_SIZE);
+  ldout(cct, 5) << "path=" << path << dendl;
+
+  std::string dir = m_image_ctx.config.template get_val<std::string>(
+    "rbd_persistent_cache_path");
+  if (::mkdir(dir.c_str(), 0700) < 0 && errno != EEXIST) {
+    int r = -errno;
+    lderr(cct) << "failed to create " << dir << ": " << cpp_strerror(r)
+               << dendl;
+    return r;
+  }
+
+  m_fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+  if (m_fd < 0) {
+    int r = -errno;
+    lderr(cct) << "failed to open " << path << ": " << cpp_strerror(r)
+               << dendl;
+    return r;
+  }
+
+  SuperBlock super;
+  int r = read_super(&super);
+  if (r == -ENOENT) {
+    ldout(cct, 5) << "creating a new log of " << log_size << " bytes" << dendl;
+    super.pool_id = m_image_ctx.md_ctx.get_id();
+    super.image_id = m_image_ctx.id;
+    super.log_size = log_size;
+    if (::ftruncate(m_fd, LOG_AREA_OFFSET + log_size) < 0) {
+      r = -errno;
+      lderr(cct) << "failed to size " << path << ": " << cpp_strerror(r)
+                 << dendl;
+      return r;
+    }
+    r = write_super(super);
+    if (r < 0) {
+      return r;
+    }
+  } else if (r < 0) {
+    return r;
+  } else if (super.pool_id != m_image_ctx.md_ctx.get_id() ||
+             super.image_id != m_image_ctx.id) {
+    lderr(cct) << path << " belongs to image " << super.pool_id << "/"
+               << super.image_id << dendl;
+    return -EEXIST;
+  } else {
+    Mutex::Locker locker(m_lock);
+    m_super = super;
+  }
+
+  r = scan_log();
+  if (r < 0) {
+    return r;
+  }
+
+  Mutex::Locker locker(m_lock);
+  if (m_log.empty() && m_super.log_size != log_size) {
+    // nothing to replay, so the new size can be applied: the log
+    // restarts at the beginning of the area with the next generation
+    ldout(cct, 5) << "resizing the log to " << log_size << " bytes" << dendl;
+    if (::ftruncate(m_fd, LOG_AREA_OFFSET + log_size) < 0) {
+      r = -errno;
+      lderr(cct) << "failed to size " << path << ": " << cpp_strerror(r)
+                 << dendl;
+      return r;
+    }
+    m_super.log_size = log_size;
+    m_head = m_tail = 0;
+  }
+  m_max_entry_data = std::min(MAX_ENTRY_DATA,
+                              p2align(m_super.log_size / 8, BLOCK_SIZE));
+  if (m_max_entry_data == 0) {
+    lderr(cct) << "log of " << m_super.log_size << " bytes is too small"
+               << dendl;
+    return -EINVAL;
+  }
+
+  if (!m_log.empty()) {
+    ldout(cct, 5) << "writing back " << m_log.size() << " entries from "
+                  << "seq " << m_log.front().seq << dendl;
+    schedule_writeback();
+  }
+  return 0;
+}
+
+template <typename I>
+int WriteLogImageCache<I>::read_super(SuperBlock *super) {
+  CephContext *cct = m_image_ctx.cct;
+
+  bool found = false;
+  for (uint64_t i = 0; i < 2; ++i) {
+    bufferptr bp(buffer::create(SUPERBLOCK_SIZE));
+    int r = safe_pread(m_fd, bp.c_str(), SUPERBLOCK_SIZE, i * SUPERBLOCK_SIZE);
+    if (r < 0) {
+      lderr(cct) << "failed to read superblock: " << cpp_strerror(r) << dendl;
+      return r;
+    } else if (r < static_cast<int>(SUPERBLOCK_SIZE)) {
+      continue;
+    }
+
+    // a copy is its crc and length followed by the encoded superblock
+    bufferlist bl;
+    bl.push_back(std::move(bp));
+    SuperBlock copy;
+    try {
+      auto it = bl.cbegin();
+      uint32_t crc;
+      uint32_t length;
+      decode(crc, it);
+      decode(length, it);
+      if (length == 0 || length > it.get_remaining()) {
+        continue;
+      }
+      bufferlist payload;
+      it.copy(length, payload);
+      if (payload.crc32c(-1) != crc) {
+        ldout(cct, 5) << "superblock copy " << i << " is corrupt" << dendl;
+        continue;
+      }
+      auto payload_it = payload.cbegin();
+      decode(copy, payload_it);
+    } catch (const buffer::error &err) {
+      ldout(cct, 5) << "failed to decode superblock copy " << i << dendl;
+      continue;
+    }
+
+    if (!found || copy.sb_seq > super->sb_seq) {
+      *super = copy;
+      found = true;
+    }
+  }
+
+  // entries are only ever appended after a superblock was persisted
+  return found ? 0 : -ENOENT;
+}
+
+template <typename I>
+int WriteLogImageCache<I>::write_super(SuperBlock super) {
+  CephContext *cct = m_image_ctx.cct;
+  {
+    Mutex::Locker locker(m_lock);
+    if (m_error < 0) {
+      return m_error;
+    }
+    super.sb_seq = m_super.sb_seq + 1;
+  }
+  ldout(cct, 20) << "sb_seq=" << super.sb_seq << ", "
+                 << "first_seq=" << super.first_seq << ", "
+                 << "first_offset=" << super.first_offset << dendl;
+
+  // alternate between the two copies so that a torn write leaves the
+  // previous superblock intact
+  bufferlist payload;
+  encode(super, payload);
+  ceph_assert(payload.length() + 8 <= SUPERBLOCK_SIZE);
+
+  bufferlist bl;
+  encode(payload.crc32c(-1), bl);
+  encode(static_cast<uint32_t>(payload.length()), bl);
+  bl.claim_append(payload);
+  bl.append_zero(SUPERBLOCK_SIZE - bl.length());
+
+  int r = bl.write_fd(m_fd, (super.sb_seq % 2) * SUPERBLOCK_SIZE);
+  if (r == 0 && ::fdatasync(m_fd) < 0) {
+    r = -errno;
+  }
+
+  Mutex::Locker locker(m_lock);
+  if (r < 0) {
+    lderr(cct) << "failed to write superblock: " << cpp_strerror(r) << dendl;
+    m_error = r;
+    return r;
+  }
+  m_super = super;
+  return 0;
+}
+
+template <typename I>
+int WriteLogImageCache<I>::scan_log() {
+  CephContext *cct = m_image_ctx.cct;
+
+  uint64_t log_size = m_super.log_size;
+  uint64_t generation = m_super.generation;
+  uint64_t seq = m_super.first_seq;
+  uint64_t offset = m_super.first_offset;
+  uint64_t scanned = 0;
+  while (scanned < log_size) {
+    if (offset == log_size) {
+      offset = 0;
+    }
+
+    EntryHeader header;
+    int r = safe_pread_exact(m_fd, &header, sizeof(header),
+                             LOG_AREA_OFFSET + offset);
+    if (r < 0) {
+      lderr(cct) << "failed to read log at " << offset << ": "
+                 << cpp_strerror(r) << dendl;
+      return r;
+    }
+    if (header.magic != ENTRY_MAGIC || header.generation != generation ||
+        header.seq != seq) {
+      break;
+    }
+
+    uint64_t data_len = header.data_len;
+    uint64_t bytes = round_up_to(sizeof(header) + data_len, BLOCK_SIZE);
+    if (offset + bytes > log_size) {
+      break;
+    }
+
+    bufferlist data_bl;
+    if (data_len > 0) {
+      r = read_log(offset + sizeof(header), data_len, &data_bl);
+      if (r < 0) {
+        lderr(cct) << "failed to read log at " << offset << ": "
+                   << cpp_strerror(r) << dendl;
+        return r;
+      }
+    }
+    if (!verify_entry_crc(header, data_bl)) {
+      ldout(cct, 5) << "entry seq " << seq << " at " << offset << " is torn"
+                    << dendl;
+      break;
+    }
+
+    if (header.type == ENTRY_TYPE_PAD) {
+      // the entry with this seq follows at the start of the ring
+      scanned += log_size - offset;
+      offset = 0;
+      continue;
+    }
+
+    LogEntry entry;
+    entry.seq = seq;
+    entry.type = header.type;
+    entry.flags = header.flags;
+    entry.image_offset = header.image_offset;
+    entry.length = header.length;
+    entry.data_len = data_len;
+    entry.log_offset = offset;
+    entry.state = LogEntry::STATE_DIRTY;
+    if ((entry.type != ENTRY_TYPE_WRITE && entry.type != ENTRY_TYPE_DISCARD &&
+         entry.type != ENTRY_TYPE_FLUSH) ||
+        (entry.type == ENTRY_TYPE_WRITE && entry.length != data_len)) {
+      lderr(cct) << "invalid entry seq " << seq << " at " << offset << dendl;
+      break;
+    }
+
+    Mutex::Locker locker(m_lock);
+    index_insert(entry);
+    m_log.push_back(std::move(entry));
+    offset += bytes;
+    scanned += bytes;
+    ++seq;
+  }
+
+  ldout(cct, 5) << "found " << m_log.size() << " entries up to seq "
+                << seq << dendl;
+
+  Mutex::Locker locker(m_lock);
+  m_next_seq = seq;
+  m_head = offset == log_size ? 0 : offset;
+  if (m_log.empty()) {
+    m_tail = m_head;
+    m_log_used = 0;
+  } else {
+    m_tail = m_super.first_offset;
+    m_log_used = scanned;
+  }
+  return 0;
+}
+
+template <typename I>
+void WriteLogImageCache<I>::start_new_generation(Context *on_finish) {
+  // entries left over from the previous generation no longer pass the
+  // scan, even where they were not overwritten
+  m_work_queue.queue(new FunctionContext([this, on_finish](int r) {
+      SuperBlock super;
+      {
+        Mutex::Locker locker(m_lock);
+        ceph_assert(m_log.empty() && m_pending.empty());
+        super = m_super;
+        ++super.generation;
+        super.first_seq = m_next_seq;
+        super.first_offset = m_head;
+      }
+
+      r = write_super(super);
+      if (r == 0) {
+        Mutex::Locker locker(m_lock);
+        m_tail = m_head;
+        m_log_used = 0;
+        m_super_dirty = false;
+      }
+      on_finish->complete(r);
+    }));
+}
+
+template <typename I>
+void WriteLogImageCache<I>::queue_entry(LogEntry &&entry) {
+  ceph_assert(m_lock.is_locked());
+
+  entry.seq = m_next_seq++;
+  m_pending.push_back(std::move(entry));
+  schedule_append();
+}
+
+template <typename I>
+void WriteLogImageCache<I>::schedule_append() {
+  ceph_assert(m_lock.is_locked());
+  if (m_append_scheduled) {
+    return;
+  }
+
+  m_append_scheduled = true;
+  m_work_queue.queue(new FunctionContext([this](int r) {
+      process_appends();
+    }));
+}
+
+template <typename I>
+void WriteLogImageCache<I>::process_appends() {
+  CephContext *cct = m_image_ctx.cct;
+
+  // space retired since the last append is reusable once the superblock
+  // no longer points into it
+  persist_super();
+
+  LogEntries entries;
+  LogEntries failed;
+  int failed_r = 0;
+  std::vector<std::pair<uint64_t, bufferlist> > writes;
+  {
+    Mutex::Locker locker(m_lock);
+    m_append_scheduled = false;
+    if (m_error < 0) {
+      entries.swap(m_pending);
+    }
+
+    uint64_t log_size = m_super.log_size;
+    while (!m_pending.empty()) {
+      auto &entry = m_pending.front();
+      uint64_t bytes = entry.get_log_bytes();
+      uint64_t pad = m_head + bytes > log_size ? log_size - m_head : 0;
+      if (m_log_used + pad + bytes > log_size) {
+        if (m_writeback_error < 0) {
+          // nothing is retired while writeback fails: fail the queued
+          // entries rather than hold them.  none of them reached the log,
+          // so their seqs are given out again.
+          ldout(cct, 5) << "log full, failing " << m_pending.size()
+                        << " entries" << dendl;
+          failed_r = m_writeback_error;
+          m_next_seq = m_pending.front().seq;
+          failed.swap(m_pending);
+          complete_retire_waiters();
+          break;
+        }
+        // wait for writeback to retire older entries
+        ldout(cct, 20) << "log full" << dendl;
+        break;
+      }
+
+      if (pad > 0) {
+        LogEntry pad_entry;
+        pad_entry.seq = entry.seq;
+        pad_entry.type = ENTRY_TYPE_PAD;
+        bufferlist bl;
+        encode_entry_header(m_super.generation, pad_entry, bufferlist(), &bl);
+        writes.emplace_back(m_head, std::move(bl));
+        m_log_used += pad;
+        m_head = 0;
+      }
+
+      entry.log_offset = m_head;
+      if (writes.empty() ||
+          writes.back().first + writes.back().second.length() != m_head) {
+        writes.emplace_back(m_head, bufferlist());
+      }
+      auto &bl = writes.back().second;
+      encode_entry_header(m_super.generation, entry, entry.bl, &bl);
+      bl.append(entry.bl);
+      bl.append_zero(bytes - sizeof(EntryHeader) - entry.data_len);
+
+      m_head += bytes;
+      if (m_head == log_size) {
+        m_head = 0;
+      }
+      m_log_used += bytes;
+      entries.splice(entries.end(), m_pending, m_pending.begin());
+    }
+  }
+
+  for (auto &entry : failed) {
+    entry.on_persist->complete(failed_r);
+  }
+  if (entries.empty()) {
+    return;
+  }
+
+  int r;
+  {
+    Mutex::Locker locker(m_lock);
+    r = m_error;
+  }
+  for (auto it = writes.begin(); r == 0 && it != writes.end(); ++it) {
+    r = it->second.write_fd(m_fd, LOG_AREA_OFFSET + it->first);
+  }
+  if (r == 0 && !writes.empty() && ::fdatasync(m_fd) < 0) {
+    r = -errno;
+  }
+
+  if (r < 0) {
+    Mutex::Locker locker(m_lock);
+    if (m_error == 0) {
+      lderr(cct) << "failed to append to the log: " << cpp_strerror(r)
+                 << dendl;
+      m_error = r;
+    }
+    // later appends fail as well, not to leave a hole in the log
+    entries.splice(entries.end(), m_pending);
+  }
+  append_entries(std::move(entries));
+}
+
+template <typename I>
+int WriteLogImageCache<I>::persist_super() {
+  SuperBlock super;
+  uint64_t tail;
+  {
+    Mutex::Locker locker(m_lock);
+    if (!m_super_dirty) {
+      return m_error;
+    }
+    m_super_dirty = false;
+
+    tail = m_log.empty() ? m_head : m_log.front().log_offset;
+    super = m_super;
+    super.first_seq = get_first_dirty_seq();
+    super.first_offset = tail;
+  }
+
+  int r = write_super(super);
+  if (r < 0) {
+    return r;
+  }
+
+  Mutex::Locker locker(m_lock);
+  m_tail = tail;
+  if (m_log.empty()) {
+    m_tail = m_head;
+    m_log_used = 0;
+  } else {
+    m_log_used = (m_head + m_super.log_size - m_tail) % m_super.log_size;
+    if (m_log_used == 0) {
+      m_log_used = m_super.log_size;
+    }
+  }
+  return 0;
+}
+
+template <typename I>
+void WriteLogImageCache<I>::append_entries(LogEntries &&entries) {
+  CephContext *cct = m_image_ctx.cct;
+  ldout(cct, 20) << "seq " << entries.front().seq << "~" << entries.size()
+                 << dendl;
+
+  std::vector<std::pair<Context*, int> > completions;
+  {
+    Mutex::Locker locker(m_lock);
+    int r = m_error;
+    for (auto &entry : entries) {
+      completions.emplace_back(entry.on_persist, r);
+      entry.on_persist = nullptr;
+      entry.bl.clear();
+      entry.state = LogEntry::STATE_DIRTY;
+      if (r == 0) {
+        index_insert(entry);
+      }
+    }
+    if (r == 0) {
+      m_log.splice(m_log.end(), entries);
+      if (!m_pending.empty() && m_super_dirty) {
+        schedule_append();
+      }
+      schedule_writeback();
+    } else {
+      complete_retire_waiters();
+    }
+  }
+
+  for (auto &completion : completions) {
+    completion.first->complete(completion.second);
+  }
+}
+
+template <typename I>
+void WriteLogImageCache<I>::schedule_writeback() {
+  ceph_assert(m_lock.is_locked());
+  if (m_shut_down || m_writeback_scheduled || m_writeback_error < 0 ||
+      m_writeback_in_flight >= m_max_writeback) {
+    return;
+  }
+
+  m_writeback_scheduled = true;
+  m_work_queue.queue(new FunctionContext([this](int r) {
+      process_writeback();
+    }));
+}
+
+template <typename I>
+void WriteLogImageCache<I>::process_writeback() {
+  CephContext *cct = m_image_ctx.cct;
+
+  std::vector<LogEntry*> entries;
+  {
+    Mutex::Locker locker(m_lock);
+    m_writeback_scheduled = false;
+    if (m_writeback_error < 0) {
+      return;
+    }
+
+    // dispatch the oldest dirty entries as long as they do not overlap
+    // one in flight, and nothing past a flush until it completed
+    std::vector<const LogEntry*> in_flight;
+    for (auto &entry : m_log) {
+      if (m_writeback_in_flight >= m_max_writeback) {
+        break;
+      } else if (entry.state == LogEntry::STATE_CLEAN) {
+        continue;
+      } else if (entry.state == LogEntry::STATE_WRITING_BACK) {
+        if (entry.type == ENTRY_TYPE_FLUSH) {
+          break;
+        }
+        in_flight.push_back(&entry);
+        continue;
+      }
+
+      if (entry.type == ENTRY_TYPE_FLUSH) {
+        if (in_flight.empty()) {
+          entry.state = LogEntry::STATE_WRITING_BACK;
+          ++m_writeback_in_flight;
+          entries.push_back(&entry);
+        }
+        break;
+      }
+
+      uint64_t end = entry.image_offset + entry.length;
+      bool overlaps = std::any_of(
+        in_flight.begin(), in_flight.end(),
+        [&entry, end](const LogEntry *other) {
+          return other->image_offset < end &&
+                 entry.image_offset < other->image_offset + other->length;
+        });
+      if (overlaps) {
+        break;
+      }
+
+      entry.state = LogEntry::STATE_WRITING_BACK;
+      ++m_writeback_in_flight;
+      entries.push_back(&entry);
+      in_flight.push_back(&entry);
+    }
+  }
+
+  RWLock::RLocker owner_locker(m_image_ctx.owner_lock);
+  for (auto entry : entries) {
+    ldout(cct, 20) << "seq=" << entry->seq << ", "
+                   << "type=" << static_cast<int>(entry->type) << ", "
+                   << "image_offset=" << entry->image_offset << ", "
+                   << "length=" << entry->length << dendl;
+
+    Context *ctx = new FunctionContext([this, entry](int r) {
+        handle_writeback(entry, r);
+      });
+    switch (entry->type) {
+    case ENTRY_TYPE_WRITE:
+      {
+        // the data is not retired before the write completes, so its
+        // space cannot be reused under this read
+        bufferlist bl;
+        int r = read_log(entry->log_offset + sizeof(EntryHeader),
+                         entry->data_len, &bl);
+        if (r < 0) {
+          ctx->complete(r);
+          break;
+        }
+        m_image_writeback.aio_write({{entry->image_offset, entry->length}},
+                                    std::move(bl), 0, ctx);
+      }
+      break;
+    case ENTRY_TYPE_DISCARD:
+      m_image_writeback.aio_discard(
+        entry->image_offset, entry->length,
+        (entry->flags & ENTRY_FLAG_SKIP_PARTIAL_DISCARD) != 0, ctx);
+      break;
+    case ENTRY_TYPE_FLUSH:
+      m_image_writeback.aio_flush(ctx);
+      break;
+    default:
+      ceph_abort();
+    }
+  }
+}
+
+template <typename I>
+void WriteLogImageCache<I>::handle_writeback(LogEntry *entry, int r) {
+  CephContext *cct = m_image_ctx.cct;
+  ldout(cct, 20) << "seq=" << entry->seq << ", r=" << r << dendl;
+
+  Mutex::Locker locker(m_lock);
+  ceph_assert(m_writeback_in_flight > 0);
+  --m_writeback_in_flight;
+
+  if (r < 0) {
+    // the entry stays in the log, to be written back by a retry or when
+    // the log is opened again
+    lderr(cct) << "failed to write back seq " << entry->seq << ": "
+               << cpp_strerror(r) << dendl;
+    entry->state = LogEntry::STATE_DIRTY;
+    if (r == -EBLACKLISTED && m_error == 0) {
+      // this client can no longer write to the image
+      m_error = r;
+    }
+    if (m_writeback_error == 0) {
+      m_writeback_error = r;
+      schedule_writeback_retry();
+    }
+    complete_retire_waiters();
+    if (!m_pending.empty()) {
+      // writes waiting for room in the log fail now
+      schedule_append();
+    }
+    return;
+  }
+
+  entry->state = LogEntry::STATE_CLEAN;
+  m_writeback_retry_delay = 0;
+  retire_entries();
+  complete_retire_waiters();
+
+  if (!m_pending.empty() && m_super_dirty) {
+    schedule_append();
+  }
+  schedule_writeback();
+}
+
+template <typename I>
+void WriteLogImageCache<I>::schedule_writeback_retry() {
+  CephContext *cct = m_image_ctx.cct;
+  ceph_assert(m_lock.is_locked());
+  if (m_shut_down || m_error < 0) {
+    return;
+  }
+
+  m_writeback_retry_delay = std::min(
+    std::max(2 * m_writeback_retry_delay, WRITEBACK_RETRY_MIN_DELAY),
+    WRITEBACK_RETRY_MAX_DELAY);
+  ldout(cct, 5) << "retrying writeback in " << m_writeback_retry_delay << "s"
+                << dendl;
+
+  Mutex::Locker timer_locker(*m_timer_lock);
+  ceph_assert(m_writeback_retry_ctx == nullptr);
+  m_writeback_retry_ctx = new FunctionContext([this](int r) {
+      // the timer lock is held: take m_lock on the work queue instead
+      m_writeback_retry_ctx = nullptr;
+      m_work_queue.queue(new FunctionContext([this](int r) {
+          retry_writeback();
+        }));
+    });
+  m_timer->add_event_after(m_writeback_retry_delay, m_writeback_retry_ctx);
+}
+
+template <typename I>
+void WriteLogImageCache<I>::cancel_writeback_retry() {
+  ceph_assert(m_lock.is_locked());
+
+  Mutex::Locker timer_locker(*m_timer_lock);
+  if (m_writeback_retry_ctx != nullptr) {
+    m_timer->cancel_event(m_writeback_retry_ctx);
+    m_writeback_retry_ctx = nullptr;
+  }
+}
+
+template <typename I>
+void WriteLogImageCache<I>::retry_writeback() {
+  Mutex::Locker locker(m_lock);
+  if (m_writeback_error == 0) {
+    // a flush retried already
+    return;
+  }
+  m_writeback_error = 0;
+  schedule_writeback();
+}
+
+template <typename I>
+void WriteLogImageCache<I>::retire_entries() {
+  ceph_assert(m_lock.is_locked());
+
+  // the log is retired in order, so that the superblock can point to
+  // the oldest entry still needed
+  while (!m_log.empty() &&
+         m_log.front().state == LogEntry::STATE_CLEAN) {
+    index_remove(m_log.front());
+    m_log.pop_front();
+    m_super_dirty = true;
+  }
+}
+
+template <typename I>
+void WriteLogImageCache<I>::complete_retire_waiters() {
+  ceph_assert(m_lock.is_locked());
+
+  int r = m_error < 0 ? m_error : m_writeback_error;
+  uint64_t first_dirty_seq = get_first_dirty_seq();
+  for (auto it = m_retire_waiters.begin(); it != m_retire_waiters.end();) {
+    if (r == 0 && it->first >= first_dirty_seq) {
+      ++it;
+      continue;
+    }
+
+    // completed from the work queue, not under the locks held here
+    m_work_queue.queue(it->second, r);
+    it = m_retire_waiters.erase(it);
+  }
+}
+
+template <typename I>
+uint64_t WriteLogImageCache<I>::get_first_dirty_seq() const {
+  ceph_assert(m_lock.is_locked());
+  if (!m_log.empty()) {
+    return m_log.front().seq;
+  } else if (!m_pending.empty()) {
+    return m_pending.front().seq;
+  }
+  return m_next_seq;
+}
+
+template <typename I>
+void WriteLogImageCache<I>::wait_for_retire(Context *on_finish) {
+  int r = 0;
+  {
+    Mutex::Locker locker(m_lock);
+    if (m_error < 0) {
+      r = m_error;
+    } else if (get_first_dirty_seq() < m_next_seq) {
+      if (m_writeback_error < 0) {
+        // try again now rather than fail with the error of an earlier
+        // attempt, so that a flush succeeds once the cluster is back
+        cancel_writeback_retry();
+        m_writeback_error = 0;
+      }
+      m_retire_waiters.emplace_back(m_next_seq - 1, on_finish);
+      schedule_writeback();
+      return;
+    }
+  }
+  on_finish->complete(r);
+}
+
+template <typename I>
+void WriteLogImageCache<I>::index_punch(uint64_t offset, uint64_t length) {
+  ceph_assert(m_lock.is_locked());
+
+  uint64_t end = offset + length;
+  auto it = m_index.lower_bound(offset);
+  if (it != m_index.begin()) {
+    auto prev = std::prev(it);
+    uint64_t prev_end = prev->first + prev->second.length;
+    if (prev_end > offset) {
+      if (prev_end > end) {
+        // keep what follows the punched range
+        Extent tail = prev->second;
+        tail.length = prev_end - end;
+        if (!tail.zero) {
+          tail.log_offset += end - prev->first;
+        }
+        m_index.emplace_hint(it, end, tail);
+      }
+      prev->second.length = offset - prev->first;
+    }
+  }
+
+  while (it != m_index.end() && it->first < end) {
+    uint64_t it_end = it->first + it->second.length;
+    if (it_end > end) {
+      Extent tail = it->second;
+      tail.length = it_end - end;
+      if (!tail.zero) {
+        tail.log_offset += end - it->first;
+      }
+      it = m_index.erase(it);
+      m_index.emplace_hint(it, end, tail);
+      break;
+    }
+    it = m_index.erase(it);
+  }
+}
+
+template <typename I>
+void WriteLogImageCache<I>::index_insert(const LogEntry &entry) {
+  ceph_assert(m_lock.is_locked());
+  if ((entry.type != ENTRY_TYPE_WRITE && entry.type != ENTRY_TYPE_DISCARD) ||
+      entry.length == 0) {
+    return;
+  }
+
+  index_punch(entry.image_offset, entry.length);
+  m_index[entry.image_offset] = {
+    entry.length, entry.seq, entry.log_offset + sizeof(EntryHeader),
+    entry.type == ENTRY_TYPE_DISCARD};
+}
+
+template <typename I>
+void WriteLogImageCache<I>::index_remove(const LogEntry &entry) {
+  ceph_assert(m_lock.is_locked());
+
+  // only what newer entries did not overwrite is left from this one
+  uint64_t end = entry.image_offset + entry.length;
+  for (auto it = m_index.lower_bound(entry.image_offset);
+       it != m_index.end() && it->first < end;) {
+    if (it->second.seq == entry.seq) {
+      it = m_index.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+template <typename I>
+void WriteLogImageCache<I>::process_read(const Extents &image_extents,
+                                         bufferlist *bl, int fadvise_flags,
+                                         Context *on_finish) {
+  CephContext *cct = m_image_ctx.cct;
+
+  auto ctx = new C_ReadRequest(bl, on_finish);
+  auto &pieces = ctx->pieces;
+  Extents miss_extents;
+  int r;
+  {
+    Mutex::Locker locker(m_lock);
+    r = m_error;
+    for (auto &extent : image_extents) {
+      if (r < 0) {
+        break;
+      }
+
+      uint64_t offset = extent.first;
+      uint64_t end = extent.first + extent.second;
+      auto it = m_index.upper_bound(offset);
+      if (it != m_index.begin()) {
+        auto prev = std::prev(it);
+        if (prev->first + prev->second.length > offset) {
+          it = prev;
+        }
+      }
+
+      while (offset < end) {
+        uint64_t next = (it == m_index.end() ? end :
+                         std::min(end, it->first));
+        if (next > offset) {
+          pieces.push_back({next - offset, 0, ReadExtent::MISS});
+          miss_extents.emplace_back(offset, next - offset);
+          offset = next;
+          continue;
+        }
+
+        uint64_t skip = offset - it->first;
+        uint64_t length = std::min(it->second.length - skip, end - offset);
+        if (it->second.zero) {
+          pieces.push_back({length, 0, ReadExtent::ZERO});
+        } else {
+          pieces.push_back({length, it->second.log_offset + skip,
+                            ReadExtent::HIT});
+        }
+        offset += length;
+        ++it;
+      }
+    }
+  }
+  ldout(cct, 20) << "pieces=" << pieces.size() << ", "
+                 << "miss_extents=" << miss_extents << dendl;
+
+  if (r < 0) {
+    ctx->complete(r);
+    return;
+  }
+
+  for (auto &piece : pieces) {
+    if (piece.kind == ReadExtent::HIT) {
+      ctx->hits.emplace_back();
+      r = read_log(piece.log_offset, piece.length, &ctx->hits.back());
+      if (r < 0) {
+        lderr(cct) << "failed to read log: " << cpp_strerror(r) << dendl;
+        ctx->complete(r);
+        return;
+      }
+    }
+  }
+
+  if (miss_extents.empty()) {
+    ctx->complete(0);
+    return;
+  }
+
+  RWLock::RLocker owner_locker(m_image_ctx.owner_lock);
+  m_image_writeback.aio_read(std::move(miss_extents), &ctx->miss_bl,
+                             fadvise_flags, ctx);
+}
+
+template <typename I>
+int WriteLogImageCache<I>::read_log(uint64_t log_offset, uint64_t length,
+                                    bufferlist *bl) {
+  bufferptr bp(buffer::create(length));
+  int r = safe_pread_exact(m_fd, bp.c_str(), length,
+                           LOG_AREA_OFFSET + log_offset);
+  if (r < 0) {
+    return r;
+  }
+  bl->push_back(std::move(bp));
+  return 0;
+}
+
+} // namespace cache
+} // namespace librbd
+
+template class librbd::cache::WriteLogImageCache<librbd::ImageCtx>;
@@ -0,0 +1,257 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#ifndef CEPH_LIBRBD_CACHE_WRITE_LOG_IMAGE_CACHE
+#define CEPH_LIBRBD_CACHE_WRITE_LOG_IMAGE_CACHE
+
+#include "ImageCache.h"
+#include "ImageWriteback.h"
+#include "common/Mutex.h"
+#include "common/WorkQueue.h"
+#include "include/buffer.h"
+#include "include/denc.h"
+#include <list>
+#include <map>
+#include <string>
+
+class Context;
+class SafeTimer;
+
+namespace librbd {
+
+struct ImageCtx;
+
+namespace cache {
+namespace write_log {
+
+/*
+ * On-disk layout of the cache file:
+ *
+ *   [ superblock copy 0 | superblock copy 1 | log area ... ]
+ *
+ * The log area is a ring of entries, each made of a fixed header followed
+ * by its data and padded to BLOCK_SIZE.  An entry that would run past the
+ * end of the ring is preceded by a PAD header and written at its start.
+ * The superblock points to the oldest entry not yet written back; a scan
+ * from there stops at the first entry whose header or data does not check
+ * out, so a torn append only loses the entries that were never acked.
+ */
+static const uint64_t BLOCK_SIZE = 512;
+static const uint64_t SUPERBLOCK_SIZE = 4096;
+static const uint64_t LOG_AREA_OFFSET = 2 * SUPERBLOCK_SIZE;
+static const uint32_t ENTRY_MAGIC = 0x72626477;  // "rbdw"
+
+enum EntryType {
+  ENTRY_TYPE_WRITE   = 1,
+  ENTRY_TYPE_DISCARD = 2,
+  ENTRY_TYPE_FLUSH   = 3,  ///< barrier: writeback flushes the image here
+  ENTRY_TYPE_PAD     = 4,  ///< the next entry is at the start of the ring
+};
+
+enum EntryFlag {
+  ENTRY_FLAG_SKIP_PARTIAL_DISCARD = 1 << 0,
+};
+
+struct SuperBlock {
+  uint64_t sb_seq = 0;        ///< the newest valid copy wins
+  int64_t pool_id = -1;
+  std::string image_id;
+  uint64_t log_size = 0;      ///< bytes in the log area
+  uint64_t generation = 0;    ///< bumped on every open of the log
+  uint64_t first_seq = 1;     ///< oldest entry not written back
+  uint64_t first_offset = 0;  ///< of that entry in the log area
+
+  DENC(SuperBlock, v, p) {
+    DENC_START(1, 1, p);
+    denc(v.sb_seq, p);
+    denc(v.pool_id, p);
+    denc(v.image_id, p);
+    denc(v.log_size, p);
+    denc(v.generation, p);
+    denc(v.first_seq, p);
+    denc(v.first_offset, p);
+    DENC_FINISH(p);
+  }
+};
+
+struct EntryHeader {
+  ceph_le32 magic;
+  ceph_le32 crc;           ///< of the header with a zero crc, then the data
+  ceph_le64 generation;
+  ceph_le64 seq;
+  ceph_le64 image_offset;
+  ceph_le64 length;        ///< bytes of the image covered
+  ceph_le32 data_len;
+  __u8 type;
+  __u8 flags;
+  __u8 reserved[18];
+} __attribute__ ((packed));
+static_assert(sizeof(EntryHeader) == 64, "unexpected EntryHeader size");
+
+struct LogEntry {
+  enum State {
+    STATE_PENDING,       ///< waiting to be appended to the log
+    STATE_DIRTY,         ///< persisted, not written back
+    STATE_WRITING_BACK,
+    STATE_CLEAN,         ///< written back, waiting for older entries
+  };
+
+  uint64_t seq = 0;
+  uint8_t type = ENTRY_TYPE_WRITE;
+  uint8_t flags = 0;
+  uint64_t image_offset = 0;
+  uint64_t length = 0;
+  uint32_t data_len = 0;
+  uint64_t log_offset = 0;  ///< of the header in the log area
+  ceph::bufferlist bl;      ///< the data, until persisted
+  Context *on_persist = nullptr;
+  State state = STATE_PENDING;
+
+  uint64_t get_log_bytes() const;
+};
+
+/// a piece of a read
+struct ReadExtent {
+  enum Kind { HIT, ZERO, MISS };
+
+  uint64_t length;
+  uint64_t log_offset;  ///< of the data of a hit
+  Kind kind;
+};
+
+} // namespace write_log
+
+/**
+ * Persistent, log-structured write-back cache backed by a local file,
+ * typically on an SSD.  Writes, discards and flushes are appended to the
+ * log and acked once they are stable there, several appends sharing one
+ * fdatasync().  Entries are then written back to the image in log order,
+ * never reordering overlapping writes nor writes across a flush, and are
+ * retired once they reach the cluster.  Reads are served from the log
+ * where it holds newer data than the image.  A failed writeback is retried
+ * after a growing delay, or at once by a flush; while it keeps failing,
+ * writes that no longer fit in the log fail with its error.
+ *
+ * The cache lives while the exclusive lock is held.  A log left dirty by
+ * a crash is written back before the cache is opened again.
+ */
+template <typename ImageCtxT = librbd::ImageCtx>
+class WriteLogImageCache : public ImageCache {
+public:
+  static WriteLogImageCache* create(ImageCtxT &image_ctx) {
+    return new WriteLogImageCache(image_ctx);
+  }
+
+  explicit WriteLogImageCache(ImageCtxT &image_ctx);
+  ~WriteLogImageCache() override;
+
+  /// client AIO methods
+  void aio_read(Extents&& image_extents, ceph::bufferlist *bl,
+                int fadvise_flags, Context *on_finish) override;
+  void aio_write(Extents&& image_extents, ceph::bufferlist&& bl,
+                 int fadvise_flags, Context *on_finish) override;
+  void aio_discard(uint64_t offset, uint64_t length,
+                   bool skip_partial_discard, Context *on_finish) override;
+  void aio_flush(Context *on_finish) override;
+  void aio_writesame(uint64_t offset, uint64_t length,
+                     ceph::bufferlist&& bl,
+                     int fadvise_flags, Context *on_finish) override;
+  void aio_compare_and_write(Extents&& image_extents,
+                             ceph::bufferlist&& cmp_bl, ceph::bufferlist&& bl,
+                             uint64_t *mismatch_offset,int fadvise_flags,
+                             Context *on_finish) override;
+
+  /// internal state methods
+  void init(Context *on_finish) override;
+  void shut_down(Context *on_finish) override;
+
+  void invalidate(Context *on_finish) override;
+  void flush(Context *on_finish) override;
+
+  std::string get_log_path() const;
+
+private:
+  typedef write_log::LogEntry LogEntry;
+  typedef write_log::ReadExtent ReadExtent;
+  typedef std::list<LogEntry> LogEntries;
+
+  /// an image extent whose latest data is in the log
+  struct Extent {
+    uint64_t length;
+    uint64_t seq;         ///< of the entry holding it
+    uint64_t log_offset;  ///< of its data in the log area
+    bool zero;            ///< discarded
+  };
+  typedef std::map<uint64_t, Extent> ExtentIndex;
+
+  ImageCtxT &m_image_ctx;
+  ImageWriteback<ImageCtxT> m_image_writeback;
+  uint64_t m_max_entry_data;
+  uint64_t m_max_writeback;
+
+  ThreadPool m_thread_pool;
+  ContextWQ m_work_queue;
+  SafeTimer *m_timer = nullptr;
+  Mutex *m_timer_lock = nullptr;
+
+  mutable Mutex m_lock;
+  int m_fd = -1;
+  int m_error = 0;                ///< the log is unusable
+  write_log::SuperBlock m_super;  ///< as last persisted
+  uint64_t m_next_seq = 1;
+  uint64_t m_head = 0;            ///< next append offset in the log area
+  uint64_t m_tail = 0;            ///< oldest persisted entry offset
+  uint64_t m_log_used = 0;
+  LogEntries m_pending;           ///< waiting to be appended, in seq order
+  LogEntries m_log;               ///< persisted, in seq order until retired
+  ExtentIndex m_index;
+  uint64_t m_writeback_in_flight = 0;
+  int m_writeback_error = 0;      ///< of the last attempt, until retried
+  double m_writeback_retry_delay = 0;
+  Context *m_writeback_retry_ctx = nullptr;  ///< under m_timer_lock
+  bool m_shut_down = false;
+  bool m_super_dirty = false;     ///< retired since the last superblock
+  bool m_append_scheduled = false;
+  bool m_writeback_scheduled = false;
+  std::list<std::pair<uint64_t, Context*>> m_retire_waiters;
+
+  int open_log();
+  int read_super(write_log::SuperBlock *super);
+  int write_super(write_log::SuperBlock super);
+  int scan_log();
+  void start_new_generation(Context *on_finish);
+
+  void queue_entry(LogEntry &&entry);
+  void schedule_append();
+  void process_appends();
+  int persist_super();
+  void append_entries(LogEntries &&entries);
+
+  void schedule_writeback();
+  void process_writeback();
+  void handle_writeback(LogEntry *entry, int r);
+  void schedule_writeback_retry();
+  void cancel_writeback_retry();
+  void retry_writeback();
+  void retire_entries();
+  void complete_retire_waiters();
+  uint64_t get_first_dirty_seq() const;
+  void wait_for_retire(Context *on_finish);
+
+  void index_punch(uint64_t offset, uint64_t length);
+  void index_insert(const LogEntry &entry);
+  void index_remove(const LogEntry &entry);
+
+  void process_read(const Extents &image_extents, ceph::bufferlist *bl,
+                    int fadvise_flags, Context *on_finish);
+  int read_log(uint64_t log_offset, uint64_t length, ceph::bufferlist *bl);
+};
+
+} // namespace cache
+} // namespace librbd
+
+WRITE_CLASS_DENC(librbd::cache::write_log::SuperBlock)
+
+extern template class librbd::cache::WriteLogImageCache<librbd::ImageCtx>;
+
+#endif // CEPH_LIBRBD_CACHE_WRITE_LOG_IMAGE_CACHE
@@ -79,12 +79,17 @@ void ImageCopyRequest<I>::send_object_copies() {
   ldout(m_cct, 20) << "start_object=" << m_object_no << ", "
                    << "end_object=" << m_end_object_no << dendl;
 
+  uint64_t max_ops = m_src_image_ctx->config.template get_val<uint64_t>(
+    "rbd_deep_copy_concurrent_objects");
+  if (max_ops == 0) {
+    max_ops = m_src_image_ctx->config.template get_val<uint64_t>(
+      "rbd_concurrent_management_ops");
+  }
+
   bool complete;
   {
     Mutex::Locker locker(m_lock);
-    for (uint64_t i = 0;
-         i < m_src_image_ctx->config.template get_val<uint64_t>("rbd_concurrent_management_ops");
-         ++i) {
+    for (uint64_t i = 0; i < max_ops; ++i) {
       send_next_object_copy();
       if (m_ret_val < 0 && m_current_ops == 0) {
         break;
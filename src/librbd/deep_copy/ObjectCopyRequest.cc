@@ -334,9 +334,16 @@ void ObjectCopyRequest<I>::send_write_object() {
                                  cls::rbd::ASSERT_SNAPC_SEQ_GT_SNAPSET_SEQ);
   }
 
+  bool alloc_hint = m_dst_image_ctx->enable_alloc_hint;
   for (auto &copy_op : copy_ops) {
     switch (copy_op.type) {
     case COPY_OP_TYPE_WRITE:
+      if (alloc_hint && !copy_op.dst_extent_map.empty()) {
+        // let the OSD allocate the destination object in one piece
+        uint64_t object_size = m_dst_image_ctx->layout.object_size;
+        op.set_alloc_hint(object_size, object_size);
+        alloc_hint = false;
+      }
       buffer_offset = 0;
       for (auto &e : copy_op.dst_extent_map) {
         ldout(m_cct, 20) << "write op: " << e.first << "~" << e.second
@@ -802,6 +809,9 @@ template <typename I>
 void ObjectCopyRequest<I>::merge_write_ops() {
   ldout(m_cct, 20) << dendl;
 
+  bool skip_zeroes = m_dst_image_ctx->config.template get_val<bool>(
+    "rbd_deep_copy_skip_zeroes");
+
   for (auto &it : m_zero_interval) {
     m_dst_zero_interval[it.first].insert(it.second);
   }
@@ -812,6 +822,9 @@ void ObjectCopyRequest<I>::merge_write_ops() {
     for (auto &copy_op : copy_ops) {
       uint64_t src_offset = copy_op.src_offset;
       uint64_t dst_offset = copy_op.dst_offset;
+      uint64_t buffer_offset = 0;
+      bufferlist out_bl;
+      bool zero_data = false;
       for (auto &e : copy_op.src_extent_map) {
         uint64_t zero_len = e.first - src_offset;
         if (zero_len > 0) {
@@ -822,10 +835,26 @@ void ObjectCopyRequest<I>::merge_write_ops() {
           src_offset += zero_len;
           dst_offset += zero_len;
         }
-        copy_op.dst_extent_map[dst_offset] = e.second;
+
+        bufferlist tmpbl;
+        tmpbl.substr_of(copy_op.out_bl, buffer_offset, e.second);
+        buffer_offset += e.second;
+        if (skip_zeroes && tmpbl.is_zero()) {
+          // allocated but never written with data (e.g. a thick image)
+          ldout(m_cct, 20) << "src_snap_seq=" << src_snap_seq
+                           << ", inserting zero data " << dst_offset << "~"
+                           << e.second << dendl;
+          m_dst_zero_interval[src_snap_seq].union_insert(dst_offset,
+                                                         e.second);
+          zero_data = true;
+        } else {
+          copy_op.dst_extent_map[dst_offset] = e.second;
+          out_bl.claim_append(tmpbl);
+        }
         src_offset += e.second;
         dst_offset += e.second;
       }
+      copy_op.out_bl.swap(out_bl);
       if (dst_offset < copy_op.dst_offset + copy_op.length) {
         uint64_t zero_len = copy_op.dst_offset + copy_op.length - dst_offset;
         ldout(m_cct, 20) << "src_snap_seq=" << src_snap_seq
@@ -835,6 +864,9 @@ void ObjectCopyRequest<I>::merge_write_ops() {
       } else {
         ceph_assert(dst_offset == copy_op.dst_offset + copy_op.length);
       }
+      if (zero_data && copy_op.dst_extent_map.empty()) {
+        continue;
+      }
       m_write_ops[src_snap_seq].emplace_back(std::move(copy_op));
     }
   }
@@ -15,6 +15,7 @@
 #include "librbd/Journal.h"
 #include "librbd/ObjectMap.h"
 #include "librbd/Utils.h"
+#include "librbd/cache/ImageCache.h"
 #include "librbd/image/RefreshRequest.h"
 #include "librbd/journal/Policy.h"
 
@@ -115,7 +116,7 @@ void PostAcquireRequest<I>::send_open_journal() {
   }
   if (!journal_enabled) {
     apply();
-    finish();
+    send_open_image_cache();
     return;
   }
 
@@ -173,6 +174,55 @@ void PostAcquireRequest<I>::handle_allocate_journal_tag(int r) {
     return;
   }
 
+  send_open_image_cache();
+}
+
+template <typename I>
+void PostAcquireRequest<I>::send_open_image_cache() {
+  if (!m_image_ctx.config.template get_val<bool>(
+        "rbd_persistent_cache_enabled") ||
+      m_image_ctx.read_only) {
+    finish();
+    return;
+  }
+
+  CephContext *cct = m_image_ctx.cct;
+  ldout(cct, 10) << dendl;
+
+  using klass = PostAcquireRequest<I>;
+  Context *ctx = create_context_callback<
+    klass, &klass::handle_open_image_cache>(this);
+
+  m_image_cache = m_image_ctx.create_image_cache();
+  m_image_cache->init(ctx);
+}
+
+template <typename I>
+void PostAcquireRequest<I>::handle_open_image_cache(int r) {
+  CephContext *cct = m_image_ctx.cct;
+  ldout(cct, 10) << "r=" << r << dendl;
+
+  if (r < 0) {
+    // the log may still hold writes which did not reach the image, so
+    // the lock cannot be used without it
+    lderr(cct) << "failed to open image cache: " << cpp_strerror(r) << dendl;
+    delete m_image_cache;
+    m_image_cache = nullptr;
+
+    save_result(r);
+    if (m_journal != nullptr) {
+      send_close_journal();
+    } else {
+      send_close_object_map();
+    }
+    return;
+  }
+
+  {
+    RWLock::WLocker snap_locker(m_image_ctx.snap_lock);
+    ceph_assert(m_image_ctx.image_cache == nullptr);
+    m_image_ctx.image_cache = m_image_cache;
+  }
   finish();
 }
 
@@ -48,8 +48,13 @@ private:
    *  ALLOCATE_JOURNAL_TAG  *
    *      |            *    *
    *      |            *    *
-   *      |            v    v
-   *      |         CLOSE_JOURNAL
+   *      v            *    *
+   *  OPEN_IMAGE_CACHE *    *
+   *      |   (skip if *    *
+   *      |   disabled)*    *
+   *      |   *        *    *
+   *      |   *        v    v
+   *      |   * * > CLOSE_JOURNAL
    *      |               |
    *      |               v
    *      |         CLOSE_OBJECT_MAP
@@ -69,6 +74,7 @@ private:
 
   decltype(m_image_ctx.object_map) m_object_map;
   decltype(m_image_ctx.journal) m_journal;
+  decltype(m_image_ctx.image_cache) m_image_cache = nullptr;
 
   bool m_prepare_lock_completed = false;
   int m_error_result;
@@ -82,6 +88,9 @@ private:
   void send_allocate_journal_tag();
   void handle_allocate_journal_tag(int r);
 
+  void send_open_image_cache();
+  void handle_open_image_cache(int r);
+
   void send_open_object_map();
   void handle_open_object_map(int r);
 
@@ -11,6 +11,7 @@
 #include "librbd/Journal.h"
 #include "librbd/ObjectMap.h"
 #include "librbd/Utils.h"
+#include "librbd/cache/ImageCache.h"
 #include "librbd/io/ImageRequestWQ.h"
 #include "librbd/io/ObjectDispatcher.h"
 
@@ -157,6 +158,73 @@ void PreReleaseRequest<I>::handle_wait_for_ops(int r) {
   CephContext *cct = m_image_ctx.cct;
   ldout(cct, 10) << dendl;
 
+  send_flush_image_cache();
+}
+
+template <typename I>
+void PreReleaseRequest<I>::send_flush_image_cache() {
+  if (m_image_ctx.image_cache == nullptr) {
+    send_invalidate_cache();
+    return;
+  }
+
+  CephContext *cct = m_image_ctx.cct;
+  ldout(cct, 10) << dendl;
+
+  Context *ctx = create_context_callback<
+      PreReleaseRequest<I>,
+      &PreReleaseRequest<I>::handle_flush_image_cache>(this);
+  m_image_ctx.image_cache->flush(ctx);
+}
+
+template <typename I>
+void PreReleaseRequest<I>::handle_flush_image_cache(int r) {
+  CephContext *cct = m_image_ctx.cct;
+  ldout(cct, 10) << "r=" << r << dendl;
+
+  if (r < 0 && r != -EBLACKLISTED) {
+    // keep the lock rather than let writes bypass data still in the cache
+    lderr(cct) << "failed to flush image cache: " << cpp_strerror(r)
+               << dendl;
+    m_image_ctx.io_work_queue->unblock_writes();
+    save_result(r);
+    finish();
+    return;
+  }
+
+  send_shut_down_image_cache();
+}
+
+template <typename I>
+void PreReleaseRequest<I>::send_shut_down_image_cache() {
+  CephContext *cct = m_image_ctx.cct;
+  ldout(cct, 10) << dendl;
+
+  {
+    RWLock::WLocker snap_locker(m_image_ctx.snap_lock);
+    std::swap(m_image_cache, m_image_ctx.image_cache);
+  }
+
+  Context *ctx = create_context_callback<
+      PreReleaseRequest<I>,
+      &PreReleaseRequest<I>::handle_shut_down_image_cache>(this);
+  m_image_cache->shut_down(ctx);
+}
+
+template <typename I>
+void PreReleaseRequest<I>::handle_shut_down_image_cache(int r) {
+  CephContext *cct = m_image_ctx.cct;
+  ldout(cct, 10) << "r=" << r << dendl;
+
+  if (r < 0) {
+    // whatever is left in the log is written back when it is next opened
+    lderr(cct) << "failed to shut down image cache: " << cpp_strerror(r)
+               << dendl;
+  }
+
+  delete m_image_cache;
+  m_image_cache = nullptr;
+
   send_invalidate_cache();
 }
 
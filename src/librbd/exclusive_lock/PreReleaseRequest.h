@@ -45,6 +45,12 @@ private:
    * WAIT_FOR_OPS
    *    |
    *    v
+   * FLUSH_IMAGE_CACHE (skip if no image cache)
+   *    |
+   *    v
+   * SHUT_DOWN_IMAGE_CACHE
+   *    |
+   *    v
    * INVALIDATE_CACHE
    *    |
    *    v
@@ -74,6 +80,7 @@ private:
 
   decltype(m_image_ctx.object_map) m_object_map = nullptr;
   decltype(m_image_ctx.journal) m_journal = nullptr;
+  decltype(m_image_ctx.image_cache) m_image_cache = nullptr;
 
   void send_prepare_lock();
   void handle_prepare_lock(int r);
@@ -87,6 +94,12 @@ private:
   void send_wait_for_ops();
   void handle_wait_for_ops(int r);
 
+  void send_flush_image_cache();
+  void handle_flush_image_cache(int r);
+
+  void send_shut_down_image_cache();
+  void handle_shut_down_image_cache(int r);
+
   void send_invalidate_cache();
   void handle_invalidate_cache(int r);
 
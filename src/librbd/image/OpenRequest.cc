@@ -8,9 +8,12 @@
 #include "librbd/ImageCtx.h"
 #include "librbd/Utils.h"
 #include "librbd/cache/ObjectCacherObjectDispatch.h"
+#include "librbd/cache/ReadaheadObjectDispatch.h"
+#include "librbd/cache/SharedReadOnlyObjectDispatch.h"
 #include "librbd/image/CloseRequest.h"
 #include "librbd/image/RefreshRequest.h"
 #include "librbd/image/SetSnapRequest.h"
+#include "librbd/io/WriteCoalesceObjectDispatch.h"
 #include <boost/algorithm/string/predicate.hpp>
 #include "include/ceph_assert.h"
 
@@ -515,8 +518,31 @@ Context *OpenRequest<I>::handle_refresh(int *result) {
 
 template <typename I>
 Context *OpenRequest<I>::send_init_cache(int *result) {
-  // cache is disabled or parent image context
-  if (!m_image_ctx->cache || m_image_ctx->child != nullptr) {
+  if (m_image_ctx->child != nullptr) {
+    // parent image context: share the snapshot objects with other clones
+    if (m_image_ctx->config.template get_val<bool>(
+          "rbd_shared_cache_enabled")) {
+      auto cache = cache::SharedReadOnlyObjectDispatch<I>::create(
+        m_image_ctx);
+      cache->init();
+    }
+    return send_register_watch(result);
+  }
+
+  // cache is disabled
+  if (!m_image_ctx->cache) {
+    if (m_image_ctx->readahead_max_bytes > 0 &&
+        m_image_ctx->config.template get_val<uint64_t>(
+          "rbd_readahead_objects") > 0 &&
+        m_image_ctx->layout.stripe_count == 1) {
+      auto readahead = cache::ReadaheadObjectDispatch<I>::create(m_image_ctx);
+      readahead->init();
+    }
+    if (!m_image_ctx->read_only &&
+        m_image_ctx->config.template get_val<bool>("rbd_write_coalesce")) {
+      auto coalesce = io::WriteCoalesceObjectDispatch<I>::create(m_image_ctx);
+      coalesce->init();
+    }
     return send_register_watch(result);
   }
 
@@ -59,6 +59,9 @@ enum DispatchResult {
 enum ObjectDispatchLayer {
   OBJECT_DISPATCH_LAYER_NONE = 0,
   OBJECT_DISPATCH_LAYER_CACHE,
+  OBJECT_DISPATCH_LAYER_READAHEAD,
+  OBJECT_DISPATCH_LAYER_SHARED_PERSISTENT_CACHE,
+  OBJECT_DISPATCH_LAYER_WRITE_COALESCE,
   OBJECT_DISPATCH_LAYER_JOURNAL,
   OBJECT_DISPATCH_LAYER_CORE,
   OBJECT_DISPATCH_LAYER_LAST
@@ -0,0 +1,360 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "librbd/io/WriteCoalesceObjectDispatch.h"
+#include "common/dout.h"
+#include "common/perf_counters.h"
+#include "common/Timer.h"
+#include "common/WorkQueue.h"
+#include "librbd/ImageCtx.h"
+#include "librbd/Types.h"
+#include "librbd/Utils.h"
+#include "librbd/io/ObjectDispatchSpec.h"
+#include "librbd/io/ObjectDispatcher.h"
+
+#define dout_subsys ceph_subsys_rbd
+#undef dout_prefix
+#define dout_prefix *_dout << "librbd::io::WriteCoalesceObjectDispatch: " \
+                           << this << " " << __func__ << ": "
+
+namespace librbd {
+namespace io {
+
+template <typename I>
+WriteCoalesceObjectDispatch<I>::WriteCoalesceObjectDispatch(I* image_ctx)
+  : m_image_ctx(image_ctx),
+    m_max_bytes(image_ctx->config.template get_val<Option::size_t>(
+      "rbd_write_coalesce_max_bytes")),
+    m_max_delay(image_ctx->config.template get_val<double>(
+      "rbd_write_coalesce_max_delay")),
+    m_lock(util::unique_lock_name(
+      "librbd::io::WriteCoalesceObjectDispatch::m_lock", this)) {
+  ImageCtx::get_timer_instance(image_ctx->cct, &m_timer, &m_timer_lock);
+}
+
+template <typename I>
+WriteCoalesceObjectDispatch<I>::~WriteCoalesceObjectDispatch() {
+  ceph_assert(m_objects.empty());
+}
+
+template <typename I>
+void WriteCoalesceObjectDispatch<I>::init() {
+  auto cct = m_image_ctx->cct;
+  ldout(cct, 5) << "max_bytes=" << m_max_bytes << ", "
+                << "max_delay=" << m_max_delay << dendl;
+
+  // add ourself to the IO object dispatcher chain
+  m_image_ctx->io_object_dispatcher->register_object_dispatch(this);
+}
+
+template <typename I>
+void WriteCoalesceObjectDispatch<I>::shut_down(Context* on_finish) {
+  auto cct = m_image_ctx->cct;
+  ldout(cct, 5) << dendl;
+
+  send_all_pending();
+  m_async_op_tracker.wait_for_ops(on_finish);
+}
+
+template <typename I>
+bool WriteCoalesceObjectDispatch<I>::discard(
+    const std::string &oid, uint64_t object_no, uint64_t object_off,
+    uint64_t object_len, const ::SnapContext &snapc, int discard_flags,
+    const ZTracer::Trace &parent_trace, int* object_dispatch_flags,
+    uint64_t* journal_tid, DispatchResult* dispatch_result,
+    Context** on_finish, Context* on_dispatched) {
+  send_pending(object_no);
+  start_write(object_no, on_finish);
+  return false;
+}
+
+template <typename I>
+bool WriteCoalesceObjectDispatch<I>::write(
+    const std::string &oid, uint64_t object_no, uint64_t object_off,
+    ceph::bufferlist&& data, const ::SnapContext &snapc, int op_flags,
+    const ZTracer::Trace &parent_trace, int* object_dispatch_flags,
+    uint64_t* journal_tid, DispatchResult* dispatch_result,
+    Context** on_finish, Context* on_dispatched) {
+  auto cct = m_image_ctx->cct;
+  ldout(cct, 20) << "object_no=" << object_no << " " << object_off << "~"
+                 << data.length() << dendl;
+
+  if (*journal_tid != 0 || *object_dispatch_flags != 0) {
+    send_pending(object_no);
+    start_write(object_no, on_finish);
+    return false;
+  }
+
+  Batches batches;
+  {
+    Mutex::Locker locker(m_lock);
+    auto it = m_objects.find(object_no);
+    if (it == m_objects.end()) {
+      // nothing in flight to wait for: send it now
+      auto &state = m_objects[object_no];
+      state.in_flight = 1;
+      state.tail_end = object_off + data.length();
+    } else {
+      auto &state = it->second;
+      bool hold;
+      if (state.pending.empty()) {
+        // start a new batch if the write continues the last one and
+        // leaves room for more
+        hold = (state.tail_end == object_off &&
+                data.length() < m_max_bytes);
+      } else {
+        hold = can_merge(*state.pending.back(), object_off, data, snapc,
+                         op_flags);
+      }
+      if (hold) {
+        if (state.pending.empty()) {
+          ldout(cct, 20) << "delaying write" << dendl;
+          m_async_op_tracker.start_op();
+          state.pending.push_back(new Batch{oid, object_no, object_off,
+                                            std::move(data), snapc, op_flags,
+                                            parent_trace, {on_dispatched}});
+          state.tail_end = object_off + state.pending.back()->data.length();
+        } else {
+          ldout(cct, 20) << "merging into pending write" << dendl;
+          auto batch = state.pending.back();
+          state.tail_end = object_off + data.length();
+          batch->data.claim_append(data);
+          batch->on_dispatched.push_back(on_dispatched);
+        }
+
+        schedule_send(object_no);
+
+        m_image_ctx->perfcounter->inc(l_librbd_coalesced_wr);
+        *dispatch_result = DISPATCH_RESULT_COMPLETE;
+        return true;
+      }
+
+      // not sequential: send it now, after the writes held before it
+      batches.swap(state.pending);
+      state.in_flight += batches.size() + 1;
+      state.tail_end = object_off + data.length();
+    }
+    m_async_op_tracker.start_op();
+  }
+
+  send_batches(std::move(batches));
+
+  Context* ctx = *on_finish;
+  *on_finish = new FunctionContext([this, object_no, ctx](int r) {
+      finish_write(object_no);
+      ctx->complete(r);
+      m_async_op_tracker.finish_op();
+    });
+  return false;
+}
+
+template <typename I>
+bool WriteCoalesceObjectDispatch<I>::write_same(
+    const std::string &oid, uint64_t object_no, uint64_t object_off,
+    uint64_t object_len, Extents&& buffer_extents,
+    ceph::bufferlist&& data, const ::SnapContext &snapc, int op_flags,
+    const ZTracer::Trace &parent_trace, int* object_dispatch_flags,
+    uint64_t* journal_tid, DispatchResult* dispatch_result,
+    Context** on_finish, Context* on_dispatched) {
+  send_pending(object_no);
+  start_write(object_no, on_finish);
+  return false;
+}
+
+template <typename I>
+bool WriteCoalesceObjectDispatch<I>::compare_and_write(
+    const std::string &oid, uint64_t object_no, uint64_t object_off,
+    ceph::bufferlist&& cmp_data, ceph::bufferlist&& write_data,
+    const ::SnapContext &snapc, int op_flags,
+    const ZTracer::Trace &parent_trace, uint64_t* mismatch_offset,
+    int* object_dispatch_flags, uint64_t* journal_tid,
+    DispatchResult* dispatch_result, Context** on_finish,
+    Context* on_dispatched) {
+  send_pending(object_no);
+  start_write(object_no, on_finish);
+  return false;
+}
+
+template <typename I>
+bool WriteCoalesceObjectDispatch<I>::flush(
+    FlushSource flush_source, const ZTracer::Trace &parent_trace,
+    DispatchResult* dispatch_result, Context** on_finish,
+    Context* on_dispatched) {
+  auto cct = m_image_ctx->cct;
+  ldout(cct, 20) << dendl;
+
+  send_all_pending();
+  return false;
+}
+
+template <typename I>
+bool WriteCoalesceObjectDispatch<I>::can_merge(
+    const Batch &batch, uint64_t object_off, const ceph::bufferlist &data,
+    const ::SnapContext &snapc, int op_flags) const {
+  return (batch.object_off + batch.data.length() == object_off &&
+          batch.data.length() + data.length() <= m_max_bytes &&
+          batch.op_flags == op_flags &&
+          batch.snapc.seq == snapc.seq &&
+          batch.snapc.snaps == snapc.snaps);
+}
+
+template <typename I>
+void WriteCoalesceObjectDispatch<I>::schedule_send(uint64_t object_no) {
+  ceph_assert(m_lock.is_locked());
+
+  // bound the time a write waits for the writes in flight
+  Mutex::Locker timer_locker(*m_timer_lock);
+  if (m_timer_tasks.count(object_no) != 0) {
+    return;
+  }
+
+  m_async_op_tracker.start_op();
+  auto ctx = new FunctionContext([this, object_no](int r) {
+      // timer lock is held
+      m_timer_tasks.erase(object_no);
+      m_image_ctx->op_work_queue->queue(
+        new FunctionContext([this, object_no](int r) {
+          send_pending(object_no);
+          m_async_op_tracker.finish_op();
+        }), 0);
+    });
+  m_timer_tasks[object_no] = ctx;
+  m_timer->add_event_after(m_max_delay, ctx);
+}
+
+template <typename I>
+void WriteCoalesceObjectDispatch<I>::cancel_send(uint64_t object_no) {
+  {
+    Mutex::Locker timer_locker(*m_timer_lock);
+    auto it = m_timer_tasks.find(object_no);
+    if (it == m_timer_tasks.end()) {
+      return;
+    }
+
+    bool canceled = m_timer->cancel_event(it->second);
+    ceph_assert(canceled);
+    m_timer_tasks.erase(it);
+  }
+
+  m_async_op_tracker.finish_op();
+}
+
+template <typename I>
+void WriteCoalesceObjectDispatch<I>::start_write(uint64_t object_no,
+                                                 Context** on_finish) {
+  {
+    Mutex::Locker locker(m_lock);
+    ++m_objects[object_no].in_flight;
+  }
+
+  m_async_op_tracker.start_op();
+  Context* ctx = *on_finish;
+  *on_finish = new FunctionContext([this, object_no, ctx](int r) {
+      finish_write(object_no);
+      ctx->complete(r);
+      m_async_op_tracker.finish_op();
+    });
+}
+
+template <typename I>
+void WriteCoalesceObjectDispatch<I>::finish_write(uint64_t object_no) {
+  Batches batches;
+  {
+    Mutex::Locker locker(m_lock);
+    auto it = m_objects.find(object_no);
+    ceph_assert(it != m_objects.end());
+
+    auto &state = it->second;
+    ceph_assert(state.in_flight > 0);
+    if (--state.in_flight > 0) {
+      return;
+    }
+
+    if (!state.pending.empty()) {
+      // the merged writes are sent once the earlier writes complete
+      batches.swap(state.pending);
+      state.in_flight = batches.size();
+    } else {
+      m_objects.erase(it);
+    }
+  }
+
+  if (batches.empty()) {
+    cancel_send(object_no);
+    return;
+  }
+
+  send_batches(std::move(batches));
+}
+
+template <typename I>
+void WriteCoalesceObjectDispatch<I>::send_pending(uint64_t object_no) {
+  Batches batches;
+  {
+    Mutex::Locker locker(m_lock);
+    auto it = m_objects.find(object_no);
+    if (it == m_objects.end()) {
+      return;
+    }
+
+    auto &state = it->second;
+    batches.swap(state.pending);
+    state.in_flight += batches.size();
+  }
+
+  send_batches(std::move(batches));
+}
+
+template <typename I>
+void WriteCoalesceObjectDispatch<I>::send_all_pending() {
+  Batches batches;
+  {
+    Mutex::Locker locker(m_lock);
+    for (auto &it : m_objects) {
+      auto &state = it.second;
+      state.in_flight += state.pending.size();
+      batches.splice(batches.end(), state.pending);
+    }
+  }
+
+  send_batches(std::move(batches));
+}
+
+template <typename I>
+void WriteCoalesceObjectDispatch<I>::send_batches(Batches&& batches) {
+  auto cct = m_image_ctx->cct;
+  for (auto batch : batches) {
+    ldout(cct, 20) << "object_no=" << batch->object_no << " "
+                   << batch->object_off << "~" << batch->data.length()
+                   << ", writes=" << batch->on_dispatched.size() << dendl;
+    m_image_ctx->perfcounter->inc(l_librbd_coalesced_wr_ops);
+
+    auto ctx = new FunctionContext([this, batch](int r) {
+        handle_batch(batch, r);
+      });
+    auto req = ObjectDispatchSpec::create_write(
+      m_image_ctx, OBJECT_DISPATCH_LAYER_WRITE_COALESCE, batch->oid,
+      batch->object_no, batch->object_off, std::move(batch->data),
+      batch->snapc, batch->op_flags, 0, batch->parent_trace, ctx);
+    req->send();
+  }
+}
+
+template <typename I>
+void WriteCoalesceObjectDispatch<I>::handle_batch(Batch* batch, int r) {
+  auto cct = m_image_ctx->cct;
+  ldout(cct, 20) << "object_no=" << batch->object_no << ", r=" << r << dendl;
+
+  for (auto on_dispatched : batch->on_dispatched) {
+    on_dispatched->complete(r);
+  }
+
+  finish_write(batch->object_no);
+  delete batch;
+  m_async_op_tracker.finish_op();
+}
+
+} // namespace io
+} // namespace librbd
+
+template class librbd::io::WriteCoalesceObjectDispatch<librbd::ImageCtx>;
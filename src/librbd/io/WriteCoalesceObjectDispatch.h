@@ -0,0 +1,163 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#ifndef CEPH_LIBRBD_IO_WRITE_COALESCE_OBJECT_DISPATCH_H
+#define CEPH_LIBRBD_IO_WRITE_COALESCE_OBJECT_DISPATCH_H
+
+#include "librbd/io/ObjectDispatchInterface.h"
+#include "common/AsyncOpTracker.h"
+#include "common/Mutex.h"
+#include "common/snap_types.h"
+#include "common/zipkin_trace.h"
+#include <list>
+#include <map>
+
+class SafeTimer;
+
+namespace librbd {
+
+class ImageCtx;
+
+namespace io {
+
+/**
+ * Merges small sequential writes to an object while earlier writes to the
+ * same object are in flight.  A write to an idle object is passed down
+ * untouched.  A write which starts where the previous write to the object
+ * ended is held, and the writes which follow on from it are appended to
+ * it; they are sent as a single object write once the writes in flight
+ * complete, or once they have waited for the maximum delay.  Any other
+ * write is passed down right away, behind the write being held.
+ *
+ * Writes are only completed once the merged write which carries them
+ * completes, so flushes still wait for them.  Journaled writes are never
+ * merged since each one commits its own journal event.
+ */
+template <typename ImageCtxT = ImageCtx>
+class WriteCoalesceObjectDispatch : public ObjectDispatchInterface {
+public:
+  static WriteCoalesceObjectDispatch* create(ImageCtxT* image_ctx) {
+    return new WriteCoalesceObjectDispatch(image_ctx);
+  }
+
+  WriteCoalesceObjectDispatch(ImageCtxT* image_ctx);
+  ~WriteCoalesceObjectDispatch() override;
+
+  ObjectDispatchLayer get_object_dispatch_layer() const override {
+    return OBJECT_DISPATCH_LAYER_WRITE_COALESCE;
+  }
+
+  void init();
+  void shut_down(Context* on_finish) override;
+
+  bool read(
+      const std::string &oid, uint64_t object_no, uint64_t object_off,
+      uint64_t object_len, librados::snap_t snap_id, int op_flags,
+      const ZTracer::Trace &parent_trace, ceph::bufferlist* read_data,
+      ExtentMap* extent_map, int* object_dispatch_flags,
+      DispatchResult* dispatch_result, Context** on_finish,
+      Context* on_dispatched) override {
+    return false;
+  }
+
+  bool discard(
+      const std::string &oid, uint64_t object_no, uint64_t object_off,
+      uint64_t object_len, const ::SnapContext &snapc, int discard_flags,
+      const ZTracer::Trace &parent_trace, int* object_dispatch_flags,
+      uint64_t* journal_tid, DispatchResult* dispatch_result,
+      Context** on_finish, Context* on_dispatched) override;
+
+  bool write(
+      const std::string &oid, uint64_t object_no, uint64_t object_off,
+      ceph::bufferlist&& data, const ::SnapContext &snapc, int op_flags,
+      const ZTracer::Trace &parent_trace, int* object_dispatch_flags,
+      uint64_t* journal_tid, DispatchResult* dispatch_result,
+      Context** on_finish, Context* on_dispatched) override;
+
+  bool write_same(
+      const std::string &oid, uint64_t object_no, uint64_t object_off,
+      uint64_t object_len, Extents&& buffer_extents,
+      ceph::bufferlist&& data, const ::SnapContext &snapc, int op_flags,
+      const ZTracer::Trace &parent_trace, int* object_dispatch_flags,
+      uint64_t* journal_tid, DispatchResult* dispatch_result,
+      Context** on_finish, Context* on_dispatched) override;
+
+  bool compare_and_write(
+      const std::string &oid, uint64_t object_no, uint64_t object_off,
+      ceph::bufferlist&& cmp_data, ceph::bufferlist&& write_data,
+      const ::SnapContext &snapc, int op_flags,
+      const ZTracer::Trace &parent_trace, uint64_t* mismatch_offset,
+      int* object_dispatch_flags, uint64_t* journal_tid,
+      DispatchResult* dispatch_result, Context** on_finish,
+      Context* on_dispatched) override;
+
+  bool flush(
+      FlushSource flush_source, const ZTracer::Trace &parent_trace,
+      DispatchResult* dispatch_result, Context** on_finish,
+      Context* on_dispatched) override;
+
+  bool invalidate_cache(Context* on_finish) override {
+    return false;
+  }
+  bool reset_existence_cache(Context* on_finish) override {
+    return false;
+  }
+
+  void extent_overwritten(
+      uint64_t object_no, uint64_t object_off, uint64_t object_len,
+      uint64_t journal_tid, uint64_t new_journal_tid) override {
+  }
+
+private:
+  /// writes merged into a single object write
+  struct Batch {
+    std::string oid;
+    uint64_t object_no;
+    uint64_t object_off;
+    ceph::bufferlist data;
+    ::SnapContext snapc;
+    int op_flags;
+    ZTracer::Trace parent_trace;
+    std::list<Context*> on_dispatched;
+  };
+  typedef std::list<Batch*> Batches;
+
+  struct ObjectState {
+    uint64_t in_flight = 0;
+    Batches pending;
+    uint64_t tail_end = 0;  ///< end of the last write sent or held
+  };
+
+  ImageCtxT* m_image_ctx;
+  uint64_t m_max_bytes;
+  double m_max_delay;
+
+  SafeTimer* m_timer = nullptr;
+  Mutex* m_timer_lock = nullptr;
+  std::map<uint64_t, Context*> m_timer_tasks;  ///< protected by m_timer_lock
+  AsyncOpTracker m_async_op_tracker;
+
+  Mutex m_lock;
+  std::map<uint64_t, ObjectState> m_objects;  ///< by object number
+
+  bool can_merge(const Batch &batch, uint64_t object_off,
+                 const ceph::bufferlist &data, const ::SnapContext &snapc,
+                 int op_flags) const;
+  void schedule_send(uint64_t object_no);
+  void cancel_send(uint64_t object_no);
+
+  void start_write(uint64_t object_no, Context** on_finish);
+  void finish_write(uint64_t object_no);
+
+  void send_pending(uint64_t object_no);
+  void send_all_pending();
+  void send_batches(Batches&& batches);
+  void handle_batch(Batch* batch, int r);
+};
+
+} // namespace io
+} // namespace librbd
+
+extern template class librbd::io::WriteCoalesceObjectDispatch<librbd::ImageCtx>;
+
+#endif // CEPH_LIBRBD_IO_WRITE_COALESCE_OBJECT_DISPATCH_H
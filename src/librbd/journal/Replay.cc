@@ -173,7 +173,9 @@ struct C_RefreshIfRequired : public Context {
 
 template <typename I>
 Replay<I>::Replay(I &image_ctx)
-  : m_image_ctx(image_ctx), m_lock("Replay<I>::m_lock") {
+  : m_image_ctx(image_ctx), m_lock("Replay<I>::m_lock"),
+    m_max_batched_writes(image_ctx.config.template get_val<uint64_t>(
+      "rbd_journal_replay_max_concurrent_writes")) {
 }
 
 template <typename I>
@@ -184,6 +186,8 @@ Replay<I>::~Replay() {
   ceph_assert(m_aio_modify_safe_contexts.empty());
   ceph_assert(m_op_events.empty());
   ceph_assert(m_in_flight_op_events == 0);
+  ceph_assert(m_in_flight_batched_writes == 0);
+  ceph_assert(m_on_batched_writes == nullptr);
 }
 
 template <typename I>
@@ -204,6 +208,23 @@ void Replay<I>::process(const EventEntry &event_entry,
   ldout(cct, 20) << ": on_ready=" << on_ready << ", on_safe=" << on_safe
                  << dendl;
 
+  {
+    Mutex::Locker locker(m_lock);
+    if (is_blocked_by_batched_writes(event_entry)) {
+      ldout(cct, 20) << ": waiting for in-flight batched writes" << dendl;
+
+      // account for the event as an in-flight modification so that
+      // shut down waits for it
+      ceph_assert(m_on_batched_writes == nullptr);
+      ++m_in_flight_aio_modify;
+      m_on_batched_writes = new FunctionContext(
+        [this, event_entry, on_ready, on_safe](int r) {
+          process_blocked_event(event_entry, on_ready, on_safe);
+        });
+      return;
+    }
+  }
+
   on_ready = util::create_async_context_callback(m_image_ctx, on_ready);
 
   RWLock::RLocker owner_lock(m_image_ctx.owner_lock);
@@ -219,6 +240,60 @@ void Replay<I>::process(const EventEntry &event_entry,
                        event_entry.event);
 }
 
+template <typename I>
+bool Replay<I>::is_blocked_by_batched_writes(
+    const EventEntry &event_entry) const {
+  ceph_assert(m_lock.is_locked());
+  if (m_in_flight_batched_writes == 0 || m_shut_down) {
+    return false;
+  }
+
+  switch (event_entry.get_event_type()) {
+  case EVENT_TYPE_AIO_WRITE:
+    {
+      // overlapping writes are applied in journal order
+      auto &event = boost::get<AioWriteEvent>(event_entry.event);
+      return (m_in_flight_batched_writes >= m_max_batched_writes ||
+              (event.length > 0 &&
+               m_batched_write_extents.intersects(event.offset,
+                                                  event.length)));
+    }
+  case EVENT_TYPE_AIO_DISCARD:
+  case EVENT_TYPE_AIO_WRITESAME:
+  case EVENT_TYPE_AIO_COMPARE_AND_WRITE:
+    return true;
+  case EVENT_TYPE_AIO_FLUSH:
+    // writes after a flush must not land before the writes ahead of it
+    return true;
+  default:
+    // ops quiesce IO themselves
+    return false;
+  }
+}
+
+template <typename I>
+void Replay<I>::process_blocked_event(const EventEntry &event_entry,
+                                      Context *on_ready, Context *on_safe) {
+  CephContext *cct = m_image_ctx.cct;
+  ldout(cct, 20) << dendl;
+
+  process(event_entry, on_ready, on_safe);
+
+  Context *on_flush = nullptr;
+  {
+    Mutex::Locker locker(m_lock);
+    ceph_assert(m_in_flight_aio_modify > 0);
+    --m_in_flight_aio_modify;
+    if (m_in_flight_op_events == 0 &&
+        (m_in_flight_aio_flush + m_in_flight_aio_modify) == 0) {
+      std::swap(on_flush, m_flush_ctx);
+    }
+  }
+  if (on_flush != nullptr) {
+    m_image_ctx.op_work_queue->queue(on_flush, 0);
+  }
+}
+
 template <typename I>
 void Replay<I>::shut_down(bool cancel_ops, Context *on_finish) {
   CephContext *cct = m_image_ctx.cct;
@@ -376,10 +451,12 @@ void Replay<I>::handle_event(const journal::AioWriteEvent &event,
 
   bufferlist data = event.data;
   bool flush_required;
+  Context *on_batch_ready = nullptr;
   auto aio_comp = create_aio_modify_completion(on_ready, on_safe,
                                                io::AIO_TYPE_WRITE,
-                                               &flush_required,
-                                               {});
+                                               &flush_required, {},
+                                               {{event.offset, event.length}},
+                                               &on_batch_ready);
   if (aio_comp == nullptr) {
     return;
   }
@@ -390,6 +467,12 @@ void Replay<I>::handle_event(const journal::AioWriteEvent &event,
                                    std::move(data), 0, {});
   }
 
+  // the next event is only processed once the write has been issued so
+  // that a following flush or op covers it
+  if (on_batch_ready != nullptr) {
+    on_batch_ready->complete(0);
+  }
+
   if (flush_required) {
     m_lock.Lock();
     auto flush_comp = create_aio_flush_completion(nullptr);
@@ -883,12 +966,27 @@ void Replay<I>::handle_event(const journal::UnknownEvent &event,
 template <typename I>
 void Replay<I>::handle_aio_modify_complete(Context *on_ready, Context *on_safe,
                                            int r, std::set<int> &filters,
-                                           bool writeback_cache_enabled) {
+                                           bool writeback_cache_enabled,
+                                           const io::Extents &batch_extents) {
   Mutex::Locker locker(m_lock);
   CephContext *cct = m_image_ctx.cct;
   ldout(cct, 20) << ": on_ready=" << on_ready << ", "
                  << "on_safe=" << on_safe << ", r=" << r << dendl;
 
+  if (!batch_extents.empty()) {
+    ceph_assert(m_in_flight_batched_writes > 0);
+    --m_in_flight_batched_writes;
+    for (auto &extent : batch_extents) {
+      m_batched_write_extents.erase(extent.first, extent.second);
+    }
+
+    // re-evaluate the event waiting for the batch
+    if (m_on_batched_writes != nullptr) {
+      m_image_ctx.op_work_queue->queue(m_on_batched_writes, 0);
+      m_on_batched_writes = nullptr;
+    }
+  }
+
   if (on_ready != nullptr) {
     on_ready->complete(0);
   }
@@ -1084,7 +1182,9 @@ Replay<I>::create_aio_modify_completion(Context *on_ready,
                                         Context *on_safe,
                                         io::aio_type_t aio_type,
                                         bool *flush_required,
-                                        std::set<int> &&filters) {
+                                        std::set<int> &&filters,
+                                        io::Extents &&batch_extents,
+                                        Context **on_batch_ready) {
   Mutex::Locker locker(m_lock);
   CephContext *cct = m_image_ctx.cct;
   ceph_assert(m_on_aio_ready == nullptr);
@@ -1127,12 +1227,27 @@ Replay<I>::create_aio_modify_completion(Context *on_ready,
     std::swap(m_on_aio_ready, on_ready);
   }
 
+  // without a writeback cache, writes to disjoint extents are batched:
+  // the caller processes the next event as soon as the write is issued
+  if (!writeback_cache_enabled && m_max_batched_writes > 1 &&
+      on_batch_ready != nullptr && !batch_extents.empty() &&
+      batch_extents.front().second > 0) {
+    ++m_in_flight_batched_writes;
+    for (auto &extent : batch_extents) {
+      m_batched_write_extents.insert(extent.first, extent.second);
+    }
+    std::swap(*on_batch_ready, on_ready);
+  } else {
+    batch_extents.clear();
+  }
+
   // when the modification is ACKed by librbd, we can process the next
   // event. when flushed, the completion of the next flush will fire the
   // on_safe callback
   auto aio_comp = io::AioCompletion::create_and_start<Context>(
     new C_AioModifyComplete(this, on_ready, on_safe, std::move(filters),
-                            writeback_cache_enabled),
+                            writeback_cache_enabled,
+                            std::move(batch_extents)),
     util::get_image_ctx(&m_image_ctx), aio_type);
   return aio_comp;
 }
@@ -8,6 +8,7 @@
 #include "include/buffer_fwd.h"
 #include "include/Context.h"
 #include "common/Mutex.h"
+#include "include/interval_set.h"
 #include "librbd/io/Types.h"
 #include "librbd/journal/Types.h"
 #include <boost/variant.hpp>
@@ -79,16 +80,20 @@ private:
     Context *on_safe;
     std::set<int> filters;
     bool writeback_cache_enabled;
+    io::Extents batch_extents;
     C_AioModifyComplete(Replay *replay, Context *on_ready,
                         Context *on_safe, std::set<int> &&filters,
-                        bool writeback_cache_enabled)
+                        bool writeback_cache_enabled,
+                        io::Extents &&batch_extents)
       : replay(replay), on_ready(on_ready), on_safe(on_safe),
         filters(std::move(filters)),
-        writeback_cache_enabled(writeback_cache_enabled) {
+        writeback_cache_enabled(writeback_cache_enabled),
+        batch_extents(std::move(batch_extents)) {
     }
     void finish(int r) override {
       replay->handle_aio_modify_complete(on_ready, on_safe, r, filters,
-                                         writeback_cache_enabled);
+                                         writeback_cache_enabled,
+                                         batch_extents);
     }
   };
 
@@ -137,6 +142,12 @@ private:
   Context *m_flush_ctx = nullptr;
   Context *m_on_aio_ready = nullptr;
 
+  // AIO writes to disjoint extents which are replayed concurrently
+  uint64_t m_max_batched_writes;
+  uint64_t m_in_flight_batched_writes = 0;
+  interval_set<uint64_t> m_batched_write_extents;
+  Context *m_on_batched_writes = nullptr;   ///< event waiting for the batch
+
   void handle_event(const AioDiscardEvent &event, Context *on_ready,
                     Context *on_safe);
   void handle_event(const AioWriteEvent &event, Context *on_ready,
@@ -182,7 +193,8 @@ private:
 
   void handle_aio_modify_complete(Context *on_ready, Context *on_safe,
                                   int r, std::set<int> &filters,
-                                  bool writeback_cache_enabled);
+                                  bool writeback_cache_enabled,
+                                  const io::Extents &batch_extents);
   void handle_aio_flush_complete(Context *on_flush_safe, Contexts &on_safe_ctxs,
                                  int r);
 
@@ -194,10 +206,16 @@ private:
                                                   Context *on_safe,
                                                   io::aio_type_t aio_type,
                                                   bool *flush_required,
-                                                  std::set<int> &&filters);
+                                                  std::set<int> &&filters,
+                                                  io::Extents &&batch_extents = {},
+                                                  Context **on_batch_ready = nullptr);
   io::AioCompletion *create_aio_flush_completion(Context *on_safe);
   void handle_aio_completion(io::AioCompletion *aio_comp);
 
+  bool is_blocked_by_batched_writes(const EventEntry &event_entry) const;
+  void process_blocked_event(const EventEntry &event_entry, Context *on_ready,
+                             Context *on_safe);
+
   bool clipped_io(uint64_t image_offset, io::AioCompletion *aio_comp);
 
 };
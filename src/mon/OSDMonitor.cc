@@ -493,6 +493,7 @@ void OSDMonitor::update_from_paxos(bool *need_bootstrap)
     osdmap.encode(full_bl, f | CEPH_FEATURE_RESERVED);
     tx_size += full_bl.length();
 
+    bool canonical_reset = false;
     bufferlist orig_full_bl;
     get_version_full(osdmap.epoch, orig_full_bl);
     if (orig_full_bl.length()) {
@@ -518,6 +519,7 @@ void OSDMonitor::update_from_paxos(bool *need_bootstrap)
 
 	osdmap = OSDMap();
 	osdmap.decode(orig_full_bl);
+	canonical_reset = true;
 
 	dout(20) << __func__ << " canonical full osdmap:\n";
 	JSONFormatter jf(true);
@@ -533,6 +535,17 @@ void OSDMonitor::update_from_paxos(bool *need_bootstrap)
     }
     put_version_latest_full(t, osdmap.epoch);
 
+    // bring the pg mapping along if this epoch only remaps a few pgs;
+    // otherwise start_mapping() will do a full update.  a mapping job
+    // still running writes the same tables from the mapper threads.
+    if (g_conf()->mon_osd_mapping_incremental_max_pgs && !canonical_reset &&
+	(!mapping_job || mapping_job->is_done())) {
+      mapping.update_incremental(
+	cct, osdmap, inc,
+	g_conf()->mon_osd_mapping_incremental_max_pgs,
+	g_conf()->mon_osd_mapping_incremental_verify);
+    }
+
     // share
     dout(1) << osdmap << dendl;
 
@@ -607,6 +620,13 @@ void OSDMonitor::start_mapping()
   }
   if (!osdmap.get_pools().empty()) {
     auto fin = new C_UpdateCreatingPGs(this, osdmap.get_epoch());
+    if (mapping.get_epoch() == osdmap.get_epoch()) {
+      dout(10) << __func__ << " mapping already updated incrementally"
+	       << dendl;
+      mapping_job = nullptr;
+      fin->complete(0);
+      return;
+    }
     mapping_job = mapping.start_update(osdmap, mapper,
 				       g_conf()->mon_osd_mapping_pgs_per_chunk);
     dout(10) << __func__ << " started mapping job " << mapping_job.get()
@@ -1042,6 +1062,11 @@ void OSDMonitor::encode_pending(MonitorDBStore::TransactionRef t)
 	maybe_prime_pg_temp();
       }
     } 
+  } else if (mapping.get_epoch() == osdmap.get_epoch()) {
+    // mapping was updated incrementally
+    if (g_conf()->mon_osd_prime_pg_temp) {
+      maybe_prime_pg_temp();
+    }
   } else if (g_conf()->mon_osd_prime_pg_temp) {
     dout(1) << __func__ << " skipping prime_pg_temp; mapping job did not start"
 	    << dendl;
@@ -3003,8 +3028,8 @@ bool OSDMonitor::prepare_boot(MonOpRequestRef op)
 	(g_conf()->mon_osd_auto_mark_new_in && (oldstate & CEPH_OSD_NEW)) ||
 	(g_conf()->mon_osd_auto_mark_in)) {
       if (can_mark_in(from)) {
-	if (osdmap.osd_xinfo[from].old_weight > 0) {
-	  pending_inc.new_weight[from] = osdmap.osd_xinfo[from].old_weight;
+	if ((*osdmap.osd_xinfo)[from].old_weight > 0) {
+	  pending_inc.new_weight[from] = (*osdmap.osd_xinfo)[from].old_weight;
 	  xi.old_weight = 0;
 	} else {
 	  pending_inc.new_weight[from] = CEPH_OSD_IN;
@@ -4370,7 +4395,7 @@ void OSDMonitor::tick()
 
 	  // remember previous weight
 	  if (pending_inc.new_xinfo.count(o) == 0)
-	    pending_inc.new_xinfo[o] = osdmap.osd_xinfo[o];
+	    pending_inc.new_xinfo[o] = (*osdmap.osd_xinfo)[o];
 	  pending_inc.new_xinfo[o].old_weight = osdmap.osd_weight[o];
 
 	  do_propose = true;
@@ -10195,7 +10220,7 @@ bool OSDMonitor::prepare_command_impl(MonOpRequestRef op,
 	    pending_inc.new_weight[osd] = CEPH_OSD_OUT;
 	    if (osdmap.osd_weight[osd]) {
 	      if (pending_inc.new_xinfo.count(osd) == 0) {
-	        pending_inc.new_xinfo[osd] = osdmap.osd_xinfo[osd];
+	        pending_inc.new_xinfo[osd] = (*osdmap.osd_xinfo)[osd];
 	      }
 	      pending_inc.new_xinfo[osd].old_weight = osdmap.osd_weight[osd];
 	    }
@@ -10219,10 +10244,10 @@ bool OSDMonitor::prepare_command_impl(MonOpRequestRef op,
             if (verbose)
 	      ss << "osd." << osd << " is already in. ";
 	  } else {
-	    if (osdmap.osd_xinfo[osd].old_weight > 0) {
-	      pending_inc.new_weight[osd] = osdmap.osd_xinfo[osd].old_weight;
+	    if ((*osdmap.osd_xinfo)[osd].old_weight > 0) {
+	      pending_inc.new_weight[osd] = (*osdmap.osd_xinfo)[osd].old_weight;
 	      if (pending_inc.new_xinfo.count(osd) == 0) {
-	        pending_inc.new_xinfo[osd] = osdmap.osd_xinfo[osd];
+	        pending_inc.new_xinfo[osd] = (*osdmap.osd_xinfo)[osd];
 	      }
 	      pending_inc.new_xinfo[osd].old_weight = 0;
 	    } else {
@@ -12800,7 +12825,7 @@ int OSDMonitor::_prepare_remove_pool(
     }
   }
   // remove any pg_upmap mappings for this pool
-  for (auto& p : osdmap.pg_upmap) {
+  for (auto& p : *osdmap.pg_upmap) {
     if (p.first.pool() == pool) {
       dout(10) << __func__ << " " << pool
                << " removing obsolete pg_upmap "
@@ -12823,7 +12848,7 @@ int OSDMonitor::_prepare_remove_pool(
     }
   }
   // remove any pg_upmap_items mappings for this pool
-  for (auto& p : osdmap.pg_upmap_items) {
+  for (auto& p : *osdmap.pg_upmap_items) {
     if (p.first.pool() == pool) {
       dout(10) << __func__ << " " << pool
                << " removing obsolete pg_upmap_items " << p.first
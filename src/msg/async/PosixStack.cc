@@ -21,11 +21,13 @@
 #include <errno.h>
 
 #include <algorithm>
+#include <fstream>
 
 #include "PosixStack.h"
 
 #include "include/buffer.h"
 #include "include/str_list.h"
+#include "include/util.h"
 #include "common/errno.h"
 #include "common/strtol.h"
 #include "common/dout.h"
@@ -280,6 +282,26 @@ int PosixWorker::connect(const entity_addr_t &addr, const SocketOptions &opts, C
   return 0;
 }
 
+// cpus of the NUMA node the given network interface is attached to
+static int get_iface_numa_cpus(const string& iface, vector<int> *cpus)
+{
+  string node;
+  {
+    std::ifstream f("/sys/class/net/" + iface + "/device/numa_node");
+    if (!(f >> node))
+      return -ENOENT;
+  }
+  if (node == "-1")
+    return -ENODEV;   // not a NUMA system, or the device doesn't say
+  string cpulist;
+  {
+    std::ifstream f("/sys/devices/system/node/node" + node + "/cpulist");
+    if (!std::getline(f, cpulist))
+      return -ENOENT;
+  }
+  return parse_cpu_list(cpulist, cpus);
+}
+
 PosixNetworkStack::PosixNetworkStack(CephContext *c, const string &t)
     : NetworkStack(c, t)
 {
@@ -293,4 +315,35 @@ PosixNetworkStack::PosixNetworkStack(CephContext *c, const string &t)
     else
       lderr(cct) << __func__ << " failed to parse " << corestr << " in " << cct->_conf->ms_async_affinity_cores << dendl;
   }
+  const string& iface = cct->_conf->ms_async_affinity_iface;
+  if (coreids.empty() && !iface.empty()) {
+    int r = get_iface_numa_cpus(iface, &coreids);
+    if (r < 0) {
+      lderr(cct) << __func__ << " unable to find NUMA-local cpus for "
+                 << iface << ": " << cpp_strerror(r) << dendl;
+      coreids.clear();
+    } else {
+      ldout(cct, 1) << __func__ << " " << iface << " is local to cpus "
+                    << coreids << dendl;
+    }
+  }
+}
+
+void PosixNetworkStack::set_worker_affinity(unsigned i)
+{
+  int cpuid = get_cpuid(i);
+  if (cpuid < 0 || !cct->_conf->ms_async_set_affinity)
+    return;
+  cpu_set_t cpuset;
+  CPU_ZERO(&cpuset);
+  CPU_SET(cpuid, &cpuset);
+  int r = pthread_setaffinity_np(threads[i].native_handle(),
+                                 sizeof(cpuset), &cpuset);
+  if (r) {
+    lderr(cct) << __func__ << " failed to pin worker " << i << " to cpu "
+               << cpuid << ": " << cpp_strerror(r) << dendl;
+  } else {
+    ldout(cct, 10) << __func__ << " pinned worker " << i << " to cpu "
+                   << cpuid << dendl;
+  }
 }
@@ -50,7 +50,9 @@ class PosixNetworkStack : public NetworkStack {
   void spawn_worker(unsigned i, std::function<void ()> &&func) override {
     threads.resize(i+1);
     threads[i] = std::thread(func);
+    set_worker_affinity(i);
   }
+  void set_worker_affinity(unsigned i);
   void join_worker(unsigned i) override {
     ceph_assert(threads.size() > i && threads[i].joinable());
     threads[i].join();
@@ -169,6 +169,7 @@ void ProtocolV1::fault() {
   replacing = false;
 
   connection->fault();
+  batch_msgs = 0;
 
   reset_recv_state();
 
@@ -368,9 +369,9 @@ void ProtocolV1::write_event() {
                        << " messages" << dendl;
         ack_left -= left;
         left = ack_left;
-        r = connection->_try_send(left);
+        r = send_batch(left);
       } else if (is_queued()) {
-        r = connection->_try_send();
+        r = send_batch();
       }
     }
 
@@ -1077,6 +1078,22 @@ void ProtocolV1::randomize_out_seq() {
   }
 }
 
+ssize_t ProtocolV1::send_batch(bool more) {
+  ssize_t total_send_size = connection->outcoming_bl.length();
+  ssize_t rc = connection->_try_send(more);
+  if (rc >= 0) {
+    connection->logger->inc(
+        l_msgr_send_bytes, total_send_size - connection->outcoming_bl.length());
+  }
+  if (batch_msgs) {
+    connection->logger->inc(l_msgr_send_batches);
+    connection->logger->hinc(l_msgr_send_batch_histogram, batch_msgs,
+                             total_send_size);
+    batch_msgs = 0;
+  }
+  return rc;
+}
+
 ssize_t ProtocolV1::write_message(Message *m, bufferlist &bl, bool more) {
   FUNCTRACE(cct);
   ceph_assert(connection->center->in_thread());
@@ -1145,16 +1162,26 @@ ssize_t ProtocolV1::write_message(Message *m, bufferlist &bl, bool more) {
   m->trace.event("async writing message");
   ldout(cct, 20) << __func__ << " sending " << m->get_seq() << " " << m
                  << dendl;
-  ssize_t total_send_size = connection->outcoming_bl.length();
-  ssize_t rc = connection->_try_send(more);
-  if (rc < 0) {
-    ldout(cct, 1) << __func__ << " error sending " << m << ", "
-                  << cpp_strerror(rc) << dendl;
+  ++batch_msgs;
+  ssize_t rc = 0;
+  if (more &&
+      batch_msgs < cct->_conf->ms_async_send_batch_msgs &&
+      connection->outcoming_bl.length() <
+        cct->_conf->ms_async_send_batch_bytes) {
+    // more messages are queued right behind this one; hand them to the
+    // socket together rather than paying a syscall per message.
+    ldout(cct, 20) << __func__ << " batching " << m << " (" << batch_msgs
+                   << " msgs, " << connection->outcoming_bl.length()
+                   << " bytes)" << dendl;
   } else {
-    connection->logger->inc(
-        l_msgr_send_bytes, total_send_size - connection->outcoming_bl.length());
-    ldout(cct, 10) << __func__ << " sending " << m
-                   << (rc ? " continuely." : " done.") << dendl;
+    rc = send_batch(more);
+    if (rc < 0) {
+      ldout(cct, 1) << __func__ << " error sending " << m << ", "
+                    << cpp_strerror(rc) << dendl;
+    } else {
+      ldout(cct, 10) << __func__ << " sending " << m
+                     << (rc ? " continuely." : " done.") << dendl;
+    }
   }
   if (m->get_type() == CEPH_MSG_OSD_OP)
     OID_EVENT_TRACE_WITH_MSG(m, "SEND_MSG_OSD_OP_END", false);
@@ -1578,6 +1605,7 @@ CtPtr ProtocolV1::handle_connect_reply_2() {
 
     // see session_reset
     connection->outcoming_bl.clear();
+    batch_msgs = 0;
 
     return CONTINUE(send_connect_message);
   }
@@ -2226,6 +2254,7 @@ CtPtr ProtocolV1::replace(AsyncConnectionRef existing,
             existing->write_lock.lock();
             exproto->requeue_sent();
             existing->outcoming_bl.clear();
+            exproto->batch_msgs = 0;
             existing->open_write = false;
             existing->write_lock.unlock();
             if (exproto->state == NONE) {
@@ -199,6 +199,7 @@ protected:
   // priority queue for outbound msgs
   std::map<int, std::list<std::pair<bufferlist, Message *>>> out_q;
   bool keepalive;
+  unsigned batch_msgs = 0;  // messages in outcoming_bl not yet handed to the socket
 
   __u32 connect_seq, peer_global_seq;
   std::atomic<uint64_t> in_seq{0};
@@ -289,6 +290,7 @@ protected:
 
   void prepare_send_message(uint64_t features, Message *m, bufferlist &bl);
   ssize_t write_message(Message *m, bufferlist &bl, bool more);
+  ssize_t send_batch(bool more = false);
 
   void requeue_sent();
   uint64_t discard_requeued_up_to(uint64_t out_seq, uint64_t seq);
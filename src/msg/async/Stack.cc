@@ -26,6 +26,9 @@
 #ifdef HAVE_DPDK
 #include "dpdk/DPDKStack.h"
 #endif
+#ifdef HAVE_LIBURING
+#include "UringStack.h"
+#endif
 
 #include "common/dout.h"
 #include "include/ceph_assert.h"
@@ -75,6 +78,10 @@ std::shared_ptr<NetworkStack> NetworkStack::create(CephContext *c, const string
   else if (t == "dpdk")
     return std::make_shared<DPDKStack>(c, t);
 #endif
+#ifdef HAVE_LIBURING
+  else if (t == "uring")
+    return std::make_shared<UringNetworkStack>(c, t);
+#endif
 
   lderr(c) << __func__ << " ms_async_transport_type " << t <<
     " is not supported! " << dendl;
@@ -94,6 +101,10 @@ Worker* NetworkStack::create_worker(CephContext *c, const string &type, unsigned
   else if (type == "dpdk")
     return new DPDKWorker(c, i);
 #endif
+#ifdef HAVE_LIBURING
+  else if (type == "uring")
+    return new UringWorker(c, i);
+#endif
 
   lderr(c) << __func__ << " ms_async_transport_type " << type <<
     " is not supported! " << dendl;
@@ -143,20 +154,60 @@ void NetworkStack::start()
     workers[i]->wait_for_init();
 }
 
+void NetworkStack::_update_worker_load()
+{
+  auto now = ceph::mono_clock::now();
+  for (unsigned i = 0; i < num_workers; ++i) {
+    Worker *w = workers[i];
+    double elapsed = std::chrono::duration<double>(now - w->load_stamp).count();
+    if (elapsed < 1.0) {
+      continue;
+    }
+    uint64_t traffic = w->get_traffic();
+    if (w->load_stamp != ceph::mono_time()) {
+      double rate = (traffic - w->load_traffic) / elapsed;
+      w->load = (w->load + rate) / 2;
+    }
+    w->load_stamp = now;
+    w->load_traffic = traffic;
+  }
+}
+
 Worker* NetworkStack::get_worker()
 {
   ldout(cct, 30) << __func__ << dendl;
 
    // start with some reasonably large number
-  unsigned min_load = std::numeric_limits<int>::max();
+  double min_load = std::numeric_limits<double>::max();
   Worker* current_best = nullptr;
+  const bool by_traffic = cct->_conf->ms_async_worker_placement == "load";
 
   pool_spin.lock();
-  // find worker with least references
+  // estimate what one more connection costs from the average so far, so
+  // that a burst of new connections still spreads out before their
+  // traffic shows up in the samples.
+  double per_conn = 0;
+  if (by_traffic) {
+    _update_worker_load();
+    double total_load = 0;
+    unsigned total_refs = 0;
+    for (unsigned i = 0; i < num_workers; ++i) {
+      total_load += workers[i]->load;
+      total_refs += workers[i]->references.load();
+    }
+    if (total_refs) {
+      per_conn = total_load / total_refs;
+    }
+  }
+  // find worker with least references (or load)
   // tempting case is returning on references == 0, but in reality
   // this will happen so rarely that there's no need for special case.
   for (unsigned i = 0; i < num_workers; ++i) {
-    unsigned worker_load = workers[i]->references.load();
+    unsigned refs = workers[i]->references.load();
+    double worker_load = refs;
+    if (by_traffic && per_conn > 0) {
+      worker_load = workers[i]->load + refs * per_conn;
+    }
     if (worker_load < min_load) {
       current_best = workers[i];
       min_load = worker_load;
@@ -165,6 +216,8 @@ Worker* NetworkStack::get_worker()
 
   pool_spin.unlock();
   ceph_assert(current_best);
+  ldout(cct, 20) << __func__ << " picked worker " << current_best->id
+                 << " load " << min_load << dendl;
   ++current_best->references;
   return current_best;
 }
@@ -200,6 +200,9 @@ enum {
   l_msgr_running_recv_time,
   l_msgr_running_fast_dispatch_time,
 
+  l_msgr_send_batches,
+  l_msgr_send_batch_histogram,
+
   l_msgr_last,
 };
 
@@ -218,6 +221,20 @@ class Worker {
   std::atomic_uint references;
   EventCenter center;
 
+  // recent traffic, sampled by NetworkStack::get_worker() under pool_spin
+  ceph::mono_time load_stamp;
+  uint64_t load_traffic = 0;
+  double load = 0;  ///< bytes/sec
+
+  /// bytes handled so far; small messages count as a nominal 4K each, since
+  /// their cost is mostly per message rather than per byte.
+  uint64_t get_traffic() const {
+    return perf_logger->get(l_msgr_send_bytes) +
+      perf_logger->get(l_msgr_recv_bytes) +
+      (perf_logger->get(l_msgr_send_messages) +
+       perf_logger->get(l_msgr_recv_messages)) * 4096;
+  }
+
   Worker(const Worker&) = delete;
   Worker& operator=(const Worker&) = delete;
 
@@ -240,6 +257,21 @@ class Worker {
     plb.add_time(l_msgr_running_recv_time, "msgr_running_recv_time", "The total time of message receiving");
     plb.add_time(l_msgr_running_fast_dispatch_time, "msgr_running_fast_dispatch_time", "The total time of fast dispatch");
 
+    PerfHistogramCommon::axis_config_d batch_msgs_axis{
+      "Messages",
+      PerfHistogramCommon::SCALE_LOG2,
+      0, 1, 12,
+    };
+    PerfHistogramCommon::axis_config_d batch_bytes_axis{
+      "Batch size (bytes)",
+      PerfHistogramCommon::SCALE_LOG2,
+      0, 512, 24,
+    };
+    plb.add_u64_counter(l_msgr_send_batches, "msgr_send_batches", "Batches of messages handed to the socket");
+    plb.add_u64_counter_histogram(l_msgr_send_batch_histogram, "msgr_send_batch_histogram",
+                                  batch_msgs_axis, batch_bytes_axis,
+                                  "Histogram of messages and bytes per socket write");
+
     perf_logger = plb.create_perf_counters();
     cct->get_perfcounters_collection()->add(perf_logger);
   }
@@ -293,6 +325,7 @@ class NetworkStack {
   bool started = false;
 
   std::function<void ()> add_thread(unsigned i);
+  void _update_worker_load();
 
  protected:
   CephContext *cct;
@@ -0,0 +1,790 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <errno.h>
+
+#include <algorithm>
+
+#include "UringStack.h"
+
+#include "include/buffer.h"
+#include "common/errno.h"
+#include "common/dout.h"
+#include "include/compat.h"
+#include "include/sock_compat.h"
+
+#define dout_subsys ceph_subsys_ms
+#undef dout_prefix
+#define dout_prefix *_dout << "UringStack "
+
+// ring operations, kept in the low bits of the handle pointer in user_data
+enum {
+  OP_RECV = 1,
+  OP_SEND,
+  OP_POLL,
+  OP_ACCEPT,
+};
+static const uintptr_t OP_MASK = 7;
+
+static void notify_eventfd(int fd)
+{
+  // note: write argument of an eventfd must be a 64bit integer
+  uint64_t i = 1;
+  ceph_assert(sizeof(i) == ::write(fd, &i, sizeof(i)));
+}
+
+static void drain_eventfd(int fd)
+{
+  uint64_t i;
+  int r = ::read(fd, &i, sizeof(i));
+  (void)r;  // -EAGAIN if nothing was signalled
+}
+
+class UringSocket : public UringHandle {
+  // stop receiving while this many completed receives are unread, so that
+  // a connection that isn't reading cannot take all of the worker's buffers
+  static const unsigned MAX_RX_CHUNKS = 4;
+  // stop taking data to send while this much is queued, so that a slow
+  // peer cannot make the queue grow without bound
+  static const unsigned MAX_TX_BYTES = 4 << 20;
+
+  struct rx_chunk {
+    unsigned bid;
+    unsigned off;
+    unsigned len;
+  };
+
+  UringWorker *worker;
+  std::deque<rx_chunk> rx;
+  bool recv_armed = false;
+  bool rx_eof = false;
+  int rx_error = 0;
+
+  bufferlist tx_pending;   ///< queued while a sendmsg is in flight
+  bufferlist tx_inflight;
+  std::vector<iovec> tx_iov;
+  struct msghdr tx_msg;
+  bool tx_armed = false;
+  bool tx_full = false;    ///< a send was cut short; notify once there is room
+  int tx_error = 0;
+
+  bool poll_armed = false;
+
+  void release_rx() {
+    for (auto& c : rx) {
+      worker->put_buffer(c.bid);
+    }
+    rx.clear();
+  }
+  void send_pending();
+
+ public:
+  const int sd;
+  const int notify_fd;
+  bool closed = false;
+  bool waiting_buffer = false;
+
+  UringSocket(CephContext *c, UringWorker *w, int sd)
+    : UringHandle(c), worker(w), sd(sd),
+      notify_fd(eventfd(0, EFD_CLOEXEC|EFD_NONBLOCK)) {}
+  ~UringSocket() override {
+    ::close(sd);
+    ::close(notify_fd);
+  }
+
+  void notify() {
+    notify_eventfd(notify_fd);
+  }
+  void shutdown() {
+    ::shutdown(sd, SHUT_RDWR);
+    if (!tx_error)
+      tx_error = -EPIPE;
+  }
+  void arm_recv();
+  void arm_connect_poll();
+  ssize_t read(char *buf, size_t len);
+  ssize_t send(bufferlist &bl);
+  void close();
+  void complete(unsigned op, int res, unsigned flags) override;
+};
+
+void UringSocket::arm_recv()
+{
+  if (recv_armed || waiting_buffer || closed || rx_eof || rx_error ||
+      rx.size() >= MAX_RX_CHUNKS)
+    return;
+  io_uring_sqe *sqe = worker->get_sqe();
+  io_uring_prep_recv(sqe, sd, nullptr, worker->get_buffer_size(), 0);
+  sqe->flags |= IOSQE_BUFFER_SELECT;
+  sqe->buf_group = UringWorker::BUF_GROUP;
+  worker->set_op(sqe, this, OP_RECV);
+  recv_armed = true;
+  worker->queue_submit();
+}
+
+void UringSocket::arm_connect_poll()
+{
+  if (poll_armed || closed)
+    return;
+  io_uring_sqe *sqe = worker->get_sqe();
+  io_uring_prep_poll_add(sqe, sd, POLLOUT);
+  worker->set_op(sqe, this, OP_POLL);
+  poll_armed = true;
+  worker->queue_submit();
+}
+
+ssize_t UringSocket::read(char *buf, size_t len)
+{
+  drain_eventfd(notify_fd);
+
+  ssize_t got = 0;
+  while (len > 0 && !rx.empty()) {
+    rx_chunk& c = rx.front();
+    size_t n = std::min<size_t>(len, c.len);
+    memcpy(buf, worker->get_buffer(c.bid) + c.off, n);
+    buf += n;
+    len -= n;
+    got += n;
+    c.off += n;
+    c.len -= n;
+    if (!c.len) {
+      worker->put_buffer(c.bid);
+      rx.pop_front();
+    }
+  }
+  arm_recv();
+
+  // level-triggered: keep the eventfd readable while there is more to say
+  if (!rx.empty() || rx_eof || rx_error || tx_error)
+    notify();
+
+  if (got)
+    return got;
+  if (rx_error)
+    return rx_error;
+  if (rx_eof)
+    return 0;
+  if (tx_error)
+    return tx_error;
+  return -EAGAIN;
+}
+
+ssize_t UringSocket::send(bufferlist &bl)
+{
+  if (tx_error)
+    return tx_error;
+
+  // like a socket with a full send buffer: take what fits, leave the rest
+  // in bl and signal the eventfd once the queue has drained
+  uint64_t queued = tx_pending.length() + tx_inflight.length();
+  if (queued >= MAX_TX_BYTES) {
+    tx_full = true;
+    return 0;
+  }
+  ssize_t len = bl.length();
+  if (queued + len > MAX_TX_BYTES) {
+    len = MAX_TX_BYTES - queued;
+    bufferlist head;
+    bl.splice(0, len, &head);
+    tx_pending.claim_append(head);
+    tx_full = true;
+  } else {
+    tx_pending.claim_append(bl);
+  }
+  send_pending();
+  return len;
+}
+
+void UringSocket::send_pending()
+{
+  if (tx_armed || tx_error || closed)
+    return;
+  if (!tx_inflight.length()) {
+    if (!tx_pending.length())
+      return;
+    tx_inflight.swap(tx_pending);
+  }
+
+  tx_iov.clear();
+  for (auto& p : tx_inflight.buffers()) {
+    if (tx_iov.size() == IOV_MAX)
+      break;
+    if (p.length())
+      tx_iov.push_back(iovec{(void*)p.c_str(), p.length()});
+  }
+  memset(&tx_msg, 0, sizeof(tx_msg));
+  tx_msg.msg_iov = tx_iov.data();
+  tx_msg.msg_iovlen = tx_iov.size();
+
+  io_uring_sqe *sqe = worker->get_sqe();
+  io_uring_prep_sendmsg(sqe, sd, &tx_msg, MSG_NOSIGNAL);
+  worker->set_op(sqe, this, OP_SEND);
+  tx_armed = true;
+  worker->queue_submit();
+}
+
+void UringSocket::close()
+{
+  // wakes up whatever is in flight; the last completion drops the last
+  // ref and closes the socket
+  closed = true;
+  ::shutdown(sd, SHUT_RDWR);
+  if (worker->center.in_thread()) {
+    release_rx();
+  } else {
+    boost::intrusive_ptr<UringSocket> s(this);
+    worker->center.submit_to(worker->center.get_id(), [s]() {
+	s->release_rx();
+      }, true);
+  }
+}
+
+void UringSocket::complete(unsigned op, int res, unsigned flags)
+{
+  switch (op) {
+  case OP_RECV:
+    recv_armed = false;
+    if (res == -ENOBUFS) {
+      if (!closed)
+	worker->wait_buffer(this);
+      return;
+    }
+    if (flags & IORING_CQE_F_BUFFER) {
+      unsigned bid = flags >> IORING_CQE_BUFFER_SHIFT;
+      if (res > 0 && !closed)
+	rx.push_back(rx_chunk{bid, 0, (unsigned)res});
+      else
+	worker->put_buffer(bid);
+    }
+    if (res == 0)
+      rx_eof = true;
+    else if (res < 0 && res != -EINTR && res != -EAGAIN)
+      rx_error = res;
+    arm_recv();
+    notify();
+    break;
+
+  case OP_SEND:
+    tx_armed = false;
+    if (res >= 0) {
+      tx_inflight.splice(0, res);
+    } else if (res != -EINTR && res != -EAGAIN) {
+      ldout(worker->cct, 10) << __func__ << " sd=" << sd << " send failed: "
+		     << cpp_strerror(res) << dendl;
+      tx_error = res;
+      tx_inflight.clear();
+      tx_pending.clear();
+      notify();
+      break;
+    }
+    send_pending();
+    if (tx_full &&
+	tx_pending.length() + tx_inflight.length() < MAX_TX_BYTES / 2) {
+      // the edge on the eventfd fires the connection's writable event
+      tx_full = false;
+      notify();
+    }
+    break;
+
+  case OP_POLL:
+    poll_armed = false;
+    notify();
+    break;
+
+  default:
+    ceph_abort_msg("unexpected socket op");
+  }
+}
+
+class UringConnectedSocketImpl final : public ConnectedSocketImpl {
+  NetHandler &handler;
+  boost::intrusive_ptr<UringSocket> s;
+  entity_addr_t sa;
+  bool connected;
+
+ public:
+  UringConnectedSocketImpl(NetHandler &h, const entity_addr_t &sa,
+			   UringSocket *s, bool connected)
+    : handler(h), s(s), sa(sa), connected(connected) {}
+
+  int is_connected() override {
+    if (connected)
+      return 1;
+
+    drain_eventfd(s->notify_fd);
+    int r = handler.reconnect(sa, s->sd);
+    if (r == 0) {
+      connected = true;
+      return 1;
+    } else if (r < 0) {
+      return r;
+    } else {
+      s->arm_connect_poll();
+      return 0;
+    }
+  }
+
+  ssize_t zero_copy_read(bufferptr&) override {
+    return -EOPNOTSUPP;
+  }
+
+  ssize_t read(char *buf, size_t len) override {
+    return s->read(buf, len);
+  }
+
+  ssize_t send(bufferlist &bl, bool more) override {
+    return s->send(bl);
+  }
+
+  void shutdown() override {
+    s->shutdown();
+  }
+
+  void close() override {
+    if (!s->closed)
+      s->close();
+  }
+
+  int fd() const override {
+    return s->notify_fd;
+  }
+};
+
+class UringListener : public UringHandle {
+  UringWorker *worker;
+  bool armed = false;
+  std::deque<int> accepted;
+  int error = 0;
+
+ public:
+  const int sd;
+  const int notify_fd;
+  bool aborted = false;
+
+  UringListener(CephContext *c, UringWorker *w, int sd)
+    : UringHandle(c), worker(w), sd(sd),
+      notify_fd(eventfd(0, EFD_CLOEXEC|EFD_NONBLOCK)) {}
+  ~UringListener() override {
+    for (int fd : accepted)
+      ::close(fd);
+    ::close(sd);
+    ::close(notify_fd);
+  }
+
+  void arm() {
+    if (armed || aborted)
+      return;
+    io_uring_sqe *sqe = worker->get_sqe();
+    io_uring_prep_multishot_accept(sqe, sd, nullptr, nullptr, SOCK_CLOEXEC);
+    worker->set_op(sqe, this, OP_ACCEPT);
+    armed = true;
+    worker->queue_submit();
+  }
+
+  /// pop an accepted fd, or return -errno
+  int pop() {
+    drain_eventfd(notify_fd);
+    if (!accepted.empty()) {
+      int fd = accepted.front();
+      accepted.pop_front();
+      if (!accepted.empty())
+	notify_eventfd(notify_fd);
+      return fd;
+    }
+    if (error) {
+      // the accept stopped; report it once and start over
+      int r = error;
+      error = 0;
+      return r;
+    }
+    arm();
+    return -EAGAIN;
+  }
+
+  void complete(unsigned op, int res, unsigned flags) override {
+    ceph_assert(op == OP_ACCEPT);
+    if (res >= 0) {
+      if (aborted)
+	::close(res);
+      else
+	accepted.push_back(res);
+    } else if (!aborted) {
+      error = res;
+    }
+    if (!(flags & IORING_CQE_F_MORE)) {
+      armed = false;
+      if (!error)
+	arm();
+    }
+    notify_eventfd(notify_fd);
+  }
+};
+
+class UringServerSocketImpl : public ServerSocketImpl {
+  NetHandler &handler;
+  boost::intrusive_ptr<UringListener> l;
+
+ public:
+  UringServerSocketImpl(NetHandler &h, UringListener *l, int type)
+    : ServerSocketImpl(type), handler(h), l(l) {}
+  int accept(ConnectedSocket *sock, const SocketOptions &opt,
+	     entity_addr_t *out, Worker *w) override;
+  void abort_accept() override {
+    // fails the outstanding accept; the listener goes with its last ref
+    l->aborted = true;
+    ::shutdown(l->sd, SHUT_RDWR);
+  }
+  int fd() const override {
+    return l->notify_fd;
+  }
+};
+
+int UringServerSocketImpl::accept(ConnectedSocket *sock, const SocketOptions &opt,
+				  entity_addr_t *out, Worker *w)
+{
+  ceph_assert(sock);
+  int sd = l->pop();
+  if (sd < 0)
+    return sd;
+
+  sockaddr_storage ss;
+  socklen_t slen = sizeof(ss);
+  if (::getpeername(sd, (sockaddr*)&ss, &slen) < 0) {
+    int r = -errno;
+    ::close(sd);
+    return r;
+  }
+
+  int r = handler.set_nonblock(sd);
+  if (r < 0) {
+    ::close(sd);
+    return -errno;
+  }
+
+  r = handler.set_socket_options(sd, opt.nodelay, opt.rcbuf_size);
+  if (r < 0) {
+    ::close(sd);
+    return -errno;
+  }
+
+  ceph_assert(NULL != out); //out should not be NULL in accept connection
+
+  out->set_type(addr_type);
+  out->set_sockaddr((sockaddr*)&ss);
+  handler.set_priority(sd, opt.priority, out->get_family());
+
+  // the socket belongs to the worker that will run the connection
+  UringWorker *uw = static_cast<UringWorker*>(w);
+  *sock = ConnectedSocket(std::make_unique<UringConnectedSocketImpl>(
+      handler, *out, new UringSocket(uw->cct, uw, sd), true));
+  return 0;
+}
+
+class C_handle_completions : public EventCallback {
+  UringWorker *worker;
+
+ public:
+  explicit C_handle_completions(UringWorker *w) : worker(w) {}
+  void do_request(uint64_t fd) override {
+    worker->handle_completions();
+  }
+};
+
+class C_handle_submit : public EventCallback {
+  UringWorker *worker;
+
+ public:
+  explicit C_handle_submit(UringWorker *w) : worker(w) {}
+  void do_request(uint64_t fd) override {
+    worker->submit();
+  }
+};
+
+UringWorker::UringWorker(CephContext *c, unsigned i)
+  : Worker(c, i), net(c),
+    completion_handler(new C_handle_completions(this)),
+    submit_handler(new C_handle_submit(this))
+{
+}
+
+UringWorker::~UringWorker()
+{
+  delete completion_handler;
+  delete submit_handler;
+}
+
+void UringWorker::initialize()
+{
+  int r = io_uring_queue_init(cct->_conf->ms_async_uring_queue_depth, &ring, 0);
+  if (r < 0) {
+    lderr(cct) << __func__ << " io_uring_queue_init failed: "
+	       << cpp_strerror(r) << dendl;
+    ceph_abort();
+  }
+  ring_ready = true;
+
+  ring_efd = eventfd(0, EFD_CLOEXEC|EFD_NONBLOCK);
+  ceph_assert(ring_efd >= 0);
+  r = io_uring_register_eventfd(&ring, ring_efd);
+  if (r < 0) {
+    lderr(cct) << __func__ << " io_uring_register_eventfd failed: "
+	       << cpp_strerror(r) << dendl;
+    ceph_abort();
+  }
+  center.create_file_event(ring_efd, EVENT_READABLE, completion_handler);
+
+  buf_size = cct->_conf->ms_async_uring_recv_buffer_size;
+  buf_count = cct->_conf->ms_async_uring_recv_buffers;
+  r = ::posix_memalign((void**)&bufs, CEPH_PAGE_SIZE, (size_t)buf_size * buf_count);
+  ceph_assert(r == 0);
+  io_uring_sqe *sqe = get_sqe();
+  io_uring_prep_provide_buffers(sqe, bufs, buf_size, buf_count, BUF_GROUP, 0);
+  io_uring_sqe_set_data(sqe, nullptr);
+  submit();
+  ldout(cct, 10) << __func__ << " ring ready with " << buf_count << " x "
+		 << buf_size << " byte receive buffers" << dendl;
+}
+
+void UringWorker::destroy()
+{
+  if (!ring_ready)
+    return;
+  center.delete_file_event(ring_efd, EVENT_READABLE);
+  cancel_inflight();
+  io_uring_queue_exit(&ring);
+  ring_ready = false;
+  ::close(ring_efd);
+  ring_efd = -1;
+  for (auto s : buf_waiters)
+    s->put();
+  buf_waiters.clear();
+  ::free(bufs);
+  bufs = nullptr;
+}
+
+void UringWorker::cancel_inflight()
+{
+  if (!inflight_ops)
+    return;
+
+  ldout(cct, 10) << __func__ << " cancelling " << inflight_ops
+		 << " operations" << dendl;
+  io_uring_sqe *sqe = get_sqe();
+  io_uring_prep_cancel(sqe, nullptr,
+		       IORING_ASYNC_CANCEL_ALL | IORING_ASYNC_CANCEL_ANY);
+  io_uring_sqe_set_data(sqe, nullptr);
+  submit();
+
+  // reap the completions without handling them, so that nothing is armed
+  // again, and drop the refs the operations hold
+  while (inflight_ops) {
+    io_uring_cqe *cqe;
+    __kernel_timespec ts = {1, 0};
+    int r = io_uring_wait_cqe_timeout(&ring, &cqe, &ts);
+    if (r == -EINTR)
+      continue;
+    if (r < 0) {
+      lderr(cct) << __func__ << " " << inflight_ops
+		 << " operations did not complete: " << cpp_strerror(r)
+		 << dendl;
+      break;
+    }
+    uintptr_t data = (uintptr_t)io_uring_cqe_get_data(cqe);
+    int res = cqe->res;
+    unsigned flags = cqe->flags;
+    io_uring_cqe_seen(&ring, cqe);
+    if (!data)
+      continue;
+    if ((data & OP_MASK) == OP_ACCEPT && res >= 0)
+      ::close(res);
+    if (!(flags & IORING_CQE_F_MORE)) {
+      --inflight_ops;
+      ((UringHandle*)(data & ~OP_MASK))->put();
+    }
+  }
+}
+
+io_uring_sqe *UringWorker::get_sqe()
+{
+  ceph_assert(center.in_thread());
+  io_uring_sqe *sqe = io_uring_get_sqe(&ring);
+  if (!sqe) {
+    // submission queue is full, make room
+    submit();
+    sqe = io_uring_get_sqe(&ring);
+    ceph_assert(sqe);
+  }
+  return sqe;
+}
+
+void UringWorker::set_op(io_uring_sqe *sqe, UringHandle *h, unsigned op)
+{
+  ceph_assert(((uintptr_t)h & OP_MASK) == 0);
+  h->get();
+  ++inflight_ops;
+  io_uring_sqe_set_data(sqe, (void*)((uintptr_t)h | op));
+}
+
+void UringWorker::queue_submit()
+{
+  if (submit_queued)
+    return;
+  submit_queued = true;
+  center.dispatch_event_external(submit_handler);
+}
+
+void UringWorker::submit()
+{
+  submit_queued = false;
+  int r = io_uring_submit(&ring);
+  if (r < 0) {
+    // e.g. -EBUSY while the completion queue overflows; try again once
+    // the completions have been reaped
+    ldout(cct, 1) << __func__ << " io_uring_submit failed: "
+		  << cpp_strerror(r) << dendl;
+    queue_submit();
+  }
+}
+
+void UringWorker::handle_completions()
+{
+  drain_eventfd(ring_efd);
+
+  unsigned n;
+  do {
+    unsigned head;
+    io_uring_cqe *cqe;
+    n = 0;
+    io_uring_for_each_cqe(&ring, head, cqe) {
+      ++n;
+      uintptr_t data = (uintptr_t)io_uring_cqe_get_data(cqe);
+      if (!data) {
+	// buffers given back to the kernel
+	if (cqe->res < 0)
+	  lderr(cct) << __func__ << " providing receive buffers failed: "
+		     << cpp_strerror(cqe->res) << dendl;
+	continue;
+      }
+      // a multishot operation holds its ref until its last completion
+      UringHandle *h = (UringHandle*)(data & ~OP_MASK);
+      bool more = cqe->flags & IORING_CQE_F_MORE;
+      h->complete(data & OP_MASK, cqe->res, cqe->flags);
+      if (!more) {
+	--inflight_ops;
+	h->put();
+      }
+    }
+    io_uring_cq_advance(&ring, n);
+  } while (n);
+
+  submit();
+}
+
+void UringWorker::put_buffer(unsigned bid)
+{
+  io_uring_sqe *sqe = get_sqe();
+  io_uring_prep_provide_buffers(sqe, get_buffer(bid), buf_size, 1, BUF_GROUP, bid);
+  io_uring_sqe_set_data(sqe, nullptr);
+  queue_submit();
+
+  // restart a receive that ran out
+  while (!buf_waiters.empty()) {
+    UringSocket *s = buf_waiters.front();
+    buf_waiters.pop_front();
+    s->waiting_buffer = false;
+    bool live = !s->closed;
+    if (live)
+      s->arm_recv();
+    s->put();
+    if (live)
+      break;
+  }
+}
+
+void UringWorker::wait_buffer(UringSocket *s)
+{
+  s->waiting_buffer = true;
+  s->get();
+  buf_waiters.push_back(s);
+}
+
+int UringWorker::listen(entity_addr_t &sa, const SocketOptions &opt,
+			ServerSocket *sock)
+{
+  int listen_sd = net.create_socket(sa.get_family(), true);
+  if (listen_sd < 0) {
+    return -errno;
+  }
+
+  int r = net.set_nonblock(listen_sd);
+  if (r < 0) {
+    ::close(listen_sd);
+    return -errno;
+  }
+
+  r = net.set_socket_options(listen_sd, opt.nodelay, opt.rcbuf_size);
+  if (r < 0) {
+    ::close(listen_sd);
+    return -errno;
+  }
+
+  r = ::bind(listen_sd, sa.get_sockaddr(), sa.get_sockaddr_len());
+  if (r < 0) {
+    r = -errno;
+    ldout(cct, 10) << __func__ << " unable to bind to " << sa.get_sockaddr()
+		   << ": " << cpp_strerror(r) << dendl;
+    ::close(listen_sd);
+    return r;
+  }
+
+  r = ::listen(listen_sd, cct->_conf->ms_tcp_listen_backlog);
+  if (r < 0) {
+    r = -errno;
+    lderr(cct) << __func__ << " unable to listen on " << sa << ": " << cpp_strerror(r) << dendl;
+    ::close(listen_sd);
+    return r;
+  }
+
+  UringListener *l = new UringListener(cct, this, listen_sd);
+  *sock = ServerSocket(
+    std::make_unique<UringServerSocketImpl>(net, l, sa.get_type()));
+  l->arm();
+  return 0;
+}
+
+int UringWorker::connect(const entity_addr_t &addr, const SocketOptions &opts,
+			 ConnectedSocket *socket)
+{
+  int sd;
+
+  if (opts.nonblock) {
+    sd = net.nonblock_connect(addr, opts.connect_bind_addr);
+  } else {
+    sd = net.connect(addr, opts.connect_bind_addr);
+  }
+
+  if (sd < 0) {
+    return -errno;
+  }
+
+  net.set_priority(sd, opts.priority, addr.get_family());
+  UringSocket *s = new UringSocket(cct, this, sd);
+  *socket = ConnectedSocket(std::make_unique<UringConnectedSocketImpl>(
+      net, addr, s, !opts.nonblock));
+  if (opts.nonblock)
+    s->arm_connect_poll();
+  return 0;
+}
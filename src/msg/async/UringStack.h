@@ -0,0 +1,110 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_MSG_ASYNC_URINGSTACK_H
+#define CEPH_MSG_ASYNC_URINGSTACK_H
+
+#include <deque>
+
+#include <liburing.h>
+
+#include "common/RefCountedObj.h"
+#include "msg/async/net_handler.h"
+
+#include "PosixStack.h"
+
+/*
+ * A socket stack driven by io_uring instead of readiness polling.
+ *
+ * Each worker owns a ring whose completions are signalled through an
+ * eventfd watched by the worker's EventCenter, so the rest of the
+ * messenger keeps its event model: every socket exposes an eventfd as
+ * fd() and signals it when there is something to read, a connect has
+ * progressed or a connection is waiting to be accepted.  Receives use a
+ * pool of buffers provided to the kernel per worker, listeners use a
+ * multishot accept, and sends queued while one is in flight go out
+ * together in the next sendmsg.  Submissions made while handling one
+ * round of events are flushed to the kernel with a single
+ * io_uring_submit().
+ *
+ * Ring operations are only ever issued from the owning worker's thread.
+ */
+
+class UringSocket;
+
+/// an object with ring operations in flight; each operation holds a ref
+class UringHandle : public RefCountedObject {
+ public:
+  explicit UringHandle(CephContext *c) : RefCountedObject(c, 0) {}
+  virtual void complete(unsigned op, int res, unsigned flags) = 0;
+};
+
+class UringWorker : public Worker {
+  NetHandler net;
+  struct io_uring ring;
+  bool ring_ready = false;
+  int ring_efd = -1;
+  EventCallbackRef completion_handler;
+  EventCallbackRef submit_handler;
+  bool submit_queued = false;
+  uint64_t inflight_ops = 0;   ///< each holds a ref on its handle
+
+  // receive buffers provided to the kernel
+  char *bufs = nullptr;
+  unsigned buf_size = 0;
+  unsigned buf_count = 0;
+  std::deque<UringSocket*> buf_waiters;  ///< ran out of buffers; hold a ref
+
+  void initialize() override;
+  void destroy() override;
+  void cancel_inflight();
+
+ public:
+  static const int BUF_GROUP = 0;
+
+  UringWorker(CephContext *c, unsigned i);
+  ~UringWorker() override;
+
+  int listen(entity_addr_t &sa, const SocketOptions &opt,
+	     ServerSocket *socks) override;
+  int connect(const entity_addr_t &addr, const SocketOptions &opts,
+	      ConnectedSocket *socket) override;
+
+  io_uring_sqe *get_sqe();
+  void set_op(io_uring_sqe *sqe, UringHandle *h, unsigned op);
+  /// submit everything queued once the current round of events is handled
+  void queue_submit();
+  void submit();
+  void handle_completions();
+
+  char *get_buffer(unsigned bid) {
+    return bufs + (size_t)bid * buf_size;
+  }
+  unsigned get_buffer_size() const {
+    return buf_size;
+  }
+  void put_buffer(unsigned bid);
+  void wait_buffer(UringSocket *s);
+};
+
+class UringNetworkStack : public PosixNetworkStack {
+ public:
+  explicit UringNetworkStack(CephContext *c, const string &t)
+    : PosixNetworkStack(c, t) {}
+
+  // connect progress is signalled through the socket's eventfd
+  bool nonblock_connect_need_writable_event() const override {
+    return false;
+  }
+};
+
+#endif //CEPH_MSG_ASYNC_URINGSTACK_H
@@ -2455,33 +2455,40 @@ int ECBackend::be_deep_scrub(
   if (stride % sinfo.get_chunk_size())
     stride += sinfo.get_chunk_size() - (stride % sinfo.get_chunk_size());
 
-  bufferlist bl;
-  r = store->read(
-    ch,
-    ghobject_t(
-      poid, ghobject_t::NO_GEN, get_parent()->whoami_shard().shard),
-    pos.data_pos,
-    stride, bl,
-    fadvise_flags);
-  if (r < 0) {
-    dout(20) << __func__ << "  " << poid << " got "
-	     << r << " on read, read_error" << dendl;
-    o.read_error = true;
-    return 0;
-  }
-  if (bl.length() % sinfo.get_chunk_size()) {
-    dout(20) << __func__ << "  " << poid << " got "
-	     << r << " on read, not chunk size " << sinfo.get_chunk_size() << " aligned"
-	     << dendl;
-    o.read_error = true;
-    return 0;
-  }
-  if (r > 0) {
-    pos.data_hash << bl;
-  }
-  pos.data_pos += r;
-  if (r == (int)stride) {
-    return -EINPROGRESS;
+  const uint64_t max_bytes = cct->_conf->osd_deep_scrub_work_item_bytes;
+  while (true) {
+    bufferlist bl;
+    r = store->read(
+      ch,
+      ghobject_t(
+	poid, ghobject_t::NO_GEN, get_parent()->whoami_shard().shard),
+      pos.data_pos,
+      stride, bl,
+      fadvise_flags);
+    if (r < 0) {
+      dout(20) << __func__ << "  " << poid << " got "
+	       << r << " on read, read_error" << dendl;
+      o.read_error = true;
+      return 0;
+    }
+    if (bl.length() % sinfo.get_chunk_size()) {
+      dout(20) << __func__ << "  " << poid << " got "
+	       << r << " on read, not chunk size " << sinfo.get_chunk_size() << " aligned"
+	       << dendl;
+      o.read_error = true;
+      return 0;
+    }
+    if (r > 0) {
+      pos.data_hash << bl;
+    }
+    pos.data_pos += r;
+    pos.bytes_read += r;
+    if (r != (int)stride) {
+      break;
+    }
+    if (pos.work_item_done(max_bytes)) {
+      return -EINPROGRESS;
+    }
   }
 
   ECUtil::HashInfoRef hinfo = get_hash_info(poid, false, &o.attrs);
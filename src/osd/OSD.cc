@@ -249,6 +249,7 @@ OSDService::OSDService(OSD *osd) :
   recovery_request_timer(cct, recovery_request_lock, false),
   sleep_lock("OSDService::sleep_lock"),
   sleep_timer(cct, sleep_lock, false),
+  scrub_budget_lock("OSDService::scrub_budget_lock"),
   reserver_finisher(cct),
   local_reserver(cct, &reserver_finisher, cct->_conf->osd_max_backfills,
 		 cct->_conf->osd_min_recovery_priority),
@@ -1651,6 +1652,13 @@ void OSDService::queue_for_snap_trim(PG *pg)
       pg->get_osdmap_epoch()));
 }
 
+double OSDService::charge_deep_scrub_reads(uint64_t bytes)
+{
+  std::lock_guard l(scrub_budget_lock);
+  return scrub_budget.charge(bytes, cct->_conf->osd_deep_scrub_max_bytes_per_sec,
+			     ceph_clock_now());
+}
+
 void OSDService::queue_for_scrub(PG *pg, bool with_high_priority)
 {
   unsigned scrub_queue_priority = pg->scrubber.priority;
@@ -3467,6 +3475,16 @@ void OSD::create_logger()
   osd_plb.add_u64_counter(
     l_osd_pg_biginfo, "osd_pg_biginfo", "PG updated its biginfo attr");
 
+  osd_plb.add_u64_counter(
+    l_osd_peering_batch_pgs, "peering_batch_pgs",
+    "PGs whose peering messages were sent in a batch");
+  osd_plb.add_u64_counter(
+    l_osd_peering_batch_sent, "peering_batch_sent",
+    "Batches of peering messages sent");
+  osd_plb.add_time_avg(
+    l_osd_peering_batch_lat, "peering_batch_lat",
+    "Time peering messages waited in a batch");
+
   logger = osd_plb.create_perf_counters();
   cct->get_perfcounters_collection()->add(logger);
 }
@@ -7645,14 +7663,29 @@ void OSD::handle_osd_map(MOSDMap *m)
 
       OSDMap *o = new OSDMap;
       if (e > 1) {
-	bufferlist obl;
-        bool got = get_map_bl(e - 1, obl);
-	if (!got) {
-	  auto p = added_maps_bl.find(e - 1);
-	  ceph_assert(p != added_maps_bl.end());
-	  obl = p->second;
+	// if the previous map is still in memory, start from a copy of it
+	// that shares its sections; apply_incremental() only duplicates
+	// the ones the incremental touches.
+	OSDMapRef prev;
+	auto q = added_maps.find(e - 1);
+	if (q != added_maps.end()) {
+	  prev = q->second;
+	} else {
+	  std::lock_guard l(service.map_cache_lock);
+	  prev = service.map_cache.lookup(e - 1);
+	}
+	if (prev) {
+	  o->deepish_copy_from(*prev);
+	} else {
+	  bufferlist obl;
+	  bool got = get_map_bl(e - 1, obl);
+	  if (!got) {
+	    auto p = added_maps_bl.find(e - 1);
+	    ceph_assert(p != added_maps_bl.end());
+	    obl = p->second;
+	  }
+	  o->decode(obl);
 	}
-	o->decode(obl);
       }
 
       OSDMap::Incremental inc;
@@ -8806,6 +8839,199 @@ void OSD::discard_context(PG::RecoveryCtx& ctx)
   delete ctx.transaction;
 }
 
+/** queue_peering_messages
+ * Like dispatch_context(), but rather than sending the messages right
+ * away, merge them into the shard's pending batch so that events for
+ * many PGs produce one MOSDPGNotify/Query/Info per peer.  The batch is
+ * sent when the shard runs out of work, when it covers
+ * osd_peering_batch_max_pgs PGs or has waited osd_peering_batch_max_delay,
+ * and before a work item other than a peering event runs on one of its
+ * PGs.
+ */
+void OSD::queue_peering_messages(OSDShard *sdata, PG::RecoveryCtx &ctx,
+				 PG *pg, OSDMapRef curmap,
+				 ThreadPool::TPHandle *handle)
+{
+  const uint64_t max_pgs = cct->_conf->osd_peering_batch_max_pgs;
+  if (max_pgs == 0 && sdata->peering_unsent == 0) {
+    dispatch_context(ctx, pg, curmap, handle);
+    return;
+  }
+  if ((!ctx.transaction->empty() || ctx.transaction->has_contexts()) && pg) {
+    int tr = store->queue_transaction(
+      pg->ch,
+      std::move(*ctx.transaction), TrackedOpRef(),
+      handle);
+    ceph_assert(tr == 0);
+  }
+
+  set<pg_t> pgs;
+  for (auto& p : *ctx.query_map) {
+    for (auto& q : p.second) {
+      pgs.insert(q.first.pgid);
+    }
+  }
+  for (auto& p : *ctx.notify_list) {
+    for (auto& n : p.second) {
+      pgs.insert(n.first.info.pgid.pgid);
+    }
+  }
+  for (auto& p : *ctx.info_map) {
+    for (auto& n : p.second) {
+      pgs.insert(n.first.info.pgid.pgid);
+    }
+  }
+
+  if (!pgs.empty()) {
+    std::unique_lock l(sdata->peering_lock);
+    bool requery = false;
+    for (auto& p : *ctx.query_map) {
+      auto q = sdata->peering_queries.find(p.first);
+      if (q == sdata->peering_queries.end()) {
+	continue;
+      }
+      for (auto& i : p.second) {
+	requery |= q->second.count(i.first) > 0;
+      }
+    }
+    if (requery ||
+	(sdata->peering_osdmap &&
+	 sdata->peering_osdmap->get_epoch() != curmap->get_epoch())) {
+      // a batch is built against one map and holds one query per pg
+      // and peer
+      _flush_peering_messages(sdata, l);
+    }
+    if (sdata->peering_pgs.empty()) {
+      sdata->peering_osdmap = curmap;
+      sdata->peering_since = ceph::mono_clock::now();
+    }
+    for (auto& p : *ctx.query_map) {
+      auto& q = sdata->peering_queries[p.first];
+      q.insert(p.second.begin(), p.second.end());
+    }
+    for (auto& p : *ctx.notify_list) {
+      auto& v = sdata->peering_notifies[p.first];
+      v.insert(v.end(), p.second.begin(), p.second.end());
+    }
+    for (auto& p : *ctx.info_map) {
+      auto& v = sdata->peering_infos[p.first];
+      v.insert(v.end(), p.second.begin(), p.second.end());
+    }
+    size_t before = sdata->peering_pgs.size();
+    sdata->peering_pgs.insert(pgs.begin(), pgs.end());
+    sdata->peering_unsent += sdata->peering_pgs.size() - before;
+    if (sdata->peering_pgs.size() >= max_pgs) {
+      _flush_peering_messages(sdata, l);
+    }
+  }
+  discard_context(ctx);
+}
+
+/*
+ * Make sure the peering messages pgid has queued are on the wire before
+ * it does anything else.  Only the batch holding them is waited for.
+ */
+void OSD::flush_peering_messages(OSDShard *sdata, const pg_t& pgid)
+{
+  if (sdata->peering_unsent == 0) {
+    return;
+  }
+  std::unique_lock l(sdata->peering_lock);
+  if (sdata->peering_pgs.count(pgid)) {
+    _flush_peering_messages(sdata, l);
+  }
+  uint64_t seq = 0;
+  for (auto& b : sdata->peering_send_queue) {
+    if (b.pgs.count(pgid)) {
+      seq = b.seq;
+    }
+  }
+  if (seq) {
+    // another thread is sending it
+    sdata->peering_sent_cond.wait(l, [sdata, seq] {
+	return sdata->peering_sent_seq >= seq;
+      });
+  }
+}
+
+void OSD::maybe_flush_peering_messages(OSDShard *sdata)
+{
+  if (sdata->peering_unsent == 0) {
+    return;
+  }
+  bool idle;
+  {
+    std::lock_guard l(sdata->shard_lock);
+    idle = sdata->pqueue->empty();
+  }
+  std::unique_lock l(sdata->peering_lock);
+  if (sdata->peering_pgs.empty()) {
+    return;
+  }
+  auto max_delay = ceph::make_timespan(
+    cct->_conf->osd_peering_batch_max_delay);
+  if (idle || ceph::mono_clock::now() - sdata->peering_since >= max_delay) {
+    _flush_peering_messages(sdata, l);
+  }
+}
+
+/*
+ * Move the pending batch to the send queue.  The messages go out with
+ * peering_lock dropped, so that work items queueing peering messages are
+ * not held up behind the messenger; only one thread sends at a time to
+ * keep batches in order, and if another thread is already sending we
+ * leave the batch to it and return at once.  l is held again on return.
+ */
+void OSD::_flush_peering_messages(OSDShard *sdata,
+				  std::unique_lock<ceph::mutex>& l)
+{
+  ceph_assert(l.owns_lock());
+  if (sdata->peering_pgs.empty()) {
+    return;
+  }
+  dout(20) << __func__ << " " << sdata->shard_name << " "
+	   << sdata->peering_pgs.size() << " pgs e"
+	   << sdata->peering_osdmap->get_epoch() << dendl;
+  logger->inc(l_osd_peering_batch_pgs, sdata->peering_pgs.size());
+  logger->inc(l_osd_peering_batch_sent);
+  logger->tinc(l_osd_peering_batch_lat,
+	       ceph::mono_clock::now() - sdata->peering_since);
+
+  sdata->peering_send_queue.emplace_back();
+  auto& batch = sdata->peering_send_queue.back();
+  batch.seq = ++sdata->peering_queued_seq;
+  batch.pgs.swap(sdata->peering_pgs);
+  batch.osdmap.swap(sdata->peering_osdmap);
+  batch.queries.swap(sdata->peering_queries);
+  batch.notifies.swap(sdata->peering_notifies);
+  batch.infos.swap(sdata->peering_infos);
+
+  if (sdata->peering_sending) {
+    return;
+  }
+  sdata->peering_sending = true;
+  while (!sdata->peering_send_queue.empty()) {
+    // others may append to the queue meanwhile, but leave the front alone
+    auto& b = sdata->peering_send_queue.front();
+    l.unlock();
+    if (!service.get_osdmap()->is_up(whoami)) {
+      dout(20) << __func__ << " not up in osdmap" << dendl;
+    } else if (!is_active()) {
+      dout(20) << __func__ << " not active" << dendl;
+    } else {
+      do_notifies(b.notifies, b.osdmap);
+      do_queries(b.queries, b.osdmap);
+      do_infos(b.infos, b.osdmap);
+    }
+    l.lock();
+    sdata->peering_unsent -= b.pgs.size();
+    sdata->peering_sent_seq = b.seq;
+    sdata->peering_send_queue.pop_front();
+    sdata->peering_sent_cond.notify_all();
+  }
+  sdata->peering_sending = false;
+}
+
 
 /** do_notifies
  * Send an MOSDPGNotify to a primary, with a list of PGs that I have
@@ -9450,7 +9676,7 @@ void OSD::dequeue_peering_evt(
   if (need_up_thru) {
     queue_want_up_thru(same_interval_since);
   }
-  dispatch_context(rctx, pg, curmap, &handle);
+  queue_peering_messages(sdata, rctx, pg, curmap, &handle);
 
   service.send_pg_temp();
 }
@@ -10324,6 +10550,9 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb)
   // callback.
   bool is_smallest_thread_index = thread_index < osd->num_shards;
 
+  // send peering messages batched by earlier work items before going idle
+  osd->maybe_flush_peering_messages(sdata);
+
   // peek at spg_t
   sdata->shard_lock.lock();
   if (sdata->pqueue->empty() &&
@@ -10583,6 +10812,13 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb)
   delete f;
   *_dout << dendl;
 
+  // whatever this pg does next must follow the peering messages it has
+  // already queued.  a peering event only adds its own to the batch, behind
+  // them, so it need not wait.
+  if (!qi.is_peering()) {
+    osd->flush_peering_messages(sdata, pg->pg_id.pgid);
+  }
+
   qi.run(osd, sdata, pg, tp_handle);
 
   {
@@ -187,6 +187,10 @@ enum {
   l_osd_pg_fastinfo,
   l_osd_pg_biginfo,
 
+  l_osd_peering_batch_pgs,
+  l_osd_peering_batch_sent,
+  l_osd_peering_batch_lat,
+
   l_osd_last,
 };
 
@@ -259,6 +263,37 @@ class MOSDForceRecovery;
 
 class OSD;
 
+/// token bucket shared by all deep scrubs on an OSD
+struct DeepScrubReadBudget {
+  double budget = 0;  ///< bytes available; negative when in debt
+  utime_t stamp;      ///< last time the budget was charged
+
+  /**
+   * charge bytes read at time now against a limit of rate bytes/sec
+   *
+   * At most a second's worth of unused budget carries over.
+   *
+   * @returns seconds the caller should wait before reading more
+   */
+  double charge(uint64_t bytes, uint64_t rate, utime_t now) {
+    if (rate == 0) {
+      budget = 0;
+      stamp = utime_t();
+      return 0;
+    }
+    if (stamp != utime_t() && now > stamp) {
+      budget += (double)(now - stamp) * rate;
+    }
+    budget = std::min<double>(budget, rate);
+    stamp = now;
+    budget -= bytes;
+    if (budget >= 0) {
+      return 0;
+    }
+    return -budget / rate;
+  }
+};
+
 class OSDService {
 public:
   OSD *osd;
@@ -701,6 +736,19 @@ public:
   Mutex sleep_lock;
   SafeTimer sleep_timer;
 
+  // -- deep scrub read budget --
+private:
+  Mutex scrub_budget_lock;
+  DeepScrubReadBudget scrub_budget;
+public:
+  /**
+   * charge deep scrub reads against osd_deep_scrub_max_bytes_per_sec
+   *
+   * @param bytes [in] object data bytes just read
+   * @returns seconds the caller should wait before reading more
+   */
+  double charge_deep_scrub_reads(uint64_t bytes);
+
   // -- tids --
   // for ops i issue
   std::atomic<unsigned int> last_tid{0};
@@ -1173,6 +1221,37 @@ struct OSDShard {
 
   ContextQueue context_queue;
 
+  /// peering messages queued by work items on this shard, coalesced per
+  /// peer and sent together; see OSD::queue_peering_messages().
+  string peering_lock_name;
+  ceph::mutex peering_lock;
+  OSDMapRef peering_osdmap;   ///< map the queued messages were built with
+  map<int, map<spg_t,pg_query_t>> peering_queries;
+  map<int, vector<pair<pg_notify_t,PastIntervals>>> peering_notifies;
+  map<int, vector<pair<pg_notify_t,PastIntervals>>> peering_infos;
+  set<pg_t> peering_pgs;      ///< pgs with queued messages
+  ceph::mono_time peering_since;
+  /// pgs with messages queued or not yet sent; read without peering_lock
+  /// so that work items skip all of this while nothing is batched.
+  std::atomic<size_t> peering_unsent = {0};
+
+  /// batches taken off the pending maps above, waiting to be sent.  they
+  /// are sent in order by one thread at a time, without peering_lock held,
+  /// and stay at the front of the queue until they are out.
+  struct peering_batch_t {
+    uint64_t seq;
+    set<pg_t> pgs;
+    OSDMapRef osdmap;
+    map<int, map<spg_t,pg_query_t>> queries;
+    map<int, vector<pair<pg_notify_t,PastIntervals>>> notifies;
+    map<int, vector<pair<pg_notify_t,PastIntervals>>> infos;
+  };
+  std::list<peering_batch_t> peering_send_queue;
+  bool peering_sending = false;
+  uint64_t peering_queued_seq = 0;
+  uint64_t peering_sent_seq = 0;
+  ceph::condition_variable peering_sent_cond;
+
   void _enqueue_front(OpQueueItem&& item, unsigned cutoff) {
     unsigned priority = item.get_priority();
     unsigned cost = item.get_cost();
@@ -1231,7 +1310,9 @@ struct OSDShard {
       osdmap_lock{make_mutex(osdmap_lock_name)},
       shard_lock_name(shard_name + "::shard_lock"),
       shard_lock{make_mutex(shard_lock_name)},
-      context_queue(sdata_wait_lock, sdata_cond) {
+      context_queue(sdata_wait_lock, sdata_cond),
+      peering_lock_name(shard_name + "::peering_lock"),
+      peering_lock{make_mutex(peering_lock_name)} {
     if (opqueue == io_queue::weightedpriority) {
       pqueue = std::make_unique<
 	WeightedPriorityQueue<OpQueueItem,uint64_t>>(
@@ -2025,6 +2106,13 @@ protected:
   void dispatch_context_transaction(PG::RecoveryCtx &ctx, PG *pg,
                                     ThreadPool::TPHandle *handle = NULL);
   void discard_context(PG::RecoveryCtx &ctx);
+  void queue_peering_messages(OSDShard *sdata, PG::RecoveryCtx &ctx,
+			      PG *pg, OSDMapRef curmap,
+			      ThreadPool::TPHandle *handle = NULL);
+  void flush_peering_messages(OSDShard *sdata, const pg_t& pgid);
+  void maybe_flush_peering_messages(OSDShard *sdata);
+  void _flush_peering_messages(OSDShard *sdata,
+			       std::unique_lock<ceph::mutex>& l);
   void do_notifies(map<int,
 		       vector<pair<pg_notify_t, PastIntervals> > >&
 		       notify_list,
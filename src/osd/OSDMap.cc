@@ -1264,14 +1264,15 @@ void OSDMap::set_max_osd(int m)
     osd_weight[o] = CEPH_OSD_OUT;
   }
   osd_info.resize(m);
-  osd_xinfo.resize(m);
-  osd_addrs->client_addrs.resize(m);
-  osd_addrs->cluster_addrs.resize(m);
-  osd_addrs->hb_back_addrs.resize(m);
-  osd_addrs->hb_front_addrs.resize(m);
-  osd_uuid->resize(m);
+  _cow(osd_xinfo).resize(m);
+  auto& addrs = _cow(osd_addrs);
+  addrs.client_addrs.resize(m);
+  addrs.cluster_addrs.resize(m);
+  addrs.hb_back_addrs.resize(m);
+  addrs.hb_front_addrs.resize(m);
+  _cow(osd_uuid).resize(m);
   if (osd_primary_affinity)
-    osd_primary_affinity->resize(m, CEPH_OSD_DEFAULT_PRIMARY_AFFINITY);
+    _cow(osd_primary_affinity).resize(m, CEPH_OSD_DEFAULT_PRIMARY_AFFINITY);
 
   calc_num_osds();
 }
@@ -1464,7 +1465,7 @@ uint64_t OSDMap::get_features(int entity_type, uint64_t *pmask) const
   }
   mask |= CEPH_FEATURES_CRUSH;
 
-  if (!pg_upmap.empty() || !pg_upmap_items.empty())
+  if (!pg_upmap->empty() || !pg_upmap_items->empty())
     features |= CEPH_FEATUREMASK_OSDMAP_PG_UPMAP;
   mask |= CEPH_FEATUREMASK_OSDMAP_PG_UPMAP;
 
@@ -1597,7 +1598,13 @@ void OSDMap::dedup(const OSDMap *o, OSDMap *n)
 
   int diff = 0;
 
-  // do addrs match?
+  // do addrs match?  (n may already share sections with o, or with the
+  // map it was copied from; never write through a shared section.)
+  if (o->osd_addrs == n->osd_addrs) {
+    _dedup_sections(o, n);
+    return;
+  }
+  _cow(n->osd_addrs);
   if (o->max_osd != n->max_osd)
     diff++;
   for (int i = 0; i < o->max_osd && i < n->max_osd; i++) {
@@ -1626,21 +1633,30 @@ void OSDMap::dedup(const OSDMap *o, OSDMap *n)
     // zoinks, no differences at all!
     n->osd_addrs = o->osd_addrs;
   }
+  _dedup_sections(o, n);
+}
+
+void OSDMap::_dedup_sections(const OSDMap *o, OSDMap *n)
+{
+  using ceph::encode;
 
   // does crush match?
-  bufferlist oc, nc;
-  encode(*o->crush, oc, CEPH_FEATURES_SUPPORTED_DEFAULT);
-  encode(*n->crush, nc, CEPH_FEATURES_SUPPORTED_DEFAULT);
-  if (oc.contents_equal(nc)) {
-    n->crush = o->crush;
+  if (o->crush != n->crush) {
+    bufferlist oc, nc;
+    encode(*o->crush, oc, CEPH_FEATURES_SUPPORTED_DEFAULT);
+    encode(*n->crush, nc, CEPH_FEATURES_SUPPORTED_DEFAULT);
+    if (oc.contents_equal(nc)) {
+      n->crush = o->crush;
+    }
   }
 
   // does pg_temp match?
-  if (*o->pg_temp == *n->pg_temp)
+  if (o->pg_temp != n->pg_temp && *o->pg_temp == *n->pg_temp)
     n->pg_temp = o->pg_temp;
 
   // does primary_temp match?
-  if (o->primary_temp->size() == n->primary_temp->size()) {
+  if (o->primary_temp != n->primary_temp &&
+      o->primary_temp->size() == n->primary_temp->size()) {
     if (*o->primary_temp == *n->primary_temp)
       n->primary_temp = o->primary_temp;
   }
@@ -1649,6 +1665,23 @@ void OSDMap::dedup(const OSDMap *o, OSDMap *n)
   if (o->osd_uuid->size() == n->osd_uuid->size() &&
       *o->osd_uuid == *n->osd_uuid)
     n->osd_uuid = o->osd_uuid;
+
+  // do xinfo match?
+  if (o->osd_xinfo != n->osd_xinfo &&
+      o->osd_xinfo->size() == n->osd_xinfo->size()) {
+    bufferlist ox, nx;
+    encode(*o->osd_xinfo, ox);
+    encode(*n->osd_xinfo, nx);
+    if (ox.contents_equal(nx))
+      n->osd_xinfo = o->osd_xinfo;
+  }
+
+  // do upmaps match?
+  if (o->pg_upmap != n->pg_upmap && *o->pg_upmap == *n->pg_upmap)
+    n->pg_upmap = o->pg_upmap;
+  if (o->pg_upmap_items != n->pg_upmap_items &&
+      *o->pg_upmap_items == *n->pg_upmap_items)
+    n->pg_upmap_items = o->pg_upmap_items;
 }
 
 void OSDMap::clean_temps(CephContext *cct,
@@ -1742,10 +1775,10 @@ void OSDMap::maybe_remove_pg_upmaps(CephContext *cct,
   set<pg_t> to_cancel;
   map<int, map<int, float>> rule_weight_map;
 
-  for (auto& p : nextmap.pg_upmap) {
+  for (auto& p : *nextmap.pg_upmap) {
     to_check.insert(p.first);
   }
-  for (auto& p : nextmap.pg_upmap_items) {
+  for (auto& p : *nextmap.pg_upmap_items) {
     to_check.insert(p.first);
   }
   for (auto& p : pending_inc->new_pg_upmap) {
@@ -1835,10 +1868,10 @@ void OSDMap::maybe_remove_pg_upmaps(CephContext *cct,
                        << dendl;
         pending_inc->new_pg_upmap.erase(it);
       }
-      if (oldmap.pg_upmap.count(pg)) {
+      if (oldmap.pg_upmap->count(pg)) {
         ldout(cct, 10) << __func__ << " cancel invalid pg_upmap entry "
-                       << oldmap.pg_upmap.find(pg)->first << "->"
-                       << oldmap.pg_upmap.find(pg)->second
+                       << oldmap.pg_upmap->find(pg)->first << "->"
+                       << oldmap.pg_upmap->find(pg)->second
                        << dendl;
         pending_inc->old_pg_upmap.insert(pg);
       }
@@ -1852,11 +1885,11 @@ void OSDMap::maybe_remove_pg_upmaps(CephContext *cct,
                        << dendl;
         pending_inc->new_pg_upmap_items.erase(it);
       }
-      if (oldmap.pg_upmap_items.count(pg)) {
+      if (oldmap.pg_upmap_items->count(pg)) {
         ldout(cct, 10) << __func__ << " cancel invalid "
                        << "pg_upmap_items entry "
-                       << oldmap.pg_upmap_items.find(pg)->first << "->"
-                       << oldmap.pg_upmap_items.find(pg)->second
+                       << oldmap.pg_upmap_items->find(pg)->first << "->"
+                       << oldmap.pg_upmap_items->find(pg)->second
                        << dendl;
         pending_inc->old_pg_upmap_items.insert(pg);
       }
@@ -1963,7 +1996,7 @@ int OSDMap::apply_incremental(const Incremental &inc)
     // xinfo old_weight.
     if (weight.second) {
       osd_state[weight.first] &= ~(CEPH_OSD_AUTOOUT | CEPH_OSD_NEW);
-      osd_xinfo[weight.first].old_weight = 0;
+      _cow(osd_xinfo)[weight.first].old_weight = 0;
     }
   }
 
@@ -1986,19 +2019,20 @@ int OSDMap::apply_incremental(const Incremental &inc)
     if ((osd_state[osd] & CEPH_OSD_UP) &&
 	(s & CEPH_OSD_UP)) {
       osd_info[osd].down_at = epoch;
-      osd_xinfo[osd].down_stamp = modified;
+      _cow(osd_xinfo)[osd].down_stamp = modified;
     }
     if ((osd_state[osd] & CEPH_OSD_EXISTS) &&
 	(s & CEPH_OSD_EXISTS)) {
       // osd is destroyed; clear out anything interesting.
-      (*osd_uuid)[osd] = uuid_d();
+      _cow(osd_uuid)[osd] = uuid_d();
       osd_info[osd] = osd_info_t();
-      osd_xinfo[osd] = osd_xinfo_t();
+      _cow(osd_xinfo)[osd] = osd_xinfo_t();
       set_primary_affinity(osd, CEPH_OSD_DEFAULT_PRIMARY_AFFINITY);
-      osd_addrs->client_addrs[osd].reset(new entity_addrvec_t());
-      osd_addrs->cluster_addrs[osd].reset(new entity_addrvec_t());
-      osd_addrs->hb_front_addrs[osd].reset(new entity_addrvec_t());
-      osd_addrs->hb_back_addrs[osd].reset(new entity_addrvec_t());
+      auto& addrs = _cow(osd_addrs);
+      addrs.client_addrs[osd].reset(new entity_addrvec_t());
+      addrs.cluster_addrs[osd].reset(new entity_addrvec_t());
+      addrs.hb_front_addrs[osd].reset(new entity_addrvec_t());
+      addrs.hb_back_addrs[osd].reset(new entity_addrvec_t());
       osd_state[osd] = 0;
     } else {
       osd_state[osd] ^= s;
@@ -2007,18 +2041,19 @@ int OSDMap::apply_incremental(const Incremental &inc)
 
   for (const auto &client : inc.new_up_client) {
     osd_state[client.first] |= CEPH_OSD_EXISTS | CEPH_OSD_UP;
-    osd_addrs->client_addrs[client.first].reset(
+    auto& addrs = _cow(osd_addrs);
+    addrs.client_addrs[client.first].reset(
       new entity_addrvec_t(client.second));
-    osd_addrs->hb_back_addrs[client.first].reset(
+    addrs.hb_back_addrs[client.first].reset(
       new entity_addrvec_t(inc.new_hb_back_up.find(client.first)->second));
-    osd_addrs->hb_front_addrs[client.first].reset(
+    addrs.hb_front_addrs[client.first].reset(
       new entity_addrvec_t(inc.new_hb_front_up.find(client.first)->second));
 
     osd_info[client.first].up_from = epoch;
   }
 
   for (const auto &cluster : inc.new_up_cluster)
-    osd_addrs->cluster_addrs[cluster.first].reset(
+    _cow(osd_addrs).cluster_addrs[cluster.first].reset(
       new entity_addrvec_t(cluster.second));
 
   // info
@@ -2035,42 +2070,43 @@ int OSDMap::apply_incremental(const Incremental &inc)
 
   // xinfo
   for (const auto &xinfo : inc.new_xinfo)
-    osd_xinfo[xinfo.first] = xinfo.second;
+    _cow(osd_xinfo)[xinfo.first] = xinfo.second;
 
   // uuid
   for (const auto &uuid : inc.new_uuid)
-    (*osd_uuid)[uuid.first] = uuid.second;
+    _cow(osd_uuid)[uuid.first] = uuid.second;
 
   // pg rebuild
-  for (const auto &pg : inc.new_pg_temp) {
-    if (pg.second.empty())
-      pg_temp->erase(pg.first);
-    else
-      pg_temp->set(pg.first, pg.second);
-  }
   if (!inc.new_pg_temp.empty()) {
+    auto& temp = _cow(pg_temp);
+    for (const auto &pg : inc.new_pg_temp) {
+      if (pg.second.empty())
+	temp.erase(pg.first);
+      else
+	temp.set(pg.first, pg.second);
+    }
     // make sure pg_temp is efficiently stored
-    pg_temp->rebuild();
+    temp.rebuild();
   }
 
   for (const auto &pg : inc.new_primary_temp) {
     if (pg.second == -1)
-      primary_temp->erase(pg.first);
+      _cow(primary_temp).erase(pg.first);
     else
-      (*primary_temp)[pg.first] = pg.second;
+      _cow(primary_temp)[pg.first] = pg.second;
   }
 
   for (auto& p : inc.new_pg_upmap) {
-    pg_upmap[p.first] = p.second;
+    _cow(pg_upmap)[p.first] = p.second;
   }
   for (auto& pg : inc.old_pg_upmap) {
-    pg_upmap.erase(pg);
+    _cow(pg_upmap).erase(pg);
   }
   for (auto& p : inc.new_pg_upmap_items) {
-    pg_upmap_items[p.first] = p.second;
+    _cow(pg_upmap_items)[p.first] = p.second;
   }
   for (auto& pg : inc.old_pg_upmap_items) {
-    pg_upmap_items.erase(pg);
+    _cow(pg_upmap_items).erase(pg);
   }
 
   // blacklist
@@ -2233,8 +2269,8 @@ int OSDMap::_pick_primary(const vector<int>& osds) const
 void OSDMap::_apply_upmap(const pg_pool_t& pi, pg_t raw_pg, vector<int> *raw) const
 {
   pg_t pg = pi.raw_pg_to_pg(raw_pg);
-  auto p = pg_upmap.find(pg);
-  if (p != pg_upmap.end()) {
+  auto p = pg_upmap->find(pg);
+  if (p != pg_upmap->end()) {
     // make sure targets aren't marked out
     for (auto osd : p->second) {
       if (osd != CRUSH_ITEM_NONE && osd < max_osd && osd >= 0 &&
@@ -2247,8 +2283,8 @@ void OSDMap::_apply_upmap(const pg_pool_t& pi, pg_t raw_pg, vector<int> *raw) co
     // continue to check and apply pg_upmap_items if any
   }
 
-  auto q = pg_upmap_items.find(pg);
-  if (q != pg_upmap_items.end()) {
+  auto q = pg_upmap_items->find(pg);
+  if (q != pg_upmap_items->end()) {
     // NOTE: this approach does not allow a bidirectional swap,
     // e.g., [[1,2],[2,1]] applied to [0,1,2] -> [0,2,1].
     for (auto& r : q->second) {
@@ -2469,6 +2505,79 @@ void OSDMap::_pg_to_up_acting_osds(
     *acting_primary = _acting_primary;
 }
 
+void OSDMap::pg_range_to_up_acting_osds(
+  int64_t poolid, unsigned ps_begin, unsigned ps_end,
+  std::function<void(ps_t ps,
+		     vector<int>& up, int up_primary,
+		     vector<int>& acting, int acting_primary)> f) const
+{
+  const pg_pool_t *pool = get_pg_pool(poolid);
+  ceph_assert(pool);
+  ceph_assert(ps_begin <= ps_end);
+  vector<int> pps(ps_end - ps_begin);
+  for (unsigned ps = ps_begin; ps < ps_end; ++ps) {
+    pps[ps - ps_begin] = pool->raw_pg_to_pps(pg_t(ps, poolid));
+  }
+
+  vector<vector<int>> raws;
+  unsigned size = pool->get_size();
+  int ruleno = crush->find_rule(pool->get_crush_rule(), pool->get_type(), size);
+  if (ruleno >= 0) {
+    crush->do_rule_batch(ruleno, pps, &raws, size, osd_weight, poolid);
+  } else {
+    raws.resize(pps.size());
+  }
+
+  for (unsigned ps = ps_begin; ps < ps_end; ++ps) {
+    pg_t pg(ps, poolid);
+    vector<int>& raw = raws[ps - ps_begin];
+    vector<int> up, acting;
+    int up_primary, acting_primary;
+    _remove_nonexistent_osds(*pool, raw);
+    _get_temp_osds(*pool, pg, &acting, &acting_primary);
+    _apply_upmap(*pool, pg, &raw);
+    _raw_to_up_osds(*pool, raw, &up);
+    up_primary = _pick_primary(up);
+    _apply_primary_affinity(pps[ps - ps_begin], *pool, &up, &up_primary);
+    if (acting.empty()) {
+      acting = up;
+      if (acting_primary == -1) {
+	acting_primary = up_primary;
+      }
+    }
+    f(ps, up, up_primary, acting, acting_primary);
+  }
+}
+
+void OSDMap::get_pgs_with_overrides_on(int osd, set<pg_t> *pgs) const
+{
+  for (auto p = pg_temp->begin(); p != pg_temp->end(); ++p) {
+    if (std::find(p->second.begin(), p->second.end(), osd) !=
+	p->second.end()) {
+      pgs->insert(p->first);
+    }
+  }
+  for (auto& p : *primary_temp) {
+    if (p.second == osd) {
+      pgs->insert(p.first);
+    }
+  }
+  for (auto& p : *pg_upmap) {
+    if (std::find(p.second.begin(), p.second.end(), osd) !=
+	p.second.end()) {
+      pgs->insert(p.first);
+    }
+  }
+  for (auto& p : *pg_upmap_items) {
+    for (auto& q : p.second) {
+      if (q.first == osd || q.second == osd) {
+	pgs->insert(p.first);
+	break;
+      }
+    }
+  }
+}
+
 int OSDMap::calc_pg_rank(int osd, const vector<int>& acting, int nrep)
 {
   if (!nrep)
@@ -2640,7 +2749,7 @@ void OSDMap::encode_classic(bufferlist& bl, uint64_t features) const
   encode(cluster_snapshot_epoch, bl);
   encode(cluster_snapshot, bl);
   encode(*osd_uuid, bl);
-  encode(osd_xinfo, bl);
+  encode(*osd_xinfo, bl);
   encode(osd_addrs->hb_front_addrs, bl, features);
 }
 
@@ -2735,11 +2844,11 @@ void OSDMap::encode(bufferlist& bl, uint64_t features) const
     encode(erasure_code_profiles, bl);
 
     if (v >= 4) {
-      encode(pg_upmap, bl);
-      encode(pg_upmap_items, bl);
+      encode(*pg_upmap, bl);
+      encode(*pg_upmap_items, bl);
     } else {
-      ceph_assert(pg_upmap.empty());
-      ceph_assert(pg_upmap_items.empty());
+      ceph_assert(pg_upmap->empty());
+      ceph_assert(pg_upmap_items->empty());
     }
     if (v >= 6) {
       encode(crush_version, bl);
@@ -2789,7 +2898,7 @@ void OSDMap::encode(bufferlist& bl, uint64_t features) const
     encode(cluster_snapshot_epoch, bl);
     encode(cluster_snapshot, bl);
     encode(*osd_uuid, bl);
-    encode(osd_xinfo, bl);
+    encode(*osd_xinfo, bl);
     if (target_v < 7) {
       encode_addrvec_pvec_as_addr(osd_addrs->hb_front_addrs, bl, features);
     } else {
@@ -2832,6 +2941,23 @@ void OSDMap::encode(bufferlist& bl, uint64_t features) const
   crc_defined = true;
 }
 
+void OSDMap::_reset_shared_sections()
+{
+  // sections may be shared with other maps (see deepish_copy_from() and
+  // dedup()); decoding fills them in place, so start from private copies.
+  osd_addrs = std::make_shared<addrs_s>();
+  osd_uuid = std::make_shared<mempool::osdmap::vector<uuid_d>>();
+  osd_xinfo = std::make_shared<mempool::osdmap::vector<osd_xinfo_t>>();
+  pg_temp = std::make_shared<PGTempMap>();
+  primary_temp = std::make_shared<mempool::osdmap::map<pg_t,int32_t>>();
+  pg_upmap = std::make_shared<
+    mempool::osdmap::map<pg_t,mempool::osdmap::vector<int32_t>>>();
+  pg_upmap_items = std::make_shared<
+    mempool::osdmap::map<pg_t,mempool::osdmap::vector<pair<int32_t,int32_t>>>>();
+  osd_primary_affinity.reset();
+  crush = std::make_shared<CrushWrapper>();
+}
+
 void OSDMap::decode(bufferlist& bl)
 {
   auto p = bl.cbegin();
@@ -2843,6 +2969,7 @@ void OSDMap::decode_classic(bufferlist::const_iterator& p)
   using ceph::decode;
   __u32 n, t;
   __u16 v;
+  _reset_shared_sections();
   decode(v, p);
 
   // base
@@ -2945,9 +3072,9 @@ void OSDMap::decode_classic(bufferlist::const_iterator& p)
     osd_uuid->resize(max_osd);
   }
   if (ev >= 9)
-    decode(osd_xinfo, p);
+    decode(*osd_xinfo, p);
   else
-    osd_xinfo.resize(max_osd);
+    osd_xinfo->resize(max_osd);
 
   if (ev >= 10)
     decode(osd_addrs->hb_front_addrs, p);
@@ -2973,6 +3100,7 @@ void OSDMap::decode(bufferlist::const_iterator& bl)
   size_t tail_offset = 0;
   bufferlist crc_front, crc_tail;
 
+  _reset_shared_sections();
   DECODE_START_LEGACY_COMPAT_LEN(8, 7, 7, bl); // wrapper
   if (struct_v < 7) {
     bl.seek(start_offset);
@@ -3032,11 +3160,11 @@ void OSDMap::decode(bufferlist::const_iterator& bl)
       erasure_code_profiles.clear();
     }
     if (struct_v >= 4) {
-      decode(pg_upmap, bl);
-      decode(pg_upmap_items, bl);
+      decode(*pg_upmap, bl);
+      decode(*pg_upmap_items, bl);
     } else {
-      pg_upmap.clear();
-      pg_upmap_items.clear();
+      pg_upmap->clear();
+      pg_upmap_items->clear();
     }
     if (struct_v >= 6) {
       decode(crush_version, bl);
@@ -3061,7 +3189,7 @@ void OSDMap::decode(bufferlist::const_iterator& bl)
     decode(cluster_snapshot_epoch, bl);
     decode(cluster_snapshot, bl);
     decode(*osd_uuid, bl);
-    decode(osd_xinfo, bl);
+    decode(*osd_xinfo, bl);
     decode(osd_addrs->hb_front_addrs, bl);
     if (struct_v >= 2) {
       decode(nearfull_ratio, bl);
@@ -3245,14 +3373,14 @@ void OSDMap::dump(Formatter *f) const
     if (exists(i)) {
       f->open_object_section("xinfo");
       f->dump_int("osd", i);
-      osd_xinfo[i].dump(f);
+      (*osd_xinfo)[i].dump(f);
       f->close_section();
     }
   }
   f->close_section();
 
   f->open_array_section("pg_upmap");
-  for (auto& p : pg_upmap) {
+  for (auto& p : *pg_upmap) {
     f->open_object_section("mapping");
     f->dump_stream("pgid") << p.first;
     f->open_array_section("osds");
@@ -3264,7 +3392,7 @@ void OSDMap::dump(Formatter *f) const
   }
   f->close_section();
   f->open_array_section("pg_upmap_items");
-  for (auto& p : pg_upmap_items) {
+  for (auto& p : *pg_upmap_items) {
     f->open_object_section("mapping");
     f->dump_stream("pgid") << p.first;
     f->open_array_section("mappings");
@@ -3490,10 +3618,10 @@ void OSDMap::print(ostream& out) const
   }
   out << std::endl;
 
-  for (auto& p : pg_upmap) {
+  for (auto& p : *pg_upmap) {
     out << "pg_upmap " << p.first << " " << p.second << "\n";
   }
-  for (auto& p : pg_upmap_items) {
+  for (auto& p : *pg_upmap_items) {
     out << "pg_upmap_items " << p.first << " " << p.second << "\n";
   }
 
@@ -4194,7 +4322,7 @@ int OSDMap::clean_pg_upmaps(
 {
   ldout(cct, 10) << __func__ << dendl;
   int changed = 0;
-  for (auto& p : pg_upmap) {
+  for (auto& p : *pg_upmap) {
     vector<int> raw;
     int primary;
     pg_to_raw_osds(p.first, &raw, &primary);
@@ -4205,7 +4333,7 @@ int OSDMap::clean_pg_upmaps(
       ++changed;
     }
   }
-  for (auto& p : pg_upmap_items) {
+  for (auto& p : *pg_upmap_items) {
     vector<int> raw;
     int primary;
     pg_to_raw_osds(p.first, &raw, &primary);
@@ -4292,6 +4420,7 @@ int OSDMap::calc_pg_upmaps(
   }
   OSDMap tmp;
   tmp.deepish_copy_from(*this);
+  _cow(tmp.pg_upmap_items);  // modified in place below
   float start_deviation = 0;
   float end_deviation = 0;
   int num_changed = 0;
@@ -4412,8 +4541,8 @@ int OSDMap::calc_pg_upmaps(
 
       // look for remaps we can un-remap
       for (auto pg : pgs) {
-	auto p = tmp.pg_upmap_items.find(pg);
-	if (p != tmp.pg_upmap_items.end()) {
+	auto p = tmp.pg_upmap_items->find(pg);
+	if (p != tmp.pg_upmap_items->end()) {
 	  for (auto q : p->second) {
 	    if (q.second == osd) {
 	      ldout(cct, 10) << "  dropping pg_upmap_items " << pg
@@ -4422,7 +4551,7 @@ int OSDMap::calc_pg_upmaps(
                 pgs_by_osd[i.second].erase(pg);
                 pgs_by_osd[i.first].insert(pg);
               }
-	      tmp.pg_upmap_items.erase(p);
+	      tmp.pg_upmap_items->erase(p);
 	      pending_inc->old_pg_upmap_items.insert(pg);
 	      ++num_changed;
 	      restart = true;
@@ -4436,8 +4565,8 @@ int OSDMap::calc_pg_upmaps(
 	break;
 
       for (auto pg : pgs) {
-	if (tmp.pg_upmap.count(pg) ||
-	    tmp.pg_upmap_items.count(pg)) {
+	if (tmp.pg_upmap->count(pg) ||
+	    tmp.pg_upmap_items->count(pg)) {
 	  ldout(cct, 20) << "  already remapped " << pg << dendl;
 	  continue;
 	}
@@ -4451,7 +4580,7 @@ int OSDMap::calc_pg_upmaps(
 	  continue;
 	}
 	ceph_assert(orig != out);
-	auto& rmi = tmp.pg_upmap_items[pg];
+	auto& rmi = (*tmp.pg_upmap_items)[pg];
 	for (unsigned i = 0; i < out.size(); ++i) {
 	  if (orig[i] != out[i]) {
 	    rmi.push_back(make_pair(orig[i], out[i]));
@@ -547,8 +547,8 @@ private:
   std::shared_ptr< mempool::osdmap::vector<__u32> > osd_primary_affinity; ///< 16.16 fixed point, 0x10000 = baseline
 
   // remap (post-CRUSH, pre-up)
-  mempool::osdmap::map<pg_t,mempool::osdmap::vector<int32_t>> pg_upmap; ///< remap pg
-  mempool::osdmap::map<pg_t,mempool::osdmap::vector<pair<int32_t,int32_t>>> pg_upmap_items; ///< remap osds in up set
+  std::shared_ptr<mempool::osdmap::map<pg_t,mempool::osdmap::vector<int32_t>>> pg_upmap; ///< remap pg
+  std::shared_ptr<mempool::osdmap::map<pg_t,mempool::osdmap::vector<pair<int32_t,int32_t>>>> pg_upmap_items; ///< remap osds in up set
 
   mempool::osdmap::map<int64_t,pg_pool_t> pools;
   mempool::osdmap::map<int64_t,string> pool_name;
@@ -556,7 +556,7 @@ private:
   mempool::osdmap::map<string,int64_t> name_pool;
 
   std::shared_ptr< mempool::osdmap::vector<uuid_d> > osd_uuid;
-  mempool::osdmap::vector<osd_xinfo_t> osd_xinfo;
+  std::shared_ptr< mempool::osdmap::vector<osd_xinfo_t> > osd_xinfo;
 
   mempool::osdmap::unordered_map<entity_addr_t,utime_t> blacklist;
 
@@ -609,7 +609,12 @@ private:
 	     osd_addrs(std::make_shared<addrs_s>()),
 	     pg_temp(std::make_shared<PGTempMap>()),
 	     primary_temp(std::make_shared<mempool::osdmap::map<pg_t,int32_t>>()),
+	     pg_upmap(std::make_shared<
+		      mempool::osdmap::map<pg_t,mempool::osdmap::vector<int32_t>>>()),
+	     pg_upmap_items(std::make_shared<
+			    mempool::osdmap::map<pg_t,mempool::osdmap::vector<pair<int32_t,int32_t>>>>()),
 	     osd_uuid(std::make_shared<mempool::osdmap::vector<uuid_d>>()),
+	     osd_xinfo(std::make_shared<mempool::osdmap::vector<osd_xinfo_t>>()),
 	     cluster_snapshot_epoch(0),
 	     new_blacklist_entries(false),
 	     cached_up_osd_features(0),
@@ -620,6 +625,21 @@ private:
 private:
   OSDMap(const OSDMap& other) = default;
   OSDMap& operator=(const OSDMap& other) = default;
+
+  /**
+   * the sections we hold by shared_ptr may be shared with other maps
+   * (see deepish_copy_from() and dedup()).  get a private copy of one
+   * before modifying it.
+   */
+  template<typename T>
+  static T& _cow(std::shared_ptr<T>& section) {
+    if (section.use_count() > 1) {
+      section = std::make_shared<T>(*section);
+    }
+    return *section;
+  }
+  void _reset_shared_sections();
+  static void _dedup_sections(const OSDMap *oldmap, OSDMap *newmap);
 public:
 
   /// return feature mask subset that is relevant to OSDMap encoding
@@ -630,19 +650,11 @@ public:
   uint64_t get_encoding_features() const;
 
   void deepish_copy_from(const OSDMap& o) {
+    // NOTE: the sections held by shared_ptr (addrs, temps, upmaps,
+    // uuids, xinfo, primary affinity and crush) stay shared with o.
+    // they are copied on write, so only the ones an incremental
+    // actually modifies get duplicated.
     *this = o;
-    primary_temp.reset(new mempool::osdmap::map<pg_t,int32_t>(*o.primary_temp));
-    pg_temp.reset(new PGTempMap(*o.pg_temp));
-    osd_uuid.reset(new mempool::osdmap::vector<uuid_d>(*o.osd_uuid));
-
-    if (o.osd_primary_affinity)
-      osd_primary_affinity.reset(new mempool::osdmap::vector<__u32>(*o.osd_primary_affinity));
-
-    // NOTE: this still references shared entity_addrvec_t's.
-    osd_addrs.reset(new addrs_s(*o.osd_addrs));
-
-    // NOTE: we do not copy crush.  note that apply_incremental will
-    // allocate a new CrushWrapper, though.
   }
 
   // map info
@@ -758,7 +770,7 @@ public:
       osd_primary_affinity.reset(
 	new mempool::osdmap::vector<__u32>(
 	  max_osd, CEPH_OSD_DEFAULT_PRIMARY_AFFINITY));
-    (*osd_primary_affinity)[o] = w;
+    _cow(osd_primary_affinity)[o] = w;
   }
   unsigned get_primary_affinity(int o) const {
     ceph_assert(o < max_osd);
@@ -949,7 +961,7 @@ public:
 
   const osd_xinfo_t& get_xinfo(int osd) const {
     ceph_assert(osd < max_osd);
-    return osd_xinfo[osd];
+    return (*osd_xinfo)[osd];
   }
   
   int get_next_up_osd_after(int n) const {
@@ -1180,6 +1192,16 @@ public:
     int up_primary, acting_primary;
     pg_to_up_acting_osds(pg, &up, &up_primary, &acting, &acting_primary);
   }
+  /**
+   * map pgs [ps_begin, ps_end) of a pool to their up and acting sets,
+   * evaluating the CRUSH rule for the whole range in one batch. f is
+   * called for each pg with what pg_to_up_acting_osds() would return.
+   */
+  void pg_range_to_up_acting_osds(
+    int64_t pool, unsigned ps_begin, unsigned ps_end,
+    std::function<void(ps_t ps,
+		       vector<int>& up, int up_primary,
+		       vector<int>& acting, int acting_primary)> f) const;
   bool pg_is_ec(pg_t pg) const {
     auto i = pools.find(pg.pool());
     ceph_assert(i != pools.end());
@@ -1385,10 +1407,13 @@ public:
   int get_osds_by_bucket_name(const string &name, set<int> *osds) const;
 
   bool have_pg_upmaps(pg_t pg) const {
-    return pg_upmap.count(pg) ||
-      pg_upmap_items.count(pg);
+    return pg_upmap->count(pg) ||
+      pg_upmap_items->count(pg);
   }
 
+  /// get pgs whose pg_temp, primary_temp or pg_upmap[_items] refer to osd
+  void get_pgs_with_overrides_on(int osd, set<pg_t> *pgs) const;
+
   /*
    * handy helpers to build simple maps...
    */
@@ -1434,8 +1459,8 @@ public:
   int validate_crush_rules(CrushWrapper *crush, ostream *ss) const;
 
   void clear_temp() {
-    pg_temp->clear();
-    primary_temp->clear();
+    _cow(pg_temp).clear();
+    _cow(primary_temp).clear();
   }
 
 private:
@@ -30,13 +30,15 @@ void OSDMapMapping::_init_mappings(const OSDMap& osdmap)
 	q = pools.erase(q);
       } else {
 	// keep it
+	q->second.set_inputs(p.second);
 	++q;
 	continue;
       }
     }
-    pools.emplace(p.first, PoolMapping(p.second.get_size(),
-				       p.second.get_pg_num(),
-				       p.second.is_erasure()));
+    auto r = pools.emplace(p.first, PoolMapping(p.second.get_size(),
+						p.second.get_pg_num(),
+						p.second.is_erasure()));
+    r.first->second.set_inputs(p.second);
   }
   pools.erase(q, pools.end());
   ceph_assert(pools.size() == osdmap.get_pools().size());
@@ -57,6 +59,226 @@ void OSDMapMapping::update(const OSDMap& osdmap, pg_t pgid)
   _update_range(osdmap, pgid.pool(), pgid.ps(), pgid.ps() + 1);
 }
 
+bool OSDMapMapping::_get_incremental_work(
+  CephContext *cct,
+  const OSDMap& osdmap,
+  const OSDMap::Incremental& inc,
+  std::set<int64_t> *dirty_pools,
+  std::map<int64_t,std::set<ps_t>> *dirty_pgs)
+{
+  if (inc.fullmap.length() || inc.crush.length() || inc.new_max_osd >= 0) {
+    ldout(cct, 10) << __func__ << " e" << inc.epoch
+		   << " has a full map, crush or max_osd change" << dendl;
+    return false;
+  }
+
+  // pools that are new or whose mapping inputs changed
+  for (auto& p : osdmap.get_pools()) {
+    auto q = pools.find(p.first);
+    if (q == pools.end() || !q->second.same_inputs(p.second)) {
+      dirty_pools->insert(p.first);
+    }
+  }
+
+  // osds whose weight, existence or up-ness changes the CRUSH or
+  // upmap result, and osds whose removal from (or change of affinity
+  // within) the up set only affects the pgs currently mapped to them.
+  std::set<int> remap_osds, mapped_osds;
+  for (auto& p : inc.new_weight) {
+    remap_osds.insert(p.first);
+  }
+  for (auto& p : inc.new_state) {
+    unsigned s = p.second ? p.second : CEPH_OSD_UP;
+    if (s & CEPH_OSD_EXISTS) {
+      remap_osds.insert(p.first);
+    } else if (s & CEPH_OSD_UP) {
+      if (osdmap.is_up(p.first)) {
+	remap_osds.insert(p.first);
+      } else {
+	mapped_osds.insert(p.first);
+      }
+    }
+  }
+  for (auto& p : inc.new_up_client) {
+    remap_osds.insert(p.first);
+  }
+  for (auto& p : inc.new_primary_affinity) {
+    mapped_osds.insert(p.first);
+  }
+
+  auto mark_pg = [&](pg_t pgid) {
+    const pg_pool_t *pi = osdmap.get_pg_pool(pgid.pool());
+    if (pi && pgid.ps() < pi->get_pg_num() &&
+	!dirty_pools->count(pgid.pool())) {
+      (*dirty_pgs)[pgid.pool()].insert(pgid.ps());
+    }
+  };
+
+  for (auto osd : remap_osds) {
+    for (auto& p : osdmap.get_pools()) {
+      if (dirty_pools->count(p.first)) {
+	continue;
+      }
+      int ruleno = osdmap.crush->find_rule(p.second.get_crush_rule(),
+					   p.second.get_type(),
+					   p.second.get_size());
+      if (ruleno < 0) {
+	continue;
+      }
+      for (int step = 0; step < osdmap.crush->get_rule_len(ruleno); ++step) {
+	if (osdmap.crush->get_rule_op(ruleno, step) == CRUSH_RULE_TAKE &&
+	    osdmap.crush->subtree_contains(
+	      osdmap.crush->get_rule_arg1(ruleno, step), osd)) {
+	  ldout(cct, 20) << __func__ << " osd." << osd << " remaps pool "
+			 << p.first << dendl;
+	  dirty_pools->insert(p.first);
+	  break;
+	}
+      }
+    }
+    mapped_osds.insert(osd);
+  }
+
+  std::set<pg_t> override_pgs;
+  for (auto osd : mapped_osds) {
+    osdmap.get_pgs_with_overrides_on(osd, &override_pgs);
+  }
+  for (auto pgid : override_pgs) {
+    mark_pg(pgid);
+  }
+  if (!mapped_osds.empty()) {
+    // a single pass over the tables, whatever the number of osds
+    std::vector<bool> is_mapped(*mapped_osds.rbegin() + 1);
+    for (auto osd : mapped_osds) {
+      if (osd >= 0) {
+	is_mapped[osd] = true;
+      }
+    }
+    for (auto& p : pools) {
+      if (dirty_pools->count(p.first) ||
+	  !osdmap.have_pg_pool(p.first)) {
+	continue;
+      }
+      for (unsigned ps = 0; ps < p.second.pg_num; ++ps) {
+	if (p.second.has_any_osd(ps, is_mapped)) {
+	  (*dirty_pgs)[p.first].insert(ps);
+	}
+      }
+    }
+  }
+
+  // per-pg overrides
+  for (auto& p : inc.new_pg_temp) {
+    mark_pg(p.first);
+  }
+  for (auto& p : inc.new_primary_temp) {
+    mark_pg(p.first);
+  }
+  for (auto& p : inc.new_pg_upmap) {
+    mark_pg(p.first);
+  }
+  for (auto& pgid : inc.old_pg_upmap) {
+    mark_pg(pgid);
+  }
+  for (auto& p : inc.new_pg_upmap_items) {
+    mark_pg(p.first);
+  }
+  for (auto& pgid : inc.old_pg_upmap_items) {
+    mark_pg(pgid);
+  }
+  return true;
+}
+
+bool OSDMapMapping::update_incremental(
+  CephContext *cct,
+  const OSDMap& osdmap,
+  const OSDMap::Incremental& inc,
+  uint64_t max_pgs,
+  bool verify)
+{
+  if (epoch == 0 ||
+      epoch + 1 != inc.epoch ||
+      osdmap.get_epoch() != inc.epoch) {
+    ldout(cct, 10) << __func__ << " mapping is e" << epoch
+		   << ", cannot apply inc e" << inc.epoch
+		   << " to get e" << osdmap.get_epoch() << dendl;
+    return false;
+  }
+
+  std::set<int64_t> dirty_pools;
+  std::map<int64_t,std::set<ps_t>> dirty_pgs;
+  if (!_get_incremental_work(cct, osdmap, inc, &dirty_pools, &dirty_pgs)) {
+    return false;
+  }
+  uint64_t work = 0;
+  for (auto pool : dirty_pools) {
+    work += osdmap.get_pg_pool(pool)->get_pg_num();
+  }
+  for (auto& p : dirty_pgs) {
+    work += p.second.size();
+  }
+  if (max_pgs && work > max_pgs) {
+    ldout(cct, 10) << __func__ << " e" << inc.epoch << " remaps " << work
+		   << " > " << max_pgs << " pgs" << dendl;
+    return false;
+  }
+  ldout(cct, 10) << __func__ << " e" << inc.epoch << " remapping "
+		 << dirty_pools.size() << " pools, " << work << " pgs of "
+		 << num_pgs << dendl;
+
+  _start(osdmap);
+  for (auto pool : dirty_pools) {
+    _update_range(osdmap, pool, 0, osdmap.get_pg_pool(pool)->get_pg_num());
+  }
+  for (auto& p : dirty_pgs) {
+    for (auto ps : p.second) {
+      _update_range(osdmap, p.first, ps, ps + 1);
+    }
+  }
+  _finish(osdmap);
+
+  if (verify && !_verify(cct, osdmap)) {
+    ceph_abort_msg("incremental OSDMapMapping update does not match full update");
+  }
+  return true;
+}
+
+bool OSDMapMapping::_verify(CephContext *cct, const OSDMap& osdmap) const
+{
+  OSDMapMapping full;
+  full.update(osdmap);
+  bool ok = true;
+  for (auto& p : full.pools) {
+    auto q = pools.find(p.first);
+    if (q == pools.end()) {
+      lderr(cct) << __func__ << " missing pool " << p.first << dendl;
+      ok = false;
+      continue;
+    }
+    for (unsigned ps = 0; ps < p.second.pg_num; ++ps) {
+      vector<int> up, acting, up2, acting2;
+      int up_primary, acting_primary, up_primary2, acting_primary2;
+      p.second.get(ps, &up, &up_primary, &acting, &acting_primary);
+      q->second.get(ps, &up2, &up_primary2, &acting2, &acting_primary2);
+      if (up != up2 || up_primary != up_primary2 ||
+	  acting != acting2 || acting_primary != acting_primary2) {
+	lderr(cct) << __func__ << " " << pg_t(ps, p.first)
+		   << " up " << up2 << "/" << up_primary2
+		   << " acting " << acting2 << "/" << acting_primary2
+		   << " != full up " << up << "/" << up_primary
+		   << " acting " << acting << "/" << acting_primary << dendl;
+	ok = false;
+      }
+    }
+  }
+  if (pools.size() != full.pools.size()) {
+    lderr(cct) << __func__ << " have " << pools.size() << " pools, expected "
+	       << full.pools.size() << dendl;
+    ok = false;
+  }
+  return ok;
+}
+
 void OSDMapMapping::_build_rmap(const OSDMap& osdmap)
 {
   acting_rmap.resize(osdmap.get_max_osd());
@@ -112,15 +334,13 @@ void OSDMapMapping::_update_range(
   ceph_assert(i != pools.end());
   ceph_assert(pg_begin <= pg_end);
   ceph_assert(pg_end <= i->second.pg_num);
-  for (unsigned ps = pg_begin; ps < pg_end; ++ps) {
-    vector<int> up, acting;
-    int up_primary, acting_primary;
-    osdmap.pg_to_up_acting_osds(
-      pg_t(ps, pool),
-      &up, &up_primary, &acting, &acting_primary);
-    i->second.set(ps, std::move(up), up_primary,
-		  std::move(acting), acting_primary);
-  }
+  osdmap.pg_range_to_up_acting_osds(
+    pool, pg_begin, pg_end,
+    [&](ps_t ps,
+	vector<int>& up, int up_primary,
+	vector<int>& acting, int acting_primary) {
+      i->second.set(ps, up, up_primary, acting, acting_primary);
+    });
 }
 
 // ---------------------------
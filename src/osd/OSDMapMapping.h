@@ -8,12 +8,11 @@
 #include <vector>
 #include <map>
 
+#include "osd/OSDMap.h"
 #include "osd/osd_types.h"
 #include "common/WorkQueue.h"
 #include "common/Cond.h"
 
-class OSDMap;
-
 /// work queue to perform work on batches of pgids on multiple CPUs
 class ParallelPGMapper {
 public:
@@ -180,6 +179,11 @@ private:
     bool erasure = false;
     mempool::osdmap_mapping::vector<int32_t> table;
 
+    // other pool properties the mapping was calculated from
+    unsigned pgp_num = 0;
+    int crush_rule = -1;
+    bool hashpspool = false;
+
     size_t row_size() const {
       return
 	1 + // acting_primary
@@ -197,6 +201,39 @@ private:
 	table(pg_num * row_size()) {
     }
 
+    void set_inputs(const pg_pool_t& pi) {
+      pgp_num = pi.get_pgp_num();
+      crush_rule = pi.get_crush_rule();
+      hashpspool = pi.has_flag(pg_pool_t::FLAG_HASHPSPOOL);
+    }
+    bool same_inputs(const pg_pool_t& pi) const {
+      return size == pi.get_size() &&
+	pg_num == pi.get_pg_num() &&
+	erasure == pi.is_erasure() &&
+	pgp_num == pi.get_pgp_num() &&
+	crush_rule == pi.get_crush_rule() &&
+	hashpspool == pi.has_flag(pg_pool_t::FLAG_HASHPSPOOL);
+    }
+
+    /// true if any osd flagged in osds is in the up or acting set of pg ps
+    bool has_any_osd(size_t ps, const std::vector<bool>& osds) const {
+      const int32_t *row = &table[row_size() * ps];
+      auto test = [&osds](int32_t osd) {
+	return osd >= 0 && (size_t)osd < osds.size() && osds[osd];
+      };
+      for (int i = 0; i < row[2]; ++i) {
+	if (test(row[4 + i])) {
+	  return true;
+	}
+      }
+      for (int i = 0; i < row[3]; ++i) {
+	if (test(row[4 + size + i])) {
+	  return true;
+	}
+      }
+      return false;
+    }
+
     void get(size_t ps,
 	     std::vector<int> *up,
 	     int *up_primary,
@@ -260,7 +297,18 @@ private:
 
   void _build_rmap(const OSDMap& osdmap);
 
+  bool _get_incremental_work(
+    CephContext *cct,
+    const OSDMap& osdmap,
+    const OSDMap::Incremental& inc,
+    std::set<int64_t> *dirty_pools,
+    std::map<int64_t,std::set<ps_t>> *dirty_pgs);
+  bool _verify(CephContext *cct, const OSDMap& osdmap) const;
+
   void _start(const OSDMap& osdmap) {
+    // the table is inconsistent until _finish(); make sure nobody
+    // applies an incremental on top of a partial (e.g. aborted) update
+    epoch = 0;
     _init_mappings(osdmap);
   }
   void _finish(const OSDMap& osdmap);
@@ -325,6 +373,22 @@ public:
   void update(const OSDMap& map);
   void update(const OSDMap& map, pg_t pgid);
 
+  /**
+   * update a mapping of epoch inc.epoch - 1 to map, the result of
+   * applying inc, recalculating only the pools and pgs inc may remap
+   *
+   * @param max_pgs give up if more than this many pgs need to be
+   *                recalculated (0 for no limit)
+   * @param verify cross-check the result against a full update
+   * @return false, with the mapping left untouched, if a full update
+   *         is needed instead
+   */
+  bool update_incremental(CephContext *cct,
+			  const OSDMap& map,
+			  const OSDMap::Incremental& inc,
+			  uint64_t max_pgs = 0,
+			  bool verify = false);
+
   std::unique_ptr<MappingJob> start_update(
     const OSDMap& map,
     ParallelPGMapper& mapper,
@@ -2294,6 +2294,41 @@ bool PG::requeue_scrub(bool high_priority)
   }
 }
 
+void PG::requeue_scrub_after(double delay)
+{
+  ceph_assert(is_locked());
+  if (delay <= 0) {
+    requeue_scrub();
+    return;
+  }
+  if (scrub_queued) {
+    dout(10) << __func__ << ": already queued" << dendl;
+    return;
+  }
+  dout(10) << __func__ << ": requeueing in " << delay << "s" << dendl;
+
+  // Do an async wait so we don't block the op queue; scrub_queued keeps
+  // anyone else from queueing us in the meantime.
+  scrub_queued = true;
+  OSDService *osds = osd;
+  spg_t pgid = get_pgid();
+  epoch_t epoch = get_osdmap_epoch();
+  auto scrub_requeue_callback =
+    new FunctionContext([osds, pgid, epoch](int r) {
+      PGRef pg = osds->osd->lookup_lock_pg(pgid);
+      if (pg == nullptr) {
+	return;
+      }
+      if (!pg->pg_has_reset_since(epoch)) {
+	pg->scrub_queued = false;
+	pg->requeue_scrub();
+      }
+      pg->unlock();
+    });
+  std::lock_guard l(osd->sleep_lock);
+  osd->sleep_timer.add_event_after(delay, scrub_requeue_callback);
+}
+
 void PG::queue_recovery()
 {
   if (!is_primary() || !is_peered()) {
@@ -4752,12 +4787,17 @@ int PG::build_scrub_map_chunk(
   }
 
   // scan objects
+  const uint64_t max_bytes = cct->_conf->osd_deep_scrub_work_item_bytes;
+  pos.bytes_read = 0;
   while (!pos.done()) {
     int r = get_pgbackend()->be_scan_list(map, pos);
-    if (r == -EINPROGRESS) {
-      return r;
+    if (r == -EINPROGRESS ||
+	(!pos.done() && pos.work_item_done(max_bytes))) {
+      scrubber.read_delay = osd->charge_deep_scrub_reads(pos.bytes_read);
+      return -EINPROGRESS;
     }
   }
+  scrubber.read_delay = osd->charge_deep_scrub_reads(pos.bytes_read);
 
   // finish
   dout(20) << __func__ << " finishing" << dendl;
@@ -5266,7 +5306,7 @@ void PG::chunky_scrub(ThreadPool::TPHandle &handle)
 	  scrubber.deep,
 	  handle);
 	if (ret == -EINPROGRESS) {
-	  requeue_scrub();
+	  requeue_scrub_after(scrubber.read_delay);
 	  done = true;
 	  break;
 	}
@@ -5370,7 +5410,7 @@ void PG::chunky_scrub(ThreadPool::TPHandle &handle)
 	    handle);
 	}
 	if (ret == -EINPROGRESS) {
-	  requeue_scrub();
+	  requeue_scrub_after(scrubber.read_delay);
 	  done = true;
 	  break;
 	}
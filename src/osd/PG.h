@@ -1593,6 +1593,9 @@ public:
     bool needs_sleep = true;
     utime_t sleep_start;
 
+    // delay owed to osd_deep_scrub_max_bytes_per_sec by the last work item
+    double read_delay = 0;
+
     // flags to indicate explicitly requested scrubs (by admin)
     bool must_scrub, must_deep_scrub, must_repair;
 
@@ -1737,6 +1740,7 @@ public:
       sleeping = false;
       needs_sleep = true;
       sleep_start = utime_t();
+      read_delay = 0;
     }
 
     void create_results(const hobject_t& obj);
@@ -2921,6 +2925,7 @@ protected:
   virtual void kick_snap_trim() = 0;
   virtual void snap_trimmer_scrub_complete() = 0;
   bool requeue_scrub(bool high_priority = false);
+  void requeue_scrub_after(double delay);
   void queue_recovery();
   bool queue_scrub();
   unsigned get_scrub_priority();
@@ -611,35 +611,52 @@ int ReplicatedBackend::be_deep_scrub(
       pos.data_hash = bufferhash(-1);
     }
 
-    bufferlist bl;
-    r = store->read(
-      ch,
-      ghobject_t(
-	poid, ghobject_t::NO_GEN, get_parent()->whoami_shard().shard),
-      pos.data_pos,
-      cct->_conf->osd_deep_scrub_stride, bl,
-      fadvise_flags);
-    if (r < 0) {
-      dout(20) << __func__ << "  " << poid << " got "
-	       << r << " on read, read_error" << dendl;
-      o.read_error = true;
-      return 0;
-    }
-    if (r > 0) {
-      pos.data_hash << bl;
-    }
-    pos.data_pos += r;
-    if (r == cct->_conf->osd_deep_scrub_stride) {
-      dout(20) << __func__ << "  " << poid << " more data, digest so far 0x"
-	       << std::hex << pos.data_hash.digest() << std::dec << dendl;
-      return -EINPROGRESS;
+    // a store that verifies its own checksums on read will return EIO
+    // for damaged data; reading it all is enough to find media errors.
+    const bool use_store_csum =
+      cct->_conf->osd_deep_scrub_use_store_csum && store->has_builtin_csum();
+    const int stride = cct->_conf->osd_deep_scrub_stride;
+    const uint64_t max_bytes = cct->_conf->osd_deep_scrub_work_item_bytes;
+    while (true) {
+      bufferlist bl;
+      r = store->read(
+	ch,
+	ghobject_t(
+	  poid, ghobject_t::NO_GEN, get_parent()->whoami_shard().shard),
+	pos.data_pos,
+	stride, bl,
+	fadvise_flags);
+      if (r < 0) {
+	dout(20) << __func__ << "  " << poid << " got "
+		 << r << " on read, read_error" << dendl;
+	o.read_error = true;
+	return 0;
+      }
+      if (r > 0 && !use_store_csum) {
+	pos.data_hash << bl;
+      }
+      pos.data_pos += r;
+      pos.bytes_read += r;
+      if (r != stride) {
+	break;
+      }
+      if (pos.work_item_done(max_bytes)) {
+	dout(20) << __func__ << "  " << poid << " more data, digest so far 0x"
+		 << std::hex << pos.data_hash.digest() << std::dec << dendl;
+	return -EINPROGRESS;
+      }
     }
     // done with bytes
     pos.data_pos = -1;
-    o.digest = pos.data_hash.digest();
-    o.digest_present = true;
-    dout(20) << __func__ << "  " << poid << " done with data, digest 0x"
-	     << std::hex << o.digest << std::dec << dendl;
+    if (use_store_csum) {
+      dout(20) << __func__ << "  " << poid
+	       << " done with data, verified by store checksums" << dendl;
+    } else {
+      o.digest = pos.data_hash.digest();
+      o.digest_present = true;
+      dout(20) << __func__ << "  " << poid << " done with data, digest 0x"
+	       << std::hex << o.digest << std::dec << dendl;
+    }
   }
 
   // omap header
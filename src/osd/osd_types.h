@@ -866,6 +866,38 @@ public:
 };
 WRITE_CLASS_ENCODER(eversion_t)
 
+// the same fixed 12-byte layout as the legacy encoding, so that eversion_t
+// can be used in DENC structures and containers
+template<>
+struct denc_traits<eversion_t> {
+  static constexpr bool supported = true;
+  static constexpr bool featured = false;
+  static constexpr bool bounded = true;
+  static constexpr bool need_contiguous =
+    !_denc::has_legacy_denc<eversion_t>::value;
+  static void bound_encode(const eversion_t& v, size_t& p) {
+    p += sizeof(version_t) + sizeof(epoch_t);
+  }
+  static void encode(const eversion_t& v,
+		     bufferlist::contiguous_appender& p) {
+#if defined(CEPH_LITTLE_ENDIAN)
+    p.append((const char *)&v, sizeof(version_t) + sizeof(epoch_t));
+#else
+    denc(v.version, p);
+    denc(v.epoch, p);
+#endif
+  }
+  static void decode(eversion_t& v, bufferptr::const_iterator& p) {
+#if defined(CEPH_LITTLE_ENDIAN)
+    memcpy((char *)&v, p.get_pos_add(sizeof(version_t) + sizeof(epoch_t)),
+	   sizeof(version_t) + sizeof(epoch_t));
+#else
+    denc(v.version, p);
+    denc(v.epoch, p);
+#endif
+  }
+};
+
 inline bool operator==(const eversion_t& l, const eversion_t& r) {
   return (l.epoch == r.epoch) && (l.version == r.version);
 }
@@ -5313,6 +5345,7 @@ struct ScrubMapBuilder {
   bufferhash data_hash, omap_hash;  ///< accumulatinng hash value
   uint64_t omap_keys = 0;
   uint64_t omap_bytes = 0;
+  uint64_t bytes_read = 0;  ///< object data read in this work item
 
   bool empty() {
     return ls.empty();
@@ -5328,6 +5361,11 @@ struct ScrubMapBuilder {
     return data_pos < 0;
   }
 
+  /// true once this work item has read at least max_bytes of object data
+  bool work_item_done(uint64_t max_bytes) const {
+    return bytes_read > 0 && bytes_read >= max_bytes;
+  }
+
   void next_object() {
     ++pos;
     data_pos = 0;
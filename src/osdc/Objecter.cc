@@ -1003,6 +1003,50 @@ bool Objecter::ms_dispatch(Message *m)
   return false;
 }
 
+Objecter::target_changes_t::target_changes_t(
+  const OSDMap::Incremental& inc,
+  bool skipped_map)
+{
+  // the epochs we skipped may have changed anything.  so may anything
+  // that can move pgs between osds.
+  all = skipped_map ||
+    inc.fullmap.length() || inc.crush.length() || inc.new_flags >= 0 ||
+    inc.new_max_osd >= 0 || !inc.new_up_client.empty() ||
+    !inc.new_state.empty() || !inc.new_weight.empty() ||
+    !inc.new_primary_affinity.empty();
+  if (all) {
+    return;
+  }
+
+  for (auto& p : inc.new_pools) {
+    pools.insert(p.first);
+  }
+  pools.insert(inc.old_pools.begin(), inc.old_pools.end());
+
+  for (auto& p : inc.new_pg_temp) {
+    pgs.insert(p.first);
+  }
+  for (auto& p : inc.new_primary_temp) {
+    pgs.insert(p.first);
+  }
+  for (auto& p : inc.new_pg_upmap) {
+    pgs.insert(p.first);
+  }
+  for (auto& p : inc.new_pg_upmap_items) {
+    pgs.insert(p.first);
+  }
+  pgs.insert(inc.old_pg_upmap.begin(), inc.old_pg_upmap.end());
+  pgs.insert(inc.old_pg_upmap_items.begin(), inc.old_pg_upmap_items.end());
+}
+
+bool Objecter::target_changes_t::may_change(const op_target_t& t) const
+{
+  // unmapped and paused targets are always rechecked
+  return all || t.osd < 0 || t.paused ||
+    pools.count(t.base_oloc.pool) || pools.count(t.target_oloc.pool) ||
+    pgs.count(t.actual_pgid.pgid);
+}
+
 void Objecter::_scan_requests(
   OSDSession *s,
   bool skipped_map,
@@ -1012,7 +1056,8 @@ void Objecter::_scan_requests(
   list<LingerOp*>& need_resend_linger,
   map<ceph_tid_t, CommandOp*>& need_resend_command,
   shunique_lock& sul,
-  const mempool::osdmap::map<int64_t,OSDMap::snap_interval_set_t> *gap_removed_snaps)
+  const mempool::osdmap::map<int64_t,OSDMap::snap_interval_set_t> *gap_removed_snaps,
+  const target_changes_t *changes)
 {
   ceph_assert(sul.owns_lock() && sul.mutex() == &rwlock);
 
@@ -1030,7 +1075,13 @@ void Objecter::_scan_requests(
     ++lp;
     ldout(cct, 10) << " checking linger op " << op->linger_id << dendl;
     bool unregister, force_resend_writes = cluster_full;
-    int r = _recalc_linger_op_target(op, sul);
+    int r;
+    if (changes && !changes->may_change(op->target)) {
+      op->target.epoch = osdmap->get_epoch();
+      r = RECALC_OP_TARGET_NO_ACTION;
+    } else {
+      r = _recalc_linger_op_target(op, sul);
+    }
     if (pool_full_map)
       force_resend_writes = force_resend_writes ||
 	(*pool_full_map)[op->target.base_oloc.pool];
@@ -1069,8 +1120,15 @@ void Objecter::_scan_requests(
     if (pool_full_map)
       force_resend_writes = force_resend_writes ||
 	(*pool_full_map)[op->target.base_oloc.pool];
-    int r = _calc_target(&op->target,
-			 op->session ? op->session->con.get() : nullptr);
+    int r;
+    if (changes && !changes->may_change(op->target)) {
+      // the map did not touch this op's pool or pg
+      op->target.epoch = osdmap->get_epoch();
+      r = RECALC_OP_TARGET_NO_ACTION;
+    } else {
+      r = _calc_target(&op->target,
+		       op->session ? op->session->con.get() : nullptr);
+    }
     switch (r) {
     case RECALC_OP_TARGET_NO_ACTION:
       if (!skipped_map && !(force_resend_writes && op->respects_full()))
@@ -1171,6 +1229,7 @@ void Objecter::handle_osd_map(MOSDMap *m)
       for (epoch_t e = osdmap->get_epoch() + 1;
 	   e <= m->get_last();
 	   e++) {
+	target_changes_t changes;
 
 	if (osdmap->get_epoch() == e-1 &&
 	    m->incremental_maps.count(e)) {
@@ -1178,6 +1237,7 @@ void Objecter::handle_osd_map(MOSDMap *m)
 			<< dendl;
 	  OSDMap::Incremental inc(m->incremental_maps[e]);
 	  osdmap->apply_incremental(inc);
+	  changes = target_changes_t(inc, skipped_map);
 
           emit_blacklist_events(inc);
 
@@ -1213,6 +1273,14 @@ void Objecter::handle_osd_map(MOSDMap *m)
 	cluster_full = cluster_full || _osdmap_full_flag();
 	update_pool_full_map(pool_full_map);
 
+	// targets may become paused waiting for the epoch barrier
+	if (osdmap->get_epoch() < epoch_barrier) {
+	  changes = target_changes_t();
+	}
+	ldout(cct, 10) << "handle_osd_map rechecking "
+		       << (changes.all ? "all" : "changed") << " op targets"
+		       << dendl;
+
 	// check all outstanding requests on every epoch
 	for (auto& i : need_resend) {
 	  _prune_snapc(osdmap->get_new_removed_snaps(), i.second);
@@ -1223,14 +1291,14 @@ void Objecter::handle_osd_map(MOSDMap *m)
 	_scan_requests(homeless_session, skipped_map, cluster_full,
 		       &pool_full_map, need_resend,
 		       need_resend_linger, need_resend_command, sul,
-		       &m->gap_removed_snaps);
+		       &m->gap_removed_snaps, &changes);
 	for (map<int,OSDSession*>::iterator p = osd_sessions.begin();
 	     p != osd_sessions.end(); ) {
 	  OSDSession *s = p->second;
 	  _scan_requests(s, skipped_map, cluster_full,
 			 &pool_full_map, need_resend,
 			 need_resend_linger, need_resend_command, sul,
-			 &m->gap_removed_snaps);
+			 &m->gap_removed_snaps, &changes);
 	  ++p;
 	  // osd down or addr change?
 	  if (!osdmap->is_up(s->osd) ||
@@ -1251,7 +1319,7 @@ void Objecter::handle_osd_map(MOSDMap *m)
 	  OSDSession *s = p->second;
 	  _scan_requests(s, false, false, NULL, need_resend,
 			 need_resend_linger, need_resend_command, sul,
-			 nullptr);
+			 nullptr, nullptr);
 	}
 	ldout(cct, 3) << "handle_osd_map decoding full epoch "
 		      << m->get_last() << dendl;
@@ -1259,7 +1327,7 @@ void Objecter::handle_osd_map(MOSDMap *m)
 
 	_scan_requests(homeless_session, false, false, NULL,
 		       need_resend, need_resend_linger,
-		       need_resend_command, sul, nullptr);
+		       need_resend_command, sul, nullptr, nullptr);
       } else {
 	ldout(cct, 3) << "handle_osd_map hmm, i want a full map, requesting"
 		      << dendl;
@@ -2276,6 +2344,12 @@ void Objecter::_op_submit_with_budget(Op *op, shunique_lock& sul,
     }
   }
 
+  _op_start_timeout(op);
+  _op_submit(op, sul, ptid);
+}
+
+void Objecter::_op_start_timeout(Op *op)
+{
   if (osd_timeout > timespan(0)) {
     if (op->tid == 0)
       op->tid = ++last_tid;
@@ -2284,8 +2358,105 @@ void Objecter::_op_submit_with_budget(Op *op, shunique_lock& sul,
 				    [this, tid]() {
 				      op_cancel(tid, -ETIMEDOUT); });
   }
+}
 
-  _op_submit(op, sul, ptid);
+bool Objecter::_op_budget_would_block(Op *op)
+{
+  if (!keep_balanced_budget || op->ctx_budgeted) {
+    return false;
+  }
+  int64_t max_ops = op_throttle_ops.get_max();
+  int64_t max_bytes = op_throttle_bytes.get_max();
+  return (max_ops > 0 && op_throttle_ops.get_current() + 1 > max_ops) ||
+    (max_bytes > 0 &&
+     op_throttle_bytes.get_current() + calc_op_budget(op->ops) > max_bytes);
+}
+
+void Objecter::op_submit_batch(const vector<Op*>& ops)
+{
+  shunique_lock sul(rwlock, ceph::acquire_shared);
+  ceph_assert(initialized);
+
+  vector<Op*> pending;
+  pending.reserve(ops.size());
+  for (auto op : ops) {
+    ceph_assert(op->ops.size() == op->out_bl.size());
+    ceph_assert(op->ops.size() == op->out_rval.size());
+    ceph_assert(op->ops.size() == op->out_handler.size());
+
+    // ops holding budget must be on their way before we block for more
+    if (!pending.empty() && _op_budget_would_block(op)) {
+      _op_submit_grouped(pending, sul);
+      pending.clear();
+    }
+
+    op->trace.event("op submit");
+    if (!op->ctx_budgeted) {
+      _take_op_budget(op, sul);
+    }
+    _op_start_timeout(op);
+    pending.push_back(op);
+  }
+  _op_submit_grouped(pending, sul);
+}
+
+void Objecter::_op_submit_grouped(const vector<Op*>& ops, shunique_lock& sul)
+{
+  // rwlock is locked
+
+  // map every op first so that each session lock is taken once for all
+  // of the ops sent to that osd
+  epoch_t epoch = osdmap->get_epoch();
+  map<int, vector<Op*> > osd_ops;
+  vector<Op*> pool_dne_ops;
+  for (auto op : ops) {
+    ceph_assert(op->session == NULL);
+    if (_calc_target(&op->target, nullptr) == RECALC_OP_TARGET_POOL_DNE) {
+      pool_dne_ops.push_back(op);
+    } else {
+      osd_ops[op->target.osd].push_back(op);
+    }
+  }
+
+  for (auto& p : osd_ops) {
+    OSDSession *s = NULL;
+    if (osdmap->get_epoch() != epoch ||
+	_get_session(p.first, &s, sul) < 0) {
+      // a new session or a newer map needs the regular path, which may
+      // relock and remaps each op
+      for (auto op : p.second) {
+	_op_submit(op, sul, nullptr);
+      }
+      continue;
+    }
+
+    OSDSession::unique_lock sl(s->lock);
+    for (auto op : p.second) {
+      _send_op_account(op);
+      bool need_send = _op_should_send(op, s);
+      if (op->tid == 0)
+	op->tid = ++last_tid;
+
+      ldout(cct, 10) << __func__ << " oid " << op->target.base_oid
+		     << " '" << op->target.base_oloc << "' "
+		     << op->ops << " tid " << op->tid << " osd."
+		     << (!s->is_homeless() ? s->osd : -1) << dendl;
+
+      _session_op_assign(s, op);
+      if (need_send) {
+	_send_op(op);
+      }
+    }
+    sl.unlock();
+    put_session(s);
+  }
+
+  // these need a map check
+  for (auto op : pool_dne_ops) {
+    _op_submit(op, sul, nullptr);
+  }
+
+  ldout(cct, 5) << num_in_flight << " in flight" << dendl;
 }
 
 void Objecter::_send_op_account(Op *op)
@@ -2404,7 +2575,43 @@ void Objecter::_op_submit(Op *op, shunique_lock& sul, ceph_tid_t *ptid)
 
   _send_op_account(op);
 
-  // send?
+  bool need_send = _op_should_send(op, s);
+
+  OSDSession::unique_lock sl(s->lock);
+  if (op->tid == 0)
+    op->tid = ++last_tid;
+
+  ldout(cct, 10) << "_op_submit oid " << op->target.base_oid
+		 << " '" << op->target.base_oloc << "' '"
+		 << op->target.target_oloc << "' " << op->ops << " tid "
+		 << op->tid << " osd." << (!s->is_homeless() ? s->osd : -1)
+		 << dendl;
+
+  _session_op_assign(s, op);
+
+  if (need_send) {
+    _send_op(op);
+  }
+
+  // Last chance to touch Op here, after giving up session lock it can
+  // be freed at any time by response handler.
+  ceph_tid_t tid = op->tid;
+  if (check_for_latest_map) {
+    _send_op_map_check(op);
+  }
+  if (ptid)
+    *ptid = tid;
+  op = NULL;
+
+  sl.unlock();
+  put_session(s);
+
+  ldout(cct, 5) << num_in_flight << " in flight" << dendl;
+}
+
+bool Objecter::_op_should_send(Op *op, OSDSession *s)
+{
+  // rwlock is locked
 
   ceph_assert(op->target.flags & (CEPH_OSD_FLAG_READ|CEPH_OSD_FLAG_WRITE));
 
@@ -2443,37 +2650,7 @@ void Objecter::_op_submit(Op *op, shunique_lock& sul, ceph_tid_t *ptid)
   } else {
     _maybe_request_map();
   }
-
-  OSDSession::unique_lock sl(s->lock);
-  if (op->tid == 0)
-    op->tid = ++last_tid;
-
-  ldout(cct, 10) << "_op_submit oid " << op->target.base_oid
-		 << " '" << op->target.base_oloc << "' '"
-		 << op->target.target_oloc << "' " << op->ops << " tid "
-		 << op->tid << " osd." << (!s->is_homeless() ? s->osd : -1)
-		 << dendl;
-
-  _session_op_assign(s, op);
-
-  if (need_send) {
-    _send_op(op);
-  }
-
-  // Last chance to touch Op here, after giving up session lock it can
-  // be freed at any time by response handler.
-  ceph_tid_t tid = op->tid;
-  if (check_for_latest_map) {
-    _send_op_map_check(op);
-  }
-  if (ptid)
-    *ptid = tid;
-  op = NULL;
-
-  sl.unlock();
-  put_session(s);
-
-  ldout(cct, 5) << num_in_flight << " in flight" << dendl;
+  return need_send;
 }
 
 int Objecter::op_cancel(OSDSession *s, ceph_tid_t tid, int r)
@@ -1337,6 +1337,22 @@ public:
     void dump(Formatter *f) const;
   };
 
+  /**
+   * The op targets an incremental map may remap: all of them if it
+   * touches osds, crush or flags or follows skipped epochs, otherwise
+   * only those in the pools and pgs it changes.
+   */
+  struct target_changes_t {
+    bool all = true;
+    std::set<int64_t> pools;
+    std::set<pg_t> pgs;
+
+    target_changes_t() = default;
+    target_changes_t(const OSDMap::Incremental& inc, bool skipped_map);
+
+    bool may_change(const op_target_t& t) const;
+  };
+
   struct Op : public RefCountedObject {
     OSDSession *session;
     int incarnation;
@@ -2083,7 +2099,8 @@ private:
     list<LingerOp*>& need_resend_linger,
     map<ceph_tid_t, CommandOp*>& need_resend_command,
     shunique_lock& sul,
-    const mempool::osdmap::map<int64_t,OSDMap::snap_interval_set_t> *gap_removed_snaps);
+    const mempool::osdmap::map<int64_t,OSDMap::snap_interval_set_t> *gap_removed_snaps,
+    const target_changes_t *changes);
 
   int64_t get_object_hash_position(int64_t pool, const string& key,
 				   const string& ns);
@@ -2145,9 +2162,20 @@ private:
   void _op_submit_with_budget(Op *op, shunique_lock& lc,
 			      ceph_tid_t *ptid,
 			      int *ctx_budget = NULL);
+  void _op_start_timeout(Op *op);
+  bool _op_should_send(Op *op, OSDSession *s);
+  bool _op_budget_would_block(Op *op);
+  void _op_submit_grouped(const vector<Op*>& ops, shunique_lock& lc);
   // public interface
 public:
   void op_submit(Op *op, ceph_tid_t *ptid = NULL, int *ctx_budget = NULL);
+  /**
+   * Submit several ops at once.  The ops are mapped together under a
+   * single acquisition of the map lock and are handed to each OSD
+   * session back to back.  Their tids are not returned: an op may be
+   * freed as soon as it has been sent.
+   */
+  void op_submit_batch(const vector<Op*>& ops);
   bool is_active() {
     shared_lock l(rwlock);
     return !((!inflight_ops) && linger_ops.empty() &&
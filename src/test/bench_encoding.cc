@@ -0,0 +1,164 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <new>
+
+#include "common/ceph_argparse.h"
+#include "global/global_init.h"
+#include "include/buffer.h"
+#include "messages/MOSDOp.h"
+#include "messages/MOSDOpReply.h"
+#include "osd/osd_types.h"
+
+// encodes and decodes the messages and structures on the hot path of the
+// OSD, and reports the time and the allocations spent per item. heap
+// allocations are counted through operator new, which covers the nodes of
+// bufferlists and most raws, but not the raw_combined buffers backing small
+// appends, as they are allocated with posix_memalign. run with
+// CEPH_BUFFER_TRACK=true to have the buffers allocated counted as well.
+
+static std::atomic<uint64_t> num_new = {0};
+
+void* operator new(size_t size)
+{
+  num_new.fetch_add(1, std::memory_order_relaxed);
+  if (void* p = std::malloc(size); p) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+  std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+  std::free(p);
+}
+
+static void bench(const char* name, unsigned n,
+		  const std::function<void()>& func)
+{
+  const auto news = num_new.load();
+  const auto raws = buffer::get_history_alloc_num();
+  const auto start = std::chrono::steady_clock::now();
+  for (unsigned i = 0; i < n; i++) {
+    func();
+  }
+  std::chrono::duration<double, std::nano> elapsed =
+    std::chrono::steady_clock::now() - start;
+  std::cout << std::left << std::setw(24) << name << std::right
+	    << std::fixed << std::setprecision(1)
+	    << std::setw(10) << elapsed.count() / n << " ns"
+	    << std::setw(8) << double(num_new.load() - news) / n << " new"
+	    << std::setw(8)
+	    << double(buffer::get_history_alloc_num() - raws) / n
+	    << " buffers" << std::endl;
+}
+
+static const uint64_t features = CEPH_FEATURES_SUPPORTED_DEFAULT;
+
+static MOSDOp* make_osd_op(const bufferlist& data)
+{
+  hobject_t hobj(object_t("rbd_data.1234.0000000000000001"), "",
+		 CEPH_NOSNAP, 0x1234, 1, "");
+  spg_t pgid(pg_t(0x34, 1));
+  auto m = new MOSDOp(1, 1, hobj, pgid, 1, CEPH_OSD_FLAG_WRITE, features);
+  m->set_reqid(osd_reqid_t(entity_name_t::CLIENT(1), 1, 1));
+  m->set_mtime(ceph_clock_now());
+  m->set_snap_seq(0);
+  m->set_snaps({});
+  bufferlist bl(data);
+  m->write(0, bl.length(), bl);
+  return m;
+}
+
+static void bench_osd_op(unsigned n)
+{
+  bufferlist data;
+  data.append(buffer::create_page_aligned(4096));
+  bench("MOSDOp encode", n, [&data] {
+    auto m = make_osd_op(data);
+    m->encode(features, 0);
+    m->put();
+  });
+
+  auto m = make_osd_op(data);
+  m->encode(features, 0);
+  bench("MOSDOp decode", n, [m] {
+    auto d = new MOSDOp;
+    d->set_header(m->get_header());
+    bufferlist payload(m->get_payload());
+    d->set_payload(payload);
+    d->set_data(m->get_data());
+    d->decode_payload();
+    d->finish_decode();
+    d->put();
+  });
+
+  auto r = new MOSDOpReply(m, 0, 1, CEPH_OSD_FLAG_ONDISK, true);
+  bench("MOSDOpReply encode", n, [m] {
+    auto r = new MOSDOpReply(m, 0, 1, CEPH_OSD_FLAG_ONDISK, true);
+    r->encode(features, 0);
+    r->put();
+  });
+  r->encode(features, 0);
+  bench("MOSDOpReply decode", n, [r] {
+    auto d = new MOSDOpReply;
+    d->set_header(r->get_header());
+    bufferlist payload(r->get_payload());
+    d->set_payload(payload);
+    d->decode_payload();
+    d->put();
+  });
+  r->put();
+  m->put();
+}
+
+static void bench_pg_log_entry(unsigned n)
+{
+  hobject_t hobj(object_t("rbd_data.1234.0000000000000001"), "",
+		 CEPH_NOSNAP, 0x1234, 1, "");
+  pg_log_entry_t e(pg_log_entry_t::MODIFY, hobj,
+		   eversion_t(1, 2), eversion_t(1, 1), 2,
+		   osd_reqid_t(entity_name_t::CLIENT(1), 1, 1),
+		   ceph_clock_now(), 0);
+  bench("pg_log_entry_t encode", n, [&e] {
+    bufferlist bl;
+    encode(e, bl);
+  });
+  bufferlist bl;
+  encode(e, bl);
+  bench("pg_log_entry_t decode", n, [&bl] {
+    pg_log_entry_t d;
+    auto p = bl.cbegin();
+    decode(d, p);
+  });
+}
+
+int main(int argc, const char **argv)
+{
+  vector<const char*> args;
+  argv_to_vec(argc, argv, args);
+  auto cct = global_init(NULL, args, CEPH_ENTITY_TYPE_CLIENT,
+			 CODE_ENVIRONMENT_UTILITY,
+			 CINIT_FLAG_NO_DEFAULT_CONFIG_FILE);
+  common_init_finish(g_ceph_context);
+
+  unsigned n = 100000;
+  if (!args.empty()) {
+    n = std::stoul(args[0]);
+  }
+  std::cout << n << " iterations per item" << std::endl;
+  bench_osd_op(n);
+  bench_pg_log_entry(n);
+  return 0;
+}
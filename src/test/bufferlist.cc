@@ -2171,6 +2171,55 @@ TEST(BufferList, append_zero) {
   EXPECT_EQ('\0', bl[1]);
 }
 
+TEST(BufferList, append_node_in_raw) {
+  // the node of the first segment appended from a raw we hold the only
+  // reference to is placed in that raw
+  bufferlist copy;
+  {
+    bufferlist bl;
+    bl.append("abc", 3);
+    copy = bl;
+    bl.append("def", 3);
+    EXPECT_EQ((unsigned)1, bl.get_num_buffers());
+    EXPECT_EQ("abcdef", bl.to_str());
+  }
+  EXPECT_EQ("abc", copy.to_str());
+  {
+    bufferptr bp("xyz", 3);
+    bufferlist bl;
+    bl.append(std::move(bp));
+    bufferlist other = bl;
+    bl.clear();
+    EXPECT_EQ("xyz", other.to_str());
+    bl.claim_append(other);
+    EXPECT_EQ("xyz", bl.to_str());
+  }
+}
+
+TEST(BufferList, append_node_unshareable) {
+  // make_shareable() replaces an unshareable raw with a copy, so the node
+  // linking it must not live in the raw being replaced
+  bufferlist bl;
+  {
+    bufferptr bp(buffer::create_unshareable(3));
+    memcpy(bp.c_str(), "abc", 3);
+    bl.append(std::move(bp));
+  }
+  {
+    bufferptr bp(buffer::create_unshareable(3));
+    memcpy(bp.c_str(), "def", 3);
+    bl.push_back(std::move(bp));
+  }
+  const char *before = bl.front().c_str();
+  bl.make_shareable();
+  EXPECT_NE(before, bl.front().c_str());
+  EXPECT_EQ((unsigned)2, bl.get_num_buffers());
+  EXPECT_EQ("abcdef", bl.to_str());
+  bufferlist copy = bl;
+  bl.clear();
+  EXPECT_EQ("abcdef", copy.to_str());
+}
+
 TEST(BufferList, operator_brackets) {
   bufferlist bl;
   EXPECT_THROW(bl[1], buffer::end_of_buffer);
@@ -2439,6 +2488,47 @@ TEST(BufferList, crc32c_zeros) {
   }
 }
 
+TEST(BufferList, crc32c_blocks) {
+  const unsigned block = 4096;
+  bufferptr a(block * 4 + 100);
+  for (unsigned i = 0; i < a.length(); i++)
+    a[i] = i * 7;
+  bufferlist bl;
+  bl.append(a);
+  bl.append(bufferptr(a, 0, 10));  // shorter than a block, not cached
+
+  bufferlist ref;
+  ref.append(a.c_str(), a.length());
+  ref.append(a.c_str(), 10);
+  EXPECT_EQ(ref.crc32c(123), bl.crc32c_blocks(123, block));
+
+  // block-aligned chunks are answered from the recorded crcs, for any seed
+  for (uint32_t seed : {(uint32_t)-1, (uint32_t)0, (uint32_t)77}) {
+    auto p = bl.cbegin();
+    auto q = ref.cbegin();
+    p.advance(block);
+    q.advance(block);
+    EXPECT_EQ(q.crc32c(block, seed), p.crc32c(block, seed));
+    EXPECT_EQ(q.get_off(), p.get_off());
+    EXPECT_EQ(q.crc32c(block, seed), p.crc32c(block, seed));
+  }
+  // other geometries fall back to computing
+  {
+    auto p = bl.cbegin();
+    auto q = ref.cbegin();
+    p.advance(100u);
+    q.advance(100u);
+    EXPECT_EQ(q.crc32c(block, -1), p.crc32c(block, -1));
+    EXPECT_EQ(q.crc32c(block / 2, -1), p.crc32c(block / 2, -1));
+  }
+  // modifying the buffer drops the recorded crcs
+  a.zero();
+  ref.clear();
+  ref.append(a.c_str(), a.length());
+  auto p = bl.cbegin();
+  EXPECT_EQ(ref.cbegin().crc32c(block, -1), p.crc32c(block, -1));
+}
+
 TEST(BufferList, crc32c_append_perf) {
   int len = 256 * 1024 * 1024;
   bufferptr a(len);
@@ -32,3 +32,36 @@ TEST(util, collect_sys_info)
   cct->put();
 }
 #endif
+
+TEST(util, parse_cpu_list)
+{
+  vector<int> cpus;
+  ASSERT_EQ(0, parse_cpu_list("", &cpus));
+  ASSERT_TRUE(cpus.empty());
+
+  ASSERT_EQ(0, parse_cpu_list("3", &cpus));
+  ASSERT_EQ(vector<int>({3}), cpus);
+
+  ASSERT_EQ(0, parse_cpu_list("0-3,8-9", &cpus));
+  ASSERT_EQ(vector<int>({0, 1, 2, 3, 8, 9}), cpus);
+
+  ASSERT_EQ(0, parse_cpu_list("5,5-5", &cpus));
+  ASSERT_EQ(vector<int>({5}), cpus);
+
+  // duplicates and overlapping ranges are merged
+  ASSERT_EQ(0, parse_cpu_list("4-6,0,5,2-4\n", &cpus));
+  ASSERT_EQ(vector<int>({0, 2, 3, 4, 5, 6}), cpus);
+}
+
+TEST(util, parse_cpu_list_invalid)
+{
+  vector<int> cpus = {1};
+  ASSERT_EQ(-EINVAL, parse_cpu_list("a", &cpus));
+  ASSERT_EQ(-EINVAL, parse_cpu_list("1,b", &cpus));
+  ASSERT_EQ(-EINVAL, parse_cpu_list("-1", &cpus));
+  ASSERT_EQ(-EINVAL, parse_cpu_list("3-1", &cpus));
+  ASSERT_EQ(-EINVAL, parse_cpu_list("1-", &cpus));
+  ASSERT_EQ(-EINVAL, parse_cpu_list("1-2-3", &cpus));
+  // a malformed list leaves the output alone
+  ASSERT_EQ(vector<int>({1}), cpus);
+}
@@ -0,0 +1,238 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "common/ceph_argparse.h"
+#include "common/ceph_mutex.h"
+#include "common/Thread.h"
+#include "global/global_init.h"
+#include "messages/MOSDOp.h"
+#include "messages/MOSDOpReply.h"
+#include "msg/Dispatcher.h"
+#include "msg/Messenger.h"
+
+#include "perf_msgr_report.h"
+
+using perf_msgr::perf_clock;
+
+// the workload of perf_crimson_msgr over the classic messenger: write ops
+// of a given size are sent by one or more clients over loopback to a server
+// replying to each of them, while at most "depth" ops per client are in
+// flight. the messenger type is ms_type, or ms_public_type if set.
+
+namespace {
+
+class ServerDispatcher : public Dispatcher {
+ public:
+  explicit ServerDispatcher(CephContext *cct) : Dispatcher(cct) {}
+  bool ms_can_fast_dispatch_any() const override { return true; }
+  bool ms_can_fast_dispatch(const Message *m) const override {
+    return m->get_type() == CEPH_MSG_OSD_OP;
+  }
+  void ms_fast_dispatch(Message *m) override {
+    MOSDOp *osd_op = static_cast<MOSDOp*>(m);
+    MOSDOpReply *reply = new MOSDOpReply(osd_op, 0, 0, 0, false);
+    m->get_connection()->send_message(reply);
+    m->put();
+  }
+  bool ms_dispatch(Message *m) override { return true; }
+  bool ms_handle_reset(Connection *con) override { return true; }
+  void ms_handle_remote_reset(Connection *con) override {}
+  bool ms_handle_refused(Connection *con) override { return false; }
+  int ms_handle_authentication(Connection *con) override {
+    return 1;
+  }
+};
+
+class Client : public Dispatcher, public Thread {
+  const unsigned ops;
+  const unsigned depth;
+  const unsigned msg_len;
+  Messenger *msgr;
+  ConnectionRef conn;
+  bufferlist data;
+
+  ceph::mutex lock = ceph::make_mutex("perf_async_msgr::Client::lock");
+  ceph::condition_variable cond;
+  unsigned inflight = 0;
+  std::deque<perf_clock::time_point> sent;
+
+  Message *make_op(ceph_tid_t tid) {
+    const object_t oid{"object-name"};
+    hobject_t hobj{oid, "", CEPH_NOSNAP, 0, 1, ""};
+    spg_t pgid{pg_t{0, 1}};
+    auto m = new MOSDOp(0, tid, hobj, pgid, 0, 0, 0);
+    bufferlist bl{data};
+    m->write(0, msg_len, bl);
+    return m;
+  }
+
+ public:
+  std::vector<double> latencies;
+
+  Client(CephContext *cct, const std::string& type, unsigned id,
+	 unsigned ops, unsigned depth, unsigned msg_len)
+    : Dispatcher(cct), ops(ops), depth(depth), msg_len(msg_len) {
+    msgr = Messenger::create(cct, type, entity_name_t::CLIENT(id),
+			     "client", getpid() + id, 0);
+    msgr->set_default_policy(Messenger::Policy::lossless_client(0));
+    msgr->add_dispatcher_head(this);
+    data.append_zero(msg_len);
+    latencies.reserve(ops);
+  }
+  ~Client() override {
+    delete msgr;
+  }
+
+  void connect(const entity_addr_t& addr) {
+    msgr->start();
+    conn = msgr->connect_to_osd(entity_addrvec_t(addr));
+  }
+  void shutdown() {
+    msgr->shutdown();
+    msgr->wait();
+  }
+
+  void *entry() override {
+    std::unique_lock l{lock};
+    for (unsigned i = 0; i < ops; ++i) {
+      cond.wait(l, [this] { return inflight < depth; });
+      inflight++;
+      sent.push_back(perf_clock::now());
+      conn->send_message(make_op(i + 1));
+    }
+    cond.wait(l, [this] { return latencies.size() == ops; });
+    return 0;
+  }
+
+  bool ms_can_fast_dispatch_any() const override { return true; }
+  bool ms_can_fast_dispatch(const Message *m) const override {
+    return m->get_type() == CEPH_MSG_OSD_OPREPLY;
+  }
+  void ms_fast_dispatch(Message *m) override {
+    auto now = perf_clock::now();
+    m->put();
+    std::lock_guard l{lock};
+    // replies come back in the order of the requests over a connection
+    std::chrono::duration<double, std::micro> lat = now - sent.front();
+    sent.pop_front();
+    latencies.push_back(lat.count());
+    inflight--;
+    cond.notify_all();
+  }
+  bool ms_dispatch(Message *m) override { return true; }
+  bool ms_handle_reset(Connection *con) override { return true; }
+  void ms_handle_remote_reset(Connection *con) override {}
+  bool ms_handle_refused(Connection *con) override { return false; }
+  int ms_handle_authentication(Connection *con) override {
+    return 1;
+  }
+};
+
+} // anonymous namespace
+
+static void usage(const char *name)
+{
+  std::cerr << "usage: " << name << " [options]\n"
+	    << "  --addr <ip:port>  address the server binds to\n"
+	    << "  --jobs <n>        number of clients, each with its own"
+	    << " connection\n"
+	    << "  --ops <n>         number of ops sent by each client\n"
+	    << "  --depth <n>       max number of ops in flight per client\n"
+	    << "  --msg-len <n>     bytes of data in each op" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+  std::vector<const char*> args;
+  argv_to_vec(argc, (const char **)argv, args);
+
+  auto cct = global_init(NULL, args, CEPH_ENTITY_TYPE_CLIENT,
+			 CODE_ENVIRONMENT_UTILITY,
+			 CINIT_FLAG_NO_DEFAULT_CONFIG_FILE);
+  common_init_finish(g_ceph_context);
+  g_ceph_context->_conf.apply_changes(nullptr);
+
+  std::string addr_str = "127.0.0.1:9010";
+  unsigned jobs = 1;
+  unsigned ops = 100000;
+  unsigned depth = 16;
+  unsigned msg_len = 4096;
+  for (auto i = args.begin(); i != args.end();) {
+    std::string val;
+    if (ceph_argparse_double_dash(args, i)) {
+      break;
+    } else if (ceph_argparse_witharg(args, i, &val,
+				     "--addr", (char*)NULL)) {
+      addr_str = val;
+    } else if (ceph_argparse_witharg(args, i, &val,
+				     "--jobs", (char*)NULL)) {
+      jobs = std::stoul(val);
+    } else if (ceph_argparse_witharg(args, i, &val,
+				     "--ops", (char*)NULL)) {
+      ops = std::stoul(val);
+    } else if (ceph_argparse_witharg(args, i, &val,
+				     "--depth", (char*)NULL)) {
+      depth = std::stoul(val);
+    } else if (ceph_argparse_witharg(args, i, &val,
+				     "--msg-len", (char*)NULL)) {
+      msg_len = std::stoul(val);
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  entity_addr_t addr;
+  if (!addr.parse(addr_str.c_str())) {
+    std::cerr << "bad address " << addr_str << std::endl;
+    return 1;
+  }
+
+  const std::string type = g_conf()->ms_public_type.empty() ?
+    g_conf().get_val<std::string>("ms_type") : g_conf()->ms_public_type;
+
+  ServerDispatcher dispatcher(g_ceph_context);
+  std::unique_ptr<Messenger> server{
+    Messenger::create(g_ceph_context, type, entity_name_t::OSD(0),
+		      "server", 0, 0)};
+  server->set_default_policy(Messenger::Policy::stateless_server(0));
+  if (int r = server->bind(addr); r < 0) {
+    std::cerr << "failed to bind " << addr << ": " << cpp_strerror(r)
+	      << std::endl;
+    return 1;
+  }
+  server->add_dispatcher_head(&dispatcher);
+  server->start();
+
+  std::vector<std::unique_ptr<Client>> clients;
+  for (unsigned i = 0; i < jobs; ++i) {
+    clients.emplace_back(new Client(g_ceph_context, type, i,
+				    ops, depth, msg_len));
+    clients.back()->connect(addr);
+  }
+  auto start = perf_clock::now();
+  for (auto& client : clients) {
+    client->create("perf_client");
+  }
+  std::vector<double> latencies;
+  for (auto& client : clients) {
+    client->join();
+    latencies.insert(latencies.end(),
+		     client->latencies.begin(), client->latencies.end());
+  }
+  perf_msgr::report(std::cout, type, msg_len,
+		    perf_clock::now() - start, latencies);
+
+  for (auto& client : clients) {
+    client->shutdown();
+  }
+  server->shutdown();
+  server->wait();
+  return 0;
+}
@@ -0,0 +1,179 @@
+#include "messages/MOSDOp.h"
+#include "messages/MOSDOpReply.h"
+#include "crimson/net/Connection.h"
+#include "crimson/net/Dispatcher.h"
+#include "crimson/net/SocketMessenger.h"
+
+#include <deque>
+#include <boost/program_options.hpp>
+#include <boost/range/irange.hpp>
+#include <seastar/core/app-template.hh>
+#include <seastar/core/future-util.hh>
+#include <seastar/core/reactor.hh>
+#include <seastar/core/semaphore.hh>
+
+#include "perf_msgr_report.h"
+
+namespace bpo = boost::program_options;
+using perf_msgr::perf_clock;
+
+// write ops of a given size are sent by one or more clients over loopback to
+// a server replying to each of them, while at most "depth" ops per client are
+// in flight. the server runs on shard 0, and the clients on the other shards
+// when there are any. see perf_async_msgr for the same workload over the
+// classic AsyncMessenger.
+
+class ServerDispatcher final : public ceph::net::Dispatcher {
+ public:
+  seastar::future<> ms_dispatch(ceph::net::ConnectionRef c,
+                                MessageRef m) override {
+    if (m->get_type() != CEPH_MSG_OSD_OP) {
+      return seastar::now();
+    }
+    auto req = boost::static_pointer_cast<MOSDOp>(m);
+    return c->send(MessageRef{new MOSDOpReply(req.get(), 0, 0, 0, false),
+                              false});
+  }
+};
+
+class Client final : public ceph::net::Dispatcher {
+  const unsigned ops;
+  const unsigned msg_len;
+  ceph::net::SocketMessenger msgr;
+  seastar::semaphore depth;
+  bufferlist data;
+  ceph_tid_t last_tid = 0;
+  std::deque<perf_clock::time_point> sent;
+  std::vector<double> latencies;
+  seastar::promise<> done;
+
+  MessageRef make_op() {
+    const object_t oid{"object-name"};
+    hobject_t hobj{oid, "", CEPH_NOSNAP, 0, 1, ""};
+    spg_t pgid{pg_t{0, 1}};
+    auto m = new MOSDOp(0, ++last_tid, hobj, pgid, 0, 0, 0);
+    bufferlist bl{data};
+    m->write(0, msg_len, bl);
+    return MessageRef{m, false};
+  }
+
+ public:
+  Client(unsigned id, unsigned ops, unsigned depth, unsigned msg_len)
+    : ops(ops), msg_len(msg_len),
+      msgr{entity_name_t::CLIENT(id)},
+      depth(depth) {
+    data.append_zero(msg_len);
+    latencies.reserve(ops);
+  }
+
+  seastar::future<> ms_dispatch(ceph::net::ConnectionRef c,
+                                MessageRef m) override {
+    if (m->get_type() != CEPH_MSG_OSD_OPREPLY) {
+      return seastar::now();
+    }
+    // replies come back in the order of the requests over a connection
+    std::chrono::duration<double, std::micro> lat =
+      perf_clock::now() - sent.front();
+    sent.pop_front();
+    latencies.push_back(lat.count());
+    depth.signal();
+    if (latencies.size() == ops) {
+      done.set_value();
+    }
+    return seastar::now();
+  }
+
+  /// @return the latencies of all ops in microseconds
+  seastar::future<std::vector<double>> run(const entity_addr_t& addr) {
+    return msgr.start(this).then([this, addr] {
+      return msgr.connect(addr, entity_name_t::TYPE_OSD);
+    }).then([this] (ceph::net::ConnectionRef conn) {
+      return seastar::do_for_each(boost::irange(0u, ops),
+        [this, conn] (unsigned) {
+          return depth.wait().then([this, conn] {
+            sent.push_back(perf_clock::now());
+            return conn->send(make_op());
+          });
+        }).then([this] {
+          return done.get_future();
+        });
+    }).finally([this] {
+      return msgr.shutdown();
+    }).then([this] {
+      return std::move(latencies);
+    });
+  }
+};
+
+static seastar::future<> run(const entity_addr_t& addr,
+                             unsigned jobs,
+                             unsigned ops,
+                             unsigned depth,
+                             unsigned msg_len)
+{
+  struct test_state {
+    ceph::net::SocketMessenger server{entity_name_t::OSD(0)};
+    ServerDispatcher dispatcher;
+    std::vector<double> latencies;
+    perf_clock::time_point start;
+  };
+  return seastar::do_with(test_state{},
+    [=] (test_state& t) {
+      t.server.bind(addr);
+      return t.server.start(&t.dispatcher).then([=, &t] {
+        t.start = perf_clock::now();
+        return seastar::parallel_for_each(boost::irange(0u, jobs),
+          [=, &t] (unsigned i) {
+            // keep the clients off the server's shard if possible
+            unsigned shard = seastar::smp::count > 1 ?
+              1 + i % (seastar::smp::count - 1) : 0;
+            return seastar::smp::submit_to(shard, [=] {
+              auto client = std::make_unique<Client>(i, ops, depth, msg_len);
+              auto f = client->run(addr);
+              return f.finally([client = std::move(client)] {});
+            }).then([&t] (std::vector<double> latencies) {
+              t.latencies.insert(t.latencies.end(),
+                                 latencies.begin(), latencies.end());
+            });
+          });
+      }).then([msg_len, &t] {
+        perf_msgr::report(std::cout, "crimson", msg_len,
+                          perf_clock::now() - t.start, t.latencies);
+      }).finally([&t] {
+        return t.server.shutdown();
+      });
+    });
+}
+
+int main(int argc, char** argv)
+{
+  seastar::app_template app;
+  app.add_options()
+    ("addr", bpo::value<std::string>()->default_value("127.0.0.1:9010"),
+     "address the server binds to")
+    ("jobs", bpo::value<unsigned>()->default_value(1),
+     "number of clients, each with its own connection")
+    ("ops", bpo::value<unsigned>()->default_value(100000),
+     "number of ops sent by each client")
+    ("depth", bpo::value<unsigned>()->default_value(16),
+     "max number of ops in flight per client")
+    ("msg-len", bpo::value<unsigned>()->default_value(4096),
+     "bytes of data in each op");
+  return app.run(argc, argv, [&app] {
+    auto&& config = app.configuration();
+    entity_addr_t addr;
+    if (!addr.parse(config["addr"].as<std::string>().c_str())) {
+      std::cerr << "bad address" << std::endl;
+      return seastar::make_ready_future<>();
+    }
+    auto ops = config["ops"].as<unsigned>();
+    if (ops == 0) {
+      return seastar::make_ready_future<>();
+    }
+    return run(addr,
+               config["jobs"].as<unsigned>(),
+               ops,
+               config["depth"].as<unsigned>(),
+               config["msg-len"].as<unsigned>());
+  });
+}
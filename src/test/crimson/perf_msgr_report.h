@@ -0,0 +1,44 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+// the summary printed by perf_crimson_msgr and perf_async_msgr, so the two
+// messengers can be compared under the same workload
+namespace perf_msgr {
+
+using perf_clock = std::chrono::steady_clock;
+
+/// @param latencies of all ops in microseconds, they are sorted in place
+inline void report(std::ostream& out,
+                   const std::string& msgr_type,
+                   unsigned msg_len,
+                   std::chrono::duration<double> elapsed,
+                   std::vector<double>& latencies)
+{
+  std::sort(latencies.begin(), latencies.end());
+  auto percentile = [&latencies] (double p) {
+    if (latencies.empty()) {
+      return 0.0;
+    }
+    auto i = static_cast<size_t>(p / 100 * (latencies.size() - 1));
+    return latencies[i];
+  };
+  const double secs = elapsed.count();
+  const auto ops = latencies.size();
+  out << std::fixed << std::setprecision(2)
+      << msgr_type << ": " << ops << " ops in " << secs << "s\n"
+      << "  ops/s:     " << ops / secs << "\n"
+      << "  bandwidth: " << ops * msg_len / secs / (1 << 20) << " MB/s\n"
+      << "  latency (us): p50 " << percentile(50)
+      << ", p95 " << percentile(95)
+      << ", p99 " << percentile(99)
+      << ", max " << percentile(100) << std::endl;
+}
+
+} // namespace perf_msgr
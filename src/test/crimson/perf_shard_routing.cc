@@ -0,0 +1,154 @@
+#include "include/crc32c.h"
+#include "messages/MPing.h"
+#include "crimson/net/Connection.h"
+#include "crimson/net/Dispatcher.h"
+#include "crimson/net/SocketMessenger.h"
+
+#include <chrono>
+#include <iostream>
+#include <boost/program_options.hpp>
+#include <boost/range/irange.hpp>
+#include <seastar/core/app-template.hh>
+#include <seastar/core/future-util.hh>
+#include <seastar/core/reactor.hh>
+#include <seastar/core/sharded.hh>
+#include <seastar/core/sleep.hh>
+
+namespace bpo = boost::program_options;
+using namespace std::chrono_literals;
+
+// measures the messages/s a single server messenger on shard 0 sustains when
+// every message needs some cpu to handle, with all of them dispatched on
+// shard 0 and with them spread over all shards by a shard router
+
+static bool verbose = false;
+
+class ShardDispatcher : public ceph::net::Dispatcher {
+  const unsigned work;
+  char buf[4096] = {};
+ public:
+  uint64_t count = 0;
+  uint32_t crc = 0;
+
+  explicit ShardDispatcher(unsigned work) : work(work) {}
+
+  seastar::future<> ms_dispatch(ceph::net::ConnectionRef c,
+                                MessageRef m) override {
+    // stand in for the cost of handling the message
+    for (unsigned i = 0; i < work; i++) {
+      crc = ceph_crc32c(crc, reinterpret_cast<unsigned char*>(buf),
+                        sizeof(buf));
+    }
+    ++count;
+    return seastar::now();
+  }
+  seastar::future<> stop() {
+    return seastar::now();
+  }
+};
+
+static seastar::future<> run(unsigned port, unsigned count, unsigned work,
+                             bool routed)
+{
+  struct test_state {
+    entity_addr_t addr;
+    seastar::sharded<ShardDispatcher> dispatchers;
+    std::vector<ceph::net::Dispatcher*> shard_dispatchers;
+    ceph::net::SocketMessenger server{entity_name_t::OSD(1)};
+    ceph::net::SocketMessenger client{entity_name_t::OSD(0)};
+    ceph::net::Dispatcher client_dispatcher;
+    std::chrono::steady_clock::time_point start;
+  };
+  return seastar::do_with(test_state{},
+    [=] (test_state& t) {
+      t.addr.set_family(AF_INET);
+      t.addr.set_port(port);
+      t.server.bind(t.addr);
+      t.shard_dispatchers.resize(seastar::smp::count);
+      return t.dispatchers.start(work).then([&t] {
+        return seastar::parallel_for_each(
+          boost::irange(0u, seastar::smp::count),
+          [&t] (unsigned shard) {
+            return seastar::smp::submit_to(shard, [&t] {
+                return static_cast<ceph::net::Dispatcher*>(
+                  &t.dispatchers.local());
+              }).then([&t, shard] (ceph::net::Dispatcher* d) {
+                t.shard_dispatchers[shard] = d;
+              });
+          });
+      }).then([&t, routed] {
+        if (routed) {
+          t.server.set_shard_router([] (const Message& m) {
+              return m.get_seq() % seastar::smp::count;
+            }, t.shard_dispatchers);
+        }
+        return t.server.start(&t.dispatchers.local());
+      }).then([&t] {
+        return t.client.start(&t.client_dispatcher);
+      }).then([&t] {
+        return t.client.connect(t.addr, entity_name_t::TYPE_OSD);
+      }).then([&t, count] (ceph::net::ConnectionRef conn) {
+        t.start = std::chrono::steady_clock::now();
+        return seastar::do_for_each(boost::irange(0u, count),
+          [conn] (unsigned) {
+            return conn->send(MessageRef{new MPing(), false});
+          });
+      }).then([&t, count] {
+        // wait for all shards to handle their share
+        return seastar::repeat([&t, count] {
+          return t.dispatchers.map_reduce0(
+            [] (const ShardDispatcher& d) { return d.count; },
+            uint64_t(0), std::plus<uint64_t>()
+          ).then([count] (uint64_t done) {
+            if (verbose) {
+              std::cout << "handled " << done << "/" << count << std::endl;
+            }
+            if (done >= count) {
+              return seastar::make_ready_future<seastar::stop_iteration>(
+                seastar::stop_iteration::yes);
+            }
+            return seastar::sleep(1ms).then([] {
+              return seastar::stop_iteration::no;
+            });
+          });
+        });
+      }).then([&t, count, routed] {
+        std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - t.start;
+        std::cout << (routed ? "routed:   " : "unrouted: ")
+                  << count << " msgs in " << elapsed.count() << "s, "
+                  << count / elapsed.count() << " msgs/s" << std::endl;
+      }).finally([&t] {
+        return t.client.shutdown();
+      }).finally([&t] {
+        return t.server.shutdown();
+      }).finally([&t] {
+        return t.dispatchers.stop();
+      });
+    });
+}
+
+int main(int argc, char** argv)
+{
+  seastar::app_template app;
+  app.add_options()
+    ("verbose,v", bpo::value<bool>()->default_value(false),
+     "chatty if true")
+    ("count", bpo::value<unsigned>()->default_value(100000),
+     "number of messages to send")
+    ("work", bpo::value<unsigned>()->default_value(4),
+     "number of 4K crc32c computations per message handled");
+  return app.run(argc, argv, [&] {
+    auto&& config = app.configuration();
+    verbose = config["verbose"].as<bool>();
+    auto count = config["count"].as<unsigned>();
+    auto work = config["work"].as<unsigned>();
+    std::cout << seastar::smp::count << " shards" << std::endl;
+    return run(9010, count, work, false).then([=] {
+      return run(9011, count, work, true);
+    }).handle_exception([] (auto eptr) {
+      std::cout << "Test failure" << std::endl;
+      return seastar::make_exception_future<>(eptr);
+    });
+  });
+}
@@ -0,0 +1,90 @@
+#include <iostream>
+#include <seastar/core/app-template.hh>
+#include <seastar/core/reactor.hh>
+#include "crimson/os/cyan_store.h"
+
+using CyanStore = ceph::os::CyanStore;
+
+static seastar::future<> test_write_read(CyanStore& store)
+{
+  const coll_t cid{spg_t{pg_t{0, 1}}};
+  const ghobject_t oid{hobject_t{object_t{"obj"}, "", CEPH_NOSNAP, 0, 1, ""}};
+  auto c = store.create_new_collection(cid);
+  CyanStore::Transaction t;
+  t.create_collection(cid, 0);
+  bufferlist data;
+  data.append("hello world");
+  t.write(cid, oid, 4, data.length(), data);
+  bufferlist attr;
+  attr.append("value");
+  t.setattr(cid, oid, "attr", attr);
+  std::map<std::string, bufferlist> omap;
+  omap["key"] = attr;
+  t.omap_setkeys(cid, oid, omap);
+  return store.do_transaction(c, std::move(t)).then([&store, c, oid] {
+    return store.read(c, oid, 4, strlen("hello world"));
+  }).then([&store, c, oid] (bufferlist bl) {
+    if (bl.to_str() != "hello world") {
+      throw std::runtime_error("read returned unexpected data");
+    }
+    return store.stat(c, oid);
+  }).then([&store, c, oid] (uint64_t size) {
+    if (size != 4 + strlen("hello world")) {
+      throw std::runtime_error("unexpected object size");
+    }
+    return store.get_attr(c, oid, "attr");
+  }).then([&store, c, oid] (ceph::bufferptr value) {
+    if (std::string(value.c_str(), value.length()) != "value") {
+      throw std::runtime_error("getattr returned unexpected value");
+    }
+    return store.omap_get_values(c, oid, std::set<std::string>{"key"});
+  }).then([&store, c] (CyanStore::omap_values_t values) {
+    if (values.size() != 1 || values["key"].to_str() != "value") {
+      throw std::runtime_error("unexpected omap values");
+    }
+    return store.list_objects(c, ghobject_t{}, ghobject_t::get_max(), 10);
+  }).then([&store, c, oid] (std::vector<ghobject_t> objects,
+                            ghobject_t next) {
+    if (objects != std::vector<ghobject_t>{oid} ||
+        next != ghobject_t::get_max()) {
+      throw std::runtime_error("unexpected object listing");
+    }
+    CyanStore::Transaction t;
+    t.remove(c->cid, oid);
+    return store.do_transaction(c, std::move(t));
+  }).then([&store, c, oid] {
+    return store.read(c, oid, 0, 0).then_wrapped([] (auto f) {
+      try {
+        f.get();
+      } catch (const std::system_error& e) {
+        if (e.code().value() == ENOENT) {
+          return;
+        }
+        throw;
+      }
+      throw std::runtime_error("read of removed object succeeded");
+    });
+  });
+}
+
+int main(int argc, char** argv)
+{
+  CyanStore store;
+  seastar::app_template app;
+  return app.run(argc, argv, [&store] {
+      return test_write_read(store).handle_exception([](auto e) {
+          std::cerr << "Error: " << e << std::endl;
+          seastar::engine().exit(1);
+        }).finally([&store] {
+          return store.stop();
+        });
+      });
+}
+
+/*
+ * Local Variables:
+ * compile-command: "make -j4 \
+ * -C ../../../build \
+ * unittest_seastar_cyanstore"
+ * End:
+ */
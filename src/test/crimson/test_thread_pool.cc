@@ -1,5 +1,7 @@
 #include <chrono>
+#include <iostream>
 #include <numeric>
+#include <boost/range/irange.hpp>
 #include <seastar/core/app-template.hh>
 #include "crimson/thread/ThreadPool.h"
 
@@ -24,6 +26,51 @@ seastar::future<> test_accumulate(ThreadPool& tp) {
   });
 }
 
+seastar::future<> test_batch(ThreadPool& tp) {
+  static constexpr auto N = 5;
+  std::vector<std::function<int()>> funcs;
+  for (int i = 0; i < N; i++) {
+    funcs.emplace_back([i] { return i * i; });
+  }
+  return tp.submit_batch(std::move(funcs)).then([](std::vector<int> squares) {
+    for (int i = 0; i < N; i++) {
+      if (squares[i] != i * i) {
+        throw std::runtime_error("test_batch failed");
+      }
+    }
+  });
+}
+
+// compare the per-task overhead of submitting tasks one by one with
+// submitting them in batches
+seastar::future<> bench_submit(ThreadPool& tp) {
+  static constexpr unsigned N = 100000;
+  using std::chrono::steady_clock;
+  auto report = [](const char* name, steady_clock::time_point start) {
+    std::chrono::duration<double, std::nano> elapsed =
+      steady_clock::now() - start;
+    std::cout << name << ": " << elapsed.count() / N << " ns/task" << std::endl;
+  };
+  auto start = steady_clock::now();
+  return seastar::parallel_for_each(boost::irange(0u, N), [&tp](unsigned i) {
+    return tp.submit([i] { return i; }).discard_result();
+  }).then([&tp, start, report] {
+    report("submit", start);
+    const unsigned batch = tp.slots_per_shard();
+    auto start = steady_clock::now();
+    return seastar::do_for_each(boost::irange(0u, N / batch),
+      [&tp, batch](unsigned) {
+        std::vector<std::function<unsigned()>> funcs;
+        for (unsigned i = 0; i < batch; i++) {
+          funcs.emplace_back([i] { return i; });
+        }
+        return tp.submit_batch(std::move(funcs)).discard_result();
+      }).then([start, report] {
+        report("submit_batch", start);
+      });
+  });
+}
+
 int main(int argc, char** argv)
 {
   ThreadPool tp{2, 128, 0};
@@ -31,6 +78,10 @@ int main(int argc, char** argv)
   return app.run(argc, argv, [&tp] {
       return tp.start().then([&tp] {
           return test_accumulate(tp);
+        }).then([&tp] {
+          return test_batch(tp);
+        }).then([&tp] {
+          return bench_submit(tp);
         }).handle_exception([](auto e) {
           std::cerr << "Error: " << e << std::endl;
           seastar::engine().exit(1);
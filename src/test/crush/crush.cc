@@ -492,6 +492,25 @@ double calc_straw2_stddev(int *weights, int n, bool verbose)
   return stddev;
 }
 
+TEST(CRUSH, do_rule_batch) {
+  std::unique_ptr<CrushWrapper> c(build_indep_map(g_ceph_context, 3, 10, 7));
+  vector<__u32> weight(c->get_max_devices(), 0x10000);
+  for (unsigned i = 0; i < weight.size(); i += 11)
+    weight[i] = 0;
+
+  vector<int> xs;
+  for (int x = 0; x < 1000; ++x)
+    xs.push_back(x);
+  vector<vector<int>> batch;
+  c->do_rule_batch(0, xs, &batch, 5, weight, 0);
+  ASSERT_EQ(xs.size(), batch.size());
+  for (unsigned i = 0; i < xs.size(); ++i) {
+    vector<int> out;
+    c->do_rule(0, xs[i], out, 5, weight, 0);
+    ASSERT_EQ(out, batch[i]);
+  }
+}
+
 TEST(CRUSH, straw2_stddev)
 {
   int n = 15;
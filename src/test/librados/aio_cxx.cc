@@ -1335,6 +1335,62 @@ TEST(LibRadosAio, MultiWritePP) {
   delete my_completion3;
 }
 
+TEST(LibRadosAio, OperateBatchPP) {
+  AioTestDataPP test_data;
+  ASSERT_EQ("", test_data.init());
+
+  std::vector<std::string> oids = {"foo0", "foo1", "foo2"};
+  std::vector<ObjectWriteOperation> write_ops(oids.size());
+  std::vector<ObjectWriteOperation*> pwrite_ops;
+  for (size_t i = 0; i < oids.size(); ++i) {
+    bufferlist bl;
+    bl.append(oids[i]);
+    write_ops[i].write_full(bl);
+    pwrite_ops.push_back(&write_ops[i]);
+  }
+
+  std::vector<int> rvals;
+  boost::scoped_ptr<AioCompletion> write_completion(
+    test_data.m_cluster.aio_create_completion(nullptr, nullptr, nullptr));
+  ASSERT_EQ(0, test_data.m_ioctx.aio_operate_batch(oids, pwrite_ops,
+						   write_completion.get(), 0,
+						   &rvals));
+  {
+    TestAlarm alarm;
+    ASSERT_EQ(0, write_completion->wait_for_complete());
+  }
+  ASSERT_EQ(0, write_completion->get_return_value());
+  ASSERT_EQ(std::vector<int>(oids.size(), 0), rvals);
+
+  // every result is reported, along with the first error
+  oids.push_back("nonexistent");
+  std::vector<ObjectReadOperation> read_ops(oids.size());
+  std::vector<ObjectReadOperation*> pread_ops;
+  std::vector<bufferlist> bls(oids.size());
+  std::vector<int> op_rvals(oids.size());
+  for (size_t i = 0; i < oids.size(); ++i) {
+    read_ops[i].read(0, 0, &bls[i], &op_rvals[i]);
+    pread_ops.push_back(&read_ops[i]);
+  }
+
+  boost::scoped_ptr<AioCompletion> read_completion(
+    test_data.m_cluster.aio_create_completion(nullptr, nullptr, nullptr));
+  ASSERT_EQ(0, test_data.m_ioctx.aio_operate_batch(oids, pread_ops,
+						   read_completion.get(), 0,
+						   &rvals));
+  {
+    TestAlarm alarm;
+    ASSERT_EQ(0, read_completion->wait_for_complete());
+  }
+  ASSERT_EQ(-ENOENT, read_completion->get_return_value());
+  ASSERT_EQ(oids.size(), rvals.size());
+  for (size_t i = 0; i < oids.size() - 1; ++i) {
+    ASSERT_EQ(0, rvals[i]);
+    ASSERT_EQ(oids[i], bls[i].to_str());
+  }
+  ASSERT_EQ(-ENOENT, rvals.back());
+}
+
 TEST(LibRadosAio, AioUnlockPP) {
   AioTestDataPP test_data;
   ASSERT_EQ("", test_data.init());
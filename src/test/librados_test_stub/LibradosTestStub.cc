@@ -470,6 +470,30 @@ int IoCtx::aio_operate(const std::string& oid, AioCompletion *c,
   return aio_operate(oid, c, op, seq, snaps, 0, trace_info);
 }
 
+int IoCtx::aio_operate_batch(const std::vector<std::string>& oids,
+                             const std::vector<ObjectWriteOperation*>& ops,
+                             AioCompletion *c, int flags,
+                             std::vector<int> *prvals) {
+  TestIoCtxImpl *ctx = reinterpret_cast<TestIoCtxImpl*>(io_ctx_impl);
+  std::vector<TestObjectOperationImpl*> impls;
+  for (auto op : ops) {
+    impls.push_back(reinterpret_cast<TestObjectOperationImpl*>(op->impl));
+  }
+  return ctx->aio_operate_batch(oids, impls, c->pc, flags, prvals);
+}
+
+int IoCtx::aio_operate_batch(const std::vector<std::string>& oids,
+                             const std::vector<ObjectReadOperation*>& ops,
+                             AioCompletion *c, int flags,
+                             std::vector<int> *prvals) {
+  TestIoCtxImpl *ctx = reinterpret_cast<TestIoCtxImpl*>(io_ctx_impl);
+  std::vector<TestObjectOperationImpl*> impls;
+  for (auto op : ops) {
+    impls.push_back(reinterpret_cast<TestObjectOperationImpl*>(op->impl));
+  }
+  return ctx->aio_operate_batch(oids, impls, c->pc, flags, prvals);
+}
+
 int IoCtx::aio_remove(const std::string& oid, AioCompletion *c) {
   TestIoCtxImpl *ctx = reinterpret_cast<TestIoCtxImpl*>(io_ctx_impl);
   return ctx->aio_remove(oid, c->pc);
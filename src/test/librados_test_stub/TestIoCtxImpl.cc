@@ -128,6 +128,28 @@ int TestIoCtxImpl::aio_operate_read(const std::string& oid,
   return 0;
 }
 
+int TestIoCtxImpl::aio_operate_batch(
+    const std::vector<std::string>& oids,
+    const std::vector<TestObjectOperationImpl*>& ops, AioCompletionImpl *c,
+    int flags, std::vector<int> *prvals) {
+  if (oids.size() != ops.size()) {
+    return -EINVAL;
+  }
+
+  // TODO ignoring flags for now
+  if (prvals != nullptr) {
+    prvals->assign(ops.size(), 0);
+  }
+  for (auto op : ops) {
+    op->get();
+    m_pending_ops++;
+  }
+  m_client->add_aio_operation(oids.empty() ? "" : oids.front(), true,
+    boost::bind(&TestIoCtxImpl::execute_batch_operations, this, oids, ops,
+                prvals, m_snapc), c);
+  return 0;
+}
+
 int TestIoCtxImpl::aio_watch(const std::string& o, AioCompletionImpl *c,
                              uint64_t *handle, librados::WatchCtx2 *watch_ctx) {
   m_pending_ops++;
@@ -376,6 +398,23 @@ int TestIoCtxImpl::execute_aio_operations(const std::string& oid,
   return ret;
 }
 
+int TestIoCtxImpl::execute_batch_operations(
+    const std::vector<std::string>& oids,
+    const std::vector<TestObjectOperationImpl*>& ops,
+    std::vector<int> *prvals, const SnapContext &snapc) {
+  int ret = 0;
+  for (size_t i = 0; i < ops.size(); ++i) {
+    int r = execute_aio_operations(oids[i], ops[i], nullptr, snapc);
+    if (prvals != nullptr) {
+      (*prvals)[i] = r;
+    }
+    if (r < 0 && ret == 0) {
+      ret = r;
+    }
+  }
+  return ret;
+}
+
 void TestIoCtxImpl::handle_aio_notify_complete(AioCompletionImpl *c, int r) {
   m_pending_ops--;
 
@@ -90,6 +90,10 @@ public:
   virtual int aio_operate_read(const std::string& oid, TestObjectOperationImpl &ops,
                                AioCompletionImpl *c, int flags,
                                bufferlist *pbl);
+  virtual int aio_operate_batch(const std::vector<std::string>& oids,
+                                const std::vector<TestObjectOperationImpl*>& ops,
+                                AioCompletionImpl *c, int flags,
+                                std::vector<int> *prvals);
   virtual int aio_remove(const std::string& oid, AioCompletionImpl *c,
                          int flags = 0) = 0;
   virtual int aio_watch(const std::string& o, AioCompletionImpl *c,
@@ -181,6 +185,10 @@ protected:
   int execute_aio_operations(const std::string& oid,
                              TestObjectOperationImpl *ops,
                              bufferlist *pbl, const SnapContext &snapc);
+  int execute_batch_operations(const std::vector<std::string>& oids,
+                               const std::vector<TestObjectOperationImpl*>& ops,
+                               std::vector<int> *prvals,
+                               const SnapContext &snapc);
 
 private:
   struct C_AioNotify : public Context {
@@ -0,0 +1,269 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "test/librbd/test_mock_fixture.h"
+#include "test/librbd/test_support.h"
+#include "test/librbd/mock/MockImageCtx.h"
+#include "include/rbd/librbd.hpp"
+#include "include/stringify.h"
+#include "librbd/cache/ReadaheadObjectDispatch.h"
+#include "librbd/io/ObjectDispatchSpec.h"
+
+namespace librbd {
+namespace {
+
+struct MockTestImageCtx : public MockImageCtx {
+  MockTestImageCtx(ImageCtx &image_ctx) : MockImageCtx(image_ctx) {
+  }
+};
+
+} // anonymous namespace
+} // namespace librbd
+
+// template definitions
+#include "librbd/cache/ReadaheadObjectDispatch.cc"
+
+namespace librbd {
+namespace cache {
+
+using ::testing::_;
+using ::testing::Invoke;
+using ::testing::Return;
+
+class TestMockCacheReadaheadObjectDispatch : public TestMockFixture {
+public:
+  typedef ReadaheadObjectDispatch<librbd::MockTestImageCtx> MockReadaheadObjectDispatch;
+
+  void init_config(MockTestImageCtx &mock_image_ctx) {
+    mock_image_ctx.config.set_val("rbd_readahead_objects", "1");
+    mock_image_ctx.config.set_val("rbd_readahead_trigger_requests", "2");
+    mock_image_ctx.config.set_val("rbd_readahead_disable_after_bytes", "0");
+  }
+
+  void expect_register_object_dispatch(MockTestImageCtx &mock_image_ctx) {
+    EXPECT_CALL(*mock_image_ctx.io_object_dispatcher,
+                register_object_dispatch(_));
+  }
+
+  void expect_get_object_count(MockTestImageCtx &mock_image_ctx,
+                               uint64_t object_count) {
+    EXPECT_CALL(mock_image_ctx, get_object_count(_))
+      .WillRepeatedly(Return(object_count));
+  }
+
+  void expect_prefetch(MockTestImageCtx &mock_image_ctx, uint64_t object_no,
+                       const std::string &data,
+                       const io::ExtentMap &extent_map, int r) {
+    EXPECT_CALL(mock_image_ctx, get_object_name(object_no))
+      .WillOnce(Return("object" + stringify(object_no)));
+    EXPECT_CALL(*mock_image_ctx.io_object_dispatcher, send(_))
+      .WillOnce(Invoke([&mock_image_ctx, object_no, data, extent_map, r]
+                       (io::ObjectDispatchSpec* spec) {
+                  auto read = boost::get<io::ObjectDispatchSpec::ReadRequest>(
+                    &spec->request);
+                  ASSERT_TRUE(read != nullptr);
+                  ASSERT_EQ(object_no, read->object_no);
+                  ASSERT_EQ(0U, read->object_off);
+                  ASSERT_EQ(mock_image_ctx.layout.object_size,
+                            read->object_len);
+
+                  read->read_data->append(data);
+                  *read->extent_map = extent_map;
+                  spec->dispatch_result = io::DISPATCH_RESULT_COMPLETE;
+                  mock_image_ctx.image_ctx->op_work_queue->queue(
+                    &spec->dispatcher_ctx, r);
+                }));
+  }
+
+  bool read(MockReadaheadObjectDispatch &object_dispatch, uint64_t object_no,
+            uint64_t off, uint64_t len, bufferlist *bl, int *r) {
+    C_SaferCond on_dispatched;
+    io::DispatchResult dispatch_result;
+    int object_dispatch_flags = 0;
+    Context *on_finish = nullptr;
+    io::ExtentMap extent_map;
+    if (!object_dispatch.read("object" + stringify(object_no), object_no, off,
+                              len, CEPH_NOSNAP, 0, {}, bl, &extent_map,
+                              &object_dispatch_flags, &dispatch_result,
+                              &on_finish, &on_dispatched)) {
+      return false;
+    }
+    *r = on_dispatched.wait();
+    EXPECT_EQ(io::DISPATCH_RESULT_COMPLETE, dispatch_result);
+    EXPECT_TRUE(extent_map.empty());
+    return true;
+  }
+
+  // sequential reads up to the end of the first object
+  void start_stream(MockTestImageCtx &mock_image_ctx,
+                    MockReadaheadObjectDispatch &object_dispatch) {
+    uint64_t object_size = mock_image_ctx.layout.object_size;
+    bufferlist bl;
+    int r;
+    ASSERT_FALSE(read(object_dispatch, 0, object_size - 8192, 4096, &bl, &r));
+    ASSERT_FALSE(read(object_dispatch, 0, object_size - 4096, 4096, &bl, &r));
+  }
+
+  void write(MockReadaheadObjectDispatch &object_dispatch, uint64_t object_no,
+             uint64_t off, const std::string &data, Context **on_finish) {
+    bufferlist bl;
+    bl.append(data);
+    io::DispatchResult dispatch_result;
+    int object_dispatch_flags = 0;
+    uint64_t journal_tid = 0;
+    C_SaferCond on_dispatched;
+    EXPECT_FALSE(object_dispatch.write("object" + stringify(object_no),
+                                       object_no, off, std::move(bl), {}, 0,
+                                       {}, &object_dispatch_flags,
+                                       &journal_tid, &dispatch_result,
+                                       on_finish, &on_dispatched));
+  }
+
+  int shut_down(MockReadaheadObjectDispatch *object_dispatch) {
+    C_SaferCond ctx;
+    object_dispatch->shut_down(&ctx);
+    int r = ctx.wait();
+    delete object_dispatch;
+    return r;
+  }
+};
+
+TEST_F(TestMockCacheReadaheadObjectDispatch, SequentialStream) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockTestImageCtx mock_image_ctx(*ictx);
+  init_config(mock_image_ctx);
+
+  auto object_dispatch = MockReadaheadObjectDispatch::create(&mock_image_ctx);
+  expect_register_object_dispatch(mock_image_ctx);
+  object_dispatch->init();
+
+  std::string data(8192, '1');
+  expect_get_object_count(mock_image_ctx, 2);
+  expect_prefetch(mock_image_ctx, 1, data, {}, 0);
+
+  bufferlist bl;
+  int r;
+  start_stream(mock_image_ctx, *object_dispatch);
+
+  ASSERT_TRUE(read(*object_dispatch, 1, 0, 4096, &bl, &r));
+  ASSERT_EQ(0, r);
+  ASSERT_EQ(data.substr(0, 4096), bl.to_str());
+
+  // the object may be shorter than the read
+  bl.clear();
+  ASSERT_TRUE(read(*object_dispatch, 1, 4096, 8192, &bl, &r));
+  ASSERT_EQ(0, r);
+  ASSERT_EQ(data.substr(4096), bl.to_str());
+
+  ASSERT_EQ(0, shut_down(object_dispatch));
+}
+
+TEST_F(TestMockCacheReadaheadObjectDispatch, SparsePrefetch) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockTestImageCtx mock_image_ctx(*ictx);
+  init_config(mock_image_ctx);
+
+  auto object_dispatch = MockReadaheadObjectDispatch::create(&mock_image_ctx);
+  expect_register_object_dispatch(mock_image_ctx);
+  object_dispatch->init();
+
+  std::string data = std::string(4096, '1') + std::string(4096, '2');
+  expect_get_object_count(mock_image_ctx, 2);
+  expect_prefetch(mock_image_ctx, 1, data, {{0, 4096}, {8192, 4096}}, 0);
+
+  bufferlist bl;
+  int r;
+  start_stream(mock_image_ctx, *object_dispatch);
+
+  ASSERT_TRUE(read(*object_dispatch, 1, 2048, 8192, &bl, &r));
+  ASSERT_EQ(0, r);
+  ASSERT_EQ(std::string(2048, '1') + std::string(4096, '\0') +
+              std::string(2048, '2'),
+            bl.to_str());
+
+  ASSERT_EQ(0, shut_down(object_dispatch));
+}
+
+TEST_F(TestMockCacheReadaheadObjectDispatch, PrefetchDNE) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockTestImageCtx mock_image_ctx(*ictx);
+  init_config(mock_image_ctx);
+
+  auto object_dispatch = MockReadaheadObjectDispatch::create(&mock_image_ctx);
+  expect_register_object_dispatch(mock_image_ctx);
+  object_dispatch->init();
+
+  expect_get_object_count(mock_image_ctx, 2);
+  expect_prefetch(mock_image_ctx, 1, "", {}, -ENOENT);
+
+  bufferlist bl;
+  int r;
+  start_stream(mock_image_ctx, *object_dispatch);
+
+  ASSERT_TRUE(read(*object_dispatch, 1, 0, 4096, &bl, &r));
+  ASSERT_EQ(-ENOENT, r);
+
+  ASSERT_EQ(0, shut_down(object_dispatch));
+}
+
+TEST_F(TestMockCacheReadaheadObjectDispatch, RandomReads) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockTestImageCtx mock_image_ctx(*ictx);
+  init_config(mock_image_ctx);
+
+  auto object_dispatch = MockReadaheadObjectDispatch::create(&mock_image_ctx);
+  expect_register_object_dispatch(mock_image_ctx);
+  object_dispatch->init();
+
+  bufferlist bl;
+  int r;
+  ASSERT_FALSE(read(*object_dispatch, 3, 0, 4096, &bl, &r));
+  ASSERT_FALSE(read(*object_dispatch, 0, 8192, 4096, &bl, &r));
+  ASSERT_FALSE(read(*object_dispatch, 5, 4096, 4096, &bl, &r));
+  ASSERT_FALSE(read(*object_dispatch, 1, 0, 4096, &bl, &r));
+
+  ASSERT_EQ(0, shut_down(object_dispatch));
+}
+
+TEST_F(TestMockCacheReadaheadObjectDispatch, WriteInvalidates) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockTestImageCtx mock_image_ctx(*ictx);
+  init_config(mock_image_ctx);
+
+  auto object_dispatch = MockReadaheadObjectDispatch::create(&mock_image_ctx);
+  expect_register_object_dispatch(mock_image_ctx);
+  object_dispatch->init();
+
+  expect_get_object_count(mock_image_ctx, 2);
+  expect_prefetch(mock_image_ctx, 1, std::string(8192, '1'), {}, 0);
+
+  bufferlist bl;
+  int r;
+  start_stream(mock_image_ctx, *object_dispatch);
+
+  C_SaferCond on_write;
+  Context *on_finish = &on_write;
+  write(*object_dispatch, 1, 0, std::string(4096, '2'), &on_finish);
+  ASSERT_NE(&on_write, on_finish);
+
+  // the written object is no longer buffered
+  ASSERT_FALSE(read(*object_dispatch, 1, 0, 4096, &bl, &r));
+
+  on_finish->complete(0);
+  ASSERT_EQ(0, on_write.wait());
+
+  ASSERT_EQ(0, shut_down(object_dispatch));
+}
+
+} // namespace cache
+} // namespace librbd
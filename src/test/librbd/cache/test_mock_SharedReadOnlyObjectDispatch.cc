@@ -0,0 +1,253 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "test/librbd/test_mock_fixture.h"
+#include "test/librbd/test_support.h"
+#include "test/librbd/mock/MockImageCtx.h"
+#include "test/librados_test_stub/MockTestMemIoCtxImpl.h"
+#include "include/rbd/librbd.hpp"
+#include "librbd/cache/SharedReadOnlyObjectDispatch.h"
+#include <ftw.h>
+#include <stdlib.h>
+
+namespace librbd {
+namespace {
+
+struct MockTestImageCtx : public MockImageCtx {
+  MockTestImageCtx(ImageCtx &image_ctx) : MockImageCtx(image_ctx) {
+  }
+};
+
+} // anonymous namespace
+} // namespace librbd
+
+// template definitions
+#include "librbd/cache/SharedReadOnlyObjectDispatch.cc"
+
+namespace librbd {
+namespace cache {
+
+using ::testing::_;
+using ::testing::DoAll;
+using ::testing::Invoke;
+using ::testing::Return;
+using ::testing::SetArgPointee;
+using ::testing::WithArg;
+
+class TestMockCacheSharedReadOnlyObjectDispatch : public TestMockFixture {
+public:
+  typedef SharedReadOnlyObjectDispatch<librbd::MockTestImageCtx> MockSharedReadOnlyObjectDispatch;
+
+  void SetUp() override {
+    TestMockFixture::SetUp();
+
+    char dir[] = "/tmp/test_mock_SharedReadOnlyObjectDispatch.XXXXXX";
+    ASSERT_NE(nullptr, ::mkdtemp(dir));
+    m_cache_dir = dir;
+  }
+
+  void TearDown() override {
+    ::nftw(m_cache_dir.c_str(),
+           [](const char *path, const struct stat *, int, struct FTW *) {
+             return ::remove(path);
+           }, 16, FTW_DEPTH | FTW_PHYS);
+
+    TestMockFixture::TearDown();
+  }
+
+  void init_config(MockTestImageCtx &mock_image_ctx) {
+    mock_image_ctx.config.set_val("rbd_shared_cache_path", m_cache_dir);
+  }
+
+  void expect_register_object_dispatch(MockTestImageCtx &mock_image_ctx) {
+    EXPECT_CALL(*mock_image_ctx.io_object_dispatcher,
+                register_object_dispatch(_));
+  }
+
+  void expect_get_read_flags(MockTestImageCtx &mock_image_ctx) {
+    EXPECT_CALL(mock_image_ctx, get_read_flags(_)).WillOnce(Return(0));
+  }
+
+  void expect_get_parent_overlap(MockTestImageCtx &mock_image_ctx,
+                                 librados::snap_t snap_id, uint64_t overlap) {
+    EXPECT_CALL(mock_image_ctx, get_parent_overlap(snap_id, _))
+      .WillRepeatedly(DoAll(SetArgPointee<1>(overlap), Return(0)));
+  }
+
+  void expect_read(MockTestImageCtx &mock_image_ctx, const std::string &oid,
+                   const std::string &data, int r) {
+    bufferlist bl;
+    bl.append(data);
+
+    auto& expect = EXPECT_CALL(get_mock_io_ctx(mock_image_ctx.data_ctx),
+                               read(oid, mock_image_ctx.layout.object_size,
+                                    0, _));
+    if (r < 0) {
+      expect.WillOnce(Return(r));
+    } else {
+      expect.WillOnce(WithArg<3>(Invoke([bl](bufferlist *out_bl) {
+                                   out_bl->append(bl);
+                                   return bl.length();
+                                 })));
+    }
+  }
+
+  bool read(MockSharedReadOnlyObjectDispatch &object_dispatch,
+            const std::string &oid, uint64_t off, uint64_t len,
+            librados::snap_t snap_id, bufferlist *bl,
+            io::DispatchResult *dispatch_result, int r = 0) {
+    C_SaferCond on_dispatched;
+    int object_dispatch_flags = 0;
+    Context *on_finish = nullptr;
+    if (!object_dispatch.read(oid, 0, off, len, snap_id, 0, {}, bl, nullptr,
+                              &object_dispatch_flags, dispatch_result,
+                              &on_finish, &on_dispatched)) {
+      return false;
+    }
+    EXPECT_EQ(r, on_dispatched.wait());
+    return true;
+  }
+
+  int shut_down(MockSharedReadOnlyObjectDispatch *object_dispatch) {
+    C_SaferCond ctx;
+    object_dispatch->shut_down(&ctx);
+    int r = ctx.wait();
+    delete object_dispatch;
+    return r;
+  }
+
+  std::string m_cache_dir;
+};
+
+TEST_F(TestMockCacheSharedReadOnlyObjectDispatch, NoSnap) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockTestImageCtx mock_image_ctx(*ictx);
+  init_config(mock_image_ctx);
+
+  auto object_dispatch = MockSharedReadOnlyObjectDispatch::create(
+    &mock_image_ctx);
+  expect_register_object_dispatch(mock_image_ctx);
+  object_dispatch->init();
+
+  bufferlist bl;
+  io::DispatchResult dispatch_result;
+  ASSERT_FALSE(read(*object_dispatch, "object0", 0, 4096, CEPH_NOSNAP, &bl,
+                    &dispatch_result));
+
+  ASSERT_EQ(0, shut_down(object_dispatch));
+}
+
+TEST_F(TestMockCacheSharedReadOnlyObjectDispatch, FetchThenHit) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockTestImageCtx mock_image_ctx(*ictx);
+  init_config(mock_image_ctx);
+
+  std::string data(8192, '1');
+  data.replace(1024, 1024, std::string(1024, '2'));
+
+  auto object_dispatch = MockSharedReadOnlyObjectDispatch::create(
+    &mock_image_ctx);
+  expect_register_object_dispatch(mock_image_ctx);
+  object_dispatch->init();
+
+  // the whole object is fetched once
+  expect_get_read_flags(mock_image_ctx);
+  expect_read(mock_image_ctx, "object0", data, 0);
+
+  bufferlist bl;
+  io::DispatchResult dispatch_result;
+  ASSERT_TRUE(read(*object_dispatch, "object0", 1024, 1024, 2, &bl,
+                   &dispatch_result));
+  ASSERT_EQ(io::DISPATCH_RESULT_COMPLETE, dispatch_result);
+  ASSERT_EQ(data.substr(1024, 1024), bl.to_str());
+
+  bl.clear();
+  ASSERT_TRUE(read(*object_dispatch, "object0", 4096, 8192, 2, &bl,
+                   &dispatch_result));
+  ASSERT_EQ(io::DISPATCH_RESULT_COMPLETE, dispatch_result);
+  ASSERT_EQ(data.substr(4096), bl.to_str());
+
+  ASSERT_EQ(0, shut_down(object_dispatch));
+
+  // other clients of the host share the cached object
+  object_dispatch = MockSharedReadOnlyObjectDispatch::create(&mock_image_ctx);
+  expect_register_object_dispatch(mock_image_ctx);
+  object_dispatch->init();
+
+  bl.clear();
+  ASSERT_TRUE(read(*object_dispatch, "object0", 0, 2048, 2, &bl,
+                   &dispatch_result));
+  ASSERT_EQ(io::DISPATCH_RESULT_COMPLETE, dispatch_result);
+  ASSERT_EQ(data.substr(0, 2048), bl.to_str());
+
+  ASSERT_EQ(0, shut_down(object_dispatch));
+}
+
+TEST_F(TestMockCacheSharedReadOnlyObjectDispatch, FetchDNE) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockTestImageCtx mock_image_ctx(*ictx);
+  init_config(mock_image_ctx);
+
+  auto object_dispatch = MockSharedReadOnlyObjectDispatch::create(
+    &mock_image_ctx);
+  expect_register_object_dispatch(mock_image_ctx);
+  object_dispatch->init();
+
+  expect_get_parent_overlap(mock_image_ctx, 2, 0);
+  expect_get_read_flags(mock_image_ctx);
+  expect_read(mock_image_ctx, "object0", "", -ENOENT);
+
+  bufferlist bl;
+  io::DispatchResult dispatch_result;
+  ASSERT_TRUE(read(*object_dispatch, "object0", 0, 4096, 2, &bl,
+                   &dispatch_result, -ENOENT));
+  ASSERT_EQ(io::DISPATCH_RESULT_COMPLETE, dispatch_result);
+  auto path = object_dispatch->get_object_path("object0", 2);
+  ASSERT_NE(0, ::access(path.c_str(), F_OK));
+  ASSERT_EQ(0, ::access((path + ".dne").c_str(), F_OK));
+
+  // the missing object is not read from the cluster again
+  ASSERT_TRUE(read(*object_dispatch, "object0", 0, 4096, 2, &bl,
+                   &dispatch_result, -ENOENT));
+  ASSERT_EQ(io::DISPATCH_RESULT_COMPLETE, dispatch_result);
+
+  ASSERT_EQ(0, shut_down(object_dispatch));
+}
+
+TEST_F(TestMockCacheSharedReadOnlyObjectDispatch, FetchDNEClone) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockTestImageCtx mock_image_ctx(*ictx);
+  init_config(mock_image_ctx);
+
+  auto object_dispatch = MockSharedReadOnlyObjectDispatch::create(
+    &mock_image_ctx);
+  expect_register_object_dispatch(mock_image_ctx);
+  object_dispatch->init();
+
+  // the parent of the image provides the data
+  expect_get_parent_overlap(mock_image_ctx, 2, 1 << 20);
+  expect_get_read_flags(mock_image_ctx);
+  expect_read(mock_image_ctx, "object0", "", -ENOENT);
+
+  bufferlist bl;
+  io::DispatchResult dispatch_result;
+  ASSERT_TRUE(read(*object_dispatch, "object0", 0, 4096, 2, &bl,
+                   &dispatch_result));
+  ASSERT_EQ(io::DISPATCH_RESULT_CONTINUE, dispatch_result);
+  auto path = object_dispatch->get_object_path("object0", 2);
+  ASSERT_NE(0, ::access(path.c_str(), F_OK));
+  ASSERT_NE(0, ::access((path + ".dne").c_str(), F_OK));
+
+  ASSERT_EQ(0, shut_down(object_dispatch));
+}
+
+} // namespace cache
+} // namespace librbd
@@ -0,0 +1,436 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "test/librbd/test_mock_fixture.h"
+#include "test/librbd/test_support.h"
+#include "test/librbd/mock/MockImageCtx.h"
+#include "include/rbd/librbd.hpp"
+#include "librbd/cache/ImageWriteback.h"
+#include "librbd/cache/WriteLogImageCache.h"
+#include "common/Timer.h"
+#include <fcntl.h>
+#include <set>
+#include <stdlib.h>
+#include <unistd.h>
+
+namespace librbd {
+namespace {
+
+struct MockTestImageCtx : public MockImageCtx {
+  MockTestImageCtx(ImageCtx &image_ctx) : MockImageCtx(image_ctx) {
+  }
+};
+
+} // anonymous namespace
+
+namespace cache {
+
+template <>
+struct ImageWriteback<librbd::MockTestImageCtx> {
+  typedef ImageCache::Extents Extents;
+
+  static ImageWriteback* s_instance;
+
+  ImageWriteback(librbd::MockTestImageCtx &image_ctx) {
+    s_instance = this;
+  }
+
+  MOCK_METHOD4(aio_read_mock, void(const Extents &, bufferlist *, int,
+                                   Context *));
+  void aio_read(Extents &&image_extents, bufferlist *bl, int fadvise_flags,
+                Context *on_finish) {
+    aio_read_mock(image_extents, bl, fadvise_flags, on_finish);
+  }
+
+  MOCK_METHOD4(aio_write_mock, void(const Extents &, const bufferlist &, int,
+                                    Context *));
+  void aio_write(Extents &&image_extents, bufferlist&& bl, int fadvise_flags,
+                 Context *on_finish) {
+    aio_write_mock(image_extents, bl, fadvise_flags, on_finish);
+  }
+
+  MOCK_METHOD4(aio_discard, void(uint64_t, uint64_t, bool, Context *));
+  MOCK_METHOD1(aio_flush, void(Context *));
+
+  MOCK_METHOD5(aio_writesame_mock, void(uint64_t, uint64_t, bufferlist &, int,
+                                        Context *));
+  void aio_writesame(uint64_t offset, uint64_t length, bufferlist&& bl,
+                     int fadvise_flags, Context *on_finish) {
+    aio_writesame_mock(offset, length, bl, fadvise_flags, on_finish);
+  }
+
+  MOCK_METHOD6(aio_compare_and_write_mock, void(const Extents &,
+                                                const bufferlist &,
+                                                const bufferlist &,
+                                                uint64_t *, int, Context *));
+  void aio_compare_and_write(Extents &&image_extents, bufferlist&& cmp_bl,
+                             bufferlist&& bl, uint64_t *mismatch_offset,
+                             int fadvise_flags, Context *on_finish) {
+    aio_compare_and_write_mock(image_extents, cmp_bl, bl, mismatch_offset,
+                               fadvise_flags, on_finish);
+  }
+};
+
+ImageWriteback<librbd::MockTestImageCtx>* ImageWriteback<librbd::MockTestImageCtx>::s_instance = nullptr;
+
+} // namespace cache
+} // namespace librbd
+
+// template definitions
+#include "librbd/cache/WriteLogImageCache.cc"
+
+namespace librbd {
+namespace cache {
+
+using ::testing::_;
+using ::testing::InSequence;
+using ::testing::Invoke;
+using ::testing::SaveArg;
+using ::testing::WithArg;
+
+class TestMockCacheWriteLogImageCache : public TestMockFixture {
+public:
+  typedef WriteLogImageCache<librbd::MockTestImageCtx> MockWriteLogImageCache;
+  typedef ImageWriteback<librbd::MockTestImageCtx> MockImageWriteback;
+  typedef ImageCache::Extents Extents;
+
+  void SetUp() override {
+    TestMockFixture::SetUp();
+
+    char dir[] = "/tmp/test_mock_WriteLogImageCache.XXXXXX";
+    ASSERT_NE(nullptr, ::mkdtemp(dir));
+    m_log_dir = dir;
+  }
+
+  void TearDown() override {
+    for (auto &path : m_log_paths) {
+      ::unlink(path.c_str());
+    }
+    ::rmdir(m_log_dir.c_str());
+
+    TestMockFixture::TearDown();
+  }
+
+  void init_config(MockTestImageCtx &mock_image_ctx) {
+    mock_image_ctx.config.set_val("rbd_persistent_cache_path", m_log_dir);
+    mock_image_ctx.config.set_val("rbd_persistent_cache_size", "1M");
+  }
+
+  int init_cache(MockTestImageCtx &mock_image_ctx,
+                 MockWriteLogImageCache &image_cache) {
+    m_log_paths.insert(image_cache.get_log_path());
+
+    C_SaferCond ctx;
+    image_cache.init(&ctx);
+    return ctx.wait();
+  }
+
+  int shut_down_cache(MockWriteLogImageCache &image_cache) {
+    C_SaferCond ctx;
+    image_cache.shut_down(&ctx);
+    return ctx.wait();
+  }
+
+  int write(MockWriteLogImageCache &image_cache, uint64_t offset,
+            const bufferlist &bl) {
+    C_SaferCond ctx;
+    bufferlist write_bl(bl);
+    image_cache.aio_write({{offset, bl.length()}}, std::move(write_bl), 0,
+                          &ctx);
+    return ctx.wait();
+  }
+
+  void expect_aio_write(MockTestImageCtx &mock_image_ctx,
+                        MockImageWriteback &mock_image_writeback,
+                        uint64_t offset, const bufferlist &bl, int r) {
+    EXPECT_CALL(mock_image_writeback,
+                aio_write_mock(Extents{{offset, bl.length()}},
+                               ContentsEqual(bl), _, _))
+      .WillOnce(WithArg<3>(CompleteContext(
+        r, mock_image_ctx.image_ctx->op_work_queue)));
+  }
+
+  void expect_aio_write_fails(MockTestImageCtx &mock_image_ctx,
+                              MockImageWriteback &mock_image_writeback,
+                              uint64_t offset, const bufferlist &bl, int r) {
+    // a flush retries the writeback, unless it raced with the failure
+    EXPECT_CALL(mock_image_writeback,
+                aio_write_mock(Extents{{offset, bl.length()}},
+                               ContentsEqual(bl), _, _))
+      .WillRepeatedly(WithArg<3>(CompleteContext(
+        r, mock_image_ctx.image_ctx->op_work_queue)));
+  }
+
+  void expect_aio_flush(MockTestImageCtx &mock_image_ctx,
+                        MockImageWriteback &mock_image_writeback, int r) {
+    EXPECT_CALL(mock_image_writeback, aio_flush(_))
+      .WillOnce(CompleteContext(r, mock_image_ctx.image_ctx->op_work_queue));
+  }
+
+  bufferlist make_data(char c, size_t len) {
+    bufferlist bl;
+    bl.append(std::string(len, c));
+    return bl;
+  }
+
+  std::string m_log_dir;
+  std::set<std::string> m_log_paths;
+};
+
+TEST_F(TestMockCacheWriteLogImageCache, WriteReadFlush) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockTestImageCtx mock_image_ctx(*ictx);
+  init_config(mock_image_ctx);
+  expect_op_work_queue(mock_image_ctx);
+
+  MockWriteLogImageCache image_cache(mock_image_ctx);
+  MockImageWriteback &mock_image_writeback = *MockImageWriteback::s_instance;
+  ASSERT_EQ(0, init_cache(mock_image_ctx, image_cache));
+
+  // hold the writeback so that the read is served from the log
+  bufferlist data = make_data('a', 4096);
+  Context *writeback_ctx = nullptr;
+  EXPECT_CALL(mock_image_writeback,
+              aio_write_mock(Extents{{0, 4096}}, ContentsEqual(data), _, _))
+    .WillOnce(SaveArg<3>(&writeback_ctx));
+  ASSERT_EQ(0, write(image_cache, 0, data));
+
+  EXPECT_CALL(mock_image_writeback, aio_read_mock(Extents{{4096, 4096}},
+                                                  _, _, _))
+    .WillOnce(Invoke([this](const Extents &, bufferlist *bl, int,
+                            Context *on_finish) {
+                       bl->append(make_data('b', 4096));
+                       on_finish->complete(0);
+                     }));
+  bufferlist read_bl;
+  C_SaferCond read_ctx;
+  image_cache.aio_read({{2048, 6144}}, &read_bl, 0, &read_ctx);
+  ASSERT_EQ(0, read_ctx.wait());
+
+  bufferlist expected_bl = make_data('a', 2048);
+  expected_bl.append(make_data('b', 4096));
+  ASSERT_TRUE(expected_bl.contents_equal(read_bl));
+
+  ASSERT_NE(nullptr, writeback_ctx);
+  writeback_ctx->complete(0);
+
+  expect_aio_flush(mock_image_ctx, mock_image_writeback, 0);
+  C_SaferCond flush_ctx;
+  image_cache.flush(&flush_ctx);
+  ASSERT_EQ(0, flush_ctx.wait());
+
+  // the superblock of a clean log points past the retired entries
+  expect_aio_flush(mock_image_ctx, mock_image_writeback, 0);
+  ASSERT_EQ(0, shut_down_cache(image_cache));
+}
+
+TEST_F(TestMockCacheWriteLogImageCache, WritebackOrder) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockTestImageCtx mock_image_ctx(*ictx);
+  init_config(mock_image_ctx);
+  expect_op_work_queue(mock_image_ctx);
+
+  MockWriteLogImageCache image_cache(mock_image_ctx);
+  MockImageWriteback &mock_image_writeback = *MockImageWriteback::s_instance;
+  ASSERT_EQ(0, init_cache(mock_image_ctx, image_cache));
+
+  bufferlist data1 = make_data('1', 4096);
+  bufferlist data2 = make_data('2', 4096);
+
+  InSequence seq;
+  expect_aio_write(mock_image_ctx, mock_image_writeback, 0, data1, 0);
+  expect_aio_flush(mock_image_ctx, mock_image_writeback, 0);
+  expect_aio_write(mock_image_ctx, mock_image_writeback, 0, data2, 0);
+  expect_aio_flush(mock_image_ctx, mock_image_writeback, 0);
+  expect_aio_flush(mock_image_ctx, mock_image_writeback, 0);
+
+  ASSERT_EQ(0, write(image_cache, 0, data1));
+  C_SaferCond aio_flush_ctx;
+  image_cache.aio_flush(&aio_flush_ctx);
+  ASSERT_EQ(0, aio_flush_ctx.wait());
+  ASSERT_EQ(0, write(image_cache, 0, data2));
+
+  C_SaferCond flush_ctx;
+  image_cache.flush(&flush_ctx);
+  ASSERT_EQ(0, flush_ctx.wait());
+
+  ASSERT_EQ(0, shut_down_cache(image_cache));
+}
+
+TEST_F(TestMockCacheWriteLogImageCache, Replay) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockTestImageCtx mock_image_ctx(*ictx);
+  init_config(mock_image_ctx);
+  expect_op_work_queue(mock_image_ctx);
+
+  bufferlist data1 = make_data('1', 4096);
+  bufferlist data2 = make_data('2', 8192);
+  {
+    // failing writeback leaves the entries in the log, as a crash would
+    MockWriteLogImageCache image_cache(mock_image_ctx);
+    MockImageWriteback &mock_image_writeback = *MockImageWriteback::s_instance;
+    ASSERT_EQ(0, init_cache(mock_image_ctx, image_cache));
+
+    expect_aio_write_fails(mock_image_ctx, mock_image_writeback, 0, data1,
+                           -EIO);
+    ASSERT_EQ(0, write(image_cache, 0, data1));
+    ASSERT_EQ(0, write(image_cache, 0, data2));
+    ASSERT_EQ(-EIO, shut_down_cache(image_cache));
+  }
+
+  MockWriteLogImageCache image_cache(mock_image_ctx);
+  MockImageWriteback &mock_image_writeback = *MockImageWriteback::s_instance;
+
+  InSequence seq;
+  expect_aio_write(mock_image_ctx, mock_image_writeback, 0, data1, 0);
+  expect_aio_write(mock_image_ctx, mock_image_writeback, 0, data2, 0);
+  ASSERT_EQ(0, init_cache(mock_image_ctx, image_cache));
+
+  expect_aio_flush(mock_image_ctx, mock_image_writeback, 0);
+  ASSERT_EQ(0, shut_down_cache(image_cache));
+}
+
+TEST_F(TestMockCacheWriteLogImageCache, ReplayTornEntry) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockTestImageCtx mock_image_ctx(*ictx);
+  init_config(mock_image_ctx);
+  expect_op_work_queue(mock_image_ctx);
+
+  bufferlist data1 = make_data('1', 4096);
+  bufferlist data2 = make_data('2', 4096);
+  std::string log_path;
+  {
+    MockWriteLogImageCache image_cache(mock_image_ctx);
+    MockImageWriteback &mock_image_writeback = *MockImageWriteback::s_instance;
+    ASSERT_EQ(0, init_cache(mock_image_ctx, image_cache));
+    log_path = image_cache.get_log_path();
+
+    expect_aio_write_fails(mock_image_ctx, mock_image_writeback, 0, data1,
+                           -EIO);
+    ASSERT_EQ(0, write(image_cache, 0, data1));
+    ASSERT_EQ(0, write(image_cache, 0, data2));
+    ASSERT_EQ(-EIO, shut_down_cache(image_cache));
+  }
+
+  // corrupt the data of the second entry, which follows the first one
+  int fd = ::open(log_path.c_str(), O_RDWR);
+  ASSERT_LE(0, fd);
+  uint64_t offset = write_log::LOG_AREA_OFFSET +
+    round_up_to(sizeof(write_log::EntryHeader) + 4096, write_log::BLOCK_SIZE) +
+    sizeof(write_log::EntryHeader) + 100;
+  ASSERT_EQ(1, ::pwrite(fd, "x", 1, offset));
+  ::close(fd);
+
+  MockWriteLogImageCache image_cache(mock_image_ctx);
+  MockImageWriteback &mock_image_writeback = *MockImageWriteback::s_instance;
+
+  InSequence seq;
+  expect_aio_write(mock_image_ctx, mock_image_writeback, 0, data1, 0);
+  ASSERT_EQ(0, init_cache(mock_image_ctx, image_cache));
+
+  expect_aio_flush(mock_image_ctx, mock_image_writeback, 0);
+  ASSERT_EQ(0, shut_down_cache(image_cache));
+}
+
+TEST_F(TestMockCacheWriteLogImageCache, WritebackErrorRetry) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockTestImageCtx mock_image_ctx(*ictx);
+  init_config(mock_image_ctx);
+  expect_op_work_queue(mock_image_ctx);
+
+  MockWriteLogImageCache image_cache(mock_image_ctx);
+  MockImageWriteback &mock_image_writeback = *MockImageWriteback::s_instance;
+  ASSERT_EQ(0, init_cache(mock_image_ctx, image_cache));
+
+  bufferlist data1 = make_data('1', 4096);
+  bufferlist data2 = make_data('2', 4096);
+  Context *writeback_ctx = nullptr;
+  EXPECT_CALL(mock_image_writeback,
+              aio_write_mock(Extents{{0, 4096}}, ContentsEqual(data1), _, _))
+    .WillOnce(SaveArg<3>(&writeback_ctx))
+    .RetiresOnSaturation();
+  ASSERT_EQ(0, write(image_cache, 0, data1));
+  // the second write overlaps the first, so it is held back until the
+  // first one is written back
+  ASSERT_EQ(0, write(image_cache, 0, data2));
+  ASSERT_NE(nullptr, writeback_ctx);
+
+  // releasing the exclusive lock flushes the cache, which retries the
+  // failed writeback rather than fail with its error
+  InSequence seq;
+  expect_aio_write(mock_image_ctx, mock_image_writeback, 0, data1, 0);
+  expect_aio_write(mock_image_ctx, mock_image_writeback, 0, data2, 0);
+  expect_aio_flush(mock_image_ctx, mock_image_writeback, 0);
+  writeback_ctx->complete(-EIO);
+
+  C_SaferCond flush_ctx;
+  image_cache.flush(&flush_ctx);
+  ASSERT_EQ(0, flush_ctx.wait());
+
+  expect_aio_flush(mock_image_ctx, mock_image_writeback, 0);
+  ASSERT_EQ(0, shut_down_cache(image_cache));
+}
+
+TEST_F(TestMockCacheWriteLogImageCache, WritebackErrorLogFull) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockTestImageCtx mock_image_ctx(*ictx);
+  init_config(mock_image_ctx);
+  expect_op_work_queue(mock_image_ctx);
+
+  MockWriteLogImageCache image_cache(mock_image_ctx);
+  MockImageWriteback &mock_image_writeback = *MockImageWriteback::s_instance;
+  ASSERT_EQ(0, init_cache(mock_image_ctx, image_cache));
+
+  // the largest entry in a 1M log: seven of them fit
+  bufferlist data = make_data('x', 128 << 10);
+  Context *writeback_ctx = nullptr;
+  EXPECT_CALL(mock_image_writeback,
+              aio_write_mock(Extents{{0, data.length()}}, ContentsEqual(data),
+                             _, _))
+    .WillOnce(SaveArg<3>(&writeback_ctx))
+    .RetiresOnSaturation();
+  ASSERT_EQ(0, write(image_cache, 0, data));
+  ASSERT_EQ(0, write(image_cache, 0, data));
+  ASSERT_NE(nullptr, writeback_ctx);
+  writeback_ctx->complete(-EIO);
+
+  {
+    // keep the retry timer from writing back under the writes below
+    SafeTimer *timer;
+    Mutex *timer_lock;
+    ImageCtx::get_timer_instance(ictx->cct, &timer, &timer_lock);
+    Mutex::Locker timer_locker(*timer_lock);
+
+    for (int i = 2; i < 7; ++i) {
+      ASSERT_EQ(0, write(image_cache, 0, data));
+    }
+    ASSERT_EQ(-EIO, write(image_cache, 0, data));
+  }
+
+  InSequence seq;
+  for (int i = 0; i < 7; ++i) {
+    expect_aio_write(mock_image_ctx, mock_image_writeback, 0, data, 0);
+  }
+  expect_aio_flush(mock_image_ctx, mock_image_writeback, 0);
+  C_SaferCond flush_ctx;
+  image_cache.flush(&flush_ctx);
+  ASSERT_EQ(0, flush_ctx.wait());
+
+  expect_aio_flush(mock_image_ctx, mock_image_writeback, 0);
+  ASSERT_EQ(0, shut_down_cache(image_cache));
+}
+
+} // namespace cache
+} // namespace librbd
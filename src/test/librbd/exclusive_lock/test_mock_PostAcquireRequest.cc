@@ -8,6 +8,7 @@
 #include "test/librbd/mock/MockJournal.h"
 #include "test/librbd/mock/MockJournalPolicy.h"
 #include "test/librbd/mock/MockObjectMap.h"
+#include "test/librbd/mock/cache/MockImageCache.h"
 #include "test/librados_test_stub/MockTestMemIoCtxImpl.h"
 #include "test/librados_test_stub/MockTestMemRadosClient.h"
 #include "librbd/exclusive_lock/PostAcquireRequest.h"
@@ -172,6 +173,19 @@ public:
     EXPECT_CALL(*mock_image_ctx.state, handle_prepare_lock_complete());
   }
 
+  void expect_create_image_cache(MockTestImageCtx &mock_image_ctx,
+                                 cache::MockImageCache *mock_image_cache) {
+    EXPECT_CALL(mock_image_ctx, create_image_cache())
+                  .WillOnce(Return(mock_image_cache));
+  }
+
+  void expect_init_image_cache(MockTestImageCtx &mock_image_ctx,
+                               cache::MockImageCache &mock_image_cache,
+                               int r) {
+    EXPECT_CALL(mock_image_cache, init(_))
+                  .WillOnce(CompleteContext(r, mock_image_ctx.image_ctx->op_work_queue));
+  }
+
 };
 
 TEST_F(TestMockExclusiveLockPostAcquireRequest, Success) {
@@ -274,6 +288,80 @@ TEST_F(TestMockExclusiveLockPostAcquireRequest, SuccessJournalDisabled) {
   ASSERT_EQ(0, ctx.wait());
 }
 
+TEST_F(TestMockExclusiveLockPostAcquireRequest, SuccessImageCache) {
+  REQUIRE_FEATURE(RBD_FEATURE_EXCLUSIVE_LOCK);
+
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockTestImageCtx mock_image_ctx(*ictx);
+  mock_image_ctx.config.set_val("rbd_persistent_cache_enabled", "true");
+  expect_op_work_queue(mock_image_ctx);
+
+  InSequence seq;
+  expect_is_refresh_required(mock_image_ctx, false);
+  expect_test_features(mock_image_ctx, RBD_FEATURE_OBJECT_MAP, false);
+  expect_test_features(mock_image_ctx, RBD_FEATURE_JOURNALING,
+                       mock_image_ctx.snap_lock, false);
+  expect_handle_prepare_lock_complete(mock_image_ctx);
+
+  cache::MockImageCache *mock_image_cache = new cache::MockImageCache();
+  expect_create_image_cache(mock_image_ctx, mock_image_cache);
+  expect_init_image_cache(mock_image_ctx, *mock_image_cache, 0);
+
+  C_SaferCond acquire_ctx;
+  C_SaferCond ctx;
+  MockPostAcquireRequest *req = MockPostAcquireRequest::create(mock_image_ctx,
+                                                               &acquire_ctx,
+                                                               &ctx);
+  req->send();
+  ASSERT_EQ(0, acquire_ctx.wait());
+  ASSERT_EQ(0, ctx.wait());
+  ASSERT_EQ(mock_image_cache, mock_image_ctx.image_cache);
+
+  mock_image_ctx.image_cache = nullptr;
+  delete mock_image_cache;
+}
+
+TEST_F(TestMockExclusiveLockPostAcquireRequest, ImageCacheError) {
+  REQUIRE_FEATURE(RBD_FEATURE_EXCLUSIVE_LOCK);
+
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockTestImageCtx mock_image_ctx(*ictx);
+  mock_image_ctx.config.set_val("rbd_persistent_cache_enabled", "true");
+  expect_op_work_queue(mock_image_ctx);
+
+  InSequence seq;
+  expect_is_refresh_required(mock_image_ctx, false);
+
+  MockObjectMap *mock_object_map = new MockObjectMap();
+  expect_test_features(mock_image_ctx, RBD_FEATURE_OBJECT_MAP, true);
+  expect_create_object_map(mock_image_ctx, mock_object_map);
+  expect_open_object_map(mock_image_ctx, *mock_object_map, 0);
+
+  expect_test_features(mock_image_ctx, RBD_FEATURE_JOURNALING,
+                       mock_image_ctx.snap_lock, false);
+  expect_handle_prepare_lock_complete(mock_image_ctx);
+
+  cache::MockImageCache *mock_image_cache = new cache::MockImageCache();
+  expect_create_image_cache(mock_image_ctx, mock_image_cache);
+  expect_init_image_cache(mock_image_ctx, *mock_image_cache, -EIO);
+  expect_close_object_map(mock_image_ctx, *mock_object_map);
+
+  C_SaferCond acquire_ctx;
+  C_SaferCond ctx;
+  MockPostAcquireRequest *req = MockPostAcquireRequest::create(mock_image_ctx,
+                                                               &acquire_ctx,
+                                                               &ctx);
+  req->send();
+  ASSERT_EQ(0, acquire_ctx.wait());
+  ASSERT_EQ(-EIO, ctx.wait());
+  ASSERT_EQ(nullptr, mock_image_ctx.image_cache);
+  ASSERT_EQ(nullptr, mock_image_ctx.object_map);
+}
+
 TEST_F(TestMockExclusiveLockPostAcquireRequest, SuccessObjectMapDisabled) {
   REQUIRE_FEATURE(RBD_FEATURE_EXCLUSIVE_LOCK);
 
@@ -0,0 +1,278 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "test/librbd/test_mock_fixture.h"
+#include "test/librbd/test_support.h"
+#include "test/librbd/mock/MockImageCtx.h"
+#include "include/rbd/librbd.hpp"
+#include "include/stringify.h"
+#include "librbd/io/ObjectDispatchSpec.h"
+#include "librbd/io/WriteCoalesceObjectDispatch.h"
+
+namespace librbd {
+namespace {
+
+struct MockTestImageCtx : public MockImageCtx {
+  MockTestImageCtx(ImageCtx &image_ctx) : MockImageCtx(image_ctx) {
+  }
+};
+
+} // anonymous namespace
+} // namespace librbd
+
+// template definitions
+#include "librbd/io/WriteCoalesceObjectDispatch.cc"
+
+namespace librbd {
+namespace io {
+
+using ::testing::_;
+using ::testing::InSequence;
+using ::testing::Invoke;
+
+class TestMockIoWriteCoalesceObjectDispatch : public TestMockFixture {
+public:
+  typedef WriteCoalesceObjectDispatch<librbd::MockTestImageCtx> MockWriteCoalesceObjectDispatch;
+
+  void init_config(MockTestImageCtx &mock_image_ctx) {
+    // writes are only sent once the writes in flight complete
+    mock_image_ctx.config.set_val("rbd_write_coalesce_max_delay", "600");
+  }
+
+  void expect_register_object_dispatch(MockTestImageCtx &mock_image_ctx) {
+    EXPECT_CALL(*mock_image_ctx.io_object_dispatcher,
+                register_object_dispatch(_));
+  }
+
+  void expect_write(MockTestImageCtx &mock_image_ctx, uint64_t object_off,
+                    const std::string &data, int r) {
+    EXPECT_CALL(*mock_image_ctx.io_object_dispatcher, send(_))
+      .WillOnce(Invoke([&mock_image_ctx, object_off, data, r]
+                       (ObjectDispatchSpec* spec) {
+                  auto write = boost::get<ObjectDispatchSpec::WriteRequest>(
+                    &spec->request);
+                  ASSERT_TRUE(write != nullptr);
+                  ASSERT_EQ(OBJECT_DISPATCH_LAYER_WRITE_COALESCE,
+                            spec->object_dispatch_layer);
+                  ASSERT_EQ(object_off, write->object_off);
+                  ASSERT_EQ(data, write->data.to_str());
+
+                  spec->dispatch_result = DISPATCH_RESULT_COMPLETE;
+                  mock_image_ctx.image_ctx->op_work_queue->queue(
+                    &spec->dispatcher_ctx, r);
+                }));
+  }
+
+  bool write(MockWriteCoalesceObjectDispatch &object_dispatch,
+             uint64_t object_off, const std::string &data,
+             uint64_t journal_tid, Context **on_finish,
+             Context *on_dispatched) {
+    bufferlist bl;
+    bl.append(data);
+    DispatchResult dispatch_result;
+    int object_dispatch_flags = 0;
+    if (!object_dispatch.write("object0", 0, object_off, std::move(bl), {}, 0,
+                               {}, &object_dispatch_flags, &journal_tid,
+                               &dispatch_result, on_finish, on_dispatched)) {
+      return false;
+    }
+    EXPECT_EQ(DISPATCH_RESULT_COMPLETE, dispatch_result);
+    return true;
+  }
+
+  int shut_down(MockWriteCoalesceObjectDispatch *object_dispatch) {
+    C_SaferCond ctx;
+    object_dispatch->shut_down(&ctx);
+    int r = ctx.wait();
+    delete object_dispatch;
+    return r;
+  }
+};
+
+TEST_F(TestMockIoWriteCoalesceObjectDispatch, IdleObject) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockTestImageCtx mock_image_ctx(*ictx);
+  init_config(mock_image_ctx);
+
+  auto object_dispatch = MockWriteCoalesceObjectDispatch::create(
+    &mock_image_ctx);
+  expect_register_object_dispatch(mock_image_ctx);
+  object_dispatch->init();
+
+  C_SaferCond on_write;
+  Context *on_finish = &on_write;
+  ASSERT_FALSE(write(*object_dispatch, 0, std::string(512, '1'), 0,
+                     &on_finish, nullptr));
+  ASSERT_NE(&on_write, on_finish);
+
+  on_finish->complete(0);
+  ASSERT_EQ(0, on_write.wait());
+
+  ASSERT_EQ(0, shut_down(object_dispatch));
+}
+
+TEST_F(TestMockIoWriteCoalesceObjectDispatch, MergeAdjacent) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockTestImageCtx mock_image_ctx(*ictx);
+  init_config(mock_image_ctx);
+
+  auto object_dispatch = MockWriteCoalesceObjectDispatch::create(
+    &mock_image_ctx);
+  expect_register_object_dispatch(mock_image_ctx);
+  object_dispatch->init();
+
+  C_SaferCond on_write1;
+  Context *on_finish = &on_write1;
+  ASSERT_FALSE(write(*object_dispatch, 0, std::string(512, '1'), 0,
+                     &on_finish, nullptr));
+
+  C_SaferCond on_dispatched2;
+  C_SaferCond on_dispatched3;
+  Context *on_finish2 = nullptr;
+  Context *on_finish3 = nullptr;
+  ASSERT_TRUE(write(*object_dispatch, 512, std::string(512, '2'), 0,
+                    &on_finish2, &on_dispatched2));
+  ASSERT_TRUE(write(*object_dispatch, 1024, std::string(512, '3'), 0,
+                    &on_finish3, &on_dispatched3));
+
+  expect_write(mock_image_ctx, 512,
+               std::string(512, '2') + std::string(512, '3'), -EIO);
+
+  on_finish->complete(0);
+  ASSERT_EQ(0, on_write1.wait());
+  ASSERT_EQ(-EIO, on_dispatched2.wait());
+  ASSERT_EQ(-EIO, on_dispatched3.wait());
+
+  ASSERT_EQ(0, shut_down(object_dispatch));
+}
+
+TEST_F(TestMockIoWriteCoalesceObjectDispatch, NonSequential) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockTestImageCtx mock_image_ctx(*ictx);
+  init_config(mock_image_ctx);
+
+  auto object_dispatch = MockWriteCoalesceObjectDispatch::create(
+    &mock_image_ctx);
+  expect_register_object_dispatch(mock_image_ctx);
+  object_dispatch->init();
+
+  C_SaferCond on_write1;
+  Context *on_finish1 = &on_write1;
+  ASSERT_FALSE(write(*object_dispatch, 0, std::string(512, '1'), 0,
+                     &on_finish1, nullptr));
+
+  // a write elsewhere in the object is not held
+  C_SaferCond on_write2;
+  Context *on_finish2 = &on_write2;
+  ASSERT_FALSE(write(*object_dispatch, 8192, std::string(512, '2'), 0,
+                     &on_finish2, nullptr));
+  ASSERT_NE(&on_write2, on_finish2);
+
+  // but one which continues it is
+  C_SaferCond on_dispatched3;
+  Context *on_finish3 = nullptr;
+  ASSERT_TRUE(write(*object_dispatch, 8704, std::string(512, '3'), 0,
+                    &on_finish3, &on_dispatched3));
+
+  // the held write is sent ahead of a write which does not extend it
+  expect_write(mock_image_ctx, 8704, std::string(512, '3'), 0);
+  C_SaferCond on_write4;
+  Context *on_finish4 = &on_write4;
+  ASSERT_FALSE(write(*object_dispatch, 512, std::string(512, '4'), 0,
+                     &on_finish4, nullptr));
+  ASSERT_NE(&on_write4, on_finish4);
+  ASSERT_EQ(0, on_dispatched3.wait());
+
+  on_finish1->complete(0);
+  ASSERT_EQ(0, on_write1.wait());
+  on_finish2->complete(0);
+  ASSERT_EQ(0, on_write2.wait());
+  on_finish4->complete(0);
+  ASSERT_EQ(0, on_write4.wait());
+
+  ASSERT_EQ(0, shut_down(object_dispatch));
+}
+
+TEST_F(TestMockIoWriteCoalesceObjectDispatch, JournaledWrite) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockTestImageCtx mock_image_ctx(*ictx);
+  init_config(mock_image_ctx);
+
+  auto object_dispatch = MockWriteCoalesceObjectDispatch::create(
+    &mock_image_ctx);
+  expect_register_object_dispatch(mock_image_ctx);
+  object_dispatch->init();
+
+  C_SaferCond on_write1;
+  Context *on_finish1 = &on_write1;
+  ASSERT_FALSE(write(*object_dispatch, 0, std::string(512, '1'), 0,
+                     &on_finish1, nullptr));
+
+  C_SaferCond on_dispatched2;
+  Context *on_finish2 = nullptr;
+  ASSERT_TRUE(write(*object_dispatch, 512, std::string(512, '2'), 0,
+                    &on_finish2, &on_dispatched2));
+
+  // the held write is sent ahead of the journaled write
+  expect_write(mock_image_ctx, 512, std::string(512, '2'), 0);
+  C_SaferCond on_write3;
+  Context *on_finish3 = &on_write3;
+  ASSERT_FALSE(write(*object_dispatch, 1024, std::string(512, '3'), 123,
+                     &on_finish3, nullptr));
+  ASSERT_NE(&on_write3, on_finish3);
+  ASSERT_EQ(0, on_dispatched2.wait());
+
+  on_finish1->complete(0);
+  ASSERT_EQ(0, on_write1.wait());
+  on_finish3->complete(0);
+  ASSERT_EQ(0, on_write3.wait());
+
+  ASSERT_EQ(0, shut_down(object_dispatch));
+}
+
+TEST_F(TestMockIoWriteCoalesceObjectDispatch, Flush) {
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockTestImageCtx mock_image_ctx(*ictx);
+  init_config(mock_image_ctx);
+
+  auto object_dispatch = MockWriteCoalesceObjectDispatch::create(
+    &mock_image_ctx);
+  expect_register_object_dispatch(mock_image_ctx);
+  object_dispatch->init();
+
+  C_SaferCond on_write1;
+  Context *on_finish1 = &on_write1;
+  ASSERT_FALSE(write(*object_dispatch, 0, std::string(512, '1'), 0,
+                     &on_finish1, nullptr));
+
+  C_SaferCond on_dispatched2;
+  Context *on_finish2 = nullptr;
+  ASSERT_TRUE(write(*object_dispatch, 512, std::string(512, '2'), 0,
+                    &on_finish2, &on_dispatched2));
+
+  expect_write(mock_image_ctx, 512, std::string(512, '2'), 0);
+  DispatchResult dispatch_result;
+  C_SaferCond on_flush;
+  Context *on_finish = &on_flush;
+  ASSERT_FALSE(object_dispatch->flush(FLUSH_SOURCE_USER, {}, &dispatch_result,
+                                      &on_finish, nullptr));
+  ASSERT_EQ(0, on_dispatched2.wait());
+
+  on_finish1->complete(0);
+  ASSERT_EQ(0, on_write1.wait());
+
+  ASSERT_EQ(0, shut_down(object_dispatch));
+}
+
+} // namespace io
+} // namespace librbd
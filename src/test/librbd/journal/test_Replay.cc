@@ -4,6 +4,7 @@
 #include "test/librbd/test_fixture.h"
 #include "test/librbd/test_support.h"
 #include "cls/rbd/cls_rbd_types.h"
+#include "common/Clock.h"
 #include "cls/journal/cls_journal_types.h"
 #include "cls/journal/cls_journal_client.h"
 #include "journal/Journaler.h"
@@ -870,3 +871,71 @@ TEST_F(TestJournalReplay, ObjectPosition) {
   ASSERT_EQ(initial_tag + 1, current_tag);
   ASSERT_EQ(3, current_entry);
 }
+
+TEST_F(TestJournalReplay, AioWriteEventBatched) {
+  REQUIRE_FEATURE(RBD_FEATURE_JOURNALING);
+
+  // replay throughput w/o a writeback cache, serially and batched
+  std::string orig_cache;
+  std::string orig_max_writes;
+  ASSERT_EQ(0, _rados.conf_get("rbd_cache", orig_cache));
+  ASSERT_EQ(0, _rados.conf_get("rbd_journal_replay_max_concurrent_writes",
+                               orig_max_writes));
+  ASSERT_EQ(0, _rados.conf_set("rbd_cache", "false"));
+
+  const uint64_t write_count = 128;
+  const uint64_t write_size = 4096;
+  char c = '1';
+  for (auto max_writes : {"1", "16"}) {
+    ASSERT_EQ(0, _rados.conf_set("rbd_journal_replay_max_concurrent_writes",
+                                 max_writes));
+
+    librbd::ImageCtx *ictx;
+    ASSERT_EQ(0, open_image(m_image_name, &ictx));
+    ASSERT_EQ(0, when_acquired_lock(ictx));
+
+    // disjoint writes followed by a write overlapping the first two
+    bufferlist payload_bl;
+    payload_bl.append(std::string(write_size, c));
+    for (uint64_t i = 0; i < write_count; ++i) {
+      inject_into_journal(ictx,
+          librbd::journal::AioWriteEvent(i * write_size, write_size,
+                                         payload_bl));
+    }
+    bufferlist overlap_bl;
+    overlap_bl.append(std::string(write_size, 'z'));
+    inject_into_journal(ictx,
+        librbd::journal::AioWriteEvent(write_size / 2, write_size,
+                                       overlap_bl));
+    close_image(ictx);
+
+    // re-open the journal so that it replays the new entries
+    ASSERT_EQ(0, open_image(m_image_name, &ictx));
+    utime_t start = ceph_clock_now();
+    ASSERT_EQ(0, when_acquired_lock(ictx));
+    utime_t elapsed = ceph_clock_now() - start;
+    std::cout << "max_concurrent_writes=" << max_writes << ": replayed "
+              << write_count + 1 << " writes in " << elapsed << " ("
+              << (write_count + 1) * 1000 /
+                   std::max<uint64_t>(elapsed.to_msec(), 1)
+              << " writes/sec)" << std::endl;
+
+    std::string expected_payload =
+      std::string(write_size / 2, c) + std::string(write_size, 'z') +
+      std::string(write_size / 2, c);
+    std::string read_payload(expected_payload.size(), '\0');
+    librbd::io::ReadResult read_result{&read_payload[0], read_payload.size()};
+    auto aio_comp = new librbd::io::AioCompletion();
+    ictx->io_work_queue->aio_read(aio_comp, 0, read_payload.size(),
+                                  std::move(read_result), 0);
+    ASSERT_EQ(0, aio_comp->wait_for_complete());
+    aio_comp->release();
+    ASSERT_EQ(expected_payload, read_payload);
+    close_image(ictx);
+    ++c;
+  }
+
+  ASSERT_EQ(0, _rados.conf_set("rbd_journal_replay_max_concurrent_writes",
+                               orig_max_writes.c_str()));
+  ASSERT_EQ(0, _rados.conf_set("rbd_cache", orig_cache.c_str()));
+}
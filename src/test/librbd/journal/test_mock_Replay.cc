@@ -432,6 +432,123 @@ TEST_F(TestMockJournalReplay, AioWrite) {
   ASSERT_EQ(0, on_safe.wait());
 }
 
+TEST_F(TestMockJournalReplay, AioWriteBatched) {
+  REQUIRE_FEATURE(RBD_FEATURE_JOURNALING);
+
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockReplayImageCtx mock_image_ctx(*ictx);
+  mock_image_ctx.config.set_val("rbd_journal_replay_max_concurrent_writes",
+                                "4");
+
+  MockExclusiveLock mock_exclusive_lock;
+  mock_image_ctx.exclusive_lock = &mock_exclusive_lock;
+  expect_accept_ops(mock_exclusive_lock, true);
+
+  MockJournalReplay mock_journal_replay(mock_image_ctx);
+  MockIoImageRequest mock_io_image_request;
+  expect_writeback_cache_enabled(mock_image_ctx, false);
+  expect_op_work_queue(mock_image_ctx);
+
+  InSequence seq;
+  io::AioCompletion *aio_comp1;
+  C_SaferCond on_ready1;
+  C_SaferCond on_safe1;
+  expect_aio_write(mock_io_image_request, &aio_comp1, 0, 512, "test1");
+  when_process(mock_journal_replay,
+               EventEntry{AioWriteEvent(0, 512, to_bl("test1"))},
+               &on_ready1, &on_safe1);
+  ASSERT_EQ(0, on_ready1.wait());
+
+  io::AioCompletion *aio_comp2;
+  C_SaferCond on_ready2;
+  C_SaferCond on_safe2;
+  expect_aio_write(mock_io_image_request, &aio_comp2, 1024, 512, "test2");
+  when_process(mock_journal_replay,
+               EventEntry{AioWriteEvent(1024, 512, to_bl("test2"))},
+               &on_ready2, &on_safe2);
+  ASSERT_EQ(0, on_ready2.wait());
+
+  // overlapping write waits for the first write to complete
+  io::AioCompletion *aio_comp3;
+  C_SaferCond on_ready3;
+  C_SaferCond on_safe3;
+  when_process(mock_journal_replay,
+               EventEntry{AioWriteEvent(256, 512, to_bl("test3"))},
+               &on_ready3, &on_safe3);
+
+  expect_aio_write(mock_io_image_request, &aio_comp3, 256, 512, "test3");
+  when_complete(mock_image_ctx, aio_comp1, 0);
+  ASSERT_EQ(0, on_safe1.wait());
+  ASSERT_EQ(0, on_ready3.wait());
+
+  when_complete(mock_image_ctx, aio_comp2, 0);
+  ASSERT_EQ(0, on_safe2.wait());
+  when_complete(mock_image_ctx, aio_comp3, 0);
+  ASSERT_EQ(0, on_safe3.wait());
+
+  ASSERT_EQ(0, when_shut_down(mock_journal_replay, false));
+}
+
+TEST_F(TestMockJournalReplay, AioWriteBatchedFlush) {
+  REQUIRE_FEATURE(RBD_FEATURE_JOURNALING);
+
+  librbd::ImageCtx *ictx;
+  ASSERT_EQ(0, open_image(m_image_name, &ictx));
+
+  MockReplayImageCtx mock_image_ctx(*ictx);
+  mock_image_ctx.config.set_val("rbd_journal_replay_max_concurrent_writes",
+                                "4");
+
+  MockExclusiveLock mock_exclusive_lock;
+  mock_image_ctx.exclusive_lock = &mock_exclusive_lock;
+  expect_accept_ops(mock_exclusive_lock, true);
+
+  MockJournalReplay mock_journal_replay(mock_image_ctx);
+  MockIoImageRequest mock_io_image_request;
+  expect_writeback_cache_enabled(mock_image_ctx, false);
+  expect_op_work_queue(mock_image_ctx);
+
+  InSequence seq;
+  io::AioCompletion *aio_comp1;
+  C_SaferCond on_ready1;
+  C_SaferCond on_safe1;
+  expect_aio_write(mock_io_image_request, &aio_comp1, 0, 512, "test1");
+  when_process(mock_journal_replay,
+               EventEntry{AioWriteEvent(0, 512, to_bl("test1"))},
+               &on_ready1, &on_safe1);
+  ASSERT_EQ(0, on_ready1.wait());
+
+  // flush waits for the batched write to complete
+  io::AioCompletion *flush_comp;
+  C_SaferCond on_flush_ready;
+  C_SaferCond on_flush_safe;
+  when_process(mock_journal_replay, EventEntry{AioFlushEvent()},
+               &on_flush_ready, &on_flush_safe);
+
+  expect_aio_flush(mock_io_image_request, &flush_comp);
+  when_complete(mock_image_ctx, aio_comp1, 0);
+  ASSERT_EQ(0, on_safe1.wait());
+  ASSERT_EQ(0, on_flush_ready.wait());
+
+  io::AioCompletion *aio_comp2;
+  C_SaferCond on_ready2;
+  C_SaferCond on_safe2;
+  expect_aio_write(mock_io_image_request, &aio_comp2, 1024, 512, "test2");
+  when_process(mock_journal_replay,
+               EventEntry{AioWriteEvent(1024, 512, to_bl("test2"))},
+               &on_ready2, &on_safe2);
+  ASSERT_EQ(0, on_ready2.wait());
+
+  when_complete(mock_image_ctx, flush_comp, 0);
+  ASSERT_EQ(0, on_flush_safe.wait());
+  when_complete(mock_image_ctx, aio_comp2, 0);
+  ASSERT_EQ(0, on_safe2.wait());
+
+  ASSERT_EQ(0, when_shut_down(mock_journal_replay, false));
+}
+
 TEST_F(TestMockJournalReplay, AioFlush) {
   REQUIRE_FEATURE(RBD_FEATURE_JOURNALING);
 
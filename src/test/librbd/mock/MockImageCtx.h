@@ -199,6 +199,7 @@ struct MockImageCtx {
   MOCK_METHOD0(create_exclusive_lock, MockExclusiveLock*());
   MOCK_METHOD1(create_object_map, MockObjectMap*(uint64_t));
   MOCK_METHOD0(create_journal, MockJournal*());
+  MOCK_METHOD0(create_image_cache, cache::MockImageCache*());
 
   MOCK_METHOD0(notify_update, void());
   MOCK_METHOD1(notify_update, void(Context *));
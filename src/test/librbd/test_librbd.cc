@@ -4169,6 +4169,70 @@ TYPED_TEST(DiffIterateTest, DiffIterateRegression6926)
   ASSERT_EQ(static_cast<size_t>(0), extents.size());
 }
 
+TYPED_TEST(DiffIterateTest, DiffIterateLargeSparse)
+{
+  librados::IoCtx ioctx;
+  ASSERT_EQ(0, this->_rados.ioctx_create(this->m_pool_name.c_str(), ioctx));
+
+  librbd::RBD rbd;
+  librbd::Image image;
+  int order = 22;
+  std::string name = this->get_temp_image_name();
+  uint64_t size = 16ULL << 30;
+
+  ASSERT_EQ(0, create_image_pp(rbd, ioctx, name.c_str(), size, &order));
+  ASSERT_EQ(0, rbd.open(ioctx, image, name.c_str(), NULL));
+
+  uint64_t object_size = 1 << order;
+  uint64_t object_count = size / object_size;
+  ceph::bufferlist bl;
+  bl.append(std::string(4096, '1'));
+
+  // sparse data, then a few updates and a removed object after the snapshot
+  for (uint64_t object_no = 0; object_no < object_count; object_no += 64) {
+    ASSERT_EQ(4096, image.write(object_no * object_size, 4096, bl));
+  }
+  ASSERT_EQ(0, image.snap_create("one"));
+
+  interval_set<uint64_t> two;
+  for (uint64_t object_no = 32; object_no < object_count; object_no += 512) {
+    uint64_t off = object_no * object_size + 8192;
+    ASSERT_EQ(4096, image.write(off, 4096, bl));
+    two.insert(off, 4096);
+  }
+  ASSERT_EQ(static_cast<int>(object_size),
+            image.discard(64 * object_size, object_size));
+
+  vector<diff_extent> extents;
+  auto start = std::chrono::steady_clock::now();
+  ASSERT_EQ(0, image.diff_iterate2("one", 0, size, true, this->whole_object,
+                                   vector_iterate_cb, (void *) &extents));
+  auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+    std::chrono::steady_clock::now() - start);
+  cout << " diff of " << object_count << " objects took " << elapsed.count()
+       << " ms" << std::endl;
+
+  interval_set<uint64_t> diff;
+  interval_set<uint64_t> holes;
+  for (auto &e : extents) {
+    ASSERT_EQ(e.offset / object_size, (e.offset + e.length - 1) / object_size);
+    interval_set<uint64_t> extent;
+    extent.insert(e.offset, e.length);
+    if (e.exists) {
+      ASSERT_EQ(32u, (e.offset / object_size) % 512);
+      diff.union_of(extent);
+    } else {
+      holes.union_of(extent);
+    }
+  }
+  ASSERT_TRUE(two.subset_of(diff));
+
+  interval_set<uint64_t> removed;
+  removed.insert(64 * object_size, object_size);
+  ASSERT_FALSE(holes.empty());
+  ASSERT_TRUE(holes.subset_of(removed));
+}
+
 TYPED_TEST(DiffIterateTest, DiffIterateIgnoreParent)
 {
   REQUIRE_FEATURE(RBD_FEATURE_LAYERING);
@@ -1072,6 +1072,9 @@ INSTANTIATE_TEST_CASE_P(
   ::testing::Values(
 #ifdef HAVE_DPDK
     "dpdk",
+#endif
+#ifdef HAVE_LIBURING
+    "uring",
 #endif
     "posix"
   )
@@ -30,10 +30,12 @@
 #include "msg/Connection.h"
 #include "messages/MPing.h"
 #include "messages/MCommand.h"
+#include "common/perf_counters_collection.h"
 
 #include <boost/random/mersenne_twister.hpp>
 #include <boost/random/uniform_int.hpp>
 #include <boost/random/binomial_distribution.hpp>
+#include <boost/algorithm/string/predicate.hpp>
 #include <gtest/gtest.h>
 
 typedef boost::mt11213b gen_type;
@@ -791,6 +793,100 @@ TEST_P(MessengerTest, MessageTest) {
 }
 
 
+class OrderDispatcher : public Dispatcher {
+ public:
+  Mutex lock;
+  Cond cond;
+  vector<uint64_t> seqs;
+
+  OrderDispatcher(): Dispatcher(g_ceph_context), lock("OrderDispatcher::lock") {
+    ms_set_require_authorizer(false);
+  }
+  bool ms_can_fast_dispatch_any() const override { return true; }
+  bool ms_can_fast_dispatch(const Message *m) const override {
+    return m->get_type() == CEPH_MSG_PING;
+  }
+  void ms_fast_dispatch(Message *m) override {
+    Mutex::Locker l(lock);
+    seqs.push_back(m->get_seq());
+    cond.Signal();
+    m->put();
+  }
+  bool ms_dispatch(Message *m) override {
+    m->put();
+    return true;
+  }
+  bool ms_handle_reset(Connection *con) override { return true; }
+  void ms_handle_remote_reset(Connection *con) override {}
+  bool ms_handle_refused(Connection *con) override { return false; }
+  int ms_handle_authentication(Connection *con) override { return 1; }
+};
+
+static uint64_t get_send_batches() {
+  uint64_t batches = 0;
+  g_ceph_context->get_perfcounters_collection()->with_counters(
+    [&batches](const PerfCountersCollectionImpl::CounterMap &by_path) {
+      for (auto& [path, ref] : by_path) {
+        if (boost::algorithm::ends_with(path, ".msgr_send_batches"))
+          batches += ref.data->u64;
+      }
+    });
+  return batches;
+}
+
+TEST_P(MessengerTest, SendBatchTest) {
+  g_ceph_context->_conf.set_val("ms_async_send_batch_msgs", "8");
+  FakeDispatcher cli_dispatcher(false);
+  OrderDispatcher srv_dispatcher;
+  entity_addr_t bind_addr;
+  bind_addr.parse("127.0.0.1");
+  Messenger::Policy p = Messenger::Policy::stateful_server(0);
+  server_msgr->set_policy(entity_name_t::TYPE_CLIENT, p);
+  p = Messenger::Policy::lossless_peer(0);
+  client_msgr->set_policy(entity_name_t::TYPE_OSD, p);
+
+  server_msgr->bind(bind_addr);
+  server_msgr->add_dispatcher_head(&srv_dispatcher);
+  server_msgr->start();
+  client_msgr->add_dispatcher_head(&cli_dispatcher);
+  client_msgr->start();
+
+  // queue the messages while the session is still being set up, so they
+  // are all waiting when the connection first becomes writeable
+  const unsigned num_msgs = 64;
+  uint64_t batches = get_send_batches();
+  ConnectionRef conn = client_msgr->connect_to(server_msgr->get_mytype(),
+					       server_msgr->get_myaddrs());
+  for (unsigned i = 0; i < num_msgs; ++i) {
+    ASSERT_EQ(conn->send_message(new MPing()), 0);
+  }
+  {
+    utime_t t;
+    t += 1000*1000*500;
+    Mutex::Locker l(srv_dispatcher.lock);
+    while (srv_dispatcher.seqs.size() < num_msgs) {
+      if (srv_dispatcher.cond.WaitInterval(srv_dispatcher.lock, t) != 0)
+        break;
+    }
+    ASSERT_EQ(num_msgs, srv_dispatcher.seqs.size());
+    for (unsigned i = 1; i < num_msgs; ++i) {
+      ASSERT_EQ(srv_dispatcher.seqs[i - 1] + 1, srv_dispatcher.seqs[i]);
+    }
+  }
+  // no batch carries more than ms_async_send_batch_msgs messages, and
+  // queued messages share a write rather than each taking their own
+  batches = get_send_batches() - batches;
+  ASSERT_GE(batches, num_msgs / 8);
+  ASSERT_LT(batches, num_msgs);
+
+  server_msgr->shutdown();
+  client_msgr->shutdown();
+  server_msgr->wait();
+  client_msgr->wait();
+  g_ceph_context->_conf.set_val("ms_async_send_batch_msgs", "32");
+}
+
+
 class SyntheticWorkload;
 
 struct Payload {
@@ -1528,6 +1624,9 @@ INSTANTIATE_TEST_CASE_P(
   MessengerTest,
   ::testing::Values(
     "async+posix",
+#ifdef HAVE_LIBURING
+    "async+uring",
+#endif
     "simple"
   )
 );
@@ -274,6 +274,138 @@ TEST_F(OSDMapTest, MapFunctionsMatch) {
   EXPECT_EQ(acting_osds, acting_osds_two);
 }
 
+TEST_F(OSDMapTest, MapPGRangeMatches) {
+  set_up_map();
+
+  // exercise the temp, upmap and affinity paths too
+  OSDMap::Incremental pending_inc(osdmap.get_epoch() + 1);
+  pg_t temppg = osdmap.raw_pg_to_pg(pg_t(3, my_rep_pool));
+  pending_inc.new_pg_temp[temppg] =
+    mempool::osdmap::vector<int>({0, 1, 2});
+  pending_inc.new_primary_affinity[1] = 0x4000;
+  osdmap.apply_incremental(pending_inc);
+
+  for (auto pool : {my_ec_pool, my_rep_pool}) {
+    unsigned pg_num = osdmap.get_pg_pool(pool)->get_pg_num();
+    unsigned seen = 0;
+    osdmap.pg_range_to_up_acting_osds(
+      pool, 0, pg_num,
+      [&](ps_t ps,
+	  vector<int>& up, int up_primary,
+	  vector<int>& acting, int acting_primary) {
+	vector<int> up2, acting2;
+	int up_primary2, acting_primary2;
+	osdmap.pg_to_up_acting_osds(pg_t(ps, pool), &up2, &up_primary2,
+				    &acting2, &acting_primary2);
+	EXPECT_EQ(up2, up);
+	EXPECT_EQ(up_primary2, up_primary);
+	EXPECT_EQ(acting2, acting);
+	EXPECT_EQ(acting_primary2, acting_primary);
+	++seen;
+      });
+    ASSERT_EQ(pg_num, seen);
+  }
+}
+
+TEST_F(OSDMapTest, MappingIncremental) {
+  set_up_map();
+  mapping.update(osdmap);
+
+  auto check = [&](const OSDMap::Incremental& inc) {
+    osdmap.apply_incremental(inc);
+    ASSERT_TRUE(mapping.update_incremental(g_ceph_context, osdmap, inc,
+					   0, true));
+    ASSERT_EQ(osdmap.get_epoch(), mapping.get_epoch());
+  };
+
+  {
+    // mark an osd down
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.new_state[1] = CEPH_OSD_UP;
+    check(inc);
+  }
+  {
+    // pg_temp and upmap
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    pg_t pga = osdmap.raw_pg_to_pg(pg_t(0, my_rep_pool));
+    pg_t pgb = osdmap.raw_pg_to_pg(pg_t(1, my_rep_pool));
+    inc.new_pg_temp[pga] = mempool::osdmap::vector<int>({3, 4, 5});
+    inc.new_pg_upmap[pgb] = mempool::osdmap::vector<int32_t>({0, 2, 5});
+    check(inc);
+  }
+  {
+    // primary affinity
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.new_primary_affinity[2] = 0;
+    check(inc);
+  }
+  {
+    // mark the osd back up
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.new_state[1] = CEPH_OSD_UP;
+    check(inc);
+  }
+  {
+    // mark an osd out
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.new_weight[4] = CEPH_OSD_OUT;
+    check(inc);
+  }
+  {
+    // crush changes need a full update
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    osdmap.crush->encode(inc.crush, CEPH_FEATURES_SUPPORTED_DEFAULT);
+    osdmap.apply_incremental(inc);
+    ASSERT_FALSE(mapping.update_incremental(g_ceph_context, osdmap, inc));
+  }
+}
+
+TEST_F(OSDMapTest, CopyOnWriteSections) {
+  set_up_map();
+
+  bufferlist orig_bl;
+  osdmap.encode(orig_bl, CEPH_FEATURES_SUPPORTED_DEFAULT);
+
+  OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+  inc.fsid = osdmap.get_fsid();
+  pg_t pgid = osdmap.raw_pg_to_pg(pg_t(0, my_rep_pool));
+  inc.new_pg_temp[pgid] = mempool::osdmap::vector<int>({0, 1, 2});
+  inc.new_primary_temp[pgid] = 1;
+  inc.new_pg_upmap_items[pg_t(1, my_rep_pool)] =
+    mempool::osdmap::vector<pair<int32_t,int32_t>>({{0, 3}});
+  uuid_d new_uuid;
+  new_uuid.generate_random();
+  inc.new_uuid[2] = new_uuid;
+  osd_xinfo_t xi;
+  xi.laggy_interval = 42;
+  inc.new_xinfo[3] = xi;
+
+  // apply to a copy that shares sections with osdmap...
+  OSDMap shared;
+  shared.deepish_copy_from(osdmap);
+  shared.apply_incremental(inc);
+
+  // ...and to a freshly decoded one
+  OSDMap decoded;
+  decoded.decode(orig_bl);
+  decoded.apply_incremental(inc);
+
+  bufferlist shared_bl, decoded_bl, after_bl;
+  shared.encode(shared_bl, CEPH_FEATURES_SUPPORTED_DEFAULT);
+  decoded.encode(decoded_bl, CEPH_FEATURES_SUPPORTED_DEFAULT);
+  ASSERT_TRUE(shared_bl.contents_equal(decoded_bl));
+  ASSERT_EQ(1u, shared.get_num_pg_temp());
+  ASSERT_EQ(new_uuid, shared.get_uuid(2));
+  ASSERT_EQ(42u, shared.get_xinfo(3).laggy_interval);
+
+  // the source map must be left untouched
+  osdmap.encode(after_bl, CEPH_FEATURES_SUPPORTED_DEFAULT);
+  ASSERT_TRUE(orig_bl.contents_equal(after_bl));
+  ASSERT_EQ(0u, osdmap.get_num_pg_temp());
+  ASSERT_NE(new_uuid, osdmap.get_uuid(2));
+  ASSERT_EQ(0u, osdmap.get_xinfo(3).laggy_interval);
+}
+
 /** This test must be removed or modified appropriately when we allow
  * other ways to specify a primary. */
 TEST_F(OSDMapTest, PrimaryIsFirst) {
@@ -142,6 +142,57 @@ TEST(TestOSDScrub, scrub_time_permit) {
 
 }
 
+TEST(DeepScrubReadBudget, unlimited) {
+  DeepScrubReadBudget b;
+  utime_t now(100, 0);
+  ASSERT_EQ(0, b.charge(1 << 30, 0, now));
+  ASSERT_EQ(0, b.charge(1 << 30, 0, now));
+  ASSERT_EQ(0, b.budget);
+}
+
+TEST(DeepScrubReadBudget, debt) {
+  DeepScrubReadBudget b;
+  const uint64_t rate = 1 << 20;
+  utime_t now(100, 0);
+
+  // the first charge starts from an empty bucket
+  ASSERT_DOUBLE_EQ(4.0, b.charge(4 << 20, rate, now));
+
+  // the debt is paid back at rate
+  now += 1.0;
+  ASSERT_DOUBLE_EQ(3.5, b.charge(512 << 10, rate, now));
+  now += 3.5;
+  ASSERT_EQ(0, b.charge(0, rate, now));
+  ASSERT_EQ(0, b.charge(0, rate, now));
+  ASSERT_DOUBLE_EQ(0.5, b.charge(512 << 10, rate, now));
+}
+
+TEST(DeepScrubReadBudget, burst) {
+  DeepScrubReadBudget b;
+  const uint64_t rate = 1 << 20;
+  utime_t now(100, 0);
+  ASSERT_EQ(0, b.charge(0, rate, now));
+
+  // an idle minute only earns a second's worth of reads
+  now += 60.0;
+  ASSERT_EQ(0, b.charge(rate, rate, now));
+  ASSERT_DOUBLE_EQ(1.0, b.charge(rate, rate, now));
+
+  // a clock going backwards earns nothing
+  now -= 10.0;
+  ASSERT_DOUBLE_EQ(2.0, b.charge(rate, rate, now));
+}
+
+TEST(DeepScrubReadBudget, rate_change) {
+  DeepScrubReadBudget b;
+  utime_t now(100, 0);
+  ASSERT_DOUBLE_EQ(2.0, b.charge(2 << 20, 1 << 20, now));
+
+  // disabling the limit forgives any debt
+  ASSERT_EQ(0, b.charge(2 << 20, 0, now));
+  ASSERT_DOUBLE_EQ(1.0, b.charge(2 << 20, 2 << 20, now));
+}
+
 // Local Variables:
 // compile-command: "cd ../.. ; make unittest_osdscrub ; ./unittest_osdscrub --log-to-stderr=true  --debug-osd=20 # --gtest_filter=*.* "
 // End:
@@ -1258,6 +1258,36 @@ TEST(pg_missing_t, split_into)
   EXPECT_TRUE(missing.is_missing(oid2));
 }
 
+TEST(eversion_t, denc) {
+  const eversion_t v(3, 0x123456789ull);
+  bufferlist legacy;
+  v.encode(legacy);
+
+  bufferlist bl;
+  {
+    size_t len = 0;
+    denc(v, len);
+    ASSERT_EQ(legacy.length(), len);
+    auto a = bl.get_contiguous_appender(len);
+    denc(v, a);
+  }
+  ASSERT_TRUE(bl.contents_equal(legacy));
+
+  eversion_t out;
+  auto p = std::cbegin(bl.front());
+  denc(out, p);
+  ASSERT_EQ(v, out);
+
+  // containers of eversion_t now take the denc path, on the same wire format
+  vector<eversion_t> vs{v, eversion_t(1, 2)}, vs_out;
+  bufferlist vbl;
+  encode(vs, vbl);
+  auto q = vbl.cbegin();
+  decode(vs_out, q);
+  ASSERT_EQ(vs, vs_out);
+  ASSERT_EQ(sizeof(uint32_t) + 2 * legacy.length(), vbl.length());
+}
+
 TEST(pg_pool_t_test, get_pg_num_divisor) {
   pg_pool_t p;
   p.set_pg_num(16);
@@ -1819,6 +1849,24 @@ TEST_F(PITest, past_intervals_ec_lost) {
     /* pg_down    */ false);
 }
 
+TEST(ScrubMapBuilder, work_item_done) {
+  ScrubMapBuilder pos;
+  ASSERT_FALSE(pos.work_item_done(0));
+  ASSERT_FALSE(pos.work_item_done(4096));
+
+  // with no byte limit, yield after the first read
+  pos.bytes_read = 512;
+  ASSERT_TRUE(pos.work_item_done(0));
+  ASSERT_FALSE(pos.work_item_done(4096));
+
+  // reads span objects until the limit is reached
+  pos.next_object();
+  pos.bytes_read += 3584;
+  ASSERT_TRUE(pos.work_item_done(4096));
+  pos.bytes_read += 1;
+  ASSERT_TRUE(pos.work_item_done(4096));
+}
+
 
 /*
  * Local Variables:
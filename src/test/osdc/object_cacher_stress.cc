@@ -3,8 +3,10 @@
 
 #include <cstdlib>
 #include <ctime>
+#include <random>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 #include <boost/scoped_ptr.hpp>
 
@@ -12,6 +14,7 @@
 #include "common/common_init.h"
 #include "common/config.h"
 #include "common/Mutex.h"
+#include "common/ceph_time.h"
 #include "common/snap_types.h"
 #include "global/global_init.h"
 #include "include/buffer.h"
@@ -175,6 +178,156 @@ int stress_test(uint64_t num_ops, uint64_t num_objs,
   return EXIT_SUCCESS;
 }
 
+// an independently locked cache, as used by librbd with rbd_cache_shards
+struct cacher_shard {
+  Mutex lock;
+  FakeWriteback writeback;
+  ObjectCacher obc;
+  ObjectCacher::ObjectSet object_set;
+
+  cacher_shard(uint64_t delay_ns, uint64_t num_shards)
+    : lock("object_cacher_stress::shard"),
+      writeback(g_ceph_context, &lock, delay_ns),
+      obc(g_ceph_context, "test", writeback, lock, NULL, NULL,
+	  g_conf()->client_oc_size / num_shards,
+	  std::max<uint64_t>(1, g_conf()->client_oc_max_objects / num_shards),
+	  g_conf()->client_oc_max_dirty / num_shards,
+	  g_conf()->client_oc_target_dirty / num_shards,
+	  g_conf()->client_oc_max_dirty_age,
+	  true),
+      object_set(NULL, 0, 0) {
+    obc.start();
+  }
+
+  int shut_down() {
+    C_SaferCond flush_ctx;
+    lock.Lock();
+    obc.release_set(&object_set);
+    obc.flush_set(&object_set, &flush_ctx);
+    lock.Unlock();
+    flush_ctx.wait();
+
+    lock.Lock();
+    loff_t unclean = obc.release_set(&object_set);
+    lock.Unlock();
+    obc.stop();
+    return unclean == 0 ? 0 : -EBUSY;
+  }
+};
+
+void scaling_worker(std::vector<std::unique_ptr<cacher_shard> > *shards,
+		    uint64_t num_ops, uint64_t num_objs, uint64_t max_obj_size,
+		    uint64_t max_op_len, float percent_reads, unsigned seed,
+		    std::atomic<unsigned> *outstanding_reads,
+		    std::vector<std::shared_ptr<op_data> > *ops)
+{
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<float> read_dist(0, 1);
+  SnapContext snapc;
+  ceph::bufferlist bl;
+  bl.append_zero(max_op_len);
+
+  for (uint64_t i = 0; i < num_ops; ++i) {
+    uint64_t offset = rng() % max_obj_size;
+    uint64_t max_len = std::min(max_obj_size - offset, max_op_len);
+    uint64_t length = rng() % (std::max<uint64_t>(max_len - 1, 1)) + 1;
+    uint64_t object_no = rng() % num_objs;
+    bool is_read = read_dist(rng) < percent_reads;
+    auto &shard = *(*shards)[object_no % shards->size()];
+
+    std::shared_ptr<op_data> op(new op_data("test" + stringify(object_no),
+					    offset, length, is_read));
+    if (is_read) {
+      ops->push_back(op);
+      ObjectCacher::OSDRead *rd = shard.obc.prepare_read(CEPH_NOSNAP,
+							 &op->result, 0);
+      rd->extents.push_back(op->extent);
+      (*outstanding_reads)++;
+      Context *completion = new C_Count(op.get(), outstanding_reads);
+      shard.lock.Lock();
+      int r = shard.obc.readx(rd, &shard.object_set, completion);
+      shard.lock.Unlock();
+      ceph_assert(r >= 0);
+      if ((uint64_t)r == length)
+	completion->complete(r);
+      else
+	ceph_assert(r == 0);
+    } else {
+      ceph::bufferlist write_bl;
+      write_bl.substr_of(bl, 0, length);
+      ObjectCacher::OSDWrite *wr = shard.obc.prepare_write(
+	snapc, write_bl, ceph::real_time::min(), 0, 0);
+      wr->extents.push_back(op->extent);
+      shard.lock.Lock();
+      shard.obc.writex(wr, &shard.object_set, NULL);
+      shard.lock.Unlock();
+    }
+  }
+}
+
+int scaling_test(uint64_t num_ops, uint64_t num_objs,
+		 uint64_t max_obj_size, uint64_t delay_ns,
+		 uint64_t max_op_len, float percent_reads,
+		 uint64_t num_threads, uint64_t num_shards, int seed)
+{
+  std::cout << "Test configuration:\n\n"
+	    << setw(10) << "ops/thread: " << num_ops << "\n"
+	    << setw(10) << "threads: " << num_threads << "\n"
+	    << setw(10) << "shards: " << num_shards << "\n"
+	    << setw(10) << "objects: " << num_objs << "\n"
+	    << setw(10) << "obj size: " << max_obj_size << "\n"
+	    << setw(10) << "delay: " << delay_ns << "\n"
+	    << setw(10) << "max op len: " << max_op_len << "\n"
+	    << setw(10) << "percent reads: " << percent_reads << "\n\n";
+
+  std::vector<std::unique_ptr<cacher_shard> > shards;
+  for (uint64_t i = 0; i < num_shards; ++i) {
+    shards.emplace_back(new cacher_shard(delay_ns, num_shards));
+  }
+
+  std::atomic<unsigned> outstanding_reads = { 0 };
+  std::vector<std::vector<std::shared_ptr<op_data> > > ops(num_threads);
+  std::vector<std::thread> threads;
+
+  auto start = ceph::mono_clock::now();
+  for (uint64_t i = 0; i < num_threads; ++i) {
+    threads.emplace_back(scaling_worker, &shards, num_ops, num_objs,
+			 max_obj_size, max_op_len, percent_reads, seed + i,
+			 &outstanding_reads, &ops[i]);
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  while (outstanding_reads > 0) {
+    usleep(100);
+  }
+  auto elapsed = std::chrono::duration<double>(
+    ceph::mono_clock::now() - start).count();
+
+  for (auto &thread_ops : ops) {
+    for (auto &op : thread_ops) {
+      if (op->done != 1) {
+	std::cout << "read " << op->extent << " completed " << op->done
+		  << " times!" << std::endl;
+	return EXIT_FAILURE;
+      }
+    }
+  }
+
+  std::cout << "elapsed: " << elapsed << " s\n"
+	    << "ops/sec: " << num_ops * num_threads / elapsed << std::endl;
+
+  for (auto &shard : shards) {
+    if (shard->shut_down() < 0) {
+      std::cout << "unclean buffers left over!" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  std::cout << "Test completed successfully." << std::endl;
+  return EXIT_SUCCESS;
+}
+
 int correctness_test(uint64_t delay_ns)
 {
   std::cerr << "starting correctness test" << std::endl;
@@ -366,8 +519,11 @@ int main(int argc, const char **argv)
   long long num_objs = 10;
   float percent_reads = 0.90;
   int seed = time(0) % 100000;
+  long long num_threads = 1;
+  long long num_shards = 1;
   bool stress = false;
   bool correctness = false;
+  bool scaling = false;
   std::ostringstream err;
   std::vector<const char*>::iterator i;
   for (i = args.begin(); i != args.end();) {
@@ -406,10 +562,22 @@ int main(int argc, const char **argv)
 	cerr << argv[0] << ": " << err.str() << std::endl;
 	return EXIT_FAILURE;
       }
+    } else if (ceph_argparse_witharg(args, i, &num_threads, err, "--threads", (char*)NULL)) {
+      if (!err.str().empty()) {
+	cerr << argv[0] << ": " << err.str() << std::endl;
+	return EXIT_FAILURE;
+      }
+    } else if (ceph_argparse_witharg(args, i, &num_shards, err, "--shards", (char*)NULL)) {
+      if (!err.str().empty()) {
+	cerr << argv[0] << ": " << err.str() << std::endl;
+	return EXIT_FAILURE;
+      }
     } else if (ceph_argparse_flag(args, i, "--stress-test", NULL)) {
       stress = true;
     } else if (ceph_argparse_flag(args, i, "--correctness-test", NULL)) {
       correctness = true;
+    } else if (ceph_argparse_flag(args, i, "--scaling-test", NULL)) {
+      scaling = true;
     } else {
       cerr << "unknown option " << *i << std::endl;
       return EXIT_FAILURE;
@@ -423,4 +591,13 @@ int main(int argc, const char **argv)
   if (correctness) {
     return correctness_test(delay_ns);
   }
+  if (scaling) {
+    if (num_threads < 1 || num_shards < 1) {
+      cerr << argv[0] << ": --threads and --shards must be positive"
+	   << std::endl;
+      return EXIT_FAILURE;
+    }
+    return scaling_test(num_ops, num_objs, obj_bytes, delay_ns, max_len,
+			percent_reads, num_threads, num_shards, seed);
+  }
 }
@@ -0,0 +1,247 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "gtest/gtest.h"
+#include "osd/OSDMap.h"
+#include "osdc/Objecter.h"
+#include "include/stringify.h"
+
+#include "global/global_context.h"
+#include "global/global_init.h"
+#include "common/common_init.h"
+#include "common/ceph_argparse.h"
+
+int main(int argc, char **argv) {
+  std::vector<const char*> args(argv, argv+argc);
+  auto cct = global_init(nullptr, args, CEPH_ENTITY_TYPE_CLIENT,
+			 CODE_ENVIRONMENT_UTILITY,
+			 CINIT_FLAG_NO_DEFAULT_CONFIG_FILE);
+  common_init_finish(g_ceph_context);
+  g_ceph_context->_conf.set_val("osd_crush_chooseleaf_type", "0");
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
+
+class TargetChangesTest : public testing::Test {
+  const static int num_osds = 6;
+public:
+  OSDMap osdmap;
+  const int64_t pool_a = 1;
+  const int64_t pool_b = 2;
+
+  void SetUp() override {
+    uuid_d fsid;
+    osdmap.build_simple(g_ceph_context, 0, fsid, num_osds);
+    OSDMap::Incremental pending_inc(osdmap.get_epoch() + 1);
+    pending_inc.fsid = osdmap.get_fsid();
+    entity_addrvec_t sample_addrs;
+    sample_addrs.v.push_back(entity_addr_t());
+    for (int i = 0; i < num_osds; ++i) {
+      sample_addrs.v[0].nonce = i;
+      pending_inc.new_state[i] = CEPH_OSD_EXISTS | CEPH_OSD_NEW;
+      pending_inc.new_up_client[i] = sample_addrs;
+      pending_inc.new_up_cluster[i] = sample_addrs;
+      pending_inc.new_hb_back_up[i] = sample_addrs;
+      pending_inc.new_hb_front_up[i] = sample_addrs;
+      pending_inc.new_weight[i] = CEPH_OSD_IN;
+    }
+    osdmap.apply_incremental(pending_inc);
+
+    OSDMap::Incremental new_pool_inc(osdmap.get_epoch() + 1);
+    new_pool_inc.new_pool_max = osdmap.get_pool_max();
+    new_pool_inc.fsid = osdmap.get_fsid();
+    pg_pool_t empty;
+    for (auto pool : {pool_a, pool_b}) {
+      ceph_assert(pool == ++new_pool_inc.new_pool_max);
+      pg_pool_t *p = new_pool_inc.get_new_pool(pool, &empty);
+      p->size = 3;
+      p->set_pg_num(64);
+      p->set_pgp_num(64);
+      p->type = pg_pool_t::TYPE_REPLICATED;
+      p->crush_rule = 0;
+      p->set_flag(pg_pool_t::FLAG_HASHPSPOOL);
+      new_pool_inc.new_pool_names[pool] = stringify(pool);
+    }
+    osdmap.apply_incremental(new_pool_inc);
+  }
+
+  // map a target the way Objecter::_calc_target() does
+  Objecter::op_target_t get_target(int64_t pool, const string& name) {
+    Objecter::op_target_t t(object_t(name), object_locator_t(pool), 0);
+    t.target_oid = t.base_oid;
+    t.target_oloc = t.base_oloc;
+    pg_t raw_pgid;
+    int r = osdmap.object_locator_to_pg(t.target_oid, t.target_oloc,
+					raw_pgid);
+    ceph_assert(r == 0);
+    t.pgid = raw_pgid;
+    t.actual_pgid = spg_t(osdmap.raw_pg_to_pg(raw_pgid));
+    osdmap.pg_to_up_acting_osds(t.actual_pgid.pgid, &t.up, &t.up_primary,
+				&t.acting, &t.acting_primary);
+    t.osd = t.acting_primary;
+    t.epoch = osdmap.get_epoch();
+    ceph_assert(t.osd >= 0);
+    return t;
+  }
+
+  // a target in the same pool as t, in another pg
+  Objecter::op_target_t get_target_in_other_pg(
+    const Objecter::op_target_t& t) {
+    for (int i = 0; ; ++i) {
+      auto other = get_target(t.base_oloc.pool, "other" + stringify(i));
+      if (other.actual_pgid != t.actual_pgid) {
+	return other;
+      }
+    }
+  }
+
+  OSDMap::Incremental new_inc() {
+    OSDMap::Incremental inc(osdmap.get_epoch() + 1);
+    inc.fsid = osdmap.get_fsid();
+    return inc;
+  }
+};
+
+TEST_F(TargetChangesTest, Nothing) {
+  auto t = get_target(pool_a, "foo");
+  auto inc = new_inc();
+  Objecter::target_changes_t changes(inc, false);
+  ASSERT_FALSE(changes.all);
+  ASSERT_FALSE(changes.may_change(t));
+
+  // unmapped and paused targets are always rechecked
+  auto unmapped = t;
+  unmapped.osd = -1;
+  ASSERT_TRUE(changes.may_change(unmapped));
+  auto paused = t;
+  paused.paused = true;
+  ASSERT_TRUE(changes.may_change(paused));
+}
+
+TEST_F(TargetChangesTest, PoolChange) {
+  auto a = get_target(pool_a, "foo");
+  auto b = get_target(pool_b, "foo");
+  auto inc = new_inc();
+  pg_pool_t *p = inc.get_new_pool(pool_a, osdmap.get_pg_pool(pool_a));
+  p->set_pg_num(128);
+  Objecter::target_changes_t changes(inc, false);
+  ASSERT_FALSE(changes.all);
+  ASSERT_TRUE(changes.may_change(a));
+  ASSERT_FALSE(changes.may_change(b));
+
+  // so does deleting it
+  auto del = new_inc();
+  del.old_pools.insert(pool_b);
+  Objecter::target_changes_t del_changes(del, false);
+  ASSERT_FALSE(del_changes.may_change(a));
+  ASSERT_TRUE(del_changes.may_change(b));
+
+  // an op redirected to a changed pool (e.g. a cache tier) is rechecked
+  auto redirected = b;
+  redirected.target_oloc.pool = pool_a;
+  ASSERT_TRUE(changes.may_change(redirected));
+}
+
+TEST_F(TargetChangesTest, PGTemp) {
+  auto t = get_target(pool_a, "foo");
+  auto other = get_target_in_other_pg(t);
+  auto inc = new_inc();
+  vector<int32_t> temp(t.acting.rbegin(), t.acting.rend());
+  inc.new_pg_temp[t.actual_pgid.pgid] =
+    mempool::osdmap::vector<int32_t>(temp.begin(), temp.end());
+  Objecter::target_changes_t changes(inc, false);
+  ASSERT_FALSE(changes.all);
+  ASSERT_TRUE(changes.may_change(t));
+  ASSERT_FALSE(changes.may_change(other));
+
+  // and the target did move
+  osdmap.apply_incremental(inc);
+  ASSERT_NE(t.osd, get_target(pool_a, "foo").osd);
+  ASSERT_EQ(other.osd, get_target(pool_a, other.base_oid.name).osd);
+}
+
+TEST_F(TargetChangesTest, PrimaryTemp) {
+  auto t = get_target(pool_a, "foo");
+  auto other = get_target_in_other_pg(t);
+  auto inc = new_inc();
+  inc.new_primary_temp[t.actual_pgid.pgid] = t.acting.back();
+  Objecter::target_changes_t changes(inc, false);
+  ASSERT_TRUE(changes.may_change(t));
+  ASSERT_FALSE(changes.may_change(other));
+}
+
+TEST_F(TargetChangesTest, Upmap) {
+  auto t = get_target(pool_a, "foo");
+  auto other = get_target_in_other_pg(t);
+  int spare = 0;
+  while (std::find(t.up.begin(), t.up.end(), spare) != t.up.end()) {
+    ++spare;
+  }
+  {
+    auto inc = new_inc();
+    inc.new_pg_upmap_items[t.actual_pgid.pgid] =
+      mempool::osdmap::vector<pair<int32_t,int32_t>>(
+	{make_pair(t.up[0], spare)});
+    Objecter::target_changes_t changes(inc, false);
+    ASSERT_TRUE(changes.may_change(t));
+    ASSERT_FALSE(changes.may_change(other));
+  }
+  {
+    auto inc = new_inc();
+    inc.new_pg_upmap[t.actual_pgid.pgid] =
+      mempool::osdmap::vector<int32_t>(t.up.rbegin(), t.up.rend());
+    Objecter::target_changes_t changes(inc, false);
+    ASSERT_TRUE(changes.may_change(t));
+    ASSERT_FALSE(changes.may_change(other));
+  }
+  {
+    auto inc = new_inc();
+    inc.old_pg_upmap_items.insert(t.actual_pgid.pgid);
+    Objecter::target_changes_t changes(inc, false);
+    ASSERT_TRUE(changes.may_change(t));
+    ASSERT_FALSE(changes.may_change(other));
+  }
+}
+
+TEST_F(TargetChangesTest, GlobalChange) {
+  auto a = get_target(pool_a, "foo");
+  auto b = get_target(pool_b, "foo");
+  vector<OSDMap::Incremental> incs;
+  incs.push_back(new_inc());
+  incs.back().new_state[a.osd] = CEPH_OSD_UP;
+  incs.push_back(new_inc());
+  incs.back().new_weight[a.osd] = CEPH_OSD_OUT;
+  incs.push_back(new_inc());
+  incs.back().new_primary_affinity[a.osd] = 0;
+  incs.push_back(new_inc());
+  incs.back().new_flags = osdmap.get_flags() | CEPH_OSDMAP_PAUSEWR;
+  incs.push_back(new_inc());
+  incs.back().new_max_osd = osdmap.get_max_osd() + 1;
+  incs.push_back(new_inc());
+  osdmap.crush->encode(incs.back().crush, CEPH_FEATURES_SUPPORTED_DEFAULT);
+  for (auto& inc : incs) {
+    Objecter::target_changes_t changes(inc, false);
+    ASSERT_TRUE(changes.all);
+    ASSERT_TRUE(changes.may_change(a));
+    ASSERT_TRUE(changes.may_change(b));
+  }
+}
+
+TEST_F(TargetChangesTest, SkippedEpoch) {
+  auto a = get_target(pool_a, "foo");
+  auto b = get_target(pool_b, "foo");
+  auto inc = new_inc();
+  inc.get_new_pool(pool_a, osdmap.get_pg_pool(pool_a))->set_pg_num(128);
+
+  // the epochs before inc are unknown, so every target is rechecked
+  Objecter::target_changes_t changes(inc, true);
+  ASSERT_TRUE(changes.all);
+  ASSERT_TRUE(changes.may_change(a));
+  ASSERT_TRUE(changes.may_change(b));
+
+  // as is the case for a full map
+  Objecter::target_changes_t full;
+  ASSERT_TRUE(full.all);
+  ASSERT_TRUE(full.may_change(a));
+  ASSERT_TRUE(full.may_change(b));
+}
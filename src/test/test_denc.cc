@@ -19,6 +19,7 @@
 
 #include "global/global_init.h"
 #include "common/ceph_argparse.h"
+#include "common/Clock.h"
 #include "global/global_context.h"
 #include "gtest/gtest.h"
 
@@ -739,3 +740,104 @@ TEST(denc, no_copy_if_segmented_and_lengthy)
     ASSERT_EQ(CEPH_PAGE_SIZE * 2, Legacy::n_decode);
   }
 }
+
+TEST(denc, memcpy_safe)
+{
+  static_assert(_denc::is_memcpy_safe_v<ceph_le32>);
+  static_assert(_denc::is_memcpy_safe_v<uint8_t>);
+  static_assert(!_denc::is_memcpy_safe_v<bool>);
+  static_assert(!_denc::is_memcpy_safe_v<std::string>);
+  static_assert(!denc_traits<std::list<ceph_le32>>::memcpy_safe);
+  {
+    cout << "std::vector<ceph_le64>" << std::endl;
+    std::vector<ceph_le64> v(100);
+    for (unsigned i = 0; i < v.size(); i++) {
+      v[i] = i;
+    }
+    test_denc(v);
+  }
+  {
+    cout << "std::vector<uint32_t>" << std::endl;
+    std::vector<uint32_t> v(100);
+    std::iota(v.begin(), v.end(), 1);
+    test_denc(v);
+    // the encoding is the same as the element-wise one
+    bufferlist bl, expected;
+    encode(v, bl);
+    encode((uint32_t)v.size(), expected);
+    for (auto i : v) {
+      encode(i, expected);
+    }
+    ASSERT_TRUE(bl.contents_equal(expected));
+  }
+  {
+    cout << "std::array<uint16_t, 5>" << std::endl;
+    std::array<uint16_t, 5> s = { 1, 2, 3, 4, 5 };
+    test_denc(s);
+  }
+  {
+    // decode a segmented bufferlist with a bufferlist iterator
+    std::vector<uint64_t> v(100), out;
+    std::iota(v.begin(), v.end(), 1);
+    bufferlist bl;
+    encode(v, bl);
+    bufferlist segmented;
+    for (unsigned off = 0; off < bl.length(); off += 13) {
+      bufferlist seg;
+      seg.substr_of(bl, off, std::min(13u, bl.length() - off));
+      segmented.append(seg.c_str(), seg.length());
+    }
+    ASSERT_GT(segmented.get_num_buffers(), 1u);
+    auto p = segmented.cbegin();
+    denc_traits<std::vector<uint64_t>>::decode(out, p);
+    ASSERT_EQ(v, out);
+  }
+  {
+    // a truncated run is detected before anything is copied
+    std::vector<uint32_t> v(100), out;
+    bufferlist bl;
+    encode(v, bl);
+    bufferlist truncated;
+    truncated.substr_of(bl, 0, bl.length() - 1);
+    auto p = truncated.cbegin();
+    ASSERT_THROW(decode(out, p), buffer::end_of_buffer);
+    truncated.rebuild();
+    auto bpi = truncated.front().begin();
+    ASSERT_THROW(denc(out, bpi), buffer::end_of_buffer);
+  }
+}
+
+template<typename T>
+static void bench_denc(const char* name, const T& v)
+{
+  constexpr unsigned rounds = 1000;
+  bufferlist bl;
+  utime_t start = ceph_clock_now();
+  for (unsigned i = 0; i < rounds; i++) {
+    bl.clear();
+    encode(v, bl);
+  }
+  const utime_t encoded = ceph_clock_now();
+  for (unsigned i = 0; i < rounds; i++) {
+    T out;
+    auto p = bl.cbegin();
+    decode(out, p);
+  }
+  cout << rounds << " rounds of " << name << " (" << bl.length()
+       << " bytes): encode " << (encoded - start)
+       << ", decode " << (ceph_clock_now() - encoded) << std::endl;
+}
+
+TEST(denc, memcpy_safe_bench)
+{
+  // vectors are copied as a whole, while lists go element by element
+  constexpr unsigned n = 65536;
+  std::vector<uint64_t> v(n);
+  std::iota(v.begin(), v.end(), 0);
+  bench_denc("std::vector<uint64_t>", v);
+  bench_denc("std::list<uint64_t>", std::list<uint64_t>(v.begin(), v.end()));
+  std::vector<uint16_t> v16(v.begin(), v.end());
+  bench_denc("std::vector<uint16_t>", v16);
+  bench_denc("std::list<uint16_t>",
+	     std::list<uint16_t>(v16.begin(), v16.end()));
+}
@@ -38,6 +38,8 @@ void usage()
   cout << "   --test-map-pgs [--pool <poolid>] [--pg_num <pg_num>] [--range-first <first> --range-last <last>] map all pgs" << std::endl;
   cout << "   --test-map-pgs-dump [--pool <poolid>] [--range-first <first> --range-last <last>] map all pgs" << std::endl;
   cout << "   --test-map-pgs-dump-all [--pool <poolid>] [--range-first <first> --range-last <last>] map all pgs to osds" << std::endl;
+  cout << "   --test-map-pgs-bench <iterations> [--pool <poolid>] compare batched vs" << std::endl;
+  cout << "                           per-pg mapping throughput of all pgs" << std::endl;
   cout << "   --mark-up-in            mark osds up and in (but do not persist)" << std::endl;
   cout << "   --mark-out <osdid>      mark an osd as out (but do not persist)" << std::endl;
   cout << "   --with-default-pool     include default pool when creating map" << std::endl;
@@ -146,6 +148,7 @@ int main(int argc, const char **argv)
   std::set<std::string> upmap_pools;
   int64_t pg_num = -1;
   bool test_map_pgs_dump_all = false;
+  int test_map_pgs_bench = 0;
 
   std::string val;
   std::ostringstream err;
@@ -201,6 +204,11 @@ int main(int argc, const char **argv)
       test_map_pgs_dump = true;
     } else if (ceph_argparse_flag(args, i, "--test-map-pgs-dump-all", (char*)NULL)) {
       test_map_pgs_dump_all = true;
+    } else if (ceph_argparse_witharg(args, i, &test_map_pgs_bench, err, "--test-map-pgs-bench", (char*)NULL)) {
+      if (!err.str().empty()) {
+	cerr << err.str() << std::endl;
+	exit(EXIT_FAILURE);
+      }
     } else if (ceph_argparse_flag(args, i, "--test-random", (char*)NULL)) {
       test_random = true;
     } else if (ceph_argparse_flag(args, i, "--clobber", (char*)NULL)) {
@@ -614,6 +622,62 @@ int main(int argc, const char **argv)
         cout << "size " << i << "\t" << size[i] << std::endl;
     }
   }
+  if (test_map_pgs_bench > 0) {
+    if (pool != -1 && !osdmap.have_pg_pool(pool)) {
+      cerr << "There is no pool " << pool << std::endl;
+      exit(1);
+    }
+    uint64_t num_pgs = 0;
+    for (auto& p : osdmap.get_pools()) {
+      if (pool == -1 || p.first == pool)
+	num_pgs += p.second.get_pg_num();
+    }
+    map<int64_t,vector<vector<int>>> batched, scalar;
+
+    utime_t start = ceph_clock_now();
+    for (int n = 0; n < test_map_pgs_bench; ++n) {
+      for (auto& p : osdmap.get_pools()) {
+	if (pool != -1 && p.first != pool)
+	  continue;
+	auto& acting_by_ps = batched[p.first];
+	acting_by_ps.resize(p.second.get_pg_num());
+	osdmap.pg_range_to_up_acting_osds(
+	  p.first, 0, p.second.get_pg_num(),
+	  [&](ps_t ps,
+	      vector<int>& up, int up_primary,
+	      vector<int>& acting, int acting_primary) {
+	    acting_by_ps[ps].swap(acting);
+	  });
+      }
+    }
+    utime_t batched_dur = ceph_clock_now() - start;
+
+    start = ceph_clock_now();
+    for (int n = 0; n < test_map_pgs_bench; ++n) {
+      for (auto& p : osdmap.get_pools()) {
+	if (pool != -1 && p.first != pool)
+	  continue;
+	auto& acting_by_ps = scalar[p.first];
+	acting_by_ps.resize(p.second.get_pg_num());
+	for (unsigned ps = 0; ps < p.second.get_pg_num(); ++ps) {
+	  osdmap.pg_to_acting_osds(pg_t(ps, p.first), acting_by_ps[ps]);
+	}
+      }
+    }
+    utime_t scalar_dur = ceph_clock_now() - start;
+
+    uint64_t total = num_pgs * test_map_pgs_bench;
+    cout << "mapped " << num_pgs << " pgs x " << test_map_pgs_bench
+	 << " iterations" << std::endl;
+    cout << " batched " << batched_dur << " s ("
+	 << (uint64_t)(total / (double)batched_dur) << " pgs/s)" << std::endl;
+    cout << " per-pg  " << scalar_dur << " s ("
+	 << (uint64_t)(total / (double)scalar_dur) << " pgs/s)" << std::endl;
+    if (batched != scalar) {
+      cerr << "batched and per-pg mappings differ!" << std::endl;
+      exit(1);
+    }
+  }
   if (test_crush) {
     int pass = 0;
     while (1) {
@@ -649,6 +713,7 @@ int main(int argc, const char **argv)
       export_crush.empty() && import_crush.empty() && 
       test_map_pg.empty() && test_map_object.empty() &&
       !test_map_pgs && !test_map_pgs_dump && !test_map_pgs_dump_all &&
+      !test_map_pgs_bench &&
       !upmap && !upmap_cleanup) {
     cerr << me << ": no action specified?" << std::endl;
     usage();